@@ -50,6 +50,11 @@ typedef AVCodec*            AVCodecPtr;
 
 #define DONOT_CACHE_HWAVFRAME 1
 
+namespace MediaCore
+{
+class YuvToRgbaConverter;
+}
+
 MEDIACORE_API extern const AVRational MILLISEC_TIMEBASE;
 MEDIACORE_API extern const AVRational MICROSEC_TIMEBASE;
 MEDIACORE_API extern const AVRational FF_AV_TIMEBASE;
@@ -70,11 +75,19 @@ MEDIACORE_API SelfFreeAVPacketPtr CloneSelfFreeAVPacketPtr(const AVPacket* avpkt
 MEDIACORE_API SelfFreeAVPacketPtr WrapSelfFreeAVPacketPtr(AVPacket* avpkt);
 
 MEDIACORE_API AVPixelFormat GetAVPixelFormatByName(const std::string& name);
+// Return true if the pixel format has alpha channel or palette, or is unknown
+MEDIACORE_API bool IsPixelFormatWithAlpha(AVPixelFormat pixfmt);
 MEDIACORE_API AVSampleFormat GetAVSampleFormatByDataType(ImDataType dataType, bool isPlanar);
 MEDIACORE_API ImColorFormat ConvertPixelFormatToColorFormat(AVPixelFormat pixfmt);
 MEDIACORE_API ImDataType GetDataTypeFromSampleFormat(AVSampleFormat smpfmt);
 MEDIACORE_API bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp);
 MEDIACORE_API bool MapAVFrameToImMat(const AVFrame* avfrm, std::vector<ImGui::ImMat>& vmat, double timestamp);
+// Create an ImMat sharing the buffer of a packed rgb AVFrame without copying, the ImMat holds a reference of the AVFrame
+// until its last copy is released. Return false if the frame can not be wrapped, e.g. its rows are padded. The planar
+// and the yuv frames are never wrapped, since ImMat has no per-plane pointer or stride, they are converted with copying.
+MEDIACORE_API bool WrapAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp);
+// Return a reference of the AVFrame wrapped by 'vmat', or null if 'vmat' is not created by 'WrapAVFrameToImMat()'.
+MEDIACORE_API SelfFreeAVFramePtr GetWrappedAVFrame(const ImGui::ImMat& vmat);
 MEDIACORE_API bool ConvertImMatToAVFrame(const ImGui::ImMat& vmat, AVFrame* avfrm, int64_t pts);
 MEDIACORE_API AVPixelFormat ConvertColorFormatToPixelFormat(ImColorFormat clrfmt, ImDataType dtype);
 
@@ -101,6 +114,12 @@ public:
     ImInterpolateMode GetResizeInterpolateMode() const { return m_resizeInterp; }
 
     void SetUseVulkanConverter(bool use) { m_useVulkanComponents = use; }
+    // Convert the common YUV formats with the SIMD kernels on cpu instead of 'swscale', it's enabled by default
+    void SetUseSimdConverter(bool use) { m_useSimdConverter = use; }
+    // Share the buffer of the AVFrame with the output ImMat instead of copying it when possible, it's enabled by default.
+    // Only the packed rgb frames output without scaling are shared, see 'WrapAVFrameToImMat()'.
+    void SetZeroCopy(bool enable) { m_zeroCopy = enable; }
+    bool IsZeroCopy() const { return m_zeroCopy; }
 
     std::string GetError() const { return m_errMsg; }
 
@@ -122,6 +141,9 @@ private:
     AVPixelFormat m_swsOutFormat{AV_PIX_FMT_RGBA};
     AVColorSpace m_swsClrspc{AVCOL_SPC_RGB};
     bool m_passThrough{false};
+    bool m_zeroCopy{true};
+    bool m_useSimdConverter{true};
+    MediaCore::YuvToRgbaConverter* m_yuvCvt{nullptr};
     std::string m_errMsg;
 };
 
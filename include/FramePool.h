@@ -0,0 +1,71 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <immat.h>
+#include "MediaCore.h"
+#include "Logger.h"
+
+struct AVFrame;
+
+namespace MediaCore
+{
+// Pool of the buffers used by the output frames of the decoding/conversion stage. A buffer acquired from
+// the pool goes back to it when the last reference to the buffer is released, and is reused by the next
+// request of the same size class.
+struct FramePool
+{
+    using Holder = std::shared_ptr<FramePool>;
+    static MEDIACORE_API Holder CreateInstance(const std::string& name = "");
+    // The process-wide pool shared by all the readers, its capacity is 1GB
+    static MEDIACORE_API Holder GetDefaultInstance();
+
+    // Create a cpu ImMat with buffer from the pool. The previous content of 'm' is released.
+    virtual bool AcquireMat(ImGui::ImMat& m, int w, int h, int c, ImDataType dtype) = 0;
+    // Allocate the buffer of a video AVFrame from the pool, 'format', 'width' and 'height' of 'avfrm' must be set.
+    // It's a replacement of 'av_frame_get_buffer()'.
+    virtual bool AllocAVFrameBuffer(AVFrame* avfrm) = 0;
+
+    // Maximum bytes held by the pool, 0 means no limit. Requests beyond the capacity are still served, but the buffers are not kept.
+    // A pool with a capacity registers as a consumer of the default 'MemoryBudget', the quota from it also limits the pool.
+    virtual void SetCapacity(uint64_t maxBytes) = 0;
+    virtual uint64_t GetCapacity() const = 0;
+    // Release all the idle buffers
+    virtual void Trim() = 0;
+
+    struct Stats
+    {
+        uint64_t matRequests{0};
+        uint64_t matHits{0};
+        uint64_t frameRequests{0};
+        uint64_t frameHits{0};
+        uint64_t bytesHeld{0};      // bytes of all the buffers owned by the pool, including the ones in use
+        uint64_t bytesInUse{0};
+
+        double MatHitRate() const { return matRequests > 0 ? (double)matHits/matRequests : 0; }
+        double FrameHitRate() const { return frameRequests > 0 ? (double)frameHits/frameRequests : 0; }
+    };
+    virtual Stats GetStats() const = 0;
+    virtual void ResetStats() = 0;
+
+    virtual void SetLogLevel(Logger::Level l) = 0;
+    virtual std::string GetError() const = 0;
+};
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "MediaCore.h"
+#include "MediaInfo.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+// Probe media files in batch. Probing runs concurrently on the shared 'TaskExecutor', and the
+// resulting 'MediaInfo' is cached in the index cache directory (see 'MediaParser::SetIndexCacheDirectory()').
+struct MediaImporter
+{
+    using Holder = std::shared_ptr<MediaImporter>;
+    static MEDIACORE_API Holder CreateInstance();
+
+    struct ProbeResult
+    {
+        std::string url;
+        MediaInfo::Holder hMediaInfo;   // nullptr if probing is failed
+        bool fromCache{false};
+        std::string errMsg;
+    };
+    // It's invoked on the worker thread as soon as a probing task is finished.
+    using ResultCallback = std::function<void(const ProbeResult& result)>;
+
+    virtual bool Import(const std::vector<std::string>& urls, ResultCallback callback) = 0;
+    // Wait until all the imported urls are probed, 'timeout' < 0 means waiting forever.
+    virtual bool WaitAll(int32_t timeout = -1) = 0;
+    // Drop the urls which are not probed yet, the running tasks are still waited.
+    virtual void Cancel() = 0;
+    virtual uint32_t GetPendingCount() const = 0;
+
+    virtual void SetMaxConcurrency(uint32_t maxConcurrency) = 0;
+    virtual void EnableProbeCache(bool enable) = 0;
+
+    virtual void SetLogLevel(Logger::Level l) = 0;
+    virtual std::string GetError() const = 0;
+};
+}
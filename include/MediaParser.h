@@ -32,6 +32,9 @@ struct MediaParser
     using Holder = std::shared_ptr<MediaParser>;
     static MEDIACORE_API Holder CreateInstance();
     static MEDIACORE_API Logger::ALogger* GetLogger();
+    // Directory to store the persistent video index files. An empty path disables the index cache.
+    static MEDIACORE_API void SetIndexCacheDirectory(const std::string& dirPath);
+    static MEDIACORE_API std::string GetIndexCacheDirectory();
 
     virtual bool Open(const std::string& url) = 0;
     virtual bool OpenImageSequence(const Ratio& frameRate,
@@ -42,6 +45,7 @@ struct MediaParser
     {
         MEDIA_INFO = 0,
         VIDEO_SEEK_POINTS,
+        VIDEO_FRAME_INDEX,
     };
     virtual bool EnableParseInfo(InfoType infoType) = 0;
     virtual bool CheckInfoReady(InfoType infoType) = 0;
@@ -61,6 +65,20 @@ struct MediaParser
     using SeekPointsHolder = std::shared_ptr<std::vector<int64_t>>;
     virtual SeekPointsHolder GetVideoSeekPoints(bool wait = true) = 0;
 
+    struct VideoFrameIndexEntry
+    {
+        int64_t pts;
+        int64_t dts;
+        int64_t pos;        // byte offset of the packet in the file, -1 if it's unknown
+        uint32_t size;
+        uint32_t flags;     // AV_PKT_FLAG_xxx
+
+        bool IsKeyFrame() const { return (flags&0x1) != 0; }
+    };
+    // index of all the packets of the best video stream, sorted by 'dts'
+    using VideoFrameIndexHolder = std::shared_ptr<std::vector<VideoFrameIndexEntry>>;
+    virtual VideoFrameIndexHolder GetVideoFrameIndex(bool wait = true) = 0;
+
     virtual std::string GetError() const = 0;
 };
 }
@@ -32,6 +32,7 @@ namespace MediaCore
 struct MediaReader
 {
     using Holder = std::shared_ptr<MediaReader>;
+    // The caches of this reader are only limited by 'SetCacheDuration()', they are not consumers of the default 'MemoryBudget'.
     static MEDIACORE_API Holder CreateInstance(const std::string& loggerName = "");
     static MEDIACORE_API Holder CreateVideoInstance(const std::string& loggerName = "");
     static MEDIACORE_API Holder CreateImageSequenceInstance(const std::string& loggerName = "");
@@ -75,6 +76,11 @@ struct MediaReader
 
     virtual bool SetCacheDuration(double forwardDur, double backwardDur) = 0;
     virtual bool SetCacheFrames(bool readForward, uint32_t forwardFrames, uint32_t backwardFrames) = 0;
+    // Under backward playback, a video reader decodes each GOP once and keeps the decoded frames for reverse output.
+    // 'maxBytes' limits the memory of the kept frames, it's also bounded by the quota from the default 'MemoryBudget'.
+    // 0 disables the reverse-decode mode, which is the default. Only the readers created by 'CreateVideoInstance()'
+    // support it, the others return false for a non-zero 'maxBytes'. 'VideoClip' enables it with a default limit.
+    virtual bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) = 0;
     virtual std::pair<double, double> GetCacheDuration() const = 0;
     virtual bool IsHwAccelEnabled() const = 0;
     virtual void EnableHwAccel(bool enable) = 0;
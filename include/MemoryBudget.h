@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include "MediaCore.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+// Memory budget shared by the frame caches. Each cache registers as a consumer and reports the bytes it wants
+// and the bytes it holds, the budget splits its limit into per-consumer quotas. Consumers with higher priority
+// and the ones used recently get larger shares, a cache holding more than its quota should shrink.
+// The consumers of the default budget are the frame caches of the readers created by 'MediaReader::CreateVideoInstance()'
+// and 'MediaReader::CreateImageSequenceInstance()', the reverse decoders, the mixed-frame cache of 'MultiTrackVideoReader'
+// and the 'FramePool' instances with a capacity. The readers created by 'MediaReader::CreateInstance()' are not registered,
+// their snapshot and audio caches keep whole GOPs of the window set by 'SetCacheDuration()' and can't shrink to a quota.
+struct MemoryBudget
+{
+    using Holder = std::shared_ptr<MemoryBudget>;
+    // 'maxBytes' = 0 means no limit
+    static MEDIACORE_API Holder CreateInstance(uint64_t maxBytes = 0, const std::string& name = "");
+    // The process-wide budget used by all the readers, its default limit is a quarter of the physical memory
+    static MEDIACORE_API Holder GetDefaultInstance();
+
+    enum Priority
+    {
+        PRIORITY_ACTIVE = 0,    // the cache being read for playback
+        PRIORITY_NORMAL,
+        PRIORITY_IDLE,          // suspended caches, which are shrunk first
+        PRIORITY_COUNT,
+    };
+
+    struct Consumer
+    {
+        using Holder = std::shared_ptr<Consumer>;
+
+        // bytes needed to keep the whole configured cache
+        virtual void SetDemand(uint64_t bytes) = 0;
+        // bytes currently held by the cache
+        virtual void UpdateUsage(uint64_t bytes) = 0;
+        virtual void SetPriority(Priority priority) = 0;
+        // mark the cache as being read
+        virtual void Touch() = 0;
+        virtual uint64_t GetQuota() const = 0;
+        virtual std::string GetName() const = 0;
+    };
+    // Invoked on any thread when the quota of a consumer is changed. It must return quickly and must not call into the budget.
+    using QuotaCallback = std::function<void(uint64_t quota)>;
+    // The consumer is unregistered when its holder is released.
+    virtual Consumer::Holder Register(const std::string& name, QuotaCallback onQuotaChanged = nullptr) = 0;
+
+    virtual void SetLimit(uint64_t maxBytes) = 0;
+    virtual uint64_t GetLimit() const = 0;
+    virtual uint64_t GetTotalUsage() const = 0;
+
+    struct ConsumerStats
+    {
+        std::string name;
+        Priority priority;
+        uint64_t demand;
+        uint64_t usage;
+        uint64_t quota;
+        int64_t idleMillisec;   // time since the last 'Touch()'
+    };
+    virtual std::vector<ConsumerStats> GetStats() const = 0;
+
+    virtual void SetLogLevel(Logger::Level l) = 0;
+};
+}
@@ -70,6 +70,40 @@ struct MultiTrackVideoReader
     virtual bool UpdateSettings(SharedSettings::Holder hSettings) = 0;
     virtual size_t GetCacheFrameNum() const = 0;
     virtual void SetCacheFrameNum(size_t szCacheNum) = 0;
+    // Number of the frames mixed concurrently, each one on its own thread. Default is 1.
+    virtual void SetMixingConcurrency(uint32_t concurrency) = 0;
+    virtual uint32_t GetMixingConcurrency() const = 0;
+    // Skip reading and processing the frames of the tracks under an opaque frame which covers the whole canvas. Enabled by default.
+    virtual void EnableOcclusionCulling(bool enable) = 0;
+    virtual bool IsOcclusionCullingEnabled() const = 0;
+    // During 'ConsecutiveSeek()', output a preview from the nearest keyframe of each clip before the exact frame is decoded.
+    // The previews skip the clip filters and are not cached, each one is refined to the exact frame if the playhead stays there.
+    // Enabled by default.
+    virtual void EnableScrubbingPreview(bool enable) = 0;
+    virtual bool IsScrubbingPreviewEnabled() const = 0;
+
+    // The mixed frames are cached by the frame index and the content hash of the visible tracks at that frame, reading
+    // a cached frame skips decoding and mixing. The hash covers the clip ranges, the transforms, the filter instances
+    // and the transition instances. A change inside a filter or a transition must be reported with 'RefreshTrackView()',
+    // which invalidates the frames of the given tracks, or 'Refresh()', which invalidates all of them. 'maxBytes' = 0
+    // disables the cache, default is 0. The size is also limited by the quota from the default 'MemoryBudget'.
+    virtual void SetFrameCacheCapacity(uint64_t maxBytes) = 0;
+    virtual uint64_t GetFrameCacheCapacity() const = 0;
+    // Store the cached frames with a lossless compression, which saves the memory of the frames with flat areas. Disabled by default.
+    virtual void EnableFrameCacheCompression(bool enable) = 0;
+    virtual bool IsFrameCacheCompressionEnabled() const = 0;
+    struct FrameCacheStats
+    {
+        uint64_t hitCount{0};
+        uint64_t missCount{0};
+        uint32_t frameCount{0};
+        uint64_t bytes{0};          // bytes held by the cached frames
+        uint64_t rawBytes{0};       // bytes of the cached frames before the compression
+
+        double HitRate() const { return hitCount+missCount > 0 ? (double)hitCount/(hitCount+missCount) : 0; }
+    };
+    virtual FrameCacheStats GetFrameCacheStats() const = 0;
+    virtual void ClearFrameCache() = 0;
 
     virtual int64_t Duration() const = 0;
     virtual int64_t ReadPos() const = 0;
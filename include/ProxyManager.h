@@ -0,0 +1,70 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <memory>
+#include "MediaCore.h"
+#include "MediaParser.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+// Generate low resolution proxies of video files in background. A proxy is an all-intra video file
+// (MJPEG) encoded with 'MediaEncoder' and saved in the index cache directory (see 'MediaParser::SetIndexCacheDirectory()'),
+// it has the same duration as the original video stream. 'VideoClip' reads the proxy instead of the original
+// file when the output size fits in the proxy.
+struct ProxyManager
+{
+    using Holder = std::shared_ptr<ProxyManager>;
+    static MEDIACORE_API Holder CreateInstance();
+    // The instance used by 'VideoClip'
+    static MEDIACORE_API Holder GetDefaultInstance();
+
+    enum State
+    {
+        PROXY_NONE = 0,     // not requested, or the original video is not larger than the proxy size
+        PROXY_PENDING,
+        PROXY_GENERATING,
+        PROXY_READY,
+        PROXY_FAILED,
+    };
+
+    // Maximum frame size of the proxies generated afterwards, default is 960x540.
+    virtual void SetProxySize(uint32_t maxWidth, uint32_t maxHeight) = 0;
+    virtual void GetProxySize(uint32_t& maxWidth, uint32_t& maxHeight) const = 0;
+    // If enabled, the proxy is requested when a 'VideoClip' is created on a video without proxy. Disabled by default.
+    virtual void EnableAutoGenerate(bool enable) = 0;
+    virtual bool IsAutoGenerateEnabled() const = 0;
+    virtual void SetMaxConcurrency(uint32_t maxConcurrency) = 0;
+
+    // Request to generate the proxy of the best video stream in 'hParser'. An existing proxy file of the same
+    // source is reused.
+    virtual State RequestProxy(MediaParser::Holder hParser) = 0;
+    virtual State GetState(const std::string& url) = 0;
+    // Progress of the generation, in range [0, 1]
+    virtual float GetProgress(const std::string& url) = 0;
+    // Return the parser opened on the proxy file of 'hParser', or nullptr if the proxy is not ready.
+    virtual MediaParser::Holder GetProxyParser(MediaParser::Holder hParser, uint32_t& width, uint32_t& height) = 0;
+    virtual void CancelProxy(const std::string& url) = 0;
+    virtual void CancelAll() = 0;
+
+    virtual void SetLogLevel(Logger::Level l) = 0;
+    virtual std::string GetError() const = 0;
+};
+}
@@ -0,0 +1,138 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "MediaCore.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+struct TaskExecutor
+{
+    using Holder = std::shared_ptr<TaskExecutor>;
+    // 'threadCount' = 0 means using the hardware concurrency
+    static MEDIACORE_API Holder CreateInstance(uint32_t threadCount = 0, const std::string& name = "");
+    // The process-wide executor shared by all the media objects
+    static MEDIACORE_API Holder GetDefaultInstance();
+    // Only takes effect if it's called before the first call of 'GetDefaultInstance()'
+    static MEDIACORE_API void SetDefaultThreadCount(uint32_t threadCount);
+    // The small executor for the jobs that mostly wait for I/O, like scanning through a whole media file,
+    // so they don't occupy the workers of the default executor for seconds.
+    static MEDIACORE_API Holder GetIoInstance();
+    // Only takes effect if it's called before the first call of 'GetIoInstance()'. The default count is 2.
+    static MEDIACORE_API void SetIoThreadCount(uint32_t threadCount);
+
+    enum Priority
+    {
+        PRIORITY_INTERACTIVE = 0,   // seeking, or any task a user is waiting for
+        PRIORITY_PLAYBACK,
+        PRIORITY_PREFETCH,
+        PRIORITY_BACKGROUND,        // media analysis, overview/snapshot generation
+        PRIORITY_COUNT,
+    };
+
+    struct Task
+    {
+        using Holder = std::shared_ptr<Task>;
+
+        // Cancel the task if it's not started yet, return false if it's already running or done.
+        virtual bool Cancel() = 0;
+        virtual bool IsDone() const = 0;
+        virtual bool IsCancelled() const = 0;
+        // Wait until the task is done or cancelled. If it's called from a worker thread of the same executor,
+        // the pending tasks with a priority not lower than this task are executed while waiting.
+        virtual void Wait() = 0;
+        virtual bool WaitFor(uint32_t millisec) = 0;
+        virtual Priority GetPriority() const = 0;
+    };
+
+    using TaskProc = std::function<void(void)>;
+    virtual Task::Holder Submit(const TaskProc& proc, Priority priority = PRIORITY_PLAYBACK) = 0;
+
+    // A loop runs 'LoopProc' as a sequence of tasks, it replaces a dedicated worker thread of a media object.
+    // 'LoopProc' returns true if it has done some work and should be run again at once, or false if it's idle.
+    // An idle loop is run again after 'idleMillisec', or as soon as 'Wakeup()' is called.
+    struct Loop
+    {
+        using Holder = std::shared_ptr<Loop>;
+
+        virtual void Wakeup() = 0;
+        // Stop the loop and wait for the running iteration to finish. If it's called from the loop's own iteration,
+        // it returns immediately and the loop ends after this iteration. Releasing the holder also stops the loop.
+        virtual void Stop() = 0;
+        virtual bool IsStopped() const = 0;
+    };
+
+    using LoopProc = std::function<bool(void)>;
+    // The executor must outlive the loops started on it
+    virtual Loop::Holder StartLoop(const LoopProc& proc, Priority priority = PRIORITY_PLAYBACK, uint32_t idleMillisec = THREAD_IDLE_TIME) = 0;
+
+    // Take the next item to process, return false if all the items are taken
+    using ItemFetcher = std::function<bool(int32_t& item)>;
+    using ParallelProc = std::function<void(const ItemFetcher& fetchItem)>;
+    // Process the items [0, itemCount) with 'proc' on the calling thread and on at most 'GetThreadCount()-1' tasks of 'hExecutor'.
+    // 'proc' is invoked once on each of these threads, it keeps fetching the items with the per-thread state it needs. The
+    // calling thread takes the items as well, so the call won't stall if the executor is busy. Only the calling thread is
+    // used if 'hExecutor' is null. It returns after all the items are processed.
+    static MEDIACORE_API void ParallelFor(Holder hExecutor, int32_t itemCount, const ParallelProc& proc, Priority priority = PRIORITY_PLAYBACK);
+
+    virtual uint32_t GetThreadCount() const = 0;
+    virtual uint32_t GetPendingTaskCount(Priority priority) const = 0;
+    virtual bool IsWorkerThread() const = 0;
+
+    virtual void SetLogLevel(Logger::Level l) = 0;
+};
+
+// Count the tasks an object has submitted to an executor, so it can wait for them before being destroyed.
+// All the methods must be invoked with the owner's lock held. 'Decrease()' notifies the waiters while the
+// lock is still held, thus a waiter can not see the count drop to 0 and destroy the owner before the
+// finishing task has released the lock.
+class RunningTaskCounter
+{
+public:
+    void Increase() { m_count++; }
+    void Decrease() { m_count--; m_doneCv.notify_all(); }
+    // wake up the waiters whose condition may be changed by the owner, e.g. the pending tasks are cleared
+    void Notify() { m_doneCv.notify_all(); }
+    uint32_t Count() const { return m_count; }
+
+    // wait until no task is running and 'pred' returns true
+    template<typename Pred>
+    void Wait(std::unique_lock<std::mutex>& lk, Pred pred)
+    {
+        m_doneCv.wait(lk, [this, &pred] { return m_count == 0 && pred(); });
+    }
+    void Wait(std::unique_lock<std::mutex>& lk) { Wait(lk, [] { return true; }); }
+
+    template<typename Pred>
+    bool WaitFor(std::unique_lock<std::mutex>& lk, uint32_t millisec, Pred pred)
+    {
+        return m_doneCv.wait_for(lk, std::chrono::milliseconds(millisec), [this, &pred] { return m_count == 0 && pred(); });
+    }
+
+private:
+    uint32_t m_count{0};
+    std::condition_variable m_doneCv;
+};
+}
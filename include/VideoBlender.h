@@ -18,6 +18,7 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <vector>
 #include <immat.h>
 #include "MediaCore.h"
 
@@ -30,8 +31,30 @@ struct VideoBlender
 
     virtual ImGui::ImMat Blend(ImGui::ImMat& baseImage, ImGui::ImMat& overlayImage, int32_t x, int32_t y, float fOpacity = 1.f) = 0;
     virtual ImGui::ImMat Blend(ImGui::ImMat& baseImage, ImGui::ImMat& overlayImage, float fOpacity = 1.f) = 0;
+    // 'alphaMat' is a single channel image of the same size as 'overlayImage', which scales the alpha of 'overlayImage'
     virtual ImGui::ImMat Blend(const ImGui::ImMat& baseImage, const ImGui::ImMat& overlayImage, const ImGui::ImMat& alphaMat) = 0;
 
+    struct Layer
+    {
+        ImGui::ImMat image;
+        int32_t x{0};
+        int32_t y{0};
+        float opacity{1.f};
+    };
+    // Blend all the 'layers' into a 'width' x 'height' image of type 'dtype', the first layer is at the bottom.
+    // The area not covered by any layer is transparent. On cpu, all the layers are blended in a single pass over
+    // cache-sized bands of the output, instead of one full frame pass per layer. Return an empty image if 'layers' is empty.
+    virtual ImGui::ImMat BlendLayers(const std::vector<Layer>& layers, uint32_t width, uint32_t height, ImDataType dtype) = 0;
+
+    enum AlphaMode
+    {
+        ALPHA_STRAIGHT = 0,
+        ALPHA_PREMULTIPLIED,
+    };
+    // How the color of the overlay image is associated with its alpha, default is ALPHA_STRAIGHT. Only used by the cpu blending.
+    virtual void SetAlphaMode(AlphaMode mode) = 0;
+    virtual AlphaMode GetAlphaMode() const = 0;
+
     virtual bool EnableUseVulkan(bool enable) = 0;
     virtual std::string GetError() const = 0;
 };
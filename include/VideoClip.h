@@ -55,6 +55,10 @@ struct VideoFilter
             return nullptr;
         return VideoFrame::CreateMatInstance(tOutMat);
     }
+
+    // Return true if the filter never makes an opaque pixel transparent. The layers under a clip are only
+    // culled when its filter keeps the frame opaque.
+    virtual bool IsOpaquePreserving() const { return false; }
 };
 
 struct VideoClip
@@ -92,11 +96,32 @@ struct VideoClip
     virtual VideoFrame::Holder ReadSourceFrame(int64_t pos, bool& eof, bool wait) = 0;
     virtual VideoFrame::Holder ProcessSourceFrame(int64_t pos, std::vector<CorrelativeVideoFrame::Holder>& frames, VideoFrame::Holder hInVf,
             const std::unordered_map<std::string, std::string>* pExtraArgs = nullptr) = 0;
-    virtual void SeekTo(int64_t pos) = 0;
+    // In seeking mode, the reader keeps the first frame decoded after the seek as the seeking flash, see 'GetSeekingFlash()'
+    virtual void SeekTo(int64_t pos, bool bSeekingMode = false) = 0;
+    // Return the seeking flash if it's inside the clip and in the gop of the last seek position, which is the nearest keyframe
+    // decoded after the last seek in seeking mode.
+    // It's null if the clip is not in seeking mode or nothing is decoded yet.
+    virtual VideoFrame::Holder GetSeekingFlash() const = 0;
     virtual void NotifyReadPos(int64_t pos) = 0;
+    // Return true if the output frame at 'pos' is fully opaque and covers the whole canvas, so the layers under it are invisible.
+    virtual bool IsCoveringCanvas(int64_t pos) const = 0;
+    // Hash of the states deciding the output frame at 'pos': the source, the clip range, the transform and the filter instance.
+    // The parameters inside the filter are not included, a change of them must be reported with 'MultiTrackVideoReader::RefreshTrackView()'.
+    virtual uint64_t GetContentHash(int64_t pos) const = 0;
     virtual void SetDirection(bool forward) = 0;
     virtual void SetFilter(VideoFilter::Holder filter) = 0;
     virtual VideoFilter::Holder GetFilter() const = 0;
+    // Cache the frames output by the external filter, so the transform-only edits don't run the filter again.
+    // The cached frames are found by the source position, the clip position and the duration. A change of the filter
+    // parameters must be reported with 'InvalidateFilterCache()'. 'maxBytes' = 0 disables the cache, it's the default.
+    virtual void SetFilterCacheCapacity(uint64_t maxBytes) = 0;
+    virtual uint64_t GetFilterCacheCapacity() const = 0;
+    virtual void InvalidateFilterCache() = 0;
+    // Limit the memory of the frames kept by the reverse decoder of the reader, which is used under backward playback,
+    // see 'MediaReader::SetReverseDecodeMemoryLimit()'. The default is derived from the limit of the default 'MemoryBudget',
+    // 0 disables the reverse decoding. It makes no difference to an image clip.
+    virtual bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) = 0;
+    virtual uint64_t GetReverseDecodeMemoryLimit() const = 0;
     virtual VideoTransformFilter::Holder GetTransformFilter() = 0;
     virtual SharedSettings::Holder GetSharedSettings() const = 0;
     virtual void UpdateSettings(SharedSettings::Holder hSettings) = 0;
@@ -155,6 +180,8 @@ struct VideoOverlap
     virtual void SeekTo(int64_t pos) = 0;
     virtual void Update() = 0;
     virtual VideoTransition::Holder GetTransition() const = 0;
+    // A process-wide unique number assigned when the transition is set, unlike the address it's never reused
+    virtual uint32_t TransitionRevision() const = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const Holder& hOverlap);
 };
@@ -40,6 +40,12 @@ struct ReadFrameTask
     virtual bool IsDiscarded() const = 0;
     virtual bool IsVisible() const = 0;
     virtual void SetVisible(bool visible) = 0;
+    // An occluded task is covered by the upper layers, its source frame is neither read nor processed.
+    virtual void SetOccluded(bool occluded) = 0;
+    virtual bool IsOccluded() const = 0;
+    // A scrubbing task outputs a preview before its source frame is decoded, which is made from the nearest keyframe
+    // with the clip filter skipped. The output is refined to the exact frame later, and it's not a preview any more.
+    virtual bool IsPreview() const = 0;
     virtual void UpdateHostFrames() = 0;
 
     struct Callback
@@ -47,6 +53,9 @@ struct ReadFrameTask
         virtual bool TriggerDrop() = 0;
         virtual bool TriggerStart() = 0;
         virtual void UpdateOutputFrames(const std::vector<CorrelativeVideoFrame::Holder>& corVidFrames) = 0;
+        // Invoked on the track's reading thread when the source frame or the output frame of the task becomes ready
+        virtual void OnSourceFrameReady() {}
+        virtual void OnOutputFrameReady() {}
     };
     virtual void SetCallback(Callback* pCallback) = 0;
 };
@@ -66,7 +75,12 @@ struct VideoTrack
     virtual bool Direction() const = 0;
     virtual void SetVisible(bool visible) = 0;
     virtual bool IsVisible() const = 0;
-    virtual ReadFrameTask::Holder CreateReadFrameTask(int64_t frameIndex, bool canDrop, bool needSeek, bool bypassBgNode, ReadFrameTask::Callback* pCb) = 0;
+    // Return true if the frame at 'frameIndex' is fully opaque and covers the whole canvas
+    virtual bool IsCoveringCanvas(int64_t frameIndex) = 0;
+    // Hash of the clip or the overlap at 'frameIndex', see 'VideoClip::GetContentHash()'. Return 0 if there is no clip at that frame.
+    virtual uint64_t GetContentHash(int64_t frameIndex) = 0;
+    virtual ReadFrameTask::Holder CreateReadFrameTask(int64_t frameIndex, bool canDrop, bool needSeek, bool bypassBgNode, ReadFrameTask::Callback* pCb,
+            bool scrubbing = false) = 0;
 
     virtual VideoClip::Holder AddVideoClip(int64_t clipId, MediaParser::Holder hParser, int64_t start, int64_t end, int64_t startOffset, int64_t endOffset, int64_t readPos) = 0;
     virtual VideoClip::Holder AddImageClip(int64_t clipId, MediaParser::Holder hParser, int64_t start, int64_t length) = 0;
@@ -78,6 +92,7 @@ struct VideoTrack
     virtual VideoClip::Holder GetClipByIndex(uint32_t index) = 0;
     virtual VideoClip::Holder GetClipById(int64_t id) = 0;
     virtual VideoOverlap::Holder GetOverlapById(int64_t id) = 0;
+    // Nothing to do now, the edits are published to the read path as soon as they are done.
     virtual void UpdateClipState() = 0;
     virtual void UpdateSettings(SharedSettings::Holder hSettings) = 0;
     virtual void SetPreReadMaxNum(int iMaxNum) = 0;
@@ -85,6 +100,15 @@ struct VideoTrack
     virtual std::list<VideoClip::Holder> GetClipList() = 0;
     virtual std::list<VideoOverlap::Holder> GetOverlapList() = 0;
 
+    // The latency from an edit being published to being picked up by the read thread
+    struct EditLatencyStats
+    {
+        uint32_t count{0};
+        double averageMillisec{0};
+        double maxMillisec{0};
+    };
+    virtual EditLatencyStats GetEditLatencyStats() const = 0;
+
     virtual void SetLogLevel(Logger::Level l) = 0;
 };
 
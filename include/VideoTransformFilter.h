@@ -162,6 +162,9 @@ namespace MediaCore
         virtual void EnableKeyFramesOnOpacity(bool bEnable) = 0;
         virtual bool IsKeyFramesEnabledOnOpacity() const = 0;
         virtual ImGui::ImNewCurve::Curve::Holder GetKeyFramesCurveOnOpacity() const = 0;
+        // Must be called after a curve from 'GetKeyFramesCurveOnXXX()' is edited through its holder, the filter keeps the
+        // curve values of the evaluated ticks and doesn't know the edit otherwise.
+        virtual void NotifyKeyFramesChanged() = 0;
         virtual ImGui::MaskCreator::Holder CreateNewOpacityMask(const std::string& name) = 0;
         virtual int GetOpacityMaskCount() const = 0;
         virtual const ImGui::MaskCreator::Holder GetOpacityMaskCreator(size_t index) const = 0;
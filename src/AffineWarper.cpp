@@ -0,0 +1,520 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "AffineWarper.h"
+#include "CpuFeatures.h"
+
+
+using namespace std;
+
+namespace MediaCore
+{
+// The pixel values are interpolated in the value range of the source type, 'SourceTraits<T>::Scale()' converts them
+// to the range of the INT8 output.
+template<typename T> struct SourceTraits;
+
+template<> struct SourceTraits<uint8_t>
+{
+    static float Scale() { return 1.f; }
+};
+
+template<> struct SourceTraits<float>
+{
+    static float Scale() { return 255.f; }
+};
+
+static inline bool IsInside(const AffineWarper::Source& src, int x, int y)
+{
+    return (uint32_t)(x-src.x0) < (uint32_t)(src.x1-src.x0) && (uint32_t)(y-src.y0) < (uint32_t)(src.y1-src.y0);
+}
+
+template<typename T>
+static inline const T* PixelPtr(const AffineWarper::Source& src, int x, int y)
+{
+    return (const T*)(src.data+(size_t)y*src.stride)+(size_t)x*4;
+}
+
+// Catmull-Rom weights of the 4 taps at the distances 1+t, t, 1-t and 2-t
+static inline void CubicWeights(float t, float* w)
+{
+    const float A = -0.5f;
+    const float t1 = t+1.f, t2 = 1.f-t;
+    w[0] = ((A*t1-5.f*A)*t1+8.f*A)*t1-4.f*A;
+    w[1] = ((A+2.f)*t-(A+3.f))*t*t+1.f;
+    w[2] = ((A+2.f)*t2-(A+3.f))*t2*t2+1.f;
+    w[3] = 1.f-w[0]-w[1]-w[2];
+}
+
+// The offsets of the area samples inside the output pixel, which is [-0.5, 0.5) in both axes
+static inline float AreaTapOffset(int i, int taps)
+{
+    return (i+0.5f)/taps-0.5f;
+}
+
+static inline uint8_t StoreU8(float v)
+{
+    return v <= 0.f ? 0 : (v >= 255.f ? 255 : (uint8_t)(v+0.5f));
+}
+
+template<typename T>
+static inline void AccumulatePixel_C(float* acc, const AffineWarper::Source& src, int x, int y, float w)
+{
+    if (!IsInside(src, x, y))
+        return;
+    const T* p = PixelPtr<T>(src, x, y);
+    acc[0] += p[0]*w; acc[1] += p[1]*w; acc[2] += p[2]*w; acc[3] += p[3]*w;
+}
+
+template<typename T>
+static inline void SampleBilinear_C(float* acc, const AffineWarper::Source& src, float fx, float fy, float w)
+{
+    const float flx = floor(fx), fly = floor(fy);
+    const int ix = (int)flx, iy = (int)fly;
+    const float wx = fx-flx, wy = fy-fly;
+    AccumulatePixel_C<T>(acc, src, ix, iy, (1.f-wx)*(1.f-wy)*w);
+    AccumulatePixel_C<T>(acc, src, ix+1, iy, wx*(1.f-wy)*w);
+    AccumulatePixel_C<T>(acc, src, ix, iy+1, (1.f-wx)*wy*w);
+    AccumulatePixel_C<T>(acc, src, ix+1, iy+1, wx*wy*w);
+}
+
+template<typename T>
+static inline void SampleBicubic_C(float* acc, const AffineWarper::Source& src, float fx, float fy)
+{
+    const float flx = floor(fx), fly = floor(fy);
+    const int ix = (int)flx-1, iy = (int)fly-1;
+    float wx[4], wy[4];
+    CubicWeights(fx-flx, wx);
+    CubicWeights(fy-fly, wy);
+    for (int j = 0; j < 4; j++)
+        for (int i = 0; i < 4; i++)
+            AccumulatePixel_C<T>(acc, src, ix+i, iy+j, wx[i]*wy[j]);
+}
+
+template<typename T>
+static inline void SampleArea_C(float* acc, const AffineWarper::Source& src, float fx, float fy)
+{
+    const float* m = src.m;
+    const int taps = src.areaTaps;
+    const float w = 1.f/(taps*taps);
+    for (int j = 0; j < taps; j++)
+    {
+        const float oy = AreaTapOffset(j, taps);
+        for (int i = 0; i < taps; i++)
+        {
+            const float ox = AreaTapOffset(i, taps);
+            SampleBilinear_C<T>(acc, src, fx+m[0]*ox+m[1]*oy, fy+m[3]*ox+m[4]*oy, w);
+        }
+    }
+}
+
+template<typename T, int INTERP>
+static void WarpRow_C(uint8_t* dst, const AffineWarper::Source& src, int row, int x0, int count)
+{
+    const float* m = src.m;
+    const float bx = m[1]*row+m[2], by = m[4]*row+m[5];
+    const float scale = SourceTraits<T>::Scale();
+    for (int i = 0; i < count; i++)
+    {
+        const int x = x0+i;
+        const float fx = m[0]*x+bx, fy = m[3]*x+by;
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        if (INTERP == AffineWarper::INTERP_BICUBIC)
+            SampleBicubic_C<T>(acc, src, fx, fy);
+        else if (INTERP == AffineWarper::INTERP_AREA)
+            SampleArea_C<T>(acc, src, fx, fy);
+        else
+            SampleBilinear_C<T>(acc, src, fx, fy, 1.f);
+        dst[0] = StoreU8(acc[0]*scale);
+        dst[1] = StoreU8(acc[1]*scale);
+        dst[2] = StoreU8(acc[2]*scale);
+        dst[3] = StoreU8(acc[3]*scale);
+        dst += 4;
+    }
+}
+
+#if MC_CPU_X86
+// One pixel is held by one vector, so the 4 channels are interpolated at once.
+MC_TARGET("sse4.1") static inline __m128 LoadPixel_SSE4(const uint8_t* p)
+{
+    int32_t v;
+    memcpy(&v, p, 4);
+    return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v)));
+}
+
+MC_TARGET("sse4.1") static inline __m128 LoadPixel_SSE4(const float* p)
+{
+    return _mm_loadu_ps(p);
+}
+
+template<typename T>
+MC_TARGET("sse4.1") static inline __m128 FetchPixel_SSE4(const AffineWarper::Source& src, int x, int y)
+{
+    return IsInside(src, x, y) ? LoadPixel_SSE4(PixelPtr<T>(src, x, y)) : _mm_setzero_ps();
+}
+
+template<typename T>
+MC_TARGET("sse4.1") static inline __m128 SampleBilinear_SSE4(const AffineWarper::Source& src, float fx, float fy)
+{
+    const float flx = floor(fx), fly = floor(fy);
+    const int ix = (int)flx, iy = (int)fly;
+    const __m128 wx = _mm_set1_ps(fx-flx), wy = _mm_set1_ps(fy-fly);
+    __m128 p0, p1, top, bottom;
+    if (ix >= src.x0 && ix+1 < src.x1 && iy >= src.y0 && iy+1 < src.y1)
+    {
+        const T* p = PixelPtr<T>(src, ix, iy);
+        const T* q = (const T*)((const uint8_t*)p+src.stride);
+        top = LoadPixel_SSE4(p);
+        p1 = LoadPixel_SSE4(p+4);
+        bottom = LoadPixel_SSE4(q);
+        p0 = LoadPixel_SSE4(q+4);
+    }
+    else
+    {
+        top = FetchPixel_SSE4<T>(src, ix, iy);
+        p1 = FetchPixel_SSE4<T>(src, ix+1, iy);
+        bottom = FetchPixel_SSE4<T>(src, ix, iy+1);
+        p0 = FetchPixel_SSE4<T>(src, ix+1, iy+1);
+    }
+    top = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(p1, top), wx));
+    bottom = _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(p0, bottom), wx));
+    return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), wy));
+}
+
+template<typename T>
+MC_TARGET("sse4.1") static inline __m128 SampleBicubic_SSE4(const AffineWarper::Source& src, float fx, float fy)
+{
+    const float flx = floor(fx), fly = floor(fy);
+    const int ix = (int)flx-1, iy = (int)fly-1;
+    float wx[4], wy[4];
+    CubicWeights(fx-flx, wx);
+    CubicWeights(fy-fly, wy);
+    const bool inside = ix >= src.x0 && ix+3 < src.x1 && iy >= src.y0 && iy+3 < src.y1;
+    __m128 acc = _mm_setzero_ps();
+    for (int j = 0; j < 4; j++)
+    {
+        __m128 rowAcc;
+        if (inside)
+        {
+            const T* p = PixelPtr<T>(src, ix, iy+j);
+            rowAcc = _mm_mul_ps(LoadPixel_SSE4(p), _mm_set1_ps(wx[0]));
+            rowAcc = _mm_add_ps(rowAcc, _mm_mul_ps(LoadPixel_SSE4(p+4), _mm_set1_ps(wx[1])));
+            rowAcc = _mm_add_ps(rowAcc, _mm_mul_ps(LoadPixel_SSE4(p+8), _mm_set1_ps(wx[2])));
+            rowAcc = _mm_add_ps(rowAcc, _mm_mul_ps(LoadPixel_SSE4(p+12), _mm_set1_ps(wx[3])));
+        }
+        else
+        {
+            rowAcc = _mm_mul_ps(FetchPixel_SSE4<T>(src, ix, iy+j), _mm_set1_ps(wx[0]));
+            rowAcc = _mm_add_ps(rowAcc, _mm_mul_ps(FetchPixel_SSE4<T>(src, ix+1, iy+j), _mm_set1_ps(wx[1])));
+            rowAcc = _mm_add_ps(rowAcc, _mm_mul_ps(FetchPixel_SSE4<T>(src, ix+2, iy+j), _mm_set1_ps(wx[2])));
+            rowAcc = _mm_add_ps(rowAcc, _mm_mul_ps(FetchPixel_SSE4<T>(src, ix+3, iy+j), _mm_set1_ps(wx[3])));
+        }
+        acc = _mm_add_ps(acc, _mm_mul_ps(rowAcc, _mm_set1_ps(wy[j])));
+    }
+    return acc;
+}
+
+template<typename T>
+MC_TARGET("sse4.1") static inline __m128 SampleArea_SSE4(const AffineWarper::Source& src, float fx, float fy)
+{
+    const float* m = src.m;
+    const int taps = src.areaTaps;
+    __m128 acc = _mm_setzero_ps();
+    for (int j = 0; j < taps; j++)
+    {
+        const float oy = AreaTapOffset(j, taps);
+        for (int i = 0; i < taps; i++)
+        {
+            const float ox = AreaTapOffset(i, taps);
+            acc = _mm_add_ps(acc, SampleBilinear_SSE4<T>(src, fx+m[0]*ox+m[1]*oy, fy+m[3]*ox+m[4]*oy));
+        }
+    }
+    return _mm_mul_ps(acc, _mm_set1_ps(1.f/(taps*taps)));
+}
+
+template<typename T, int INTERP>
+MC_TARGET("sse4.1") static void WarpRow_SSE4(uint8_t* dst, const AffineWarper::Source& src, int row, int x0, int count)
+{
+    const float* m = src.m;
+    const float bx = m[1]*row+m[2], by = m[4]*row+m[5];
+    const __m128 vScale = _mm_set1_ps(SourceTraits<T>::Scale());
+    const __m128 vMax = _mm_set1_ps(255.f);
+    const __m128 vZero = _mm_setzero_ps();
+    for (int i = 0; i < count; i++)
+    {
+        const int x = x0+i;
+        const float fx = m[0]*x+bx, fy = m[3]*x+by;
+        __m128 v;
+        if (INTERP == AffineWarper::INTERP_BICUBIC)
+            v = SampleBicubic_SSE4<T>(src, fx, fy);
+        else if (INTERP == AffineWarper::INTERP_AREA)
+            v = SampleArea_SSE4<T>(src, fx, fy);
+        else
+            v = SampleBilinear_SSE4<T>(src, fx, fy);
+        v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, vScale), vZero), vMax);
+        __m128i iv = _mm_cvtps_epi32(v);
+        iv = _mm_packus_epi32(iv, iv);
+        iv = _mm_packus_epi16(iv, iv);
+        const int32_t packed = _mm_cvtsi128_si32(iv);
+        memcpy(dst, &packed, 4);
+        dst += 4;
+    }
+}
+#endif
+
+#if MC_CPU_NEON
+static inline float32x4_t LoadPixel_NEON(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    const uint16x8_t v16 = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v)));
+    return vcvtq_f32_u32(vmovl_u16(vget_low_u16(v16)));
+}
+
+static inline float32x4_t LoadPixel_NEON(const float* p)
+{
+    return vld1q_f32(p);
+}
+
+template<typename T>
+static inline float32x4_t FetchPixel_NEON(const AffineWarper::Source& src, int x, int y)
+{
+    return IsInside(src, x, y) ? LoadPixel_NEON(PixelPtr<T>(src, x, y)) : vdupq_n_f32(0.f);
+}
+
+template<typename T>
+static inline float32x4_t SampleBilinear_NEON(const AffineWarper::Source& src, float fx, float fy)
+{
+    const float flx = floor(fx), fly = floor(fy);
+    const int ix = (int)flx, iy = (int)fly;
+    const float wx = fx-flx, wy = fy-fly;
+    float32x4_t p0, p1, top, bottom;
+    if (ix >= src.x0 && ix+1 < src.x1 && iy >= src.y0 && iy+1 < src.y1)
+    {
+        const T* p = PixelPtr<T>(src, ix, iy);
+        const T* q = (const T*)((const uint8_t*)p+src.stride);
+        top = LoadPixel_NEON(p);
+        p1 = LoadPixel_NEON(p+4);
+        bottom = LoadPixel_NEON(q);
+        p0 = LoadPixel_NEON(q+4);
+    }
+    else
+    {
+        top = FetchPixel_NEON<T>(src, ix, iy);
+        p1 = FetchPixel_NEON<T>(src, ix+1, iy);
+        bottom = FetchPixel_NEON<T>(src, ix, iy+1);
+        p0 = FetchPixel_NEON<T>(src, ix+1, iy+1);
+    }
+    top = vmlaq_n_f32(top, vsubq_f32(p1, top), wx);
+    bottom = vmlaq_n_f32(bottom, vsubq_f32(p0, bottom), wx);
+    return vmlaq_n_f32(top, vsubq_f32(bottom, top), wy);
+}
+
+template<typename T>
+static inline float32x4_t SampleBicubic_NEON(const AffineWarper::Source& src, float fx, float fy)
+{
+    const float flx = floor(fx), fly = floor(fy);
+    const int ix = (int)flx-1, iy = (int)fly-1;
+    float wx[4], wy[4];
+    CubicWeights(fx-flx, wx);
+    CubicWeights(fy-fly, wy);
+    const bool inside = ix >= src.x0 && ix+3 < src.x1 && iy >= src.y0 && iy+3 < src.y1;
+    float32x4_t acc = vdupq_n_f32(0.f);
+    for (int j = 0; j < 4; j++)
+    {
+        float32x4_t rowAcc;
+        if (inside)
+        {
+            const T* p = PixelPtr<T>(src, ix, iy+j);
+            rowAcc = vmulq_n_f32(LoadPixel_NEON(p), wx[0]);
+            rowAcc = vmlaq_n_f32(rowAcc, LoadPixel_NEON(p+4), wx[1]);
+            rowAcc = vmlaq_n_f32(rowAcc, LoadPixel_NEON(p+8), wx[2]);
+            rowAcc = vmlaq_n_f32(rowAcc, LoadPixel_NEON(p+12), wx[3]);
+        }
+        else
+        {
+            rowAcc = vmulq_n_f32(FetchPixel_NEON<T>(src, ix, iy+j), wx[0]);
+            rowAcc = vmlaq_n_f32(rowAcc, FetchPixel_NEON<T>(src, ix+1, iy+j), wx[1]);
+            rowAcc = vmlaq_n_f32(rowAcc, FetchPixel_NEON<T>(src, ix+2, iy+j), wx[2]);
+            rowAcc = vmlaq_n_f32(rowAcc, FetchPixel_NEON<T>(src, ix+3, iy+j), wx[3]);
+        }
+        acc = vmlaq_n_f32(acc, rowAcc, wy[j]);
+    }
+    return acc;
+}
+
+template<typename T>
+static inline float32x4_t SampleArea_NEON(const AffineWarper::Source& src, float fx, float fy)
+{
+    const float* m = src.m;
+    const int taps = src.areaTaps;
+    float32x4_t acc = vdupq_n_f32(0.f);
+    for (int j = 0; j < taps; j++)
+    {
+        const float oy = AreaTapOffset(j, taps);
+        for (int i = 0; i < taps; i++)
+        {
+            const float ox = AreaTapOffset(i, taps);
+            acc = vaddq_f32(acc, SampleBilinear_NEON<T>(src, fx+m[0]*ox+m[1]*oy, fy+m[3]*ox+m[4]*oy));
+        }
+    }
+    return vmulq_n_f32(acc, 1.f/(taps*taps));
+}
+
+template<typename T, int INTERP>
+static void WarpRow_NEON(uint8_t* dst, const AffineWarper::Source& src, int row, int x0, int count)
+{
+    const float* m = src.m;
+    const float bx = m[1]*row+m[2], by = m[4]*row+m[5];
+    const float scale = SourceTraits<T>::Scale();
+    const float32x4_t vMax = vdupq_n_f32(255.f);
+    const float32x4_t vZero = vdupq_n_f32(0.f);
+    const float32x4_t vHalf = vdupq_n_f32(0.5f);
+    for (int i = 0; i < count; i++)
+    {
+        const int x = x0+i;
+        const float fx = m[0]*x+bx, fy = m[3]*x+by;
+        float32x4_t v;
+        if (INTERP == AffineWarper::INTERP_BICUBIC)
+            v = SampleBicubic_NEON<T>(src, fx, fy);
+        else if (INTERP == AffineWarper::INTERP_AREA)
+            v = SampleArea_NEON<T>(src, fx, fy);
+        else
+            v = SampleBilinear_NEON<T>(src, fx, fy);
+        v = vminq_f32(vmaxq_f32(vmulq_n_f32(v, scale), vZero), vMax);
+        const uint16x4_t v16 = vmovn_u32(vcvtq_u32_f32(vaddq_f32(v, vHalf)));
+        const uint8x8_t v8 = vmovn_u16(vcombine_u16(v16, v16));
+        vst1_lane_u32((uint32_t*)dst, vreinterpret_u32_u8(v8), 0);
+        dst += 4;
+    }
+}
+#endif
+
+#define WARP_ROW_KERNELS(func) \
+    m_warpRow[0][INTERP_BILINEAR] = func<uint8_t, INTERP_BILINEAR>; \
+    m_warpRow[0][INTERP_BICUBIC] = func<uint8_t, INTERP_BICUBIC>; \
+    m_warpRow[0][INTERP_AREA] = func<uint8_t, INTERP_AREA>; \
+    m_warpRow[1][INTERP_BILINEAR] = func<float, INTERP_BILINEAR>; \
+    m_warpRow[1][INTERP_BICUBIC] = func<float, INTERP_BICUBIC>; \
+    m_warpRow[1][INTERP_AREA] = func<float, INTERP_AREA>;
+
+AffineWarper::AffineWarper()
+{
+    m_kernelName = "C";
+    WARP_ROW_KERNELS(WarpRow_C)
+#if MC_CPU_X86
+    static const bool s_hasSse41 = CpuHasSse41();
+    if (s_hasSse41)
+    {
+        m_kernelName = "SSE4.1";
+        WARP_ROW_KERNELS(WarpRow_SSE4)
+    }
+#elif MC_CPU_NEON
+    m_kernelName = "NEON";
+    WARP_ROW_KERNELS(WarpRow_NEON)
+#endif
+}
+
+static const int MAX_AREA_TAPS = 4;
+
+// Narrow [t0, t1] to the range where 'a+slope*t' is inside [lo, hi], return false if it's empty.
+static bool ClipSpan(double a, double slope, double lo, double hi, double& t0, double& t1)
+{
+    if (fabs(slope) < 1e-12)
+        return a >= lo && a <= hi;
+    double ta = (lo-a)/slope, tb = (hi-a)/slope;
+    if (ta > tb)
+        swap(ta, tb);
+    t0 = max(t0, ta);
+    t1 = min(t1, tb);
+    return t0 <= t1;
+}
+
+bool AffineWarper::Warp(ImGui::ImMat& dst, const ImGui::ImMat& src, const float invMatrix[6], const Rect& srcRect,
+        Interpolation interp, TaskExecutor::Holder hExecutor)
+{
+    if (dst.empty() || dst.device != IM_DD_CPU || dst.c != 4 || dst.type != IM_DT_INT8)
+    {
+        m_errMsg = "INVALID argument! 'dst' must be an allocated 4-channel cpu image of type INT8.";
+        return false;
+    }
+    if (src.empty() || src.device != IM_DD_CPU || src.c != 4 || (src.type != IM_DT_INT8 && src.type != IM_DT_FLOAT32))
+    {
+        m_errMsg = "ONLY support 'src' in cpu memory, which is a 4-channel image of type INT8 or FLOAT32!";
+        return false;
+    }
+    if (interp < INTERP_BILINEAR || interp > INTERP_AREA)
+    {
+        m_errMsg = "INVALID argument! Unknown interpolation mode.";
+        return false;
+    }
+
+    Source source;
+    source.data = (const uint8_t*)src.data;
+    source.stride = (size_t)src.w*src.elemsize*4;
+    source.x0 = max(srcRect.x, 0);
+    source.y0 = max(srcRect.y, 0);
+    source.x1 = min(srcRect.x+srcRect.w, src.w);
+    source.y1 = min(srcRect.y+srcRect.h, src.h);
+    memcpy(source.m, invMatrix, sizeof(source.m));
+    const float* m = source.m;
+    // the area samples cover the footprint of an output pixel with the spacing of one source pixel at most
+    const float footprint = max(sqrt(m[0]*m[0]+m[3]*m[3]), sqrt(m[1]*m[1]+m[4]*m[4]));
+    source.areaTaps = min(max((int)ceil(footprint), 1), MAX_AREA_TAPS);
+    const size_t dstRowSize = (size_t)dst.w*4;
+    if (source.x0 >= source.x1 || source.y0 >= source.y1)
+    {
+        memset(dst.data, 0, dstRowSize*dst.h);
+        return true;
+    }
+
+    // The output pixels whose samples may touch the valid area, the margin covers the kernel radius and the area footprint.
+    const double margin = 2.0+(interp == INTERP_AREA ? 0.5*(fabs(m[0])+fabs(m[1])+fabs(m[3])+fabs(m[4])) : 0.0);
+    const double xLo = source.x0-margin, xHi = source.x1-1+margin;
+    const double yLo = source.y0-margin, yHi = source.y1-1+margin;
+    const WarpRowFunc warpRow = m_warpRow[src.type == IM_DT_FLOAT32 ? 1 : 0][interp];
+    const int bandCount = (dst.h+CPU_KERNEL_BAND_ROWS-1)/CPU_KERNEL_BAND_ROWS;
+    TaskExecutor::ParallelFor(hExecutor, bandCount, [&] (const TaskExecutor::ItemFetcher& fetchBand) {
+        int32_t band;
+        while (fetchBand(band))
+        {
+            const int y0 = band*CPU_KERNEL_BAND_ROWS, y1 = min(y0+CPU_KERNEL_BAND_ROWS, dst.h);
+            for (int y = y0; y < y1; y++)
+            {
+                uint8_t* dstRow = (uint8_t*)dst.data+dstRowSize*y;
+                double t0 = 0, t1 = dst.w-1;
+                if (!ClipSpan((double)m[1]*y+m[2], m[0], xLo, xHi, t0, t1) || !ClipSpan((double)m[4]*y+m[5], m[3], yLo, yHi, t0, t1))
+                {
+                    memset(dstRow, 0, dstRowSize);
+                    continue;
+                }
+                const int xs = max((int)floor(t0), 0), xe = min((int)ceil(t1)+1, dst.w);
+                if (xs > 0)
+                    memset(dstRow, 0, (size_t)xs*4);
+                if (xe > xs)
+                    warpRow(dstRow+(size_t)xs*4, source, y, xs, xe-xs);
+                if (xe < dst.w)
+                    memset(dstRow+(size_t)xe*4, 0, (size_t)(dst.w-xe)*4);
+            }
+        }
+    });
+    return true;
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <immat.h>
+#include "TaskExecutor.h"
+
+namespace MediaCore
+{
+// Warp a RGBA image on cpu with an affine matrix in a single pass, the result is written directly into the destination
+// canvas. Every output pixel is mapped back into the source image by the inverse matrix and sampled with the chosen
+// interpolation. The row kernels are chosen at runtime by the cpu features (SSE4.1 or NEON), the scalar kernels are
+// used if none of them is available.
+// The source can be of type IM_DT_INT8 or IM_DT_FLOAT32, the destination is always of type IM_DT_INT8.
+class AffineWarper
+{
+public:
+    enum Interpolation
+    {
+        INTERP_BILINEAR = 0,
+        INTERP_BICUBIC,
+        // average of the bilinear samples over the footprint of the output pixel, for downscaling
+        INTERP_AREA,
+    };
+
+    struct Rect
+    {
+        int32_t x{0};
+        int32_t y{0};
+        int32_t w{0};
+        int32_t h{0};
+    };
+
+    AffineWarper();
+    AffineWarper(const AffineWarper&) = delete;
+    AffineWarper& operator=(const AffineWarper&) = delete;
+
+    // 'invMatrix' maps the output pixel (x, y) to the source position (m[0]*x+m[1]*y+m[2], m[3]*x+m[4]*y+m[5]), both
+    // are in pixel index coordinates. The source pixels outside 'srcRect' are taken as transparent. 'dst' must be an
+    // allocated 4-channel INT8 image.
+    // Return false if the arguments are not supported, see 'GetError()'.
+    bool Warp(ImGui::ImMat& dst, const ImGui::ImMat& src, const float invMatrix[6], const Rect& srcRect,
+            Interpolation interp, TaskExecutor::Holder hExecutor = nullptr);
+
+    const char* GetKernelName() const { return m_kernelName; }
+    std::string GetError() const { return m_errMsg; }
+
+    struct Source
+    {
+        const uint8_t* data;
+        size_t stride;
+        // the valid area is [x0, x1) x [y0, y1)
+        int32_t x0, y0, x1, y1;
+        float m[6];
+        // the count of the samples along each axis for INTERP_AREA
+        int areaTaps;
+    };
+    using WarpRowFunc = void (*)(uint8_t* dst, const Source& src, int row, int x0, int count);
+
+private:
+    const char* m_kernelName;
+    // indexed by [source type][interpolation], source type 0 is INT8, 1 is FLOAT32
+    WarpRowFunc m_warpRow[2][3];
+    std::string m_errMsg;
+};
+}
@@ -0,0 +1,630 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <algorithm>
+#include "AlphaCompositor.h"
+#include "CpuFeatures.h"
+
+
+using namespace std;
+
+namespace MediaCore
+{
+// The blending formulas, 'k' is the opacity multiplied by the mask value, 'a' is the alpha of the overlay multiplied by 'k'.
+//   straight alpha:      out.rgb = base.rgb*(1-a) + ovly.rgb*a
+//   premultiplied alpha: out.rgb = base.rgb*(1-a) + ovly.rgb*k
+//   both:                out.a   = base.a*(1-a) + a
+// For INT8 images, the 8-bit products are divided by 255 with rounding.
+
+static inline uint32_t Div255(uint32_t v)
+{
+    v += 128;
+    return (v+(v>>8))>>8;
+}
+
+template<bool PREMUL>
+static void BlendRowU8_C(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const uint8_t* k, int count)
+{
+    const uint32_t maxSum = 255*255;
+    for (int i = 0; i < count; i++)
+    {
+        const uint32_t a = Div255((uint32_t)ovly[3]*k[i]);
+        const uint32_t w = PREMUL ? k[i] : a;
+        const uint32_t ia = 255-a;
+        dst[0] = (uint8_t)Div255(min((uint32_t)base[0]*ia+(uint32_t)ovly[0]*w, maxSum));
+        dst[1] = (uint8_t)Div255(min((uint32_t)base[1]*ia+(uint32_t)ovly[1]*w, maxSum));
+        dst[2] = (uint8_t)Div255(min((uint32_t)base[2]*ia+(uint32_t)ovly[2]*w, maxSum));
+        dst[3] = (uint8_t)Div255((uint32_t)base[3]*ia+255*a);
+        dst += 4; base += 4; ovly += 4;
+    }
+}
+
+template<typename T> struct PixelTraits;
+
+template<> struct PixelTraits<uint16_t>
+{
+    static float Max() { return 65535.f; }
+    static uint16_t Store(float v) { return v <= 0.f ? 0 : (v >= 65535.f ? 65535 : (uint16_t)(v+0.5f)); }
+};
+
+template<> struct PixelTraits<float>
+{
+    static float Max() { return 1.f; }
+    static float Store(float v) { return v; }
+};
+
+template<typename T, bool PREMUL>
+static void BlendRowFloat_C(T* dst, const T* base, const T* ovly, const float* k, int count)
+{
+    using Traits = PixelTraits<T>;
+    const float maxVal = Traits::Max();
+    const float invMax = 1.f/maxVal;
+    for (int i = 0; i < count; i++)
+    {
+        const float a = (float)ovly[3]*invMax*k[i];
+        const float w = PREMUL ? k[i] : a;
+        const float ia = 1.f-a;
+        dst[0] = Traits::Store((float)base[0]*ia+(float)ovly[0]*w);
+        dst[1] = Traits::Store((float)base[1]*ia+(float)ovly[1]*w);
+        dst[2] = Traits::Store((float)base[2]*ia+(float)ovly[2]*w);
+        dst[3] = Traits::Store((float)base[3]*ia+maxVal*a);
+        dst += 4; base += 4; ovly += 4;
+    }
+}
+
+#if MC_CPU_X86
+// (v+128)*257>>16, which is v/255 with rounding. 'v' must be no larger than 255*255.
+MC_TARGET("sse4.1") static inline __m128i Div255_SSE4(__m128i v)
+{
+    return _mm_mulhi_epu16(_mm_add_epi16(v, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+}
+
+// blend 2 pixels, each channel is widened to 16-bit
+template<bool PREMUL>
+MC_TARGET("sse4.1") static inline __m128i BlendU16x8_SSE4(__m128i b, __m128i o, __m128i k)
+{
+    const __m128i v255 = _mm_set1_epi16(255);
+    const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i shufAlpha = _mm_set_epi8(15, 14, 15, 14, 15, 14, 15, 14, 7, 6, 7, 6, 7, 6, 7, 6);
+    const __m128i a = Div255_SSE4(_mm_mullo_epi16(_mm_shuffle_epi8(o, shufAlpha), k));
+    const __m128i src = _mm_blendv_epi8(o, v255, alphaLanes);
+    const __m128i w = PREMUL ? _mm_blendv_epi8(k, a, alphaLanes) : a;
+    const __m128i sum = _mm_adds_epu16(_mm_mullo_epi16(b, _mm_sub_epi16(v255, a)), _mm_mullo_epi16(src, w));
+    return Div255_SSE4(_mm_min_epu16(sum, _mm_set1_epi16((short)(255*255))));
+}
+
+template<bool PREMUL>
+MC_TARGET("sse4.1") static void BlendRowU8_SSE4(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const uint8_t* k, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i shufWeight = _mm_set_epi8(3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        const __m128i b = _mm_loadu_si128((const __m128i*)(base+i*4));
+        const __m128i o = _mm_loadu_si128((const __m128i*)(ovly+i*4));
+        int32_t k4;
+        memcpy(&k4, k+i, 4);
+        const __m128i kx = _mm_shuffle_epi8(_mm_cvtsi32_si128(k4), shufWeight);
+        const __m128i lo = BlendU16x8_SSE4<PREMUL>(_mm_cvtepu8_epi16(b), _mm_cvtepu8_epi16(o), _mm_cvtepu8_epi16(kx));
+        const __m128i hi = BlendU16x8_SSE4<PREMUL>(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(o, zero), _mm_unpackhi_epi8(kx, zero));
+        _mm_storeu_si128((__m128i*)(dst+i*4), _mm_packus_epi16(lo, hi));
+    }
+    if (i < count)
+        BlendRowU8_C<PREMUL>(dst+i*4, base+i*4, ovly+i*4, k+i, count-i);
+}
+
+template<bool PREMUL>
+MC_TARGET("sse4.1") static inline __m128 BlendPixelF_SSE4(__m128 b, __m128 o, float k, float invMax, __m128 vMax)
+{
+    const __m128 a = _mm_mul_ps(_mm_shuffle_ps(o, o, _MM_SHUFFLE(3, 3, 3, 3)), _mm_set1_ps(k*invMax));
+    const __m128 src = _mm_blend_ps(o, vMax, 0x8);
+    const __m128 w = PREMUL ? _mm_blend_ps(_mm_set1_ps(k), a, 0x8) : a;
+    return _mm_add_ps(_mm_mul_ps(b, _mm_sub_ps(_mm_set1_ps(1.f), a)), _mm_mul_ps(src, w));
+}
+
+template<bool PREMUL>
+MC_TARGET("sse4.1") static void BlendRowF32_SSE4(float* dst, const float* base, const float* ovly, const float* k, int count)
+{
+    const __m128 vMax = _mm_set1_ps(1.f);
+    for (int i = 0; i < count; i++)
+    {
+        const __m128 res = BlendPixelF_SSE4<PREMUL>(_mm_loadu_ps(base+i*4), _mm_loadu_ps(ovly+i*4), k[i], 1.f, vMax);
+        _mm_storeu_ps(dst+i*4, res);
+    }
+}
+
+MC_TARGET("sse4.1") static inline __m128 LoadU16x4_SSE4(const uint16_t* p)
+{
+    return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+template<bool PREMUL>
+MC_TARGET("sse4.1") static void BlendRowU16_SSE4(uint16_t* dst, const uint16_t* base, const uint16_t* ovly, const float* k, int count)
+{
+    const __m128 vMax = _mm_set1_ps(65535.f);
+    const float invMax = 1.f/65535.f;
+    for (int i = 0; i < count; i++)
+    {
+        const __m128 res = BlendPixelF_SSE4<PREMUL>(LoadU16x4_SSE4(base+i*4), LoadU16x4_SSE4(ovly+i*4), k[i], invMax, vMax);
+        const __m128i v = _mm_cvtps_epi32(res);
+        _mm_storel_epi64((__m128i*)(dst+i*4), _mm_packus_epi32(v, v));
+    }
+}
+
+MC_TARGET("avx2") static inline __m256i Div255_AVX2(__m256i v)
+{
+    return _mm256_mulhi_epu16(_mm256_add_epi16(v, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
+
+// blend 4 pixels, each channel is widened to 16-bit
+template<bool PREMUL>
+MC_TARGET("avx2") static inline __m256i BlendU16x16_AVX2(__m256i b, __m256i o, __m256i k)
+{
+    const __m256i v255 = _mm256_set1_epi16(255);
+    const __m256i alphaLanes = _mm256_broadcastsi128_si256(_mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0));
+    const __m256i shufAlpha = _mm256_broadcastsi128_si256(_mm_set_epi8(15, 14, 15, 14, 15, 14, 15, 14, 7, 6, 7, 6, 7, 6, 7, 6));
+    const __m256i a = Div255_AVX2(_mm256_mullo_epi16(_mm256_shuffle_epi8(o, shufAlpha), k));
+    const __m256i src = _mm256_blendv_epi8(o, v255, alphaLanes);
+    const __m256i w = PREMUL ? _mm256_blendv_epi8(k, a, alphaLanes) : a;
+    const __m256i sum = _mm256_adds_epu16(_mm256_mullo_epi16(b, _mm256_sub_epi16(v255, a)), _mm256_mullo_epi16(src, w));
+    return Div255_AVX2(_mm256_min_epu16(sum, _mm256_set1_epi16((short)(255*255))));
+}
+
+template<bool PREMUL>
+MC_TARGET("avx2") static void BlendRowU8_AVX2(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const uint8_t* k, int count)
+{
+    const __m128i shufWeightLo = _mm_set_epi8(3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+    const __m128i shufWeightHi = _mm_set_epi8(7, 7, 7, 7, 6, 6, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(base+i*4));
+        const __m256i o = _mm256_loadu_si256((const __m256i*)(ovly+i*4));
+        const __m128i k8 = _mm_loadl_epi64((const __m128i*)(k+i));
+        const __m256i lo = BlendU16x16_AVX2<PREMUL>(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(b)), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(o)),
+                _mm256_cvtepu8_epi16(_mm_shuffle_epi8(k8, shufWeightLo)));
+        const __m256i hi = BlendU16x16_AVX2<PREMUL>(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(b, 1)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(o, 1)),
+                _mm256_cvtepu8_epi16(_mm_shuffle_epi8(k8, shufWeightHi)));
+        // 'packus' works inside the 128-bit lanes, restore the pixel order
+        _mm256_storeu_si256((__m256i*)(dst+i*4), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+    }
+    if (i < count)
+        BlendRowU8_SSE4<PREMUL>(dst+i*4, base+i*4, ovly+i*4, k+i, count-i);
+}
+
+// blend 2 pixels
+template<bool PREMUL>
+MC_TARGET("avx2") static inline __m256 BlendPixelF_AVX2(__m256 b, __m256 o, float k0, float k1, float invMax, __m256 vMax)
+{
+    const __m256 a = _mm256_mul_ps(_mm256_shuffle_ps(o, o, _MM_SHUFFLE(3, 3, 3, 3)), _mm256_setr_ps(k0*invMax, k0*invMax, k0*invMax, k0*invMax, k1*invMax, k1*invMax, k1*invMax, k1*invMax));
+    const __m256 src = _mm256_blend_ps(o, vMax, 0x88);
+    const __m256 w = PREMUL ? _mm256_blend_ps(_mm256_setr_ps(k0, k0, k0, k0, k1, k1, k1, k1), a, 0x88) : a;
+    return _mm256_add_ps(_mm256_mul_ps(b, _mm256_sub_ps(_mm256_set1_ps(1.f), a)), _mm256_mul_ps(src, w));
+}
+
+template<bool PREMUL>
+MC_TARGET("avx2") static void BlendRowF32_AVX2(float* dst, const float* base, const float* ovly, const float* k, int count)
+{
+    const __m256 vMax = _mm256_set1_ps(1.f);
+    int i = 0;
+    for (; i+2 <= count; i += 2)
+    {
+        const __m256 res = BlendPixelF_AVX2<PREMUL>(_mm256_loadu_ps(base+i*4), _mm256_loadu_ps(ovly+i*4), k[i], k[i+1], 1.f, vMax);
+        _mm256_storeu_ps(dst+i*4, res);
+    }
+    if (i < count)
+        BlendRowF32_SSE4<PREMUL>(dst+i*4, base+i*4, ovly+i*4, k+i, count-i);
+}
+
+MC_TARGET("avx2") static inline __m256 LoadU16x8_AVX2(const uint16_t* p)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+
+template<bool PREMUL>
+MC_TARGET("avx2") static void BlendRowU16_AVX2(uint16_t* dst, const uint16_t* base, const uint16_t* ovly, const float* k, int count)
+{
+    const __m256 vMax = _mm256_set1_ps(65535.f);
+    const float invMax = 1.f/65535.f;
+    int i = 0;
+    for (; i+2 <= count; i += 2)
+    {
+        const __m256 res = BlendPixelF_AVX2<PREMUL>(LoadU16x8_AVX2(base+i*4), LoadU16x8_AVX2(ovly+i*4), k[i], k[i+1], invMax, vMax);
+        const __m256i v = _mm256_cvtps_epi32(res);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+        _mm_storeu_si128((__m128i*)(dst+i*4), _mm256_castsi256_si128(packed));
+    }
+    if (i < count)
+        BlendRowU16_SSE4<PREMUL>(dst+i*4, base+i*4, ovly+i*4, k+i, count-i);
+}
+#endif
+
+#if MC_CPU_NEON
+// (v+128+((v+128)>>8))>>8, which is v/255 with rounding. 'v' must be no larger than 255*255.
+static inline uint8x8_t Div255_NEON(uint16x8_t v)
+{
+    return vrshrn_n_u16(vrsraq_n_u16(v, v, 8), 8);
+}
+
+template<bool PREMUL>
+static void BlendRowU8_NEON(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const uint8_t* k, int count)
+{
+    const uint8x8_t v255 = vdup_n_u8(255);
+    const uint16x8_t vMaxSum = vdupq_n_u16(255*255);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        const uint8x8x4_t b = vld4_u8(base+i*4);
+        const uint8x8x4_t o = vld4_u8(ovly+i*4);
+        const uint8x8_t kv = vld1_u8(k+i);
+        const uint8x8_t a = Div255_NEON(vmull_u8(o.val[3], kv));
+        const uint8x8_t w = PREMUL ? kv : a;
+        const uint8x8_t ia = vsub_u8(v255, a);
+        uint8x8x4_t res;
+        for (int c = 0; c < 3; c++)
+            res.val[c] = Div255_NEON(vminq_u16(vqaddq_u16(vmull_u8(b.val[c], ia), vmull_u8(o.val[c], w)), vMaxSum));
+        res.val[3] = Div255_NEON(vaddq_u16(vmull_u8(b.val[3], ia), vmull_u8(v255, a)));
+        vst4_u8(dst+i*4, res);
+    }
+    if (i < count)
+        BlendRowU8_C<PREMUL>(dst+i*4, base+i*4, ovly+i*4, k+i, count-i);
+}
+
+template<bool PREMUL>
+static inline float32x4_t BlendPixelF_NEON(float32x4_t b, float32x4_t o, float k, float invMax, float maxVal)
+{
+    const float a = vgetq_lane_f32(o, 3)*invMax*k;
+    const float32x4_t src = vsetq_lane_f32(maxVal, o, 3);
+    const float32x4_t w = PREMUL ? vsetq_lane_f32(a, vdupq_n_f32(k), 3) : vdupq_n_f32(a);
+    return vmlaq_f32(vmulq_f32(src, w), b, vdupq_n_f32(1.f-a));
+}
+
+template<bool PREMUL>
+static void BlendRowF32_NEON(float* dst, const float* base, const float* ovly, const float* k, int count)
+{
+    for (int i = 0; i < count; i++)
+        vst1q_f32(dst+i*4, BlendPixelF_NEON<PREMUL>(vld1q_f32(base+i*4), vld1q_f32(ovly+i*4), k[i], 1.f, 1.f));
+}
+
+template<bool PREMUL>
+static void BlendRowU16_NEON(uint16_t* dst, const uint16_t* base, const uint16_t* ovly, const float* k, int count)
+{
+    const float32x4_t vZero = vdupq_n_f32(0.f);
+    const float32x4_t vMax = vdupq_n_f32(65535.f);
+    const float32x4_t vHalf = vdupq_n_f32(0.5f);
+    const float invMax = 1.f/65535.f;
+    for (int i = 0; i < count; i++)
+    {
+        const float32x4_t b = vcvtq_f32_u32(vmovl_u16(vld1_u16(base+i*4)));
+        const float32x4_t o = vcvtq_f32_u32(vmovl_u16(vld1_u16(ovly+i*4)));
+        float32x4_t res = BlendPixelF_NEON<PREMUL>(b, o, k[i], invMax, 65535.f);
+        res = vaddq_f32(vminq_f32(vmaxq_f32(res, vZero), vMax), vHalf);
+        vst1_u16(dst+i*4, vmovn_u32(vcvtq_u32_f32(res)));
+    }
+}
+#endif
+
+AlphaCompositor::AlphaCompositor()
+{
+    m_kernelName = "C";
+    m_blendRowU8[0] = BlendRowU8_C<false>;
+    m_blendRowU8[1] = BlendRowU8_C<true>;
+    m_blendRowU16[0] = BlendRowFloat_C<uint16_t, false>;
+    m_blendRowU16[1] = BlendRowFloat_C<uint16_t, true>;
+    m_blendRowF32[0] = BlendRowFloat_C<float, false>;
+    m_blendRowF32[1] = BlendRowFloat_C<float, true>;
+#if MC_CPU_X86
+    static const bool s_hasAvx2 = CpuHasAvx2();
+    static const bool s_hasSse41 = CpuHasSse41();
+    if (s_hasAvx2)
+    {
+        m_kernelName = "AVX2";
+        m_blendRowU8[0] = BlendRowU8_AVX2<false>;
+        m_blendRowU8[1] = BlendRowU8_AVX2<true>;
+        m_blendRowU16[0] = BlendRowU16_AVX2<false>;
+        m_blendRowU16[1] = BlendRowU16_AVX2<true>;
+        m_blendRowF32[0] = BlendRowF32_AVX2<false>;
+        m_blendRowF32[1] = BlendRowF32_AVX2<true>;
+    }
+    else if (s_hasSse41)
+    {
+        m_kernelName = "SSE4.1";
+        m_blendRowU8[0] = BlendRowU8_SSE4<false>;
+        m_blendRowU8[1] = BlendRowU8_SSE4<true>;
+        m_blendRowU16[0] = BlendRowU16_SSE4<false>;
+        m_blendRowU16[1] = BlendRowU16_SSE4<true>;
+        m_blendRowF32[0] = BlendRowF32_SSE4<false>;
+        m_blendRowF32[1] = BlendRowF32_SSE4<true>;
+    }
+#elif MC_CPU_NEON
+    m_kernelName = "NEON";
+    m_blendRowU8[0] = BlendRowU8_NEON<false>;
+    m_blendRowU8[1] = BlendRowU8_NEON<true>;
+    m_blendRowU16[0] = BlendRowU16_NEON<false>;
+    m_blendRowU16[1] = BlendRowU16_NEON<true>;
+    m_blendRowF32[0] = BlendRowF32_NEON<false>;
+    m_blendRowF32[1] = BlendRowF32_NEON<true>;
+#endif
+}
+
+// 256KB fits in the L2 cache of most cpus, together with the rows of the layers being read
+static const size_t BAND_BYTES = 256*1024;
+
+static bool IsSupportedDataType(ImDataType dtype)
+{
+    return dtype == IM_DT_INT8 || dtype == IM_DT_INT16 || dtype == IM_DT_FLOAT32;
+}
+
+bool AlphaCompositor::FillWeightRow(WeightRow& weights, int row, int x0, int count, float opacity, const ImGui::ImMat* mask, ImDataType dtype)
+{
+    const bool isU8 = dtype == IM_DT_INT8;
+    if (!mask)
+    {
+        // constant weights, only need to be filled once
+        if (isU8)
+        {
+            const int k = (int)(opacity*255.f+0.5f);
+            if (weights.u8.size() < (size_t)count || weights.constU8 != k)
+                weights.u8.assign(count, (uint8_t)k);
+            weights.constU8 = k;
+        }
+        else
+        {
+            if (weights.f32.size() < (size_t)count || weights.constF32 != opacity)
+                weights.f32.assign(count, opacity);
+            weights.constF32 = opacity;
+        }
+        return true;
+    }
+
+    if (isU8)
+    {
+        weights.u8.resize(count);
+        weights.constU8 = -1;
+    }
+    else
+    {
+        weights.f32.resize(count);
+        weights.constF32 = -1.f;
+    }
+    const uint8_t* pMaskRow = (const uint8_t*)mask->data+((size_t)row*mask->w+x0)*mask->elemsize;
+    float scale;
+    switch (mask->type)
+    {
+    case IM_DT_INT8:
+        if (isU8)
+        {
+            const uint32_t k = (uint32_t)(opacity*255.f+0.5f);
+            for (int i = 0; i < count; i++)
+                weights.u8[i] = (uint8_t)Div255(pMaskRow[i]*k);
+            return true;
+        }
+        scale = opacity/255.f;
+        for (int i = 0; i < count; i++)
+            weights.f32[i] = pMaskRow[i]*scale;
+        return true;
+    case IM_DT_INT16:
+    {
+        const uint16_t* pMask = (const uint16_t*)pMaskRow;
+        scale = opacity/65535.f;
+        if (isU8)
+        {
+            for (int i = 0; i < count; i++)
+                weights.u8[i] = (uint8_t)(pMask[i]*scale*255.f+0.5f);
+            return true;
+        }
+        for (int i = 0; i < count; i++)
+            weights.f32[i] = pMask[i]*scale;
+        return true;
+    }
+    case IM_DT_FLOAT32:
+    {
+        const float* pMask = (const float*)pMaskRow;
+        if (isU8)
+        {
+            for (int i = 0; i < count; i++)
+                weights.u8[i] = (uint8_t)(min(max(pMask[i], 0.f), 1.f)*opacity*255.f+0.5f);
+            return true;
+        }
+        for (int i = 0; i < count; i++)
+            weights.f32[i] = min(max(pMask[i], 0.f), 1.f)*opacity;
+        return true;
+    }
+    default:
+        break;
+    }
+    return false;
+}
+
+void AlphaCompositor::BlendRow(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const WeightRow& weights, int count, ImDataType dtype, int pmIdx) const
+{
+    switch (dtype)
+    {
+    case IM_DT_INT8:
+        m_blendRowU8[pmIdx](dst, base, ovly, weights.u8.data(), count);
+        break;
+    case IM_DT_INT16:
+        m_blendRowU16[pmIdx]((uint16_t*)dst, (const uint16_t*)base, (const uint16_t*)ovly, weights.f32.data(), count);
+        break;
+    default:
+        m_blendRowF32[pmIdx]((float*)dst, (const float*)base, (const float*)ovly, weights.f32.data(), count);
+        break;
+    }
+}
+
+bool AlphaCompositor::Composite(ImGui::ImMat& dst, const ImGui::ImMat& base, const ImGui::ImMat& overlay, int32_t x, int32_t y,
+        float opacity, bool premultiplied, const ImGui::ImMat* mask)
+{
+    if (base.empty() || overlay.empty())
+    {
+        m_errMsg = "INVALID argument! 'base' and 'overlay' must NOT be EMPTY.";
+        return false;
+    }
+    if (base.device != IM_DD_CPU || overlay.device != IM_DD_CPU || (mask && mask->device != IM_DD_CPU))
+    {
+        m_errMsg = "ONLY support images in cpu memory!";
+        return false;
+    }
+    if (base.c != 4 || overlay.c != 4)
+    {
+        m_errMsg = "ONLY support 4-channel images!";
+        return false;
+    }
+    if (base.type != overlay.type || !IsSupportedDataType(base.type))
+    {
+        m_errMsg = "ONLY support 'base' and 'overlay' of the same data type, which is INT8, INT16 or FLOAT32!";
+        return false;
+    }
+    if (mask && (mask->empty() || mask->w != overlay.w || mask->h != overlay.h || mask->c != 1 || !IsSupportedDataType(mask->type)))
+    {
+        m_errMsg = "INVALID argument! 'mask' must be a single channel image of the same size as 'overlay'.";
+        return false;
+    }
+    if (opacity < 0.f)
+        opacity = 0.f;
+    else if (opacity > 1.f)
+        opacity = 1.f;
+
+    const bool inPlace = dst.data == base.data;
+    if (!inPlace)
+    {
+        dst.create_type(base.w, base.h, 4, base.type);
+        if (dst.empty())
+        {
+            m_errMsg = "FAILED to allocate the output image!";
+            return false;
+        }
+        dst.color_format = base.color_format;
+    }
+
+    const size_t pixelSize = base.elemsize*4;
+    const size_t rowSize = (size_t)base.w*pixelSize;
+    const int x0 = max(x, 0), x1 = min(x+overlay.w, base.w);
+    const int y0 = max(y, 0), y1 = min(y+overlay.h, base.h);
+    const int count = x1-x0;
+    const int pmIdx = premultiplied ? 1 : 0;
+    for (int i = 0; i < base.h; i++)
+    {
+        const uint8_t* pBaseRow = (const uint8_t*)base.data+i*rowSize;
+        uint8_t* pDstRow = (uint8_t*)dst.data+i*rowSize;
+        if (i < y0 || i >= y1 || count <= 0)
+        {
+            if (!inPlace)
+                memcpy(pDstRow, pBaseRow, rowSize);
+            continue;
+        }
+        if (!inPlace)
+        {
+            memcpy(pDstRow, pBaseRow, x0*pixelSize);
+            memcpy(pDstRow+x1*pixelSize, pBaseRow+x1*pixelSize, (base.w-x1)*pixelSize);
+        }
+        if (!FillWeightRow(m_weights, i-y, x0-x, count, opacity, mask, base.type))
+        {
+            m_errMsg = "UNSUPPORTED data type of 'mask'!";
+            return false;
+        }
+        const uint8_t* pOvlyRow = (const uint8_t*)overlay.data+((size_t)(i-y)*overlay.w+(x0-x))*pixelSize;
+        BlendRow(pDstRow+x0*pixelSize, pBaseRow+x0*pixelSize, pOvlyRow, m_weights, count, base.type, pmIdx);
+    }
+    return true;
+}
+
+void AlphaCompositor::CompositeBand(ImGui::ImMat& dst, const vector<Layer>& layers, int y0, int y1, int pmIdx, WeightRow& weights) const
+{
+    const size_t pixelSize = dst.elemsize*4;
+    const size_t rowSize = (size_t)dst.w*pixelSize;
+    uint8_t* pBand = (uint8_t*)dst.data+y0*rowSize;
+    size_t firstLayer = 0;
+    const Layer& bottom = layers.front();
+    if (bottom.x == 0 && bottom.y == 0 && bottom.image->w == dst.w && bottom.image->h == dst.h && bottom.opacity >= 1.f)
+    {
+        // an opaque full frame bottom layer is blended onto a transparent background, which is just a copy
+        memcpy(pBand, (const uint8_t*)bottom.image->data+y0*rowSize, (y1-y0)*rowSize);
+        firstLayer = 1;
+    }
+    else
+    {
+        memset(pBand, 0, (y1-y0)*rowSize);
+    }
+
+    for (size_t l = firstLayer; l < layers.size(); l++)
+    {
+        const Layer& layer = layers[l];
+        const ImGui::ImMat& image = *layer.image;
+        const int x0 = max(layer.x, 0), x1 = min(layer.x+image.w, dst.w);
+        const int ly0 = max(layer.y, y0), ly1 = min(layer.y+image.h, y1);
+        const int count = x1-x0;
+        if (count <= 0 || ly0 >= ly1 || layer.opacity <= 0.f)
+            continue;
+        FillWeightRow(weights, 0, 0, count, layer.opacity, nullptr, dst.type);
+        for (int i = ly0; i < ly1; i++)
+        {
+            uint8_t* pDstRow = (uint8_t*)dst.data+i*rowSize+x0*pixelSize;
+            const uint8_t* pOvlyRow = (const uint8_t*)image.data+((size_t)(i-layer.y)*image.w+(x0-layer.x))*pixelSize;
+            BlendRow(pDstRow, pDstRow, pOvlyRow, weights, count, dst.type, pmIdx);
+        }
+    }
+}
+
+bool AlphaCompositor::CompositeLayers(ImGui::ImMat& dst, const vector<Layer>& layers, bool premultiplied, TaskExecutor::Holder hExecutor)
+{
+    if (dst.empty() || dst.device != IM_DD_CPU || dst.c != 4 || !IsSupportedDataType(dst.type))
+    {
+        m_errMsg = "INVALID argument! 'dst' must be an allocated 4-channel cpu image of type INT8, INT16 or FLOAT32.";
+        return false;
+    }
+    vector<Layer> validLayers;
+    validLayers.reserve(layers.size());
+    for (const auto& layer : layers)
+    {
+        if (!layer.image || layer.image->empty())
+            continue;
+        const ImGui::ImMat& image = *layer.image;
+        if (image.device != IM_DD_CPU || image.c != 4 || image.type != dst.type)
+        {
+            m_errMsg = "ONLY support layers in cpu memory, which are 4-channel images of the same data type as 'dst'!";
+            return false;
+        }
+        Layer validLayer = layer;
+        validLayer.opacity = min(max(layer.opacity, 0.f), 1.f);
+        validLayers.push_back(validLayer);
+    }
+    if (validLayers.empty())
+    {
+        memset(dst.data, 0, (size_t)dst.w*dst.h*dst.elemsize*4);
+        return true;
+    }
+
+    // Each band is blended with all the layers while it stays in the L2 cache.
+    const size_t rowSize = (size_t)dst.w*dst.elemsize*4;
+    const int bandRows = max((int)(BAND_BYTES/rowSize), 1);
+    const int bandCount = (dst.h+bandRows-1)/bandRows;
+    const int pmIdx = premultiplied ? 1 : 0;
+    TaskExecutor::ParallelFor(hExecutor, bandCount, [&] (const TaskExecutor::ItemFetcher& fetchBand) {
+        WeightRow weights;
+        int32_t band;
+        while (fetchBand(band))
+        {
+            const int y0 = band*bandRows;
+            CompositeBand(dst, validLayers, y0, min(y0+bandRows, dst.h), pmIdx, weights);
+        }
+    });
+    return true;
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <immat.h>
+#include "TaskExecutor.h"
+
+namespace MediaCore
+{
+// Blend a RGBA overlay image onto a RGBA base image on cpu. The row kernels are chosen at runtime by the cpu
+// features (AVX2, SSE4.1 or NEON), the scalar kernels are used if none of them is available.
+// Supported data types are IM_DT_INT8, IM_DT_INT16 and IM_DT_FLOAT32, the base and the overlay must have the same type.
+class AlphaCompositor
+{
+public:
+    AlphaCompositor();
+    AlphaCompositor(const AlphaCompositor&) = delete;
+    AlphaCompositor& operator=(const AlphaCompositor&) = delete;
+
+    // Write the result into 'dst', which has the same size as 'base'. 'overlay' is placed at (x, y) of 'base'.
+    // 'mask' is optional, it's a single channel image of the same size as 'overlay', which scales the alpha of 'overlay'.
+    // Return false if the arguments are not supported, see 'GetError()'.
+    bool Composite(ImGui::ImMat& dst, const ImGui::ImMat& base, const ImGui::ImMat& overlay, int32_t x, int32_t y,
+            float opacity, bool premultiplied, const ImGui::ImMat* mask = nullptr);
+
+    struct Layer
+    {
+        const ImGui::ImMat* image;
+        int32_t x;
+        int32_t y;
+        float opacity;
+    };
+    // Blend all the 'layers' into 'dst' in a single pass, the first layer is at the bottom. 'dst' must be allocated
+    // by the caller, it is cleared to transparent before the first layer. The image is processed in horizontal bands
+    // which fit in the cache, each band is written once after all the layers are blended into it. The bands are
+    // distributed to 'hExecutor' if it's not null.
+    bool CompositeLayers(ImGui::ImMat& dst, const std::vector<Layer>& layers, bool premultiplied,
+            TaskExecutor::Holder hExecutor = nullptr);
+
+    const char* GetKernelName() const { return m_kernelName; }
+    std::string GetError() const { return m_errMsg; }
+
+    using BlendRowU8Func = void (*)(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const uint8_t* k, int count);
+    using BlendRowU16Func = void (*)(uint16_t* dst, const uint16_t* base, const uint16_t* ovly, const float* k, int count);
+    using BlendRowF32Func = void (*)(float* dst, const float* base, const float* ovly, const float* k, int count);
+
+private:
+    struct WeightRow
+    {
+        std::vector<uint8_t> u8;
+        std::vector<float> f32;
+        // the constant value held by the weight row, or -1 if it is filled from a mask
+        int constU8{-1};
+        float constF32{-1.f};
+    };
+
+    static bool FillWeightRow(WeightRow& weights, int row, int x0, int count, float opacity, const ImGui::ImMat* mask, ImDataType dtype);
+    void BlendRow(uint8_t* dst, const uint8_t* base, const uint8_t* ovly, const WeightRow& weights, int count, ImDataType dtype, int pmIdx) const;
+    void CompositeBand(ImGui::ImMat& dst, const std::vector<Layer>& layers, int y0, int y1, int pmIdx, WeightRow& weights) const;
+
+private:
+    const char* m_kernelName;
+    // index 0 is for straight alpha, 1 is for premultiplied alpha
+    BlendRowU8Func m_blendRowU8[2];
+    BlendRowU16Func m_blendRowU16[2];
+    BlendRowF32Func m_blendRowF32[2];
+    WeightRow m_weights;
+    std::string m_errMsg;
+};
+}
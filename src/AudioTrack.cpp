@@ -18,8 +18,10 @@
 #include <sstream>
 #include <functional>
 #include <algorithm>
+#include <unordered_map>
 #include "AudioTrack.h"
 #include "FFUtils.h"
+#include "IntervalList.h"
 #include "DebugHelper.h"
 extern "C"
 {
@@ -104,14 +106,12 @@ public:
         lock_guard<recursive_mutex> lk(m_apiLock);
         // add this clip into clip list
         hClip->SetDirection(m_readForward);
-        m_clips.push_back(hClip);
         hClip->SetTrackId(m_id);
-        m_clips.sort(CLIP_SORT_CMP);
+        m_clipTable[hClip->Id()] = hClip;
+        // update clip order and overlap
+        UpdateClipIndex(hClip);
         // update track duration
-        AudioClip::Holder lastClip = m_clips.back();
-        m_duration = lastClip->Start()+lastClip->Duration();
-        // update overlap
-        UpdateClipOverlap(hClip);
+        m_duration = m_clips.MaxEnd();
         // update read iterators
         int64_t pos = (double)m_readSamples/m_outSampleRate;
         UpdateReadIterator(pos);
@@ -129,13 +129,10 @@ public:
         else
             hClip->SetStart(start);
 
-        // update clip order
-        m_clips.sort(CLIP_SORT_CMP);
+        // update clip order and overlap
+        UpdateClipIndex(hClip);
         // update track duration
-        AudioClip::Holder lastClip = m_clips.back();
-        m_duration = lastClip->Start()+lastClip->Duration();
-        // update overlap
-        UpdateClipOverlap(hClip);
+        m_duration = m_clips.MaxEnd();
         // update read iterators
         int64_t pos = (double)m_readSamples/m_outSampleRate;
         UpdateReadIterator(pos);
@@ -164,13 +161,10 @@ public:
         if (!rangeChanged)
             return;
 
-        // update clip order
-        m_clips.sort(CLIP_SORT_CMP);
+        // update clip order and overlap
+        UpdateClipIndex(hClip);
         // update track duration
-        AudioClip::Holder lastClip = m_clips.back();
-        m_duration = lastClip->Start()+lastClip->Duration();
-        // update overlap
-        UpdateClipOverlap(hClip);
+        m_duration = m_clips.MaxEnd();
         // update read iterators
         int64_t pos = (double)m_readSamples/m_outSampleRate;
         UpdateReadIterator(pos);
@@ -179,24 +173,15 @@ public:
     AudioClip::Holder RemoveClipById(int64_t clipId) override
     {
         lock_guard<recursive_mutex> lk(m_apiLock);
-        auto iter = find_if(m_clips.begin(), m_clips.end(), [clipId](const AudioClip::Holder& clip) {
-            return clip->Id() == clipId;
-        });
-        if (iter == m_clips.end())
+        auto iter = m_clipTable.find(clipId);
+        if (iter == m_clipTable.end())
             return nullptr;
 
-        AudioClip::Holder hClip = (*iter);
-        m_clips.erase(iter);
+        AudioClip::Holder hClip = iter->second;
+        m_clipTable.erase(iter);
+        UpdateClipIndex(hClip, true);
         hClip->SetTrackId(-1);
-        UpdateClipOverlap(hClip, true);
-
-        if (m_clips.empty())
-            m_duration = 0;
-        else
-        {
-            AudioClip::Holder lastClip = m_clips.back();
-            m_duration = lastClip->Start()+lastClip->Duration();
-        }
+        m_duration = m_clips.MaxEnd();
 
         // update read iterators
         int64_t pos = (double)m_readSamples/m_outSampleRate;
@@ -210,24 +195,11 @@ public:
         if (index >= m_clips.size())
             throw invalid_argument("Argument 'index' exceeds the count of clips!");
 
-        auto iter = m_clips.begin();
-        while (index > 0)
-        {
-            iter++; index--;
-        }
-
-        AudioClip::Holder hClip = (*iter);
-        m_clips.erase(iter);
+        AudioClip::Holder hClip = m_clips.At(index);
+        m_clipTable.erase(hClip->Id());
+        UpdateClipIndex(hClip, true);
         hClip->SetTrackId(-1);
-        UpdateClipOverlap(hClip, true);
-
-        if (m_clips.empty())
-            m_duration = 0;
-        else
-        {
-            AudioClip::Holder lastClip = m_clips.back();
-            m_duration = lastClip->Start()+lastClip->Duration();
-        }
+        m_duration = m_clips.MaxEnd();
 
         // update read iterators
         int64_t pos = (double)m_readSamples/m_outSampleRate;
@@ -510,23 +482,14 @@ public:
         lock_guard<recursive_mutex> lk(m_apiLock);
         if (index >= m_clips.size())
             return nullptr;
-        auto iter = m_clips.begin();
-        while (index > 0)
-        {
-            iter++; index--;
-        }
-        return *iter;
+        return m_clips.At(index);
     }
 
     AudioClip::Holder GetClipById(int64_t id) override
     {
         lock_guard<recursive_mutex> lk(m_apiLock);
-        auto iter = find_if(m_clips.begin(), m_clips.end(), [id] (const AudioClip::Holder& clip) {
-            return clip->Id() == id;
-        });
-        if (iter != m_clips.end())
-            return *iter;
-        return nullptr;
+        auto iter = m_clipTable.find(id);
+        return iter != m_clipTable.end() ? iter->second : nullptr;
     }
 
     AudioOverlap::Holder GetOverlapById(int64_t id) override
@@ -603,59 +566,10 @@ public:
     friend ostream& operator<<(ostream& os, AudioTrack_Impl& track);
 
 private:
-    static function<bool(const AudioClip::Holder&, const AudioClip::Holder&)> CLIP_SORT_CMP;
-    static function<bool(const AudioOverlap::Holder&, const AudioOverlap::Holder&)> OVERLAP_SORT_CMP;
-
-    void UpdateClipOverlap(AudioClip::Holder hUpdateClip, bool remove = false)
+    // Update the position of 'hClip' in the clip list and the overlaps on it, see 'UpdateTrackIndex()'
+    void UpdateClipIndex(AudioClip::Holder hClip, bool remove = false)
     {
-        const int64_t id1 = hUpdateClip->Id();
-        // remove invalid overlaps
-        auto ovIter = m_overlaps.begin();
-        while (ovIter != m_overlaps.end())
-        {
-            auto& hOverlap = *ovIter;
-            if (hOverlap->FrontClip()->TrackId() != m_id || hOverlap->RearClip()->TrackId() != m_id)
-            {
-                ovIter = m_overlaps.erase(ovIter);
-                continue;
-            }
-            if (hOverlap->FrontClip()->Id() == id1 || hOverlap->RearClip()->Id() == id1)
-            {
-                hOverlap->Update();
-                if (hOverlap->Duration() <= 0)
-                {
-                    ovIter = m_overlaps.erase(ovIter);
-                    continue;
-                }
-            }
-            ovIter++;
-        }
-        if (!remove)
-        {
-            // add new overlaps
-            for (auto& clip : m_clips)
-            {
-                if (hUpdateClip == clip)
-                    continue;
-                if (AudioOverlap::HasOverlap(hUpdateClip, clip))
-                {
-                    const int64_t id2 = clip->Id();
-                    auto iter = find_if(m_overlaps.begin(), m_overlaps.end(), [id1, id2] (const AudioOverlap::Holder& overlap) {
-                        const int64_t idf = overlap->FrontClip()->Id();
-                        const int64_t idr = overlap->RearClip()->Id();
-                        return (id1 == idf && id2 == idr) || (id1 == idr && id2 == idf);
-                    });
-                    if (iter == m_overlaps.end())
-                    {
-                        AudioOverlap::Holder hOverlap = AudioOverlap::CreateInstance(0, hUpdateClip, clip);
-                        m_overlaps.push_back(hOverlap);
-                    }
-                }
-            }
-        }
-
-        // sort overlap by 'Start' time
-        m_overlaps.sort(OVERLAP_SORT_CMP);
+        UpdateTrackIndex(m_clips, m_overlaps, hClip, remove);
     }
 
     uint32_t ReadClipData(uint8_t** buf, uint32_t toReadSamples)
@@ -837,84 +751,28 @@ private:
 
     void UpdateReadIterator(int64_t pos)
     {
+        // seek the clips lasting at 'pos', including the ones ending at 'pos'
+        for (auto& hClip : m_clips.FindInRange(pos-1, pos+1))
+        {
+            const int64_t clipPos = pos-hClip->Start();
+            if (clipPos >= 0 && clipPos <= hClip->Duration())
+                hClip->SeekTo(clipPos);
+        }
         if (m_readForward)
         {
-            // update read clip iterator
-            m_readClipIter = m_clips.end();
-            {
-                auto iter = m_clips.begin();
-                while (iter != m_clips.end())
-                {
-                    const AudioClip::Holder& hClip = *iter;
-                    int64_t clipPos = pos-hClip->Start();
-                    if (m_readClipIter == m_clips.end() && clipPos < hClip->Duration())
-                    {
-                        m_readClipIter = iter;
-                        if (clipPos < 0) clipPos = 0;
-                        hClip->SeekTo(clipPos);
-                    }
-                    else if (clipPos >= 0 && clipPos <= hClip->Duration())
-                    {
-                        hClip->SeekTo(clipPos);
-                    }
-                    iter++;
-                }
-            }
-            // update read overlap iterator
-            m_readOverlapIter = m_overlaps.end();
-            {
-                auto iter = m_overlaps.begin();
-                while (iter != m_overlaps.end())
-                {
-                    const AudioOverlap::Holder& hOverlap = *iter;
-                    int64_t overlapPos = pos-hOverlap->Start();
-                    if (m_readOverlapIter == m_overlaps.end() && overlapPos < hOverlap->Duration())
-                    {
-                        m_readOverlapIter = iter;
-                        break;
-                    }
-                    iter++;
-                }
-            }
+            // the first clip ending after 'pos', it may start after 'pos'
+            m_readClipIter = m_clips.FirstEndingAfter(pos);
+            if (m_readClipIter != m_clips.end() && pos < (*m_readClipIter)->Start())
+                (*m_readClipIter)->SeekTo(0);
+            m_readOverlapIter = m_overlaps.FirstEndingAfter(pos);
         }
         else
         {
-            m_readClipIter = m_clips.end();
-            {
-                auto riter = m_clips.rbegin();
-                while (riter != m_clips.rend())
-                {
-                    const AudioClip::Holder& hClip = *riter;
-                    int64_t clipPos = pos-hClip->Start();
-                    if (m_readClipIter == m_clips.end() && clipPos >= 0)
-                    {
-                        m_readClipIter = riter.base();
-                        m_readClipIter--;
-                        if (clipPos > hClip->Duration()) clipPos = hClip->Duration();
-                        hClip->SeekTo(clipPos);
-                    }
-                    else if (clipPos >= 0 && clipPos <= hClip->Duration())
-                    {
-                        hClip->SeekTo(clipPos);
-                    }
-                    riter++;
-                }
-            }
-            m_readOverlapIter = m_overlaps.end();
-            {
-                auto riter = m_overlaps.rbegin();
-                while (riter != m_overlaps.rend())
-                {
-                    const AudioOverlap::Holder& hOverlap = *riter;
-                    int64_t overlapPos = pos-hOverlap->Start();
-                    if (m_readOverlapIter == m_overlaps.end() && overlapPos >= 0)
-                    {
-                        m_readOverlapIter = riter.base();
-                        m_readOverlapIter--;
-                    }
-                    riter++;
-                }
-            }
+            // the last clip starting before 'pos', it may end before 'pos'
+            m_readClipIter = m_clips.LastStartingAtOrBefore(pos);
+            if (m_readClipIter != m_clips.end() && pos > (*m_readClipIter)->End())
+                (*m_readClipIter)->SeekTo((*m_readClipIter)->Duration());
+            m_readOverlapIter = m_overlaps.LastStartingAtOrBefore(pos);
         }
     }
 
@@ -986,9 +844,10 @@ private:
     uint8_t m_bytesPerSample;
     uint32_t m_frameSize;
     uint32_t m_pcmSizePerSec;
-    list<AudioClip::Holder> m_clips;
+    IntervalList<AudioClip::Holder> m_clips;
+    unordered_map<int64_t, AudioClip::Holder> m_clipTable;
     list<AudioClip::Holder>::iterator m_readClipIter;
-    list<AudioOverlap::Holder> m_overlaps;
+    IntervalList<AudioOverlap::Holder> m_overlaps;
     list<AudioOverlap::Holder>::iterator m_readOverlapIter;
     int64_t m_readSamples{0};
     int64_t m_duration{0};
@@ -1018,28 +877,15 @@ AudioTrack::Holder AudioTrack_Impl::Clone(SharedSettings::Holder hSettings)
     for (auto clip : m_clips)
     {
         auto newClip = clip->Clone(hSettings);
-        newInstance->m_clips.push_back(newClip);
         newClip->SetTrackId(m_id);
-        AudioClip::Holder lastClip = newInstance->m_clips.back();
-        newInstance->m_duration = lastClip->Start()+lastClip->Duration();
-        newInstance->UpdateClipOverlap(newClip);
+        newInstance->m_clipTable[newClip->Id()] = newClip;
+        newInstance->UpdateClipIndex(newClip);
     }
+    newInstance->m_duration = newInstance->m_clips.MaxEnd();
     newInstance->m_aeFilter->CopyParamsFrom(m_aeFilter.get());
     return AudioTrack::Holder(newInstance, AUDIO_TRACK_HOLDER_DELETER);
 }
 
-function<bool(const AudioClip::Holder&, const AudioClip::Holder&)> AudioTrack_Impl::CLIP_SORT_CMP =
-    [](const AudioClip::Holder& a, const AudioClip::Holder& b)
-    {
-        return a->Start() < b->Start();
-    };
-
-function<bool(const AudioOverlap::Holder&, const AudioOverlap::Holder&)> AudioTrack_Impl::OVERLAP_SORT_CMP =
-    [](const AudioOverlap::Holder& a, const AudioOverlap::Holder& b)
-    {
-        return a->Start() < b->Start();
-    };
-
 ALogger* AudioTrack::GetLogger()
 {
     return Logger::GetLogger("AudioTrack");
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+// Shared by the cpu image kernels (AlphaCompositor, AffineWarper, OpacityMasker and YuvToRgbaConverter). Each kernel
+// has a plain C version and the simd versions selected at runtime with the functions below.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MC_CPU_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define MC_CPU_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The x86 kernels are compiled with target attributes, so no extra compiler flag is needed for the files using them.
+#if defined(__GNUC__) || defined(__clang__)
+#define MC_TARGET(x) __attribute__((target(x)))
+#else
+#define MC_TARGET(x)
+#endif
+
+namespace MediaCore
+{
+// The images are split into bands of rows, which are processed with 'TaskExecutor::ParallelFor()' on the
+// executor passed to the kernel, or only on the calling thread if it's null.
+static const int CPU_KERNEL_BAND_ROWS = 32;
+
+#if MC_CPU_X86
+inline bool CpuHasSse41()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2]&(1<<19)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+inline bool CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    // the os must save the ymm registers
+    if ((info[2]&(1<<27)) == 0 || (info[2]&(1<<28)) == 0 || (_xgetbv(0)&0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1]&(1<<5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+}
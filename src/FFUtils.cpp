@@ -21,9 +21,13 @@
 #include <memory>
 #include <functional>
 #include <algorithm>
+#include <atomic>
 #include "Logger.h"
 #include "FFUtils.h"
 #include "HwaccelManager.h"
+#include "FramePool.h"
+#include "TaskExecutor.h"
+#include "YuvToRgbaConverter.h"
 extern "C"
 {
     #include "libavutil/pixdesc.h"
@@ -126,6 +130,14 @@ AVPixelFormat GetAVPixelFormatByName(const std::string& name)
     return av_get_pix_fmt(fmtLowerCase.c_str());
 }
 
+bool IsPixelFormatWithAlpha(AVPixelFormat pixfmt)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixfmt);
+    if (!desc)
+        return true;
+    return (desc->flags&(AV_PIX_FMT_FLAG_ALPHA|AV_PIX_FMT_FLAG_PAL)) != 0;
+}
+
 ImColorFormat ConvertPixelFormatToColorFormat(AVPixelFormat pixfmt)
 {
     const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixfmt);
@@ -425,6 +437,27 @@ bool IsHwFrame(const AVFrame* avfrm)
     return (desc->flags&AV_PIX_FMT_FLAG_HWACCEL) > 0;
 }
 
+// transfer the hardware frame into a software frame whose buffer is allocated from the frame pool
+static int TransferHwFrameDataToPooledFrame(AVFrame* swfrm, const AVFrame* hwfrm)
+{
+    if (hwfrm->hw_frames_ctx)
+    {
+        const AVHWFramesContext* hwfrmCtx = (const AVHWFramesContext*)hwfrm->hw_frames_ctx->data;
+        swfrm->format = (int)hwfrmCtx->sw_format;
+        swfrm->width = hwfrm->width;
+        swfrm->height = hwfrm->height;
+        if (MediaCore::FramePool::GetDefaultInstance()->AllocAVFrameBuffer(swfrm))
+        {
+            int fferr = av_hwframe_transfer_data(swfrm, hwfrm, 0);
+            if (fferr >= 0)
+                return fferr;
+        }
+        av_frame_unref(swfrm);
+    }
+    swfrm->format = (int)AV_PIX_FMT_NONE;
+    return av_hwframe_transfer_data(swfrm, hwfrm, 0);
+}
+
 bool HwFrameToSwFrame(AVFrame* swfrm, const AVFrame* hwfrm)
 {
     int fferr;
@@ -435,8 +468,7 @@ bool HwFrameToSwFrame(AVFrame* swfrm, const AVFrame* hwfrm)
     {
         // Log(WARN) << "av_hwframe_map() FAILED! fferr=" << fferr << "." << endl;
         av_frame_unref(swfrm);
-        swfrm->format = (int)AV_PIX_FMT_NONE;
-        fferr = av_hwframe_transfer_data(swfrm, hwfrm, 0);
+        fferr = TransferHwFrameDataToPooledFrame(swfrm, hwfrm);
         if (fferr < 0)
         {
             Log(Error) << "av_hwframe_map and av_hwframe_transfer_data() FAILED! fferr=" << fferr << "." << endl;
@@ -449,8 +481,7 @@ bool HwFrameToSwFrame(AVFrame* swfrm, const AVFrame* hwfrm)
         swfrm->height = hwfrm->height;
     }
 #else
-    swfrm->format = (int)AV_PIX_FMT_NONE;
-    fferr = av_hwframe_transfer_data(swfrm, hwfrm, 0);
+    fferr = TransferHwFrameDataToPooledFrame(swfrm, hwfrm);
     if (fferr < 0)
     {
         Log(Error) << "av_hwframe_transfer_data() FAILED! fferr=" << fferr << "." << endl;
@@ -465,8 +496,7 @@ bool TransferHwFrameToSwFrame(AVFrame* swfrm, const AVFrame* hwfrm)
 {
     int fferr;
     av_frame_unref(swfrm);
-    swfrm->format = (int)AV_PIX_FMT_NONE;
-    fferr = av_hwframe_transfer_data(swfrm, hwfrm, 0);
+    fferr = TransferHwFrameDataToPooledFrame(swfrm, hwfrm);
     if (fferr < 0)
     {
         Log(Error) << "av_hwframe_transfer_data() FAILED! fferr=" << fferr << "." << endl;
@@ -504,6 +534,35 @@ bool MakeAVFrameCopy(AVFrame* dst, const AVFrame* src)
     return true;
 }
 
+static void SetVideoMatProps(ImGui::ImMat& vmat, const AVFrame* avfrm, const AVPixFmtDescriptor* desc, double timestamp)
+{
+    const bool isRgb = (desc->flags&AV_PIX_FMT_FLAG_RGB) > 0;
+    vmat.color_space =  avfrm->colorspace == AVCOL_SPC_BT470BG ||
+                        avfrm->colorspace == AVCOL_SPC_SMPTE170M ||
+                        avfrm->colorspace == AVCOL_SPC_BT470BG ? IM_CS_BT601 :
+                        avfrm->colorspace == AVCOL_SPC_BT709 ? IM_CS_BT709 :
+                        avfrm->colorspace == AVCOL_SPC_BT2020_NCL ||
+                        avfrm->colorspace == AVCOL_SPC_BT2020_CL ? IM_CS_BT2020 :
+                        avfrm->colorspace == AVCOL_SPC_RGB ? IM_CS_SRGB :
+                        (avfrm->colorspace == AVCOL_SPC_UNSPECIFIED && isRgb) ? IM_CS_SRGB : IM_CS_BT709;
+    vmat.color_range =  avfrm->color_range == AVCOL_RANGE_MPEG ? IM_CR_NARROW_RANGE :
+                        avfrm->color_range == AVCOL_RANGE_JPEG ? IM_CR_FULL_RANGE :
+                        isRgb ? IM_CR_FULL_RANGE : IM_CR_NARROW_RANGE;
+    vmat.color_format = ConvertPixelFormatToColorFormat((AVPixelFormat)avfrm->format);
+    vmat.depth = desc->comp[0].depth;
+    vmat.flags = IM_MAT_FLAGS_VIDEO_FRAME;
+    if (avfrm->pict_type == AV_PICTURE_TYPE_I) vmat.flags |= IM_MAT_FLAGS_VIDEO_FRAME_I;
+    if (avfrm->pict_type == AV_PICTURE_TYPE_P) vmat.flags |= IM_MAT_FLAGS_VIDEO_FRAME_P;
+    if (avfrm->pict_type == AV_PICTURE_TYPE_B) vmat.flags |= IM_MAT_FLAGS_VIDEO_FRAME_B;
+#if LIBAVUTIL_VERSION_MAJOR > 59 || defined(FF_API_INTERLACED_FRAME)
+    if ((avfrm->flags&AV_FRAME_FLAG_INTERLACED) > 0)
+#else
+    if (avfrm->interlaced_frame) 
+#endif
+        vmat.flags |= IM_MAT_FLAGS_VIDEO_INTERLACED;
+    vmat.time_stamp = timestamp;
+}
+
 bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp)
 {
     SelfFreeAVFramePtr swfrm;
@@ -531,21 +590,9 @@ bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double time
     const bool isPlanar = (desc->flags&AV_PIX_FMT_FLAG_PLANAR) != 0;
 
     int bitDepth = desc->comp[0].depth;
-    ImColorSpace color_space =  avfrm->colorspace == AVCOL_SPC_BT470BG ||
-                                avfrm->colorspace == AVCOL_SPC_SMPTE170M ||
-                                avfrm->colorspace == AVCOL_SPC_BT470BG ? IM_CS_BT601 :
-                                avfrm->colorspace == AVCOL_SPC_BT709 ? IM_CS_BT709 :
-                                avfrm->colorspace == AVCOL_SPC_BT2020_NCL ||
-                                avfrm->colorspace == AVCOL_SPC_BT2020_CL ? IM_CS_BT2020 :
-                                avfrm->colorspace == AVCOL_SPC_RGB ? IM_CS_SRGB :
-                                (avfrm->colorspace == AVCOL_SPC_UNSPECIFIED && isRgb) ? IM_CS_SRGB : IM_CS_BT709;
-    ImColorRange color_range =  avfrm->color_range == AVCOL_RANGE_MPEG ? IM_CR_NARROW_RANGE :
-                                avfrm->color_range == AVCOL_RANGE_JPEG ? IM_CR_FULL_RANGE :
-                                isRgb ? IM_CR_FULL_RANGE : IM_CR_NARROW_RANGE;
-    ImColorFormat clrfmt = ConvertPixelFormatToColorFormat((AVPixelFormat)avfrm->format);
-    if ((int)clrfmt < 0)
+    ImColorFormat color_format = ConvertPixelFormatToColorFormat((AVPixelFormat)avfrm->format);
+    if ((int)color_format < 0)
         return false;
-    ImColorFormat color_format = clrfmt;
     const int width = avfrm->width;
     const int height = avfrm->height;
 
@@ -562,7 +609,8 @@ bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double time
         else
             channel = 2;
     }
-    mat_V.create_type(width, height, channel, dataType);
+    if (!MediaCore::FramePool::GetDefaultInstance()->AcquireMat(mat_V, width, height, channel, dataType))
+        mat_V.create_type(width, height, channel, dataType);
     uint8_t* prevDataPtr = nullptr;
     for (int i = 0; i < desc->nb_components; i++)
     {
@@ -592,26 +640,89 @@ bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double time
         }
     }
 
-    mat_V.color_space = color_space;
-    mat_V.color_range = color_range;
-    mat_V.color_format = color_format;
-    mat_V.depth = bitDepth;
-    mat_V.flags = IM_MAT_FLAGS_VIDEO_FRAME;
-    if (avfrm->pict_type == AV_PICTURE_TYPE_I) mat_V.flags |= IM_MAT_FLAGS_VIDEO_FRAME_I;
-    if (avfrm->pict_type == AV_PICTURE_TYPE_P) mat_V.flags |= IM_MAT_FLAGS_VIDEO_FRAME_P;
-    if (avfrm->pict_type == AV_PICTURE_TYPE_B) mat_V.flags |= IM_MAT_FLAGS_VIDEO_FRAME_B;
-#if LIBAVUTIL_VERSION_MAJOR > 59 || defined(FF_API_INTERLACED_FRAME)
-    if ((avfrm->flags&AV_FRAME_FLAG_INTERLACED) > 0)
-#else
-    if (avfrm->interlaced_frame) 
-#endif
-        mat_V.flags |= IM_MAT_FLAGS_VIDEO_INTERLACED;
-    mat_V.time_stamp = timestamp;
-
+    SetVideoMatProps(mat_V, avfrm, desc, timestamp);
     vmat = mat_V;
     return true;
 }
 
+// Allocator of the ImMat wrapping the buffer of an AVFrame. It holds a reference of the AVFrame, and deletes itself after
+// the wrapped buffer and the buffers allocated by it are all freed.
+class AVFrameMatAllocator : public ImGui::Allocator
+{
+public:
+    AVFrameMatAllocator(SelfFreeAVFramePtr hAvfrm) : m_hAvfrm(hAvfrm), m_pData(hAvfrm->data[0]) {}
+
+    void* fastMalloc(size_t size) override
+    {
+        m_userCount++;
+        return malloc(size);
+    }
+
+    void fastFree(void* ptr) override
+    {
+        if (ptr == m_pData)
+            m_hAvfrm = nullptr;
+        else
+            free(ptr);
+        if (--m_userCount == 0)
+            delete this;
+    }
+
+    SelfFreeAVFramePtr GetFrame(const void* pData) const
+    {
+        return pData == m_pData ? m_hAvfrm : nullptr;
+    }
+
+    // the reference count of the ImMat instances sharing the wrapped buffer
+    int m_refcount{1};
+
+private:
+    SelfFreeAVFramePtr m_hAvfrm;
+    const void* m_pData;
+    atomic_int m_userCount{1};
+};
+
+bool WrapAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp)
+{
+    if (!avfrm->buf[0] || IsHwFrame(avfrm))
+        return false;
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)avfrm->format);
+    if (!desc || (desc->flags&AV_PIX_FMT_FLAG_RGB) == 0 || (desc->flags&(AV_PIX_FMT_FLAG_PLANAR|AV_PIX_FMT_FLAG_PAL)) != 0)
+        return false;
+    if ((int)ConvertPixelFormatToColorFormat((AVPixelFormat)avfrm->format) < 0)
+        return false;
+    // ImMat has no row stride, so the rows must be contiguous, and every component must take whole bytes
+    const int channel = desc->nb_components;
+    const int bytePerElem = (desc->comp[0].depth+7)/8;
+    if (desc->comp[0].step != channel*bytePerElem || avfrm->linesize[0] != avfrm->width*channel*bytePerElem)
+        return false;
+
+    auto hAvfrm = CloneSelfFreeAVFramePtr(avfrm);
+    if (!hAvfrm)
+        return false;
+    const bool isBigEndian = (desc->flags&AV_PIX_FMT_FLAG_BE) > 0;
+    const ImDataType dataType = bytePerElem > 1 ? isBigEndian ? IM_DT_INT16_BE : IM_DT_INT16 : IM_DT_INT8;
+    ImGui::ImMat wrapMat;
+    wrapMat.create_type(avfrm->width, avfrm->height, channel, hAvfrm->data[0], dataType);
+    auto pAllocator = new AVFrameMatAllocator(hAvfrm);
+    wrapMat.allocator = pAllocator;
+    wrapMat.refcount = &pAllocator->m_refcount;
+    SetVideoMatProps(wrapMat, avfrm, desc, timestamp);
+    vmat = wrapMat;
+    return true;
+}
+
+SelfFreeAVFramePtr GetWrappedAVFrame(const ImGui::ImMat& vmat)
+{
+    if (vmat.device != IM_DD_CPU)
+        return nullptr;
+    auto pAllocator = dynamic_cast<AVFrameMatAllocator*>(vmat.allocator);
+    if (!pAllocator)
+        return nullptr;
+    auto hAvfrm = pAllocator->GetFrame(vmat.data);
+    return hAvfrm ? CloneSelfFreeAVFramePtr(hAvfrm.get()) : nullptr;
+}
+
 bool MapAVFrameToImMat(const AVFrame* avfrm, std::vector<ImGui::ImMat>& vmat, double timestamp)
 {
     const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)avfrm->format);
@@ -727,6 +838,14 @@ bool ConvertImMatToAVFrame(const ImGui::ImMat& vmat, AVFrame* avfrm, int64_t pts
         return false;
     }
     av_frame_unref(avfrm);
+    // the ImMat wrapping an AVFrame gives back a reference of the AVFrame
+    auto hWrappedFrm = GetWrappedAVFrame(vmat);
+    if (hWrappedFrm && hWrappedFrm->format == (int)cvtPixfmt && hWrappedFrm->width == vmat.w && hWrappedFrm->height == vmat.h
+            && av_frame_ref(avfrm, hWrappedFrm.get()) >= 0)
+    {
+        avfrm->pts = pts;
+        return true;
+    }
     avfrm->width = vmat.w;
     avfrm->height = vmat.h;
     avfrm->format = (int)cvtPixfmt;
@@ -818,6 +937,11 @@ AVFrameToImMatConverter::~AVFrameToImMatConverter()
         sws_freeContext(m_swsCtx);
         m_swsCtx = nullptr;
     }
+    if (m_yuvCvt)
+    {
+        delete m_yuvCvt;
+        m_yuvCvt = nullptr;
+    }
 }
 
 bool AVFrameToImMatConverter::SetOutSize(uint32_t width, uint32_t height)
@@ -905,6 +1029,68 @@ bool AVFrameToImMatConverter::SetResizeInterpolateMode(ImInterpolateMode interp)
     return true;
 }
 
+// Describe the planes of a YUV frame for 'YuvToRgbaConverter', return false if the pixel format is not supported by it
+static bool GetYuvConverterSource(const AVFrame* avfrm, MediaCore::YuvToRgbaConverter::Source& src)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)avfrm->format);
+    const uint64_t unsupportedFlags = AV_PIX_FMT_FLAG_RGB|AV_PIX_FMT_FLAG_PAL|AV_PIX_FMT_FLAG_BE|AV_PIX_FMT_FLAG_HWACCEL|AV_PIX_FMT_FLAG_ALPHA|AV_PIX_FMT_FLAG_BITSTREAM;
+    if (!desc || (desc->flags&unsupportedFlags) != 0 || desc->nb_components != 3 || desc->log2_chroma_w != 1 || desc->log2_chroma_h > 1)
+        return false;
+    const AVComponentDescriptor* comp = desc->comp;
+    const int depth = comp[0].depth;
+    const int sampleBytes = depth > 8 ? 2 : 1;
+    if (comp[1].depth != depth || comp[2].depth != depth || comp[1].shift != comp[0].shift || comp[2].shift != comp[0].shift)
+        return false;
+    if (comp[0].plane != 0 || comp[0].step != sampleBytes || comp[0].offset != 0 || comp[1].plane != 1)
+        return false;
+    src.semiPlanar = comp[2].plane == 1;
+    if (src.semiPlanar)
+    {
+        if (comp[1].step != sampleBytes*2 || comp[2].step != sampleBytes*2 || min(comp[1].offset, comp[2].offset) != 0 || max(comp[1].offset, comp[2].offset) != sampleBytes)
+            return false;
+        src.swapUV = comp[2].offset == 0;
+    }
+    else if (comp[2].plane != 2 || comp[1].step != sampleBytes || comp[2].step != sampleBytes || comp[1].offset != 0 || comp[2].offset != 0)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+    {
+        src.data[i] = avfrm->data[i];
+        src.linesize[i] = avfrm->linesize[i];
+    }
+    src.width = avfrm->width;
+    src.height = avfrm->height;
+    src.bitDepth = depth;
+    src.shift = comp[0].shift;
+    src.log2ChromaH = desc->log2_chroma_h;
+    src.matrix = avfrm->colorspace == AVCOL_SPC_BT470BG || avfrm->colorspace == AVCOL_SPC_SMPTE170M ? MediaCore::YuvToRgbaConverter::MATRIX_BT601 :
+                 avfrm->colorspace == AVCOL_SPC_BT2020_NCL || avfrm->colorspace == AVCOL_SPC_BT2020_CL ? MediaCore::YuvToRgbaConverter::MATRIX_BT2020 :
+                 MediaCore::YuvToRgbaConverter::MATRIX_BT709;
+    src.fullRange = avfrm->color_range == AVCOL_RANGE_JPEG || avfrm->format == (int)AV_PIX_FMT_YUVJ420P || avfrm->format == (int)AV_PIX_FMT_YUVJ422P;
+    return true;
+}
+
+static bool GetYuvConverterInterpolation(ImInterpolateMode interp, MediaCore::YuvToRgbaConverter::Interpolation& cvtInterp)
+{
+    switch (interp)
+    {
+        case IM_INTERPOLATE_NEAREST:
+            cvtInterp = MediaCore::YuvToRgbaConverter::INTERP_NEAREST;
+            return true;
+        case IM_INTERPOLATE_BILINEAR:
+            cvtInterp = MediaCore::YuvToRgbaConverter::INTERP_BILINEAR;
+            return true;
+        case IM_INTERPOLATE_BICUBIC:
+            cvtInterp = MediaCore::YuvToRgbaConverter::INTERP_BICUBIC;
+            return true;
+        case IM_INTERPOLATE_AREA:
+            cvtInterp = MediaCore::YuvToRgbaConverter::INTERP_AREA;
+            return true;
+        default:
+            return false;
+    }
+}
+
 bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& outMat, double timestamp)
 {
     if (m_useVulkanComponents)
@@ -1052,6 +1238,32 @@ bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& o
 
         int outWidth = m_outWidth == 0 ? avfrm->width : m_outWidth;
         int outHeight = m_outHeight == 0 ? avfrm->height : m_outHeight;
+
+        // the common YUV formats are converted and resized in row slices on the shared executor, 'swscale' handles the others
+        MediaCore::YuvToRgbaConverter::Source yuvSrc;
+        MediaCore::YuvToRgbaConverter::Interpolation yuvInterp;
+        if (m_useSimdConverter && GetYuvConverterSource(avfrm, yuvSrc) && GetYuvConverterInterpolation(m_resizeInterp, yuvInterp) &&
+            MediaCore::YuvToRgbaConverter::IsSupported(yuvSrc, m_outDataType))
+        {
+            if (!m_yuvCvt)
+                m_yuvCvt = new MediaCore::YuvToRgbaConverter();
+            ImGui::ImMat rgbaMat;
+            if (!MediaCore::FramePool::GetDefaultInstance()->AcquireMat(rgbaMat, outWidth, outHeight, 4, m_outDataType))
+                rgbaMat.create_type(outWidth, outHeight, 4, m_outDataType);
+            if (!m_yuvCvt->Convert(rgbaMat, yuvSrc, yuvInterp, MediaCore::TaskExecutor::GetDefaultInstance()))
+            {
+                m_errMsg = "FAILED to convert the YUV frame! "+m_yuvCvt->GetError();
+                return false;
+            }
+            SetVideoMatProps(rgbaMat, avfrm, av_pix_fmt_desc_get((AVPixelFormat)avfrm->format), timestamp);
+            rgbaMat.color_space = IM_CS_SRGB;
+            rgbaMat.color_range = IM_CR_FULL_RANGE;
+            rgbaMat.color_format = IM_CF_RGBA;
+            rgbaMat.depth = m_outDataType == IM_DT_INT8 ? 8 : (m_outDataType == IM_DT_INT16 ? 16 : 32);
+            outMat = rgbaMat;
+            return true;
+        }
+
         if (!(m_swsCtx || m_passThrough) ||
             m_swsInWidth != avfrm->width || m_swsInHeight != avfrm->height ||
             (int)m_swsInFormat != avfrm->format || m_swsClrspc != avfrm->colorspace)
@@ -1103,7 +1315,9 @@ bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& o
             pfrm->width = outWidth;
             pfrm->height = outHeight;
             pfrm->format = (int)m_swsOutFormat;
-            int fferr = av_frame_get_buffer(pfrm, 0);
+            int fferr = 0;
+            if (!MediaCore::FramePool::GetDefaultInstance()->AllocAVFrameBuffer(pfrm))
+                fferr = av_frame_get_buffer(pfrm, 0);
             if (fferr < 0)
             {
                 m_errMsg = string("FAILED to invoke 'av_frame_get_buffer()' for 'swsfrm'! fferr = ")+to_string(fferr)+".";
@@ -1114,7 +1328,9 @@ bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& o
             avfrm = swsfrm.get();
         }
 
-        // AVFrame -> ImMat
+        // AVFrame -> ImMat, the frame buffer is shared if its layout is the same as ImMat
+        if (m_zeroCopy && WrapAVFrameToImMat(avfrm, outMat, timestamp))
+            return true;
         if (!ConvertAVFrameToImMat(avfrm, outMat, timestamp))
         {
             m_errMsg = "Failed to invoke 'ConvertAVFrameToImMat()'!";
@@ -1475,6 +1691,15 @@ AVSampleFormat GetAVSampleFormatByDataType(ImDataType dataType, bool isPlanar)
 
 SelfFreeAVFramePtr ImMatWrapper_AVFrame::GetWrapper(int64_t pts)
 {
+    if (m_isVideo)
+    {
+        auto hWrappedFrm = GetWrappedAVFrame(m_mat);
+        if (hWrappedFrm)
+        {
+            hWrappedFrm->pts = pts;
+            return hWrappedFrm;
+        }
+    }
     SelfFreeAVFramePtr avfrm = AllocSelfFreeAVFramePtr();
     if (!avfrm)
     {
@@ -0,0 +1,554 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <list>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+#include "FramePool.h"
+#include "MemoryBudget.h"
+extern "C"
+{
+    #include "libavutil/buffer.h"
+    #include "libavutil/frame.h"
+    #include "libavutil/imgutils.h"
+    #include "libavutil/pixdesc.h"
+}
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+class FramePool_Impl : public FramePool
+{
+public:
+    FramePool_Impl(const string& name)
+    {
+        m_name = name.empty() ? "FramePool" : name;
+        m_logger = GetLogger(m_name);
+        m_hCounters = make_shared<FrameBufferCounters>();
+    }
+
+    FramePool_Impl(const FramePool_Impl&) = delete;
+    FramePool_Impl(FramePool_Impl&&) = delete;
+    FramePool_Impl& operator=(const FramePool_Impl&) = delete;
+
+    virtual ~FramePool_Impl()
+    {
+        m_hMemConsumer = nullptr;
+        // the buffers which are still in use will be freed when their last references are released
+        ReleaseBufferPools(0);
+        m_matBuckets.clear();
+    }
+
+    bool AcquireMat(ImGui::ImMat& m, int w, int h, int c, ImDataType dtype) override
+    {
+        if (w <= 0 || h <= 0 || c <= 0)
+        {
+            ostringstream oss; oss << "INVALID argument! w=" << w << ", h=" << h << ", c=" << c << ".";
+            m_errMsg = oss.str();
+            return false;
+        }
+        m.release();
+        lock_guard<mutex> lk(m_matLock);
+        m_matRequests++;
+        auto& bucket = m_matBuckets[MatShape(w, h, c, (int)dtype)];
+        for (auto iter = bucket.begin(); iter != bucket.end(); iter++)
+        {
+            if (IsMatIdle(*iter))
+            {
+                m = *iter;
+                // move the recently used one to the front, so the idle ones at the back get evicted first
+                bucket.splice(bucket.begin(), bucket, iter);
+                m_matHits++;
+                return true;
+            }
+        }
+
+        ImGui::ImMat newMat;
+        newMat.create_type(w, h, c, dtype);
+        if (newMat.empty())
+        {
+            m_errMsg = "FAILED to allocate ImMat buffer!";
+            return false;
+        }
+        // a new buffer exceeding the capacity is not held by the pool, it's freed as usual when released
+        const uint64_t matBytes = GetMatBytes(newMat);
+        const uint64_t limit = GetLimit();
+        if (limit > 0 && m_matBytesHeld+m_hCounters->bytesHeld+matBytes > limit)
+        {
+            const uint64_t frameBytesHeld = m_hCounters->bytesHeld;
+            EvictIdleMats(limit > frameBytesHeld+matBytes ? limit-frameBytesHeld-matBytes : 0);
+        }
+        if (limit == 0 || m_matBytesHeld+m_hCounters->bytesHeld+matBytes <= limit)
+        {
+            bucket.push_front(newMat);
+            m_matBytesHeld += matBytes;
+            UpdateMemoryUsage();
+        }
+        m = newMat;
+        return true;
+    }
+
+    bool AllocAVFrameBuffer(AVFrame* avfrm) override
+    {
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)avfrm->format);
+        if (!desc || (desc->flags&AV_PIX_FMT_FLAG_HWACCEL) != 0 || avfrm->width <= 0 || avfrm->height <= 0)
+        {
+            m_errMsg = "Only software video frame with valid size is supported!";
+            return false;
+        }
+        if (avfrm->buf[0] || avfrm->data[0])
+        {
+            m_errMsg = "The AVFrame already has buffer!";
+            return false;
+        }
+        int linesizes[4];
+        int fferr = av_image_fill_linesizes(linesizes, (AVPixelFormat)avfrm->format, FFALIGN(avfrm->width, BUFFER_ALIGN));
+        if (fferr < 0)
+        {
+            m_errMsg = string("FAILED to invoke 'av_image_fill_linesizes()'! fferr = ")+to_string(fferr)+".";
+            return false;
+        }
+        for (int i = 0; i < 4; i++)
+            linesizes[i] = FFALIGN(linesizes[i], BUFFER_ALIGN);
+        uint8_t* dataPtrs[4] = {0};
+        const int alignedHeight = FFALIGN(avfrm->height, 32);
+        fferr = av_image_fill_pointers(dataPtrs, (AVPixelFormat)avfrm->format, alignedHeight, nullptr, linesizes);
+        if (fferr < 0)
+        {
+            m_errMsg = string("FAILED to invoke 'av_image_fill_pointers()'! fferr = ")+to_string(fferr)+".";
+            return false;
+        }
+        const size_t bufSize = GetSizeClass((size_t)fferr+BUFFER_ALIGN);
+
+        AVBufferRef* poolBuf = nullptr;
+        BufferSizeClass* pClass = nullptr;
+        {
+            lock_guard<mutex> lk(m_bufPoolLock);
+            m_frameRequests++;
+            auto iter = m_bufPools.find(bufSize);
+            // an idle buffer of the same size class is reused, no matter the limit
+            const bool hasIdle = iter != m_bufPools.end() && iter->second.pClass->bytesHeld > iter->second.pClass->bytesInUse;
+            const uint64_t limit = GetLimit();
+            if (!hasIdle && limit > 0 && m_matBytesHeld+m_hCounters->bytesHeld+bufSize > limit)
+            {
+                // make room by the idle buffers of the other size classes first, the request is served
+                // without pooling if the limit is still exceeded
+                {
+                    lock_guard<mutex> lk2(m_matLock);
+                    const uint64_t frameBytesHeld = m_hCounters->bytesHeld;
+                    EvictIdleMats(limit > frameBytesHeld+bufSize ? limit-frameBytesHeld-bufSize : 0);
+                }
+                if (m_matBytesHeld+m_hCounters->bytesHeld+bufSize > limit)
+                    ReleaseBufferPools(bufSize);
+                UpdateMemoryUsage();
+                if (m_matBytesHeld+m_hCounters->bytesHeld+bufSize > limit)
+                    iter = m_bufPools.end();
+                else if (iter == m_bufPools.end())
+                    iter = CreateBufferPool(bufSize);
+            }
+            else if (iter == m_bufPools.end())
+            {
+                iter = CreateBufferPool(bufSize);
+                if (iter == m_bufPools.end())
+                    return false;
+            }
+            if (iter != m_bufPools.end())
+            {
+                pClass = iter->second.pClass;
+                const uint64_t missCnt = m_hCounters->allocCount;
+                poolBuf = av_buffer_pool_get(iter->second.pool);
+                if (poolBuf && m_hCounters->allocCount == missCnt)
+                    m_frameHits++;
+                else if (poolBuf)
+                    UpdateMemoryUsage();
+            }
+        }
+        if (!pClass)
+        {
+            // over the limit, the buffer is freed as usual when released
+            AVBufferRef* frmBuf = av_buffer_alloc(bufSize);
+            if (!frmBuf)
+            {
+                m_errMsg = "FAILED to invoke 'av_buffer_alloc()'!";
+                return false;
+            }
+            SetFrameBuffer(avfrm, frmBuf, linesizes, alignedHeight);
+            return true;
+        }
+        if (!poolBuf)
+        {
+            m_errMsg = "FAILED to invoke 'av_buffer_pool_get()'!";
+            return false;
+        }
+
+        // wrap the pooled buffer to track the bytes in use
+        auto pRef = new PooledBufferRef({poolBuf, pClass});
+        AVBufferRef* frmBuf = av_buffer_create(poolBuf->data, poolBuf->size, ReleasePooledBuffer, pRef, 0);
+        if (!frmBuf)
+        {
+            av_buffer_unref(&poolBuf);
+            delete pRef;
+            m_errMsg = "FAILED to invoke 'av_buffer_create()'!";
+            return false;
+        }
+        m_hCounters->bytesInUse += poolBuf->size;
+        pClass->bytesInUse += poolBuf->size;
+
+        SetFrameBuffer(avfrm, frmBuf, linesizes, alignedHeight);
+        return true;
+    }
+
+    void SetCapacity(uint64_t maxBytes) override
+    {
+        lock_guard<mutex> lk(m_bufPoolLock);
+        m_capacity = maxBytes;
+        {
+            // 'm_hMemConsumer' is changed with both of the locks held, so it can be used with either of them
+            lock_guard<mutex> lk2(m_matLock);
+            if (maxBytes > 0)
+            {
+                if (!m_hMemConsumer)
+                {
+                    m_hMemConsumer = MemoryBudget::GetDefaultInstance()->Register(m_name, [this] (uint64_t quota) {
+                        m_quota = quota;
+                    });
+                    m_quota = m_hMemConsumer->GetQuota();
+                }
+                m_hMemConsumer->SetDemand(maxBytes);
+            }
+            else
+            {
+                m_hMemConsumer = nullptr;
+                m_quota = UINT64_MAX;
+            }
+        }
+        ShrinkToLimit();
+    }
+
+    uint64_t GetCapacity() const override
+    {
+        return m_capacity;
+    }
+
+    void Trim() override
+    {
+        lock_guard<mutex> lk(m_bufPoolLock);
+        {
+            lock_guard<mutex> lk2(m_matLock);
+            EvictIdleMats(0);
+        }
+        ReleaseBufferPools(0);
+        UpdateMemoryUsage();
+    }
+
+    Stats GetStats() const override
+    {
+        Stats stats;
+        {
+            lock_guard<mutex> lk(m_matLock);
+            stats.matRequests = m_matRequests;
+            stats.matHits = m_matHits;
+            stats.bytesHeld = m_matBytesHeld;
+            stats.bytesInUse = GetMatBytesInUse();
+        }
+        {
+            lock_guard<mutex> lk(m_bufPoolLock);
+            stats.frameRequests = m_frameRequests;
+            stats.frameHits = m_frameHits;
+        }
+        stats.bytesHeld += m_hCounters->bytesHeld;
+        stats.bytesInUse += m_hCounters->bytesInUse;
+        return stats;
+    }
+
+    void ResetStats() override
+    {
+        {
+            lock_guard<mutex> lk(m_matLock);
+            m_matRequests = m_matHits = 0;
+        }
+        lock_guard<mutex> lk(m_bufPoolLock);
+        m_frameRequests = m_frameHits = 0;
+    }
+
+    void SetLogLevel(Logger::Level l) override
+    {
+        m_logger->SetShowLevels(l);
+    }
+
+    string GetError() const override
+    {
+        return m_errMsg;
+    }
+
+private:
+    static const int BUFFER_ALIGN = 64;
+
+    // the capacity limited by the quota from the memory budget, 0 means no limit
+    uint64_t GetLimit() const
+    {
+        const uint64_t capacity = m_capacity;
+        return capacity > 0 ? min(capacity, (uint64_t)m_quota) : 0;
+    }
+
+    // must be invoked with 'm_bufPoolLock' locked
+    void ShrinkToLimit()
+    {
+        const uint64_t limit = GetLimit();
+        if (limit == 0)
+            return;
+        {
+            lock_guard<mutex> lk(m_matLock);
+            const uint64_t frameBytesHeld = m_hCounters->bytesHeld;
+            EvictIdleMats(limit > frameBytesHeld ? limit-frameBytesHeld : 0);
+        }
+        if (m_matBytesHeld+m_hCounters->bytesHeld > limit)
+            ReleaseBufferPools(0);
+        UpdateMemoryUsage();
+    }
+
+    void UpdateMemoryUsage()
+    {
+        if (m_hMemConsumer)
+            m_hMemConsumer->UpdateUsage(m_matBytesHeld+m_hCounters->bytesHeld);
+    }
+
+    static void SetFrameBuffer(AVFrame* avfrm, AVBufferRef* frmBuf, const int* linesizes, int alignedHeight)
+    {
+        avfrm->buf[0] = frmBuf;
+        for (int i = 0; i < 4; i++)
+            avfrm->linesize[i] = linesizes[i];
+        av_image_fill_pointers(avfrm->data, (AVPixelFormat)avfrm->format, alignedHeight, frmBuf->data, avfrm->linesize);
+        avfrm->extended_data = avfrm->data;
+    }
+
+    using MatShape = tuple<int, int, int, int>;
+
+    static bool IsMatIdle(const ImGui::ImMat& m)
+    {
+        // the pool itself holds one reference
+        return m.refcount && *m.refcount == 1;
+    }
+
+    static uint64_t GetMatBytes(const ImGui::ImMat& m)
+    {
+        return (uint64_t)m.total()*m.elemsize;
+    }
+
+    uint64_t GetMatBytesInUse() const
+    {
+        uint64_t bytesInUse = 0;
+        for (auto& elem : m_matBuckets)
+            for (auto& m : elem.second)
+                if (!IsMatIdle(m))
+                    bytesInUse += GetMatBytes(m);
+        return bytesInUse;
+    }
+
+    void EvictIdleMats(uint64_t targetBytes)
+    {
+        auto bucketIter = m_matBuckets.begin();
+        while (bucketIter != m_matBuckets.end() && m_matBytesHeld > targetBytes)
+        {
+            auto& bucket = bucketIter->second;
+            auto iter = bucket.end();
+            while (iter != bucket.begin() && m_matBytesHeld > targetBytes)
+            {
+                iter--;
+                if (IsMatIdle(*iter))
+                {
+                    m_matBytesHeld -= GetMatBytes(*iter);
+                    iter = bucket.erase(iter);
+                }
+            }
+            if (bucket.empty())
+                bucketIter = m_matBuckets.erase(bucketIter);
+            else
+                bucketIter++;
+        }
+    }
+
+    // round up the size to the next size class, the gap between two classes is 1/8 of the power of 2 below the size
+    static size_t GetSizeClass(size_t size)
+    {
+        const size_t pageSize = 4096;
+        size = (size+pageSize-1)&~(pageSize-1);
+        size_t pow2 = pageSize;
+        while (pow2*2 <= size)
+            pow2 *= 2;
+        const size_t step = pow2 >= pageSize*8 ? pow2/8 : pageSize;
+        return (size+step-1)/step*step;
+    }
+
+    struct FrameBufferCounters
+    {
+        atomic<uint64_t> bytesHeld{0};
+        atomic<uint64_t> bytesInUse{0};
+        atomic<uint64_t> allocCount{0};
+    };
+    using FrameBufferCountersHolder = shared_ptr<FrameBufferCounters>;
+
+    // freed with its AVBufferPool, after the pool is uninitialized and all of its buffers are released
+    struct BufferSizeClass
+    {
+        FrameBufferCountersHolder hCounters;
+        size_t size;
+        atomic<uint64_t> bytesHeld{0};
+        atomic<uint64_t> bytesInUse{0};
+    };
+
+    struct BufferPoolEntry
+    {
+        AVBufferPool* pool;
+        BufferSizeClass* pClass;
+    };
+
+    struct PooledBufferRef
+    {
+        AVBufferRef* poolBuf;
+        BufferSizeClass* pClass;
+    };
+
+    static void FreePoolBuffer(void* opaque, uint8_t* data)
+    {
+        auto pClass = reinterpret_cast<BufferSizeClass*>(opaque);
+        pClass->hCounters->bytesHeld -= pClass->size;
+        pClass->bytesHeld -= pClass->size;
+        av_free(data);
+    }
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+    static AVBufferRef* AllocPoolBuffer(void* opaque, size_t size)
+#else
+    static AVBufferRef* AllocPoolBuffer(void* opaque, int size)
+#endif
+    {
+        auto pClass = reinterpret_cast<BufferSizeClass*>(opaque);
+        uint8_t* data = (uint8_t*)av_malloc(size);
+        if (!data)
+            return nullptr;
+        AVBufferRef* buf = av_buffer_create(data, size, FreePoolBuffer, pClass, 0);
+        if (!buf)
+        {
+            av_free(data);
+            return nullptr;
+        }
+        pClass->hCounters->bytesHeld += size;
+        pClass->hCounters->allocCount++;
+        pClass->bytesHeld += size;
+        return buf;
+    }
+
+    static void FreeBufferPool(void* opaque)
+    {
+        delete reinterpret_cast<BufferSizeClass*>(opaque);
+    }
+
+    static void ReleasePooledBuffer(void* opaque, uint8_t* data)
+    {
+        auto pRef = reinterpret_cast<PooledBufferRef*>(opaque);
+        pRef->pClass->hCounters->bytesInUse -= pRef->poolBuf->size;
+        pRef->pClass->bytesInUse -= pRef->poolBuf->size;
+        // the size class may be freed along with the last pooled buffer
+        av_buffer_unref(&pRef->poolBuf);
+        delete pRef;
+    }
+
+    // must be invoked with 'm_bufPoolLock' locked
+    map<size_t, BufferPoolEntry>::iterator CreateBufferPool(size_t bufSize)
+    {
+        auto pClass = new BufferSizeClass{m_hCounters, bufSize};
+        AVBufferPool* pool = av_buffer_pool_init2(bufSize, pClass, AllocPoolBuffer, FreeBufferPool);
+        if (!pool)
+        {
+            delete pClass;
+            m_errMsg = "FAILED to invoke 'av_buffer_pool_init2()'!";
+            return m_bufPools.end();
+        }
+        return m_bufPools.insert({bufSize, {pool, pClass}}).first;
+    }
+
+    // Release the pools holding idle buffers except the one of 'keepSize'. The idle buffers are freed after the pools
+    // are uninitialized, the ones in use are freed when they are released. 'keepSize' = 0 releases all the pools.
+    void ReleaseBufferPools(size_t keepSize)
+    {
+        auto iter = m_bufPools.begin();
+        while (iter != m_bufPools.end())
+        {
+            auto pClass = iter->second.pClass;
+            if (keepSize == 0 || (iter->first != keepSize && pClass->bytesHeld > pClass->bytesInUse))
+            {
+                av_buffer_pool_uninit(&iter->second.pool);
+                iter = m_bufPools.erase(iter);
+            }
+            else
+                iter++;
+        }
+    }
+
+private:
+    ALogger* m_logger;
+    string m_name;
+    string m_errMsg;
+    atomic<uint64_t> m_capacity{0};
+    atomic<uint64_t> m_quota{UINT64_MAX};
+    MemoryBudget::Consumer::Holder m_hMemConsumer;
+
+    map<MatShape, list<ImGui::ImMat>> m_matBuckets;
+    atomic<uint64_t> m_matBytesHeld{0};
+    uint64_t m_matRequests{0};
+    uint64_t m_matHits{0};
+    mutable mutex m_matLock;
+
+    map<size_t, BufferPoolEntry> m_bufPools;
+    FrameBufferCountersHolder m_hCounters;
+    uint64_t m_frameRequests{0};
+    uint64_t m_frameHits{0};
+    mutable mutex m_bufPoolLock;
+};
+
+static const auto FRAME_POOL_DELETER = [] (FramePool* p) {
+    FramePool_Impl* ptr = dynamic_cast<FramePool_Impl*>(p);
+    delete ptr;
+};
+
+FramePool::Holder FramePool::CreateInstance(const string& name)
+{
+    return FramePool::Holder(new FramePool_Impl(name), FRAME_POOL_DELETER);
+}
+
+static FramePool::Holder _DEFAULT_FRAME_POOL;
+static const uint64_t DEFAULT_FRAME_POOL_CAPACITY = 1024ULL*1024*1024;
+static mutex _DEFAULT_FRAME_POOL_ACCESS_LOCK;
+
+FramePool::Holder FramePool::GetDefaultInstance()
+{
+    lock_guard<mutex> lk(_DEFAULT_FRAME_POOL_ACCESS_LOCK);
+    if (!_DEFAULT_FRAME_POOL)
+    {
+        _DEFAULT_FRAME_POOL = FramePool::CreateInstance();
+        _DEFAULT_FRAME_POOL->SetCapacity(DEFAULT_FRAME_POOL_CAPACITY);
+    }
+    return _DEFAULT_FRAME_POOL;
+}
+}
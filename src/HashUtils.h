@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace MediaCore
+{
+// Mix 'value' into 'seed', it's the 64-bit variant of boost::hash_combine(). Used to build the content keys of the frame caches.
+inline uint64_t HashCombine(uint64_t seed, uint64_t value)
+{
+    seed ^= value+0x9e3779b97f4a7c15ULL+(seed<<12)+(seed>>4);
+    return seed;
+}
+
+inline uint64_t HashCombineFloat(uint64_t seed, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return HashCombine(seed, (uint64_t)bits);
+}
+}
@@ -22,9 +22,20 @@
 #include <functional>
 #include <list>
 #include <algorithm>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 #include "MediaReader.h"
 #include "FFUtils.h"
 #include "ThreadUtils.h"
+#include "ThreadSignal.h"
+#include "TaskExecutor.h"
+#include "MemoryBudget.h"
 #include "DebugHelper.h"
 extern "C"
 {
@@ -37,6 +48,96 @@ using namespace Logger;
 
 namespace MediaCore
 {
+// The demuxers which output a whole image file as one packet
+static bool IsSingleImageDemuxer(const AVInputFormat* iformat)
+{
+    if (!iformat || !iformat->name)
+        return false;
+    const string name(iformat->name);
+    const string pipeSuffix("_pipe");
+    return name == "image2" || (name.size() > pipeSuffix.size() && name.compare(name.size()-pipeSuffix.size(), pipeSuffix.size(), pipeSuffix) == 0);
+}
+
+#if !defined(_WIN32)
+static void UnmapImageFileBuffer(void* opaque, uint8_t* data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+#endif
+
+// Read a whole image file as one packet, which is what the image demuxers produce for a single image file.
+// The file is memory-mapped if the padding required by the decoders fits in the zero-filled tail of its last
+// page, otherwise it's read with one sequential read.
+static bool ReadImageFileToPacket(const string& filePath, AVPacket* avpkt)
+{
+    av_packet_unref(avpkt);
+#if defined(_WIN32)
+    FILE* fp = fopen(filePath.c_str(), "rb");
+    if (!fp)
+        return false;
+    _fseeki64(fp, 0, SEEK_END);
+    const int64_t fileSize = _ftelli64(fp);
+    _fseeki64(fp, 0, SEEK_SET);
+    bool success = false;
+    if (fileSize > 0 && fileSize < INT32_MAX-AV_INPUT_BUFFER_PADDING_SIZE && av_new_packet(avpkt, (int)fileSize) == 0)
+    {
+        success = fread(avpkt->data, 1, (size_t)fileSize, fp) == (size_t)fileSize;
+        if (!success)
+            av_packet_unref(avpkt);
+    }
+    fclose(fp);
+    return success;
+#else
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size >= INT32_MAX-AV_INPUT_BUFFER_PADDING_SIZE)
+    {
+        close(fd);
+        return false;
+    }
+    const size_t fileSize = (size_t)st.st_size;
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t tailSize = fileSize%pageSize;
+    if (tailSize > 0 && pageSize-tailSize >= AV_INPUT_BUFFER_PADDING_SIZE)
+    {
+        void* addr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            madvise(addr, fileSize, MADV_WILLNEED);
+            AVBufferRef* buf = av_buffer_create((uint8_t*)addr, fileSize, UnmapImageFileBuffer, (void*)(uintptr_t)fileSize, AV_BUFFER_FLAG_READONLY);
+            if (buf)
+            {
+                close(fd);
+                avpkt->buf = buf;
+                avpkt->data = buf->data;
+                avpkt->size = (int)fileSize;
+                return true;
+            }
+            munmap(addr, fileSize);
+        }
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    bool success = av_new_packet(avpkt, (int)fileSize) == 0;
+    size_t readSize = 0;
+    while (success && readSize < fileSize)
+    {
+        const ssize_t n = read(fd, avpkt->data+readSize, fileSize-readSize);
+        if (n <= 0)
+            success = false;
+        else
+            readSize += n;
+    }
+    if (!success)
+        av_packet_unref(avpkt);
+    close(fd);
+    return success;
+#endif
+}
+
 class ImageSequenceReader_Impl : public MediaReader
 {
 public:
@@ -49,6 +150,10 @@ public:
         int n;
         Level l = GetVideoLogger()->GetShowLevels(n);
         m_logger->SetShowLevels(l, n);
+
+        // each decoding context works on one prefetched image, bounded by the size of the shared executor
+        const uint32_t threadCount = TaskExecutor::GetDefaultInstance()->GetThreadCount();
+        m_decWorkerCount = (uint8_t)min<uint32_t>(max<uint32_t>(threadCount/2, 2), 6);
     }
 
     virtual ~ImageSequenceReader_Impl()
@@ -181,6 +286,7 @@ public:
 
         WaitAllThreadsQuit();
         FlushAllQueues();
+        m_hMemConsumer = nullptr;
 
         m_readPts = 0;
         m_prevReadResult = {0., nullptr};
@@ -201,6 +307,7 @@ public:
         WaitAllThreadsQuit();
         m_decCtxs.clear();
         FlushAllQueues();
+        m_hMemConsumer = nullptr;
 
         m_hParser = nullptr;
         m_hMediaInfo = nullptr;
@@ -256,6 +363,7 @@ public:
             return;
         }
         m_readForward = forward;
+        m_readImageSignal.Notify();
     }
 
     void Suspend() override {}
@@ -308,6 +416,8 @@ public:
             return nullptr;
         }
         UpdateReadPts(pts);
+        if (m_hMemConsumer)
+            m_hMemConsumer->Touch();
         m_logger->Log(VERBOSE) << ">> TO READ frame: pts=" << pts << ", ts=" << pos << "." << endl;
 
         auto wait1 = GetTimePoint();
@@ -317,6 +427,7 @@ public:
         VideoFrame::Holder hVfrm;
         while (!m_quitThread)
         {
+            const auto readySeq = m_vfrmReadySignal.Sequence();
             if (!zeroCache)
             {
                 lock_guard<mutex> _lk(m_vfrmQLock);
@@ -360,7 +471,7 @@ public:
             if (hVfrm || !wait)
                 break;
 
-            this_thread::sleep_for(chrono::milliseconds(2));
+            m_vfrmReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
             auto wait2 = GetTimePoint();
             if (CountElapsedMillisec(wait1, wait2) > 3000)
             {
@@ -522,9 +633,19 @@ public:
     {
         m_cacheFrameCount.first = backwardFrames;
         m_cacheFrameCount.second = forwardFrames;
+        UpdateMemoryDemand();
         return true;
     }
 
+    bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) override
+    {
+        // each image is decoded independently, there is no reverse decoder to limit
+        if (maxBytes == 0)
+            return true;
+        m_errMsg = "Reverse decoding is NOT SUPPORTED by ImageSequenceReader!";
+        return false;
+    }
+
     pair<double, double> GetCacheDuration() const override
     {
         throw runtime_error("This interface is NOT SUPPORTED by ImageSequenceReader!");
@@ -668,23 +789,30 @@ private:
 
         DecodeImageContext(ImageSequenceReader_Impl* _owner) : owner(_owner)
         {
-            m_decThread = thread(&DecodeImageContext::DecodeImageProc, this);
+            m_hExecutor = TaskExecutor::GetDefaultInstance();
         }
 
         ~DecodeImageContext()
         {
             quit = true;
-            if (m_decThread.joinable())
-                m_decThread.join();
+            TaskExecutor::Task::Holder hDecTask;
+            {
+                lock_guard<mutex> lk(m_vfLock);
+                hDecTask = m_hDecTask;
+            }
+            if (hDecTask && !hDecTask->Cancel())
+                hDecTask->Wait();
             ReleaseDecoderContext();
             ReleaseFormatContext();
         }
 
         ImageSequenceReader_Impl* owner;
-        thread m_decThread;
+        TaskExecutor::Holder m_hExecutor;
+        TaskExecutor::Task::Holder m_hDecTask;
         string m_imagePath;
         AVFormatContext* m_avfmtCtx{nullptr};
         AVCodecContext* m_viddecCtx{nullptr};
+        bool m_readFileAsPacket{false};
         atomic_bool isBusy{false};
         VideoFrame_Impl* m_pVfrm{nullptr};
         mutex m_vfLock;
@@ -705,6 +833,7 @@ private:
                 lock_guard<mutex> lk(m_vfLock);
                 m_pVfrm = pVfrm;
                 m_hVfrm = hVfrm;
+                m_hDecTask = m_hExecutor->Submit([this] { DecodeImageProc(); }, TaskExecutor::PRIORITY_PLAYBACK);
             }
             return true;
         }
@@ -727,7 +856,7 @@ private:
             }
         }
 
-        bool DecodeImageFile(const string& filePath)
+        bool OpenImageFile(const string& filePath, int& vidstmIdx)
         {
             int fferr = avformat_open_input(&m_avfmtCtx, filePath.c_str(), nullptr, nullptr);
             if (fferr < 0 || !m_avfmtCtx)
@@ -742,7 +871,7 @@ private:
                 owner->m_logger->Log(Error) << "FAILED to invoke 'avformat_find_stream_info' on file '" << filePath << "'! fferr=" << fferr << "." << endl;
                 return false;
             }
-            auto vidstmIdx = av_find_best_stream(m_avfmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+            vidstmIdx = av_find_best_stream(m_avfmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
             if (vidstmIdx < 0)
             {
                 owner->m_logger->Log(Error) << "Can not find any video stream in file '" << filePath << "'!";
@@ -791,7 +920,29 @@ private:
             {
                 avcodec_flush_buffers(m_viddecCtx);
             }
+            m_readFileAsPacket = IsSingleImageDemuxer(m_avfmtCtx->iformat);
+            return true;
+        }
+
+        bool DecodeImageFile(const string& filePath)
+        {
+            // once the decoder is opened on an image of the sequence, the following images are read as single packets
+            // and sent to the same decoder, instead of opening a demuxer for each of them
+            SelfFreeAVPacketPtr ptrFilePkt;
+            int vidstmIdx = -1;
+            if (m_readFileAsPacket && m_viddecCtx)
+            {
+                ptrFilePkt = AllocSelfFreeAVPacketPtr();
+                if (ReadImageFileToPacket(filePath, ptrFilePkt.get()))
+                    avcodec_flush_buffers(m_viddecCtx);
+                else
+                    ptrFilePkt = nullptr;
+            }
+            if (!ptrFilePkt && !OpenImageFile(filePath, vidstmIdx))
+                return false;
+            const bool readAsPacket = (bool)ptrFilePkt;
 
+            int fferr;
             SelfFreeAVPacketPtr ptrPkt = AllocSelfFreeAVPacketPtr();
             bool requireAvpkt = true;
             bool avpktReady = false;
@@ -801,7 +952,21 @@ private:
             bool vidfrmReady = false;
             while (!quit)
             {
-                if (requireAvpkt && !demuxEof)
+                if (requireAvpkt && !demuxEof && readAsPacket)
+                {
+                    av_packet_unref(ptrPkt.get());
+                    if (ptrFilePkt->data)
+                    {
+                        av_packet_move_ref(ptrPkt.get(), ptrFilePkt.get());
+                        requireAvpkt = false;
+                        avpktReady = true;
+                    }
+                    else
+                    {
+                        demuxEof = true;
+                    }
+                }
+                else if (requireAvpkt && !demuxEof)
                 {
                     av_packet_unref(ptrPkt.get());
                     fferr = av_read_frame(m_avfmtCtx, ptrPkt.get());
@@ -850,11 +1015,21 @@ private:
                     vidfrmReady = true;
                     break;
                 }
+                else if (fferr == AVERROR_EOF)
+                {
+                    break;
+                }
                 else if (fferr != AVERROR(EAGAIN))
                 {
                     owner->m_logger->Log(WARN) << "FAILED to invoke 'avcodec_receive_frame' on file '" << filePath << "'! fferr=" << fferr << "." << endl;
                 }
             }
+            if (!vidfrmReady && !quit && readAsPacket)
+            {
+                owner->m_logger->Log(DEBUG) << "FAILED to decode img-sq file '" << filePath << "' as a single packet, retry with the demuxer." << endl;
+                m_readFileAsPacket = false;
+                return DecodeImageFile(filePath);
+            }
             if (!vidfrmReady && !quit)
             {
                 owner->m_logger->Log(Error) << "FAILED to decode picture out of img-sq file '" << filePath << "'!" << endl;
@@ -885,33 +1060,27 @@ private:
             }
         }
 
+        // executed on the shared task executor, one image per submission
         void DecodeImageProc()
         {
-            while (!quit)
+            if (quit || m_imagePath.empty())
+                return;
+            if (DecodeImageFile(m_imagePath))
             {
-                bool idleLoop = true;
-
-                if (!m_imagePath.empty())
-                {
-                    if (DecodeImageFile(m_imagePath))
-                    {
-                        owner->m_logger->Log(VERBOSE) << "--> Imgsq decode done. '" << m_imagePath << "'" << endl;
-                        idleLoop = false;
-                    }
-                    else
-                    {
-                        lock_guard<mutex> lk(m_vfLock);
-                        if (m_pVfrm)
-                            m_pVfrm->decodeFailed = true;
-                    }
-                    ReleaseFormatContext();
-                    m_imagePath.clear();
-                    isBusy = false;
-                }
-
-                if (idleLoop)
-                    this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                owner->m_logger->Log(VERBOSE) << "--> Imgsq decode done. '" << m_imagePath << "'" << endl;
             }
+            else
+            {
+                lock_guard<mutex> lk(m_vfLock);
+                if (m_pVfrm)
+                    m_pVfrm->decodeFailed = true;
+            }
+            ReleaseFormatContext();
+            m_imagePath.clear();
+            isBusy = false;
+            // this context is free now, and the decoded frame is ready for conversion
+            owner->m_readImageSignal.Notify();
+            owner->m_cnvMatSignal.Notify();
         }
     };
 
@@ -1027,7 +1196,18 @@ private:
     {
         lock_guard<mutex> _lk(m_cacheRangeLock);
         m_readPts = readPts;
-        const auto cacheFrameCount = m_bInSeekingMode ? pair<int32_t, int32_t>(0, 0) : m_cacheFrameCount;
+        auto cacheFrameCount = m_bInSeekingMode ? pair<int32_t, int32_t>(0, 0) : m_cacheFrameCount;
+        // prefetch the next frames in the playback direction, as many as the decoding contexts can work on in parallel
+        if (cacheFrameCount.second > 0)
+            cacheFrameCount.second = max<int32_t>(cacheFrameCount.second, m_decWorkerCount);
+        // shrink the window to fit the memory quota, drop the frames behind the reading position first
+        const uint64_t quota = m_memQuota;
+        if (m_frameBytes > 0 && quota != UINT64_MAX)
+        {
+            const int32_t maxFrames = max<int32_t>((int32_t)min<uint64_t>(quota/m_frameBytes, INT32_MAX), 2);
+            cacheFrameCount.first = max(min(cacheFrameCount.first, maxFrames-1-cacheFrameCount.second), 0);
+            cacheFrameCount.second = max(min(cacheFrameCount.second, maxFrames-1-cacheFrameCount.first), 1);
+        }
         if (m_readForward)
         {
             m_cacheRange.first = readPts-cacheFrameCount.first*m_vidfrmIntvPts;
@@ -1043,6 +1223,36 @@ private:
             m_cacheRange.first--;
             m_cacheRange.second++;
         }
+        m_readImageSignal.Notify();
+        m_cnvMatSignal.Notify();
+    }
+
+    // Register the frame cache to the default 'MemoryBudget', the demand is the bytes of the whole prefetch window.
+    void RegisterMemoryConsumer()
+    {
+        const uint32_t w = m_outWidth > 0 ? m_outWidth : m_pVidstm->width;
+        const uint32_t h = m_outHeight > 0 ? m_outHeight : m_pVidstm->height;
+        const uint64_t elemSize = m_outDtype == IM_DT_INT8 ? 1 : (m_outDtype == IM_DT_FLOAT32 ? 4 : 2);
+        m_frameBytes = (uint64_t)w*h*4*elemSize;
+        if (!m_hMemConsumer)
+        {
+            string consumerName = "ImageSequenceReader-"+SysUtils::ExtractFileName(m_hParser->GetUrl());
+            m_hMemConsumer = MemoryBudget::GetDefaultInstance()->Register(consumerName, [this] (uint64_t quota) {
+                m_memQuota = quota;
+                m_memQuotaChanged = true;
+                m_readImageSignal.Notify();
+            });
+        }
+        m_memQuota = m_hMemConsumer->GetQuota();
+        UpdateMemoryDemand();
+    }
+
+    void UpdateMemoryDemand()
+    {
+        if (!m_hMemConsumer)
+            return;
+        const int32_t forwardCount = m_cacheFrameCount.second > 0 ? max<int32_t>(m_cacheFrameCount.second, m_decWorkerCount) : 0;
+        m_hMemConsumer->SetDemand((uint64_t)(m_cacheFrameCount.first+forwardCount+1)*m_frameBytes);
     }
 
     int64_t CvtMtsToPts(int64_t mts)
@@ -1073,6 +1283,9 @@ private:
     void WaitAllThreadsQuit(bool callFromReleaseProc = false)
     {
         m_quitThread = true;
+        m_readImageSignal.Notify();
+        m_cnvMatSignal.Notify();
+        m_vfrmReadySignal.Notify();
         if (m_readImageThread.joinable())
         {
             m_readImageThread.join();
@@ -1144,6 +1357,7 @@ private:
             }
         }
 
+        RegisterMemoryConsumer();
         m_prepared = true;
         return true;
     }
@@ -1163,6 +1377,10 @@ private:
         {
             bool idleLoop = true;
 
+            bool testVal = true;
+            if (m_memQuotaChanged.compare_exchange_strong(testVal, false))
+                UpdateReadPts(m_readPts);
+
             pair<int64_t, int64_t> cacheRange;
             {
                 lock_guard<mutex> lk(m_cacheRangeLock);
@@ -1250,7 +1468,8 @@ private:
                         }
                         pVfrm->hDecCtx = hDecCtx;
                         m_logger->Log(DEBUG) << "-> StartDecode[idx=" << fileIndex << ", pos=" << pVfrm->pos << "]: '" << pVfrm->imageFilePath << "'" << endl;
-                        hDecCtx->StartDecode(hVfrm);
+                        if (hDecCtx->StartDecode(hVfrm))
+                            m_vfrmReadySignal.Notify();
                         idleLoop = false;
                         break;
                     }
@@ -1258,7 +1477,7 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_readImageSignal.WaitFor(THREAD_IDLE_TIME);
         }
         m_rdimgThdRunning = false;
         m_logger->Log(DEBUG) << "Leave ReadImageThreadProc()." << endl;
@@ -1308,6 +1527,8 @@ private:
                         hVfrm = *iter;
                     iter++;
                 }
+                if (m_hMemConsumer)
+                    m_hMemConsumer->UpdateUsage(m_vfrmQ.size()*m_frameBytes);
             }
 
             // transfer hardware frame to software frame, to reduce the count of frames referenced from decoder
@@ -1369,7 +1590,7 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_cnvMatSignal.WaitFor(THREAD_IDLE_TIME);
         }
         m_cnvThdRunning = false;
         m_logger->Log(DEBUG) << "Leave ConvertMatThreadProc()." << endl;
@@ -1392,6 +1613,9 @@ private:
     bool m_rdimgThdRunning{false};
     thread m_cnvMatThread;
     bool m_cnvThdRunning{false};
+    ThreadSignal m_readImageSignal;
+    ThreadSignal m_cnvMatSignal;
+    BroadcastSignal m_vfrmReadySignal;
 
     MediaParser::Holder m_hParser;
     MediaInfo::Holder m_hMediaInfo;
@@ -1425,6 +1649,11 @@ private:
     ImDataType m_outDtype;
     ImInterpolateMode m_interpMode;
     AVFrameToImMatConverter* m_pFrmCvt{nullptr};
+
+    MemoryBudget::Consumer::Holder m_hMemConsumer;
+    uint64_t m_frameBytes{0};
+    atomic<uint64_t> m_memQuota{UINT64_MAX};
+    atomic_bool m_memQuotaChanged{false};
 };
 
 const function<void (VideoFrame*)> ImageSequenceReader_Impl::IMGSQ_READER_VIDEO_FRAME_HOLDER_DELETER = [] (VideoFrame* p) {
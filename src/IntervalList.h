@@ -0,0 +1,306 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+namespace MediaCore
+{
+// A list of the clips or the overlaps on a track ordered by the start time, with an index for finding them by position.
+// The ranges are cached in the index when the items are inserted or updated, so 'Update()' must be called after the
+// range of an item is changed. The index is a vector of the ranges ordered by the start time, augmented with a tree of
+// the max end times over it. 'FindAt()' and 'FirstEndingAfter()' take O(log n), 'FindInRange()' takes O((k+1)*log n)
+// for k found items, no matter how many earlier items are long. Inserting, removing and updating take O(n), since
+// the vector is shifted and the tree is rebuilt.
+// The list iterators stay valid when the items are reordered by 'Update()'.
+// 'Holder' is a shared pointer to a type with the 'Start()' and 'End()' methods.
+template<typename Holder>
+class IntervalList
+{
+public:
+    using Iterator = typename std::list<Holder>::iterator;
+    using ConstIterator = typename std::list<Holder>::const_iterator;
+
+    IntervalList() = default;
+
+    IntervalList(const IntervalList& other)
+    {
+        *this = other;
+    }
+
+    IntervalList& operator=(const IntervalList& other)
+    {
+        if (this == &other)
+            return *this;
+        m_items = other.m_items;
+        m_entries.clear();
+        m_entries.reserve(other.m_entries.size());
+        auto iter = m_items.begin();
+        for (const auto& entry : other.m_entries)
+            m_entries.push_back({entry.start, entry.end, iter++});
+        m_maxTree = other.m_maxTree;
+        m_leafCount = other.m_leafCount;
+        m_starts = other.m_starts;
+        return *this;
+    }
+
+    Iterator begin() { return m_items.begin(); }
+    Iterator end() { return m_items.end(); }
+    ConstIterator begin() const { return m_items.begin(); }
+    ConstIterator end() const { return m_items.end(); }
+    size_t size() const { return m_items.size(); }
+    bool empty() const { return m_items.empty(); }
+    const std::list<Holder>& List() const { return m_items; }
+
+    void clear()
+    {
+        m_items.clear();
+        m_entries.clear();
+        m_maxTree.clear();
+        m_leafCount = 0;
+        m_starts.clear();
+    }
+
+    // The item at 'index' in the order of the start time
+    const Holder& At(size_t index) const
+    {
+        return *m_entries[index].iter;
+    }
+
+    // The largest end time of the items, 0 if the list is empty
+    int64_t MaxEnd() const
+    {
+        return m_entries.empty() ? 0 : m_maxTree[1];
+    }
+
+    Iterator Insert(const Holder& hItem)
+    {
+        const int64_t start = hItem->Start();
+        const size_t index = UpperBound(start);
+        auto iter = m_items.insert(index < m_entries.size() ? m_entries[index].iter : m_items.end(), hItem);
+        m_entries.insert(m_entries.begin()+index, {start, hItem->End(), iter});
+        m_starts[hItem.get()] = start;
+        BuildMaxTree();
+        return iter;
+    }
+
+    bool Remove(const Holder& hItem)
+    {
+        const size_t index = IndexOf(hItem);
+        if (index == NPOS)
+            return false;
+        m_items.erase(m_entries[index].iter);
+        m_entries.erase(m_entries.begin()+index);
+        m_starts.erase(hItem.get());
+        BuildMaxTree();
+        return true;
+    }
+
+    // Move the item to the position of its current range
+    void Update(const Holder& hItem)
+    {
+        const size_t index = IndexOf(hItem);
+        if (index == NPOS)
+            return;
+        auto iter = m_entries[index].iter;
+        m_entries.erase(m_entries.begin()+index);
+        const int64_t start = hItem->Start();
+        const size_t newIndex = UpperBound(start);
+        m_items.splice(newIndex < m_entries.size() ? m_entries[newIndex].iter : m_items.end(), m_items, iter);
+        m_entries.insert(m_entries.begin()+newIndex, {start, hItem->End(), iter});
+        m_starts[hItem.get()] = start;
+        BuildMaxTree();
+    }
+
+    // The range of the item when it was inserted or updated last time
+    bool GetIndexedRange(const Holder& hItem, int64_t& start, int64_t& end) const
+    {
+        const size_t index = IndexOf(hItem);
+        if (index == NPOS)
+            return false;
+        start = m_entries[index].start;
+        end = m_entries[index].end;
+        return true;
+    }
+
+    Iterator Find(const Holder& hItem)
+    {
+        const size_t index = IndexOf(hItem);
+        return index == NPOS ? m_items.end() : m_entries[index].iter;
+    }
+
+    // Return the earliest started item containing 'pos', or null if there is none
+    Holder FindAt(int64_t pos) const
+    {
+        const size_t index = FirstEndingAfter(UpperBound(pos), pos);
+        return index == NPOS ? nullptr : *m_entries[index].iter;
+    }
+
+    // Return the items intersecting with [start, end) in the order of the start time
+    std::vector<Holder> FindInRange(int64_t start, int64_t end) const
+    {
+        std::vector<Holder> items;
+        const size_t limit = LowerBound(end);
+        for (size_t i = FirstEndingAfter(limit, start); i != NPOS; i = FirstEndingAfter(limit, start, i+1))
+            items.push_back(*m_entries[i].iter);
+        return items;
+    }
+
+    // Return the first item ending after 'pos', or 'end()' if there is none
+    Iterator FirstEndingAfter(int64_t pos)
+    {
+        const size_t index = FirstEndingAfter(m_entries.size(), pos);
+        return index == NPOS ? m_items.end() : m_entries[index].iter;
+    }
+
+    // Return the last item starting at or before 'pos', or 'end()' if there is none
+    Iterator LastStartingAtOrBefore(int64_t pos)
+    {
+        const size_t index = UpperBound(pos);
+        return index == 0 ? m_items.end() : m_entries[index-1].iter;
+    }
+
+private:
+    static constexpr size_t NPOS = (size_t)-1;
+
+    struct Entry
+    {
+        int64_t start;
+        int64_t end;
+        Iterator iter;
+    };
+
+    // index of the first entry starting after 'pos'
+    size_t UpperBound(int64_t pos) const
+    {
+        auto iter = std::upper_bound(m_entries.begin(), m_entries.end(), pos, [] (int64_t val, const Entry& entry) {
+            return val < entry.start;
+        });
+        return iter-m_entries.begin();
+    }
+
+    // index of the first entry starting at or after 'pos'
+    size_t LowerBound(int64_t pos) const
+    {
+        auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), pos, [] (const Entry& entry, int64_t val) {
+            return entry.start < val;
+        });
+        return iter-m_entries.begin();
+    }
+
+    size_t IndexOf(const Holder& hItem) const
+    {
+        auto iter = m_starts.find(hItem.get());
+        if (iter == m_starts.end())
+            return NPOS;
+        for (size_t i = LowerBound(iter->second); i < m_entries.size() && m_entries[i].start == iter->second; i++)
+        {
+            if (m_entries[i].iter->get() == hItem.get())
+                return i;
+        }
+        return NPOS;
+    }
+
+    void BuildMaxTree()
+    {
+        m_leafCount = 1;
+        while (m_leafCount < m_entries.size())
+            m_leafCount *= 2;
+        m_maxTree.assign(m_leafCount*2, INT64_MIN);
+        for (size_t i = 0; i < m_entries.size(); i++)
+            m_maxTree[m_leafCount+i] = m_entries[i].end;
+        for (size_t node = m_leafCount-1; node > 0; node--)
+            m_maxTree[node] = std::max(m_maxTree[node*2], m_maxTree[node*2+1]);
+    }
+
+    // index of the first entry in [from, limit) ending after 'pos', or NPOS if there is none
+    size_t FirstEndingAfter(size_t limit, int64_t pos, size_t from = 0) const
+    {
+        if (from >= limit)
+            return NPOS;
+        return FirstEndingAfter(1, 0, m_leafCount, from, limit, pos);
+    }
+
+    // the subtrees out of [from, limit) or not ending after 'pos' are skipped, so O(log n) nodes are visited
+    size_t FirstEndingAfter(size_t node, size_t nodeBegin, size_t nodeEnd, size_t from, size_t limit, int64_t pos) const
+    {
+        if (nodeBegin >= limit || nodeEnd <= from || m_maxTree[node] <= pos)
+            return NPOS;
+        if (nodeEnd-nodeBegin == 1)
+            return nodeBegin;
+        const size_t nodeMid = (nodeBegin+nodeEnd)/2;
+        const size_t index = FirstEndingAfter(node*2, nodeBegin, nodeMid, from, limit, pos);
+        return index != NPOS ? index : FirstEndingAfter(node*2+1, nodeMid, nodeEnd, from, limit, pos);
+    }
+
+private:
+    std::list<Holder> m_items;
+    // the entries are in the same order as 'm_items'
+    std::vector<Entry> m_entries;
+    // a complete binary tree in an array, the leaf 'm_leafCount+i' holds the end time of 'm_entries[i]',
+    // each node above holds the largest end time of its children
+    std::vector<int64_t> m_maxTree;
+    size_t m_leafCount{0};
+    std::unordered_map<const void*, int64_t> m_starts;
+};
+
+// Update the position of 'hClip' in the clip index of a track and the overlaps on it, or remove them if 'remove' is
+// true. The overlaps on it are found by the range when it was indexed last time, the overlaps between the other clips
+// are kept as is. An existing overlap with the same clip is updated instead of recreated, so its transition is kept.
+// 'OverlapHolder' points to a type with the static 'HasOverlap()' and 'CreateInstance()' of the overlap classes.
+template<typename ClipHolder, typename OverlapHolder>
+void UpdateTrackIndex(IntervalList<ClipHolder>& clips, IntervalList<OverlapHolder>& overlaps, const ClipHolder& hClip, bool remove)
+{
+    using Overlap = typename OverlapHolder::element_type;
+    std::vector<OverlapHolder> oldOverlaps;
+    int64_t prevStart, prevEnd;
+    if (clips.GetIndexedRange(hClip, prevStart, prevEnd))
+    {
+        for (auto& hOverlap : overlaps.FindInRange(prevStart, prevEnd))
+        {
+            if (hOverlap->FrontClip() == hClip || hOverlap->RearClip() == hClip)
+            {
+                overlaps.Remove(hOverlap);
+                oldOverlaps.push_back(hOverlap);
+            }
+        }
+        if (remove)
+        {
+            clips.Remove(hClip);
+            return;
+        }
+        clips.Update(hClip);
+    }
+    else if (!remove)
+    {
+        clips.Insert(hClip);
+    }
+    else
+    {
+        return;
+    }
+
+    for (auto& clip : clips.FindInRange(hClip->Start(), hClip->End()))
+    {
+        if (clip == hClip || !Overlap::HasOverlap(hClip, clip))
+            continue;
+        auto iter = std::find_if(oldOverlaps.begin(), oldOverlaps.end(), [&clip] (const OverlapHolder& hOverlap) {
+            return hOverlap->FrontClip() == clip || hOverlap->RearClip() == clip;
+        });
+        OverlapHolder hOverlap;
+        if (iter != oldOverlaps.end())
+        {
+            hOverlap = *iter;
+            hOverlap->Update();
+            if (hOverlap->Duration() <= 0)
+                continue;
+        }
+        else
+        {
+            hOverlap = Overlap::CreateInstance(0, hClip, clip);
+        }
+        overlaps.Insert(hOverlap);
+    }
+}
+}
@@ -25,6 +25,7 @@
 #include "FFUtils.h"
 #include "FileSystemUtils.h"
 #include "ThreadUtils.h"
+#include "ThreadSignal.h"
 extern "C"
 {
     #include "libavutil/avutil.h"
@@ -210,9 +211,15 @@ public:
         lock_guard<recursive_mutex> lk(m_apiLock);
 
         if (HasVideo())
+        {
             m_vidinpEof = true;
+            m_videncSignal.Notify();
+        }
         if (HasAudio())
+        {
             m_audinpEof = true;
+            m_audencSignal.Notify();
+        }
         while (!m_muxEof)
             this_thread::sleep_for(chrono::milliseconds(5));
 
@@ -267,11 +274,12 @@ public:
         if (!hVfrm)
         {
             m_vidinpEof = true;
+            m_videncSignal.Notify();
             return true;
         }
 
         while (wait && m_vfrmQ.size() >= m_vmatQMaxSize && !m_quit)
-            this_thread::sleep_for(chrono::milliseconds(5));
+            m_vfrmQSpaceSignal.WaitFor(THREAD_IDLE_TIME);
         if (m_quit)
             return false;
         if (m_vfrmQ.size() >= m_vmatQMaxSize)
@@ -282,6 +290,7 @@ public:
             m_vfrmQ.push_back(hVfrm);
             consumed = true;
         }
+        m_videncSignal.Notify();
         return true;
     }
 
@@ -335,6 +344,7 @@ public:
                 m_audencfrm = nullptr;
             }
             m_audinpEof = true;
+            m_audencSignal.Notify();
             return true;
         }
 
@@ -343,7 +353,7 @@ public:
             if (!wait)
                 return true;
             while (m_audfrmQ.size() >= m_audfrmQMaxSize && !m_quit)
-                this_thread::sleep_for(chrono::milliseconds(5));
+                m_afrmQSpaceSignal.WaitFor(THREAD_IDLE_TIME);
             if (m_quit)
                 return false;
         }
@@ -418,6 +428,7 @@ public:
                 m_audfrmPts += m_audencfrm->nb_samples;
                 m_audencfrm = nullptr;
                 m_audencfrmSmpOffset = 0;
+                m_audencSignal.Notify();
             }
         }
         consumed = true;
@@ -1063,6 +1074,11 @@ private:
     void TerminateAllThreads()
     {
         m_quit = true;
+        m_videncSignal.Notify();
+        m_audencSignal.Notify();
+        m_muxSignal.Notify();
+        m_vfrmQSpaceSignal.Notify();
+        m_afrmQSpaceSignal.Notify();
         if (m_videncThread.joinable())
             m_videncThread.join();
         if (m_audencThread.joinable())
@@ -1113,6 +1129,7 @@ private:
                         hVfrm = m_vfrmQ.front();
                         m_vfrmQ.pop_front();
                     }
+                    m_vfrmQSpaceSignal.Notify();
                     auto tNatvieData = hVfrm->GetNativeData();
                     if (tNatvieData.eType == VideoFrame::NativeData::AVFRAME)
                         encfrm = CloneSelfFreeAVFramePtr((const AVFrame*)tNatvieData.pData);
@@ -1202,9 +1219,12 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(2));
+                m_videncSignal.WaitFor(THREAD_IDLE_TIME);
+            else
+                m_muxSignal.Notify();
         }
 
+        m_muxSignal.Notify();
         m_logger->Log(DEBUG) << "Leave VideoEncodingThreadProc()." << endl;
     }
 
@@ -1223,9 +1243,12 @@ private:
             {
                 if (!m_audfrmQ.empty())
                 {
-                    lock_guard<mutex> lk(m_audfrmQLock);
-                    encfrm = m_audfrmQ.front();
-                    m_audfrmQ.pop_front();
+                    {
+                        lock_guard<mutex> lk(m_audfrmQLock);
+                        encfrm = m_audfrmQ.front();
+                        m_audfrmQ.pop_front();
+                    }
+                    m_afrmQSpaceSignal.Notify();
                 }
                 else if (m_audinpEof)
                 {
@@ -1278,9 +1301,12 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(2));
+                m_audencSignal.WaitFor(THREAD_IDLE_TIME);
+            else
+                m_muxSignal.Notify();
         }
 
+        m_muxSignal.Notify();
         m_logger->Log(DEBUG) << "Leave AudioEncodingThreadProc()." << endl;
     }
 
@@ -1312,6 +1338,8 @@ private:
                     avpktLoaded = true;
                     idleLoop = false;
                     vidposMts = av_rescale_q(avpkt.pts, m_vidAvStm->time_base, MILLISEC_TIMEBASE);
+                    // encoder output is drained, it may accept new input now
+                    m_videncSignal.Notify();
                     m_logger->Log(DEBUG) << "Got VIDEO packet at " << MillisecToString(vidposMts) << "(" << avpkt.pts << ")." << endl;
                 }
                 else if (fferr == AVERROR_EOF)
@@ -1348,6 +1376,7 @@ private:
                     avpktLoaded = true;
                     idleLoop = false;
                     audposMts = av_rescale_q(avpkt.pts, m_audAvStm->time_base, MILLISEC_TIMEBASE);
+                    m_audencSignal.Notify();
                     m_logger->Log(DEBUG) << "Got AUDIO packet at " << MillisecToString(audposMts) << "(" << avpkt.pts << ")." << endl;
                 }
                 else if (fferr == AVERROR_EOF)
@@ -1389,7 +1418,7 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(1));
+                m_muxSignal.WaitFor(THREAD_IDLE_TIME);
         }
 
         m_muxEof = true;
@@ -1436,6 +1465,8 @@ private:
     list<VideoFrame::Holder> m_vfrmQ;
     uint32_t m_vmatQMaxSize;
     mutex m_vmatQLock;
+    ThreadSignal m_videncSignal;
+    ThreadSignal m_vfrmQSpaceSignal;
     bool m_vidinpEof{false};
     bool m_vidNullFrameSent{false};
     bool m_videncEof{false};
@@ -1444,11 +1475,14 @@ private:
     list<SelfFreeAVFramePtr> m_audfrmQ;
     uint32_t m_audfrmQMaxSize;
     mutex m_audfrmQLock;
+    ThreadSignal m_audencSignal;
+    ThreadSignal m_afrmQSpaceSignal;
     bool m_audinpEof{false};
     bool m_audNullFrameSent{false};
     bool m_audencEof{false};
     // muxing thread
     thread m_muxThread;
+    ThreadSignal m_muxSignal;
     list<AVPacket*> m_vidpktQ;
     mutex m_vidpktQLock;
     list<AVPacket*> m_audpktQ;
@@ -0,0 +1,389 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <imgui_json.h>
+#include "MediaImporter.h"
+#include "MediaParser.h"
+#include "TaskExecutor.h"
+#include "MediaIndexCache.h"
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+static const char* PROBE_CACHE_FILE_SUFFIX = ".mcinfo";
+static const int PROBE_CACHE_VERSION = 1;
+
+static imgui_json::value RatioToJson(const Ratio& r)
+{
+    imgui_json::value j;
+    j["num"] = imgui_json::number(r.num);
+    j["den"] = imgui_json::number(r.den);
+    return j;
+}
+
+static Ratio RatioFromJson(const imgui_json::value& j)
+{
+    if (!j.is_object() || !j.contains("num") || !j.contains("den"))
+        return Ratio();
+    return Ratio((int32_t)j["num"].get<imgui_json::number>(), (int32_t)j["den"].get<imgui_json::number>());
+}
+
+static imgui_json::value MediaInfoToJson(const MediaInfo::Holder& hInfo)
+{
+    imgui_json::value j;
+    j["url"] = imgui_json::string(hInfo->url);
+    j["start_time"] = imgui_json::number(hInfo->startTime);
+    j["duration"] = imgui_json::number(hInfo->duration);
+    j["is_complete"] = imgui_json::boolean(hInfo->isComplete);
+    imgui_json::array ajnStreams;
+    for (auto& hStream : hInfo->streams)
+    {
+        imgui_json::value jnStm;
+        if (!hStream)
+        {
+            ajnStreams.push_back(jnStm);
+            continue;
+        }
+        jnStm["type"] = imgui_json::number((int)hStream->type);
+        jnStm["bit_rate"] = imgui_json::number((double)hStream->bitRate);
+        jnStm["start_time"] = imgui_json::number(hStream->startTime);
+        jnStm["duration"] = imgui_json::number(hStream->duration);
+        jnStm["timebase"] = RatioToJson(hStream->timebase);
+        jnStm["start_pts"] = imgui_json::number((double)hStream->startPts);
+        if (hStream->type == MediaType::VIDEO)
+        {
+            auto pVidStm = dynamic_cast<const VideoStream*>(hStream.get());
+            jnStm["width"] = imgui_json::number(pVidStm->width);
+            jnStm["height"] = imgui_json::number(pVidStm->height);
+            jnStm["raw_width"] = imgui_json::number(pVidStm->rawWidth);
+            jnStm["raw_height"] = imgui_json::number(pVidStm->rawHeight);
+            jnStm["format"] = imgui_json::string(pVidStm->format);
+            jnStm["codec"] = imgui_json::string(pVidStm->codec);
+            jnStm["sample_aspect_ratio"] = RatioToJson(pVidStm->sampleAspectRatio);
+            jnStm["avg_frame_rate"] = RatioToJson(pVidStm->avgFrameRate);
+            jnStm["real_frame_rate"] = RatioToJson(pVidStm->realFrameRate);
+            jnStm["frame_num"] = imgui_json::number((double)pVidStm->frameNum);
+            jnStm["is_image"] = imgui_json::boolean(pVidStm->isImage);
+            jnStm["is_hdr"] = imgui_json::boolean(pVidStm->isHdr);
+            jnStm["bit_depth"] = imgui_json::number(pVidStm->bitDepth);
+            jnStm["display_rotation"] = imgui_json::number(pVidStm->displayRotation);
+        }
+        else if (hStream->type == MediaType::AUDIO)
+        {
+            auto pAudStm = dynamic_cast<const AudioStream*>(hStream.get());
+            jnStm["channels"] = imgui_json::number(pAudStm->channels);
+            jnStm["sample_rate"] = imgui_json::number(pAudStm->sampleRate);
+            jnStm["format"] = imgui_json::string(pAudStm->format);
+            jnStm["codec"] = imgui_json::string(pAudStm->codec);
+            jnStm["bit_depth"] = imgui_json::number(pAudStm->bitDepth);
+        }
+        ajnStreams.push_back(jnStm);
+    }
+    j["streams"] = ajnStreams;
+    return j;
+}
+
+static double GetJsonNumber(const imgui_json::value& j, const string& name, double defaultValue = 0)
+{
+    if (!j.contains(name) || !j[name].is_number())
+        return defaultValue;
+    return j[name].get<imgui_json::number>();
+}
+
+static string GetJsonString(const imgui_json::value& j, const string& name)
+{
+    if (!j.contains(name) || !j[name].is_string())
+        return string();
+    return j[name].get<imgui_json::string>();
+}
+
+static bool GetJsonBoolean(const imgui_json::value& j, const string& name, bool defaultValue = false)
+{
+    if (!j.contains(name) || !j[name].is_boolean())
+        return defaultValue;
+    return j[name].get<imgui_json::boolean>();
+}
+
+static MediaInfo::Holder MediaInfoFromJson(const imgui_json::value& j)
+{
+    if (!j.is_object() || !j.contains("streams") || !j["streams"].is_array())
+        return nullptr;
+    MediaInfo::Holder hInfo(new MediaInfo());
+    hInfo->url = GetJsonString(j, "url");
+    hInfo->startTime = GetJsonNumber(j, "start_time");
+    hInfo->duration = GetJsonNumber(j, "duration", -1);
+    hInfo->isComplete = GetJsonBoolean(j, "is_complete", true);
+    const auto& ajnStreams = j["streams"].get<imgui_json::array>();
+    for (auto& jnStm : ajnStreams)
+    {
+        if (!jnStm.is_object())
+        {
+            hInfo->streams.push_back(nullptr);
+            continue;
+        }
+        Stream::Holder hStream;
+        const MediaType type = (MediaType)(int)GetJsonNumber(jnStm, "type", (double)(int)MediaType::UNKNOWN);
+        if (type == MediaType::VIDEO)
+        {
+            auto pVidStm = new VideoStream();
+            hStream = Stream::Holder(pVidStm);
+            pVidStm->width = (uint32_t)GetJsonNumber(jnStm, "width");
+            pVidStm->height = (uint32_t)GetJsonNumber(jnStm, "height");
+            pVidStm->rawWidth = (uint32_t)GetJsonNumber(jnStm, "raw_width");
+            pVidStm->rawHeight = (uint32_t)GetJsonNumber(jnStm, "raw_height");
+            pVidStm->format = GetJsonString(jnStm, "format");
+            pVidStm->codec = GetJsonString(jnStm, "codec");
+            if (jnStm.contains("sample_aspect_ratio")) pVidStm->sampleAspectRatio = RatioFromJson(jnStm["sample_aspect_ratio"]);
+            if (jnStm.contains("avg_frame_rate")) pVidStm->avgFrameRate = RatioFromJson(jnStm["avg_frame_rate"]);
+            if (jnStm.contains("real_frame_rate")) pVidStm->realFrameRate = RatioFromJson(jnStm["real_frame_rate"]);
+            pVidStm->frameNum = (uint64_t)GetJsonNumber(jnStm, "frame_num");
+            pVidStm->isImage = GetJsonBoolean(jnStm, "is_image");
+            pVidStm->isHdr = GetJsonBoolean(jnStm, "is_hdr");
+            pVidStm->bitDepth = (uint8_t)GetJsonNumber(jnStm, "bit_depth");
+            pVidStm->displayRotation = GetJsonNumber(jnStm, "display_rotation");
+        }
+        else if (type == MediaType::AUDIO)
+        {
+            auto pAudStm = new AudioStream();
+            hStream = Stream::Holder(pAudStm);
+            pAudStm->channels = (uint32_t)GetJsonNumber(jnStm, "channels");
+            pAudStm->sampleRate = (uint32_t)GetJsonNumber(jnStm, "sample_rate");
+            pAudStm->format = GetJsonString(jnStm, "format");
+            pAudStm->codec = GetJsonString(jnStm, "codec");
+            pAudStm->bitDepth = (uint8_t)GetJsonNumber(jnStm, "bit_depth");
+        }
+        else if (type == MediaType::SUBTITLE)
+        {
+            hStream = Stream::Holder(new SubtitleStream());
+        }
+        else
+        {
+            hStream = Stream::Holder(new Stream());
+            hStream->type = type;
+        }
+        hStream->bitRate = (uint64_t)GetJsonNumber(jnStm, "bit_rate");
+        hStream->startTime = GetJsonNumber(jnStm, "start_time");
+        hStream->duration = GetJsonNumber(jnStm, "duration");
+        if (jnStm.contains("timebase")) hStream->timebase = RatioFromJson(jnStm["timebase"]);
+        hStream->startPts = (int64_t)GetJsonNumber(jnStm, "start_pts");
+        hInfo->streams.push_back(hStream);
+    }
+    return hInfo;
+}
+
+static string IdentityHashToString(uint64_t hash)
+{
+    ostringstream oss; oss << hex << hash;
+    return oss.str();
+}
+
+class MediaImporter_Impl : public MediaImporter
+{
+public:
+    MediaImporter_Impl()
+    {
+        m_logger = GetLogger("MImporter");
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
+        m_maxConcurrency = m_hExecutor->GetThreadCount();
+    }
+
+    MediaImporter_Impl(const MediaImporter_Impl&) = delete;
+    MediaImporter_Impl(MediaImporter_Impl&&) = delete;
+    MediaImporter_Impl& operator=(const MediaImporter_Impl&) = delete;
+
+    virtual ~MediaImporter_Impl()
+    {
+        Cancel();
+        WaitAll(-1);
+    }
+
+    bool Import(const vector<string>& urls, ResultCallback callback) override
+    {
+        if (!callback)
+        {
+            m_errMsg = "INVALID argument! 'callback' can NOT be NULL.";
+            return false;
+        }
+        lock_guard<mutex> lk(m_taskLock);
+        for (auto& url : urls)
+            m_pendingTasks.push_back({url, callback});
+        ScheduleTasks();
+        return true;
+    }
+
+    bool WaitAll(int32_t timeout) override
+    {
+        unique_lock<mutex> lk(m_taskLock);
+        auto noPending = [this] { return m_pendingTasks.empty(); };
+        if (m_hExecutor->IsWorkerThread())
+        {
+            m_errMsg = "Can NOT wait for importing in the worker thread of the task executor!";
+            return noPending() && m_runningTasks.Count() == 0;
+        }
+        if (timeout < 0)
+        {
+            m_runningTasks.Wait(lk, noPending);
+            return true;
+        }
+        return m_runningTasks.WaitFor(lk, timeout, noPending);
+    }
+
+    void Cancel() override
+    {
+        lock_guard<mutex> lk(m_taskLock);
+        m_pendingTasks.clear();
+        m_runningTasks.Notify();
+    }
+
+    uint32_t GetPendingCount() const override
+    {
+        lock_guard<mutex> lk(m_taskLock);
+        return m_pendingTasks.size()+m_runningTasks.Count();
+    }
+
+    void SetMaxConcurrency(uint32_t maxConcurrency) override
+    {
+        lock_guard<mutex> lk(m_taskLock);
+        m_maxConcurrency = maxConcurrency > 0 ? maxConcurrency : m_hExecutor->GetThreadCount();
+        ScheduleTasks();
+    }
+
+    void EnableProbeCache(bool enable) override
+    {
+        m_useProbeCache = enable;
+    }
+
+    void SetLogLevel(Logger::Level l) override
+    {
+        m_logger->SetShowLevels(l);
+    }
+
+    string GetError() const override
+    {
+        return m_errMsg;
+    }
+
+private:
+    struct ImportTask
+    {
+        string url;
+        ResultCallback callback;
+    };
+
+    // must be invoked with 'm_taskLock' locked
+    void ScheduleTasks()
+    {
+        while (m_runningTasks.Count() < m_maxConcurrency && !m_pendingTasks.empty())
+        {
+            ImportTask task = m_pendingTasks.front();
+            m_pendingTasks.pop_front();
+            m_runningTasks.Increase();
+            m_hExecutor->Submit([this, task] { ProbeTaskProc(task); }, TaskExecutor::PRIORITY_BACKGROUND);
+        }
+    }
+
+    void ProbeTaskProc(const ImportTask& task)
+    {
+        ProbeResult result;
+        result.url = task.url;
+        MediaIndexCache::FileIdentity identity;
+        const bool useCache = m_useProbeCache && MediaIndexCache::GetFileIdentity(task.url, identity);
+        if (useCache)
+        {
+            result.hMediaInfo = LoadCachedMediaInfo(task.url, identity);
+            result.fromCache = (bool)result.hMediaInfo;
+        }
+        if (!result.hMediaInfo)
+        {
+            auto hParser = MediaParser::CreateInstance();
+            if (!hParser->Open(task.url))
+                result.errMsg = hParser->GetError();
+            else
+            {
+                result.hMediaInfo = hParser->GetMediaInfo(true);
+                if (!result.hMediaInfo)
+                    result.errMsg = "FAILED to parse media info!";
+                else if (useCache && !SaveCachedMediaInfo(task.url, identity, result.hMediaInfo))
+                    m_logger->Log(DEBUG) << "FAILED to save probe result of '" << task.url << "' into cache." << endl;
+            }
+        }
+        m_logger->Log(DEBUG) << "Probe '" << task.url << "' done, fromCache=" << result.fromCache << "." << endl;
+        task.callback(result);
+
+        lock_guard<mutex> lk(m_taskLock);
+        m_runningTasks.Decrease();
+        ScheduleTasks();
+    }
+
+    MediaInfo::Holder LoadCachedMediaInfo(const string& url, const MediaIndexCache::FileIdentity& identity)
+    {
+        const string cachePath = MediaIndexCache::GetCacheFilePath(url, PROBE_CACHE_FILE_SUFFIX);
+        if (cachePath.empty())
+            return nullptr;
+        auto loadRes = imgui_json::value::load(cachePath);
+        if (!loadRes.second)
+            return nullptr;
+        const auto& j = loadRes.first;
+        if (!j.is_object() || (int)GetJsonNumber(j, "version") != PROBE_CACHE_VERSION || GetJsonString(j, "url") != url
+            || (int64_t)GetJsonNumber(j, "file_size", -1) != identity.size || (int64_t)GetJsonNumber(j, "file_mtime") != identity.mtime
+            || GetJsonString(j, "content_hash") != IdentityHashToString(identity.contentHash) || !j.contains("media_info"))
+            return nullptr;
+        return MediaInfoFromJson(j["media_info"]);
+    }
+
+    bool SaveCachedMediaInfo(const string& url, const MediaIndexCache::FileIdentity& identity, const MediaInfo::Holder& hInfo)
+    {
+        if (!MediaIndexCache::PrepareCacheDirectory())
+            return false;
+        const string cachePath = MediaIndexCache::GetCacheFilePath(url, PROBE_CACHE_FILE_SUFFIX);
+        imgui_json::value j;
+        j["version"] = imgui_json::number(PROBE_CACHE_VERSION);
+        j["url"] = imgui_json::string(url);
+        j["file_size"] = imgui_json::number((double)identity.size);
+        j["file_mtime"] = imgui_json::number((double)identity.mtime);
+        j["content_hash"] = imgui_json::string(IdentityHashToString(identity.contentHash));
+        j["media_info"] = MediaInfoToJson(hInfo);
+        return j.save(cachePath);
+    }
+
+private:
+    ALogger* m_logger;
+    TaskExecutor::Holder m_hExecutor;
+    list<ImportTask> m_pendingTasks;
+    RunningTaskCounter m_runningTasks;
+    uint32_t m_maxConcurrency;
+    mutable mutex m_taskLock;
+    bool m_useProbeCache{true};
+    string m_errMsg;
+};
+
+static const auto MEDIA_IMPORTER_HOLDER_DELETER = [] (MediaImporter* p) {
+    MediaImporter_Impl* ptr = dynamic_cast<MediaImporter_Impl*>(p);
+    delete ptr;
+};
+
+MediaImporter::Holder MediaImporter::CreateInstance()
+{
+    return MediaImporter::Holder(new MediaImporter_Impl(), MEDIA_IMPORTER_HOLDER_DELETER);
+}
+}
@@ -0,0 +1,358 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+#include "MediaIndexCache.h"
+
+#if defined(_WIN32)
+#define FSEEK64 _fseeki64
+#else
+#define FSEEK64 fseeko
+#endif
+
+using namespace std;
+
+namespace MediaCore
+{
+namespace MediaIndexCache
+{
+static const char INDEX_FILE_MAGIC[8] = { 'M', 'C', 'V', 'I', 'D', 'X', 0, 0 };
+static const uint32_t INDEX_FILE_VERSION = 1;
+static const uint32_t INDEX_FILE_ENDIAN_TAG = 0x01020304;
+static const char* INDEX_FILE_SUFFIX = ".mcidx";
+
+enum IndexFileFlags
+{
+    HAS_SEEK_POINTS = 0x1,
+    HAS_FRAME_INDEX = 0x2,
+};
+
+// The index file is a flat binary image, 'header + seek points array + frame index array'. It's loaded with one
+// mapping (or one read on Windows) and the arrays are copied out of it, since the parser owns its index vectors.
+struct _IndexFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;
+    int64_t fileSize;
+    int64_t mtime;
+    uint64_t contentHash;
+    int32_t streamIndex;
+    int32_t timebaseNum;
+    int32_t timebaseDen;
+    uint32_t flags;
+    uint64_t seekPointCount;
+    uint64_t frameIndexCount;
+    uint64_t seekPointOffset;
+    uint64_t frameIndexOffset;
+};
+
+static_assert(sizeof(MediaParser::VideoFrameIndexEntry) == 32, "Layout of 'VideoFrameIndexEntry' is changed, 'INDEX_FILE_VERSION' should be updated!");
+
+static string _CACHE_DIR;
+static bool _CACHE_DIR_INITIALIZED = false;
+static mutex _CACHE_DIR_LOCK;
+
+static uint64_t Fnv1aHash(const uint8_t* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static string GetDefaultCacheDirectory()
+{
+    const char* envDir = getenv("MEDIACORE_INDEX_CACHE_DIR");
+    if (envDir)
+        return string(envDir);
+#if defined(_WIN32)
+    const char* baseDir = getenv("LOCALAPPDATA");
+    if (baseDir)
+        return string(baseDir)+"\\MediaCore\\index";
+#else
+    const char* baseDir = getenv("XDG_CACHE_HOME");
+    if (baseDir && baseDir[0] != 0)
+        return string(baseDir)+"/MediaCore/index";
+    baseDir = getenv("HOME");
+    if (baseDir)
+        return string(baseDir)+"/.cache/MediaCore/index";
+#endif
+    return string();
+}
+
+static bool MakeDirectories(const string& dirPath)
+{
+    if (dirPath.empty())
+        return false;
+    struct stat st;
+    if (stat(dirPath.c_str(), &st) == 0)
+        return (st.st_mode&S_IFDIR) != 0;
+    auto sepPos = dirPath.find_last_of("/\\");
+    if (sepPos != string::npos && sepPos > 0)
+    {
+        if (!MakeDirectories(dirPath.substr(0, sepPos)))
+            return false;
+    }
+#if defined(_WIN32)
+    return _mkdir(dirPath.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(dirPath.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+string GetCacheFilePath(const string& path, const string& suffix)
+{
+    const string cacheDir = GetCacheDirectory();
+    if (cacheDir.empty())
+        return string();
+    const uint64_t pathHash = Fnv1aHash((const uint8_t*)path.c_str(), path.size());
+    ostringstream oss;
+    oss << cacheDir << "/" << hex << setw(16) << setfill('0') << pathHash << suffix;
+    return oss.str();
+}
+
+bool PrepareCacheDirectory()
+{
+    const string cacheDir = GetCacheDirectory();
+    return !cacheDir.empty() && MakeDirectories(cacheDir);
+}
+
+bool GetFileIdentity(const string& path, FileIdentity& identity)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || (st.st_mode&S_IFREG) == 0)
+        return false;
+    identity.size = (int64_t)st.st_size;
+    identity.mtime = (int64_t)st.st_mtime;
+
+    // sample one page at the head, middle and tail of the file instead of hashing the whole content, it's done on
+    // every open of a media file. The head and the tail hold the container headers and indices, which differ
+    // between encodes even if the size and the mtime are the same. A small file is hashed once as a whole.
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    // unbuffered, so only the sampled bytes are read
+    setvbuf(fp, nullptr, _IONBF, 0);
+    const int64_t sampleSize = 4*1024;
+    uint64_t hash = Fnv1aHash((const uint8_t*)&identity.size, sizeof(identity.size));
+    if (identity.size <= sampleSize*3)
+    {
+        vector<uint8_t> content((size_t)identity.size);
+        const size_t readSize = fread(content.data(), 1, content.size(), fp);
+        hash = Fnv1aHash(content.data(), readSize, hash);
+    }
+    else
+    {
+        uint8_t buf[sampleSize];
+        const int64_t sampleOffsets[] = { 0, identity.size/2-sampleSize/2, identity.size-sampleSize };
+        for (auto offset : sampleOffsets)
+        {
+            if (FSEEK64(fp, offset, SEEK_SET) != 0)
+                break;
+            const size_t readSize = fread(buf, 1, sizeof(buf), fp);
+            hash = Fnv1aHash(buf, readSize, hash);
+        }
+    }
+    fclose(fp);
+    identity.contentHash = hash;
+    return true;
+}
+
+static bool IsArrayInImage(uint64_t offset, uint64_t count, size_t elemSize, size_t imageSize)
+{
+    return offset <= imageSize && count <= (imageSize-offset)/elemSize;
+}
+
+static bool ParseIndexImage(const uint8_t* image, size_t imageSize, const FileIdentity& identity, IndexData& data)
+{
+    if (imageSize < sizeof(_IndexFileHeader))
+        return false;
+    _IndexFileHeader header;
+    memcpy(&header, image, sizeof(header));
+    if (memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC)) != 0 || header.version != INDEX_FILE_VERSION
+        || header.endianTag != INDEX_FILE_ENDIAN_TAG)
+        return false;
+    FileIdentity cachedIdentity;
+    cachedIdentity.size = header.fileSize;
+    cachedIdentity.mtime = header.mtime;
+    cachedIdentity.contentHash = header.contentHash;
+    if (!(cachedIdentity == identity))
+        return false;
+    // compare the counts instead of the byte sizes, the counts and the offsets read from a corrupted file can make them overflow
+    if (!IsArrayInImage(header.seekPointOffset, header.seekPointCount, sizeof(int64_t), imageSize)
+        || !IsArrayInImage(header.frameIndexOffset, header.frameIndexCount, sizeof(MediaParser::VideoFrameIndexEntry), imageSize))
+        return false;
+    const uint64_t seekPointBytes = header.seekPointCount*sizeof(int64_t);
+    const uint64_t frameIndexBytes = header.frameIndexCount*sizeof(MediaParser::VideoFrameIndexEntry);
+
+    data.streamIndex = header.streamIndex;
+    data.timebaseNum = header.timebaseNum;
+    data.timebaseDen = header.timebaseDen;
+    data.hSeekPoints = nullptr;
+    data.hFrameIndex = nullptr;
+    if ((header.flags&HAS_SEEK_POINTS) != 0)
+    {
+        data.hSeekPoints = MediaParser::SeekPointsHolder(new vector<int64_t>(header.seekPointCount));
+        if (seekPointBytes > 0)
+            memcpy(data.hSeekPoints->data(), image+header.seekPointOffset, seekPointBytes);
+    }
+    if ((header.flags&HAS_FRAME_INDEX) != 0)
+    {
+        data.hFrameIndex = MediaParser::VideoFrameIndexHolder(new vector<MediaParser::VideoFrameIndexEntry>(header.frameIndexCount));
+        if (frameIndexBytes > 0)
+            memcpy(data.hFrameIndex->data(), image+header.frameIndexOffset, frameIndexBytes);
+    }
+    return true;
+}
+
+bool Load(const string& path, const FileIdentity& identity, IndexData& data)
+{
+    if (!identity.IsValid())
+        return false;
+    const string indexPath = GetCacheFilePath(path, INDEX_FILE_SUFFIX);
+    if (indexPath.empty())
+        return false;
+    bool success = false;
+#if defined(_WIN32)
+    FILE* fp = fopen(indexPath.c_str(), "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    const long fileSize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (fileSize > 0)
+    {
+        vector<uint8_t> image(fileSize);
+        if (fread(image.data(), 1, fileSize, fp) == (size_t)fileSize)
+            success = ParseIndexImage(image.data(), image.size(), identity, data);
+    }
+    fclose(fp);
+#else
+    int fd = open(indexPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* image = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (image != MAP_FAILED)
+        {
+            success = ParseIndexImage((const uint8_t*)image, st.st_size, identity, data);
+            munmap(image, st.st_size);
+        }
+    }
+    close(fd);
+#endif
+    return success;
+}
+
+bool Save(const string& path, const FileIdentity& identity, const IndexData& data)
+{
+    if (!identity.IsValid())
+        return false;
+    if (!PrepareCacheDirectory())
+        return false;
+    const string indexPath = GetCacheFilePath(path, INDEX_FILE_SUFFIX);
+
+    _IndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+    header.version = INDEX_FILE_VERSION;
+    header.endianTag = INDEX_FILE_ENDIAN_TAG;
+    header.fileSize = identity.size;
+    header.mtime = identity.mtime;
+    header.contentHash = identity.contentHash;
+    header.streamIndex = data.streamIndex;
+    header.timebaseNum = data.timebaseNum;
+    header.timebaseDen = data.timebaseDen;
+    if (data.hSeekPoints)
+    {
+        header.flags |= HAS_SEEK_POINTS;
+        header.seekPointCount = data.hSeekPoints->size();
+    }
+    if (data.hFrameIndex)
+    {
+        header.flags |= HAS_FRAME_INDEX;
+        header.frameIndexCount = data.hFrameIndex->size();
+    }
+    header.seekPointOffset = sizeof(header);
+    header.frameIndexOffset = header.seekPointOffset+header.seekPointCount*sizeof(int64_t);
+
+    // write to a temporary file then rename it, so that a reader never sees a partially written index
+    ostringstream tmpOss; tmpOss << indexPath << "." << hex << hash<thread::id>()(this_thread::get_id()) << ".tmp";
+    const string tmpPath = tmpOss.str();
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (success && header.seekPointCount > 0)
+        success = fwrite(data.hSeekPoints->data(), sizeof(int64_t), header.seekPointCount, fp) == header.seekPointCount;
+    if (success && header.frameIndexCount > 0)
+        success = fwrite(data.hFrameIndex->data(), sizeof(MediaParser::VideoFrameIndexEntry), header.frameIndexCount, fp) == header.frameIndexCount;
+    success = fclose(fp) == 0 && success;
+    if (success)
+    {
+#if defined(_WIN32)
+        remove(indexPath.c_str());
+#endif
+        success = rename(tmpPath.c_str(), indexPath.c_str()) == 0;
+    }
+    if (!success)
+        remove(tmpPath.c_str());
+    return success;
+}
+
+void SetCacheDirectory(const string& dirPath)
+{
+    lock_guard<mutex> lk(_CACHE_DIR_LOCK);
+    _CACHE_DIR = dirPath;
+    _CACHE_DIR_INITIALIZED = true;
+}
+
+string GetCacheDirectory()
+{
+    lock_guard<mutex> lk(_CACHE_DIR_LOCK);
+    if (!_CACHE_DIR_INITIALIZED)
+    {
+        _CACHE_DIR = GetDefaultCacheDirectory();
+        _CACHE_DIR_INITIALIZED = true;
+    }
+    return _CACHE_DIR;
+}
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "MediaParser.h"
+
+namespace MediaCore
+{
+namespace MediaIndexCache
+{
+    // Identity of a media file. A cached index is only valid if all the fields are matched.
+    struct FileIdentity
+    {
+        int64_t size{-1};
+        int64_t mtime{0};
+        uint64_t contentHash{0};
+
+        bool IsValid() const { return size >= 0; }
+        bool operator==(const FileIdentity& other) const
+        { return size == other.size && mtime == other.mtime && contentHash == other.contentHash; }
+    };
+
+    bool GetFileIdentity(const std::string& path, FileIdentity& identity);
+
+    struct IndexData
+    {
+        int32_t streamIndex{-1};
+        int32_t timebaseNum{0};
+        int32_t timebaseDen{0};
+        MediaParser::SeekPointsHolder hSeekPoints;
+        MediaParser::VideoFrameIndexHolder hFrameIndex;
+    };
+
+    // Load the index of 'path' from cache directory, return false if there is no valid cache.
+    bool Load(const std::string& path, const FileIdentity& identity, IndexData& data);
+    bool Save(const std::string& path, const FileIdentity& identity, const IndexData& data);
+
+    void SetCacheDirectory(const std::string& dirPath);
+    std::string GetCacheDirectory();
+    // Path of the cache file for 'path' with the given suffix, empty string if the cache is disabled
+    std::string GetCacheFilePath(const std::string& path, const std::string& suffix);
+    bool PrepareCacheDirectory();
+}
+}
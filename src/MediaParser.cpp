@@ -26,6 +26,8 @@
 #include <sstream>
 #include "ThreadUtils.h"
 #include "MediaParser.h"
+#include "TaskExecutor.h"
+#include "MediaIndexCache.h"
 #include "FFUtils.h"
 extern "C"
 {
@@ -55,7 +57,8 @@ public:
     MediaParser_Impl()
     {
         m_logger = MediaParser::GetLogger();
-        m_taskThread = thread(&MediaParser_Impl::TaskThreadProc, this);
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
+        m_hIoExecutor = TaskExecutor::GetIoInstance();
     }
 
     MediaParser_Impl(const MediaParser_Impl&) = delete;
@@ -64,14 +67,19 @@ public:
 
     virtual ~MediaParser_Impl()
     {
-        m_quitTaskThread = true;
         {
-            lock_guard<mutex> lk(m_pendingTaskQLock);
+            unique_lock<mutex> lk(m_pendingTaskQLock);
+            m_quitTaskThread = true;
+            m_pendingTaskQ.clear();
             if (m_currTask)
+            {
                 m_currTask->cancel = true;
+                if (m_hExecTask && m_hExecTask->Cancel())
+                    m_currTask = nullptr;
+            }
+            // wait for the running parse task to finish
+            m_taskDoneCv.wait(lk, [this] { return !m_currTask; });
         }
-        if (m_taskThread.joinable())
-            m_taskThread.join();
         Close();
     }
 
@@ -97,6 +105,7 @@ public:
 
         TaskHolder hTask(new ParseTask());
         hTask->taskProc = bind(&MediaParser_Impl::ParseGeneralMediaInfo, this, _1);
+        hTask->priority = TaskExecutor::PRIORITY_INTERACTIVE;
         {
             lock_guard<mutex> lk(m_taskTableLock);
             m_taskTable[MEDIA_INFO] = hTask;
@@ -104,6 +113,7 @@ public:
         {
             lock_guard<mutex> lk(m_pendingTaskQLock);
             m_pendingTaskQ.push_back(hTask);
+            ScheduleNextTask();
         }
 
         m_opened = true;
@@ -135,6 +145,7 @@ public:
 
         TaskHolder hTask(new ParseTask());
         hTask->taskProc = bind(&MediaParser_Impl::ParseGeneralMediaInfo, this, _1);
+        hTask->priority = TaskExecutor::PRIORITY_INTERACTIVE;
         {
             lock_guard<mutex> lk(m_taskTableLock);
             m_taskTable[MEDIA_INFO] = hTask;
@@ -142,6 +153,7 @@ public:
         {
             lock_guard<mutex> lk(m_pendingTaskQLock);
             m_pendingTaskQ.push_back(hTask);
+            ScheduleNextTask();
         }
 
         m_imgsqFrameRate = frameRate;
@@ -172,6 +184,9 @@ public:
 
         m_hMediaInfo = nullptr;
         m_hVidSeekPoints = nullptr;
+        m_hVidFrameIndex = nullptr;
+        m_fileIdentity = MediaIndexCache::FileIdentity();
+        m_indexCacheChecked = false;
 
         m_url = "";
         m_errMsg = "";
@@ -196,16 +211,32 @@ public:
                 {
                     case MEDIA_INFO:
                         hTask->taskProc = bind(&MediaParser_Impl::ParseGeneralMediaInfo, this, _1);
+                        hTask->priority = TaskExecutor::PRIORITY_INTERACTIVE;
                         break;
                     case VIDEO_SEEK_POINTS:
                         if (!m_isImageSequence)
+                        {
                             hTask->taskProc = bind(&MediaParser_Impl::ParseVideoSeekPoints, this, _1);
+                            hTask->scanWholeFile = true;
+                        }
                         else
                         {
                             m_errMsg = "Image sequence do NOT support parsing seek-points!";
                             return false;
                         }
                         break;
+                    case VIDEO_FRAME_INDEX:
+                        if (!m_isImageSequence)
+                        {
+                            hTask->taskProc = bind(&MediaParser_Impl::ParseVideoFrameIndex, this, _1);
+                            hTask->scanWholeFile = true;
+                        }
+                        else
+                        {
+                            m_errMsg = "Image sequence do NOT support parsing frame index!";
+                            return false;
+                        }
+                        break;
                     default:
                         oss << "Invalid argument value! There is no method to parse 'infoType'(" << to_string((int)infoType) << ").";
                         m_errMsg = oss.str();
@@ -218,6 +249,7 @@ public:
         {
             lock_guard<mutex> lk(m_pendingTaskQLock);
             m_pendingTaskQ.push_back(hTask);
+            ScheduleNextTask();
         }
         return true;
     }
@@ -296,6 +328,13 @@ public:
         return m_hVidSeekPoints;
     }
 
+    VideoFrameIndexHolder GetVideoFrameIndex(bool wait) override
+    {
+        if (wait)
+            WaitTaskDone(VIDEO_FRAME_INDEX);
+        return m_hVidFrameIndex;
+    }
+
     bool IsOpened() const override
     {
         return m_opened;
@@ -323,6 +362,9 @@ private:
     struct ParseTask
     {
         function<bool(TaskHolder)> taskProc;
+        TaskExecutor::Priority priority{TaskExecutor::PRIORITY_BACKGROUND};
+        // the task reading through the whole file runs on the I/O executor
+        bool scanWholeFile{false};
         bool cancel{false};
         bool failed{false};
         bool success{false};
@@ -339,41 +381,42 @@ private:
         return oss.str();
     }
 
-    void TaskThreadProc()
+    // Parse tasks share the same 'm_avfmtCtx', so they are executed one by one on the shared executor, except the
+    // full-file scans which go to the small I/O executor. This method must be invoked with 'm_pendingTaskQLock' locked.
+    void ScheduleNextTask()
     {
-        while (!m_quitTaskThread)
-        {
-            bool idleLoop = true;
-            if (!m_pendingTaskQ.empty())
-            {
-                lock_guard<mutex> lk(m_pendingTaskQLock);
-                if (!m_pendingTaskQ.empty())
-                {
-                    m_currTask = m_pendingTaskQ.front();
-                    m_pendingTaskQ.pop_front();
-                }
-            }
-
-            if (m_currTask)
-            {
-                if (!m_currTask->taskProc(m_currTask))
-                    m_currTask->failed = true;
-                else if (!m_currTask->cancel)
-                    m_currTask->success = true;
-                else
-                    m_logger->Log(DEBUG) << "Task cancelled." << endl;
-                idleLoop = false;
-
-                {
-                    lock_guard<mutex> lk(m_pendingTaskQLock);
-                    m_currTask = nullptr;
-                }
-                m_taskDoneCv.notify_all();
-            }
+        if (m_quitTaskThread || m_currTask || m_pendingTaskQ.empty())
+            return;
+        m_currTask = m_pendingTaskQ.front();
+        m_pendingTaskQ.pop_front();
+        auto& hExecutor = m_currTask->scanWholeFile ? m_hIoExecutor : m_hExecutor;
+        m_hExecTask = hExecutor->Submit([this] { RunCurrentTask(); }, m_currTask->priority);
+    }
 
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+    void RunCurrentTask()
+    {
+        TaskHolder hTask;
+        {
+            lock_guard<mutex> lk(m_pendingTaskQLock);
+            hTask = m_currTask;
         }
+        if (hTask)
+        {
+            if (hTask->cancel)
+                m_logger->Log(DEBUG) << "Task cancelled." << endl;
+            else if (!hTask->taskProc(hTask))
+                hTask->failed = true;
+            else if (!hTask->cancel)
+                hTask->success = true;
+            else
+                m_logger->Log(DEBUG) << "Task cancelled." << endl;
+        }
+        // notify with the lock held, the destructor may free this object as soon as it sees 'm_currTask' cleared
+        lock_guard<mutex> lk(m_pendingTaskQLock);
+        m_currTask = nullptr;
+        m_hExecTask = nullptr;
+        ScheduleNextTask();
+        m_taskDoneCv.notify_all();
     }
 
     bool ParseGeneralMediaInfo(TaskHolder hTask)
@@ -386,11 +429,6 @@ private:
 
     bool ParseMediaInfoFromFile(TaskHolder hTask)
     {
-        string fileName = SysUtils::ExtractFileName(m_url);
-        ostringstream thnOss;
-        thnOss << "PsrTsk-" << fileName;
-        SysUtils::SetThreadName(m_taskThread, thnOss.str());
-
         int fferr = 0;
         fferr = av_opt_set_int(m_avfmtCtx, "probesize", 5000, 0);
         if (fferr < 0)
@@ -470,11 +508,6 @@ private:
 
     bool ParseMediaInfoFromImageSequence(TaskHolder hTask)
     {
-        string dirPath = m_hFileIter->GetBaseDirPath();
-        ostringstream thnOss;
-        thnOss << "PsrTskIs-" << dirPath;
-        SysUtils::SetThreadName(m_taskThread, thnOss.str());
-
         m_hMediaInfo = MediaInfo::Holder(new MediaInfo());
         m_hMediaInfo->url = m_url;
         auto filePath = m_hFileIter->GetQuickSample();
@@ -526,6 +559,9 @@ private:
             hTask->errMsg = "No video stream found!";
             return false;
         }
+        LoadIndexCache();
+        if (m_hVidSeekPoints)
+            return true;
 
         // find the 1st key frame pts
         int vidstmidx = m_bestVidStmIdx;
@@ -631,9 +667,116 @@ private:
             hSeekPoints->push_back(pts);
         m_hVidSeekPoints = hSeekPoints;
         m_logger->Log(INFO) << "Parse video seek points of media '" << m_url << "' done. " << vidSeekPoints.size() << " seek points are found." << endl;
+        SaveIndexCache();
+        return true;
+    }
+
+    bool ParseVideoFrameIndex(TaskHolder hTask)
+    {
+        if (m_bestVidStmIdx < 0)
+        {
+            hTask->errMsg = "No video stream found!";
+            return false;
+        }
+        LoadIndexCache();
+        if (m_hVidFrameIndex)
+            return true;
+
+        if (!ResetAVFormatContext(hTask))
+            return false;
+        // only demux the video stream
+        const int vidstmidx = m_bestVidStmIdx;
+        AVStream* vidStream = m_avfmtCtx->streams[vidstmidx];
+        vector<AVDiscard> orgDiscards(m_avfmtCtx->nb_streams);
+        for (uint32_t i = 0; i < m_avfmtCtx->nb_streams; i++)
+        {
+            orgDiscards[i] = m_avfmtCtx->streams[i]->discard;
+            if ((int)i != vidstmidx)
+                m_avfmtCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+
+        VideoFrameIndexHolder hFrameIndex(new vector<VideoFrameIndexEntry>());
+        AVPacket avpkt = {0};
+        int fferr = 0;
+        while (!hTask->cancel)
+        {
+            fferr = av_read_frame(m_avfmtCtx, &avpkt);
+            if (fferr < 0)
+                break;
+            if (avpkt.stream_index == vidstmidx)
+                hFrameIndex->push_back({avpkt.pts, avpkt.dts, avpkt.pos, (uint32_t)avpkt.size, (uint32_t)avpkt.flags});
+            av_packet_unref(&avpkt);
+        }
+        for (uint32_t i = 0; i < m_avfmtCtx->nb_streams; i++)
+            m_avfmtCtx->streams[i]->discard = orgDiscards[i];
+        if (hTask->cancel)
+            return true;
+        if (fferr < 0 && fferr != AVERROR_EOF)
+        {
+            hTask->errMsg = FFapiFailureMessage("av_read_frame", fferr);
+            return false;
+        }
+        m_hVidFrameIndex = hFrameIndex;
+
+        // seek points can be derived from the key frames, with the same minimum interval as 'ParseVideoSeekPoints()'
+        if (!m_hVidSeekPoints)
+        {
+            const int64_t ptsStep = av_rescale_q((int64_t)(m_minSpIntervalSec*1000000), MICROSEC_TIMEBASE, vidStream->time_base);
+            SeekPointsHolder hSeekPoints(new vector<int64_t>());
+            for (auto& entry : *hFrameIndex)
+            {
+                if (!entry.IsKeyFrame() || entry.pts == AV_NOPTS_VALUE)
+                    continue;
+                if (hSeekPoints->empty() || entry.pts >= hSeekPoints->back()+ptsStep)
+                    hSeekPoints->push_back(entry.pts);
+            }
+            if (!hSeekPoints->empty())
+                m_hVidSeekPoints = hSeekPoints;
+        }
+        m_logger->Log(INFO) << "Parse video frame index of media '" << m_url << "' done. " << hFrameIndex->size() << " packets are indexed." << endl;
+        SaveIndexCache();
         return true;
     }
 
+    void LoadIndexCache()
+    {
+        if (m_indexCacheChecked)
+            return;
+        m_indexCacheChecked = true;
+        if (!MediaIndexCache::GetFileIdentity(m_url, m_fileIdentity))
+            return;
+        MediaIndexCache::IndexData data;
+        if (!MediaIndexCache::Load(m_url, m_fileIdentity, data))
+            return;
+        const AVStream* vidStream = m_avfmtCtx->streams[m_bestVidStmIdx];
+        if (data.streamIndex != m_bestVidStmIdx || data.timebaseNum != vidStream->time_base.num || data.timebaseDen != vidStream->time_base.den)
+        {
+            m_logger->Log(WARN) << "Cached video index of media '" << m_url << "' does NOT MATCH the video stream, discard it." << endl;
+            return;
+        }
+        if (data.hSeekPoints && !m_hVidSeekPoints)
+            m_hVidSeekPoints = data.hSeekPoints;
+        if (data.hFrameIndex && !m_hVidFrameIndex)
+            m_hVidFrameIndex = data.hFrameIndex;
+        m_logger->Log(INFO) << "Load video index of media '" << m_url << "' from cache. seekPoints=" << (data.hSeekPoints ? data.hSeekPoints->size() : 0)
+                << ", frameIndex=" << (data.hFrameIndex ? data.hFrameIndex->size() : 0) << "." << endl;
+    }
+
+    void SaveIndexCache()
+    {
+        if (!m_fileIdentity.IsValid())
+            return;
+        const AVStream* vidStream = m_avfmtCtx->streams[m_bestVidStmIdx];
+        MediaIndexCache::IndexData data;
+        data.streamIndex = m_bestVidStmIdx;
+        data.timebaseNum = vidStream->time_base.num;
+        data.timebaseDen = vidStream->time_base.den;
+        data.hSeekPoints = m_hVidSeekPoints;
+        data.hFrameIndex = m_hVidFrameIndex;
+        if (!MediaIndexCache::Save(m_url, m_fileIdentity, data))
+            m_logger->Log(DEBUG) << "FAILED to save video index of media '" << m_url << "' to cache directory '" << MediaIndexCache::GetCacheDirectory() << "'." << endl;
+    }
+
     bool ResetAVFormatContext(TaskHolder hTask)
     {
         int fferr = avformat_seek_file(m_avfmtCtx, -1, INT64_MIN, m_avfmtCtx->start_time, m_avfmtCtx->start_time, 0);
@@ -659,13 +802,29 @@ private:
             return;
         {
             unique_lock<mutex> lk(m_pendingTaskQLock);
-            m_taskDoneCv.wait(lk, [hTask]() { return hTask->isDone(); });
+            while (!hTask->isDone())
+            {
+                auto hExecTask = m_hExecTask;
+                if (hExecTask && (m_hExecutor->IsWorkerThread() || m_hIoExecutor->IsWorkerThread()))
+                {
+                    // keep the worker thread busy with the pending tasks, instead of blocking it
+                    lk.unlock();
+                    hExecTask->Wait();
+                    lk.lock();
+                }
+                else
+                {
+                    m_taskDoneCv.wait(lk);
+                }
+            }
         }
     }
 
 private:
     ALogger* m_logger;
-    thread m_taskThread;
+    TaskExecutor::Holder m_hExecutor;
+    TaskExecutor::Holder m_hIoExecutor;
+    TaskExecutor::Task::Holder m_hExecTask;
     TaskHolder m_currTask;
     bool m_quitTaskThread{false};
     list<TaskHolder> m_pendingTaskQ;
@@ -683,6 +842,9 @@ private:
 
     SeekPointsHolder m_hVidSeekPoints;
     double m_minSpIntervalSec{2};
+    VideoFrameIndexHolder m_hVidFrameIndex;
+    MediaIndexCache::FileIdentity m_fileIdentity;
+    bool m_indexCacheChecked{false};
 
     SysUtils::FileIterator::Holder m_hFileIter;
     bool m_isImageSequence{false};
@@ -708,4 +870,14 @@ ALogger* MediaParser::GetLogger()
 {
     return Logger::GetLogger("MParser");
 }
+
+void MediaParser::SetIndexCacheDirectory(const string& dirPath)
+{
+    MediaIndexCache::SetCacheDirectory(dirPath);
+}
+
+string MediaParser::GetIndexCacheDirectory()
+{
+    return MediaIndexCache::GetCacheDirectory();
+}
 }
\ No newline at end of file
@@ -26,6 +26,8 @@
 #include "MediaReader.h"
 #include "FFUtils.h"
 #include "ThreadUtils.h"
+#include "ThreadSignal.h"
+#include "TaskExecutor.h"
 extern "C"
 {
     #include "libavutil/avutil.h"
@@ -66,6 +68,7 @@ public:
             Level l = MediaReader::GetDefaultLogger()->GetShowLevels(n);
             m_logger->SetShowLevels(l, n);
         }
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
     }
 
     MediaReader_Impl(const MediaReader_Impl&) = delete;
@@ -365,6 +368,8 @@ public:
         m_seekPos = 0;
         m_vidfrmIntvMts = 0;
         m_hSeekPoints = nullptr;
+        m_vidGopPlans.clear();
+        m_byteSeekable = false;
         m_vidDurMts = 0;
         m_audDurMts = 0;
         m_audFrmSize = 0;
@@ -392,6 +397,7 @@ public:
     void Close() override
     {
         m_close = true;
+        m_frameReadySignal.Notify();
         lock_guard<recursive_mutex> lk(m_apiLock);
         WaitAllThreadsQuit();
         FlushAllQueues();
@@ -439,6 +445,8 @@ public:
         m_seekPos = 0;
         m_vidfrmIntvMts = 0;
         m_hSeekPoints = nullptr;
+        m_vidGopPlans.clear();
+        m_byteSeekable = false;
         m_vidDurMts = 0;
         m_audDurMts = 0;
         m_audFrmSize = 0;
@@ -790,6 +798,15 @@ public:
         throw runtime_error("This interface is NOT SUPPORTED by 'MediaReader_Impl'!");
     }
 
+    bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) override
+    {
+        // the snapshot and audio caches already keep whole gops, there is no reverse decoder to limit
+        if (maxBytes == 0)
+            return true;
+        m_errMsg = "Reverse decoding is NOT SUPPORTED by 'MediaReader_Impl'!";
+        return false;
+    }
+
     int64_t GetReadPos() const override
     {
         return m_cacheWnd.readPos;
@@ -1152,6 +1169,8 @@ private:
             m_vidStartPts = m_vidAvStm->start_time != AV_NOPTS_VALUE ? m_vidAvStm->start_time : 0;
             m_vidTimeBase = m_vidAvStm->time_base;
             m_vidfrmIntvPts = av_rescale_q(1, av_inv_q(m_vidAvStm->r_frame_rate), m_vidAvStm->time_base);
+            if (!m_isImage)
+                BuildGopPlansFromFrameIndex();
 
             m_viddecOpenOpts.onlyUseSoftwareDecoder = !m_vidPreferUseHw;
             m_viddecOpenOpts.useHardwareType = m_vidUseHwType;
@@ -1318,73 +1337,60 @@ private:
         return true;
     }
 
+    // The demuxing, decoding and frame generating loops run on the shared executor. They are started and stopped
+    // with 'm_apiLock' held, and the demuxing loop can not prepare before the lock is released.
     void StartAllThreads()
     {
-        string fileName = SysUtils::ExtractFileName(m_hParser->GetUrl());
-        ostringstream thnOss;
         m_quitThread = false;
-        m_demuxThread = thread(&MediaReader_Impl::DemuxThreadProc, this);
-        thnOss << (m_isVideoReader ? "V" : "A") << "rdrDmx-" << fileName;
-        SysUtils::SetThreadName(m_demuxThread, thnOss.str());
+        m_demuxState = DemuxLoopState();
+        m_decodeState = DecodeLoopState();
         if (m_isVideoReader)
         {
-            m_viddecThread = thread(&MediaReader_Impl::VideoDecodeThreadProc, this);
-            thnOss.str(""); thnOss << "VrdrVdc-" << fileName;
-            SysUtils::SetThreadName(m_viddecThread, thnOss.str());
-            m_genVfThread = thread(&MediaReader_Impl::GenerateVideoFrameThreadProc, this);
-            thnOss.str(""); thnOss << "VrdrGvf-" << fileName;
-            SysUtils::SetThreadName(m_genVfThread, thnOss.str());
+            atomic_store(&m_hGenFrameLoop, m_hExecutor->StartLoop([this] { return GenerateVideoFrameStep(); }));
+            atomic_store(&m_hDecodeLoop, m_hExecutor->StartLoop([this] { return VideoDecodeStep(); }));
         }
         else
         {
-            m_auddecThread = thread(&MediaReader_Impl::AudioDecodeThreadProc, this);
-            thnOss.str(""); thnOss << "ArdrAdc-" << fileName;
-            SysUtils::SetThreadName(m_auddecThread, thnOss.str());
-            m_genAfThread = thread(&MediaReader_Impl::GenerateAudioSamplesThreadProc, this);
-            thnOss.str(""); thnOss << "ArdrGaf-" << fileName;
-            SysUtils::SetThreadName(m_genAfThread, thnOss.str());
+            atomic_store(&m_hGenFrameLoop, m_hExecutor->StartLoop([this] { return GenerateAudioSamplesStep(); }));
+            atomic_store(&m_hDecodeLoop, m_hExecutor->StartLoop([this] { return AudioDecodeStep(); }));
         }
+        atomic_store(&m_hDemuxLoop, m_hExecutor->StartLoop([this] { return DemuxStep(); }));
         if (m_isImage)
-        {
-            m_releaseThread = thread(&MediaReader_Impl::ReleaseResourceProc, this);
-            thnOss << "VrdrRls-" << fileName;
-            SysUtils::SetThreadName(m_releaseThread, thnOss.str());
-        }
+            atomic_store(&m_hReleaseLoop, m_hExecutor->StartLoop([this] { return ReleaseResourceStep(); }, TaskExecutor::PRIORITY_BACKGROUND, 100));
     }
 
-    void WaitAllThreadsQuit(bool callFromReleaseProc = false)
+    void WaitAllThreadsQuit()
     {
         m_quitThread = true;
-        if (!callFromReleaseProc && m_releaseThread.joinable())
-        {
-            m_releaseThread.join();
-            m_releaseThread = thread();
-        }
-        if (m_demuxThread.joinable())
-        {
-            m_demuxThread.join();
-            m_demuxThread = thread();
-        }
-        if (m_viddecThread.joinable())
-        {
-            m_viddecThread.join();
-            m_viddecThread = thread();
-        }
-        if (m_genVfThread.joinable())
+        m_frameReadySignal.Notify();
+        // 'Stop()' returns immediately when it's called from the loop's own iteration, e.g. 'ReleaseResourceStep()'
+        for (auto phLoop : {&m_hReleaseLoop, &m_hDemuxLoop, &m_hDecodeLoop, &m_hGenFrameLoop})
         {
-            m_genVfThread.join();
-            m_genVfThread = thread();
-        }
-        if (m_auddecThread.joinable())
-        {
-            m_auddecThread.join();
-            m_auddecThread = thread();
-        }
-        if (m_genAfThread.joinable())
-        {
-            m_genAfThread.join();
-            m_genAfThread = thread();
+            auto hLoop = atomic_exchange(phLoop, TaskExecutor::Loop::Holder());
+            if (hLoop)
+                hLoop->Stop();
         }
+        m_demuxState.Release();
+        m_decodeState.Release();
+        m_genFrameTask = nullptr;
+    }
+
+    void WakeupLoop(const TaskExecutor::Loop::Holder& hLoopRef)
+    {
+        auto hLoop = atomic_load(&hLoopRef);
+        if (hLoop)
+            hLoop->Wakeup();
+    }
+
+    // End a loop from its own iteration after a fatal error, it's not run again until the loops are restarted
+    template<typename State>
+    bool QuitLoop(const TaskExecutor::Loop::Holder& hLoopRef, State& state)
+    {
+        state.Release();
+        auto hLoop = atomic_load(&hLoopRef);
+        if (hLoop)
+            hLoop->Stop();
+        return false;
     }
 
     void FlushAllQueues()
@@ -1402,6 +1408,7 @@ private:
         int64_t pts = CvtMtsToPts(pos);
         while (!m_close)
         {
+            const auto readySeq = m_frameReadySignal.Sequence();
             // check if the readPos has been changed by another operation, such as Seek.
             // if so, abort this read operation
             if (m_cacheWnd.readPos != pos)
@@ -1436,6 +1443,27 @@ private:
                 auto& vfAry = task->vfAry;
                 if (vfAry.empty())
                     continue;
+                if (task->framePlanned)
+                {
+                    // the frame to show is known from the frame index, no need to wait for the following frames being decoded
+                    int64_t expectedPos = INT64_MIN;
+                    for (auto framePts : task->frmPtsAry)
+                    {
+                        const int64_t framePos = CvtPtsToMts(framePts);
+                        if (framePos > pos)
+                            break;
+                        expectedPos = framePos;
+                    }
+                    auto iter = find_if(vfAry.begin(), vfAry.end(), [expectedPos](auto& frm) {
+                        return frm.pos == expectedPos;
+                    });
+                    if (iter != vfAry.end())
+                    {
+                        pBestCandidate = &(*iter);
+                        foundBestFrame = true;
+                        break;
+                    }
+                }
                 auto iter = find_if(vfAry.begin(), vfAry.end(), [pos](auto& frm) {
                     return frm.pos > pos;
                 });
@@ -1464,15 +1492,20 @@ private:
                 break;
             if (!targetTasks.empty() && tasksDecodeDone)
                 break;
-            this_thread::sleep_for(chrono::milliseconds(2));
+            m_frameReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
         }
 
         if (foundBestFrame)
         {
             if (wait)
             {
-                while(!m_close && pBestCandidate->vmat.empty())
-                    this_thread::sleep_for(chrono::milliseconds(2));
+                while (!m_close)
+                {
+                    const auto readySeq = m_frameReadySignal.Sequence();
+                    if (!pBestCandidate->vmat.empty())
+                        break;
+                    m_frameReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
+                }
             }
             if (!pBestCandidate->vmat.empty())
                 m = pBestCandidate->vmat;
@@ -1501,6 +1534,7 @@ private:
         do
         {
             bool idleLoop = true;
+            const auto readySeq = m_frameReadySignal.Sequence();
 
             GopDecodeTaskHolder readTask = m_audReadTask;
             if (!readTask || readTask->cancel)
@@ -1649,7 +1683,7 @@ private:
 
             needLoop = ((readTask && !readTask->cancel) || (!readTask && wait) || !idleLoop) && toReadSize > readSize && !m_audReadEof && !m_close;
             if (needLoop && idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_frameReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
 
             // if (!needLoop && readSize < toReadSize)
             //     m_logger->Log(WARN) << "Quit 'ReadAudioSamples()' before 'readSize'(" << readSize << ") reaches 'toReadSize'(" << toReadSize << ")! readTask is " << (readTask ? "non-NULL" : "NULL")
@@ -1719,9 +1753,141 @@ private:
         bool decInputEof{false};
         bool decodeStopped{false};
         bool cancel{false};
+        // if 'framePlanned' is true, 'frmPtsAry' and 'frmPtsRange' are filled from the frame index when the task is created
+        bool framePlanned{false};
+        int64_t keyDts{INT64_MIN};
+        int64_t keyPos{-1};
+        // dts of the last packet to demux for a planned task, INT64_MIN means stopping at 'seekPts.second' by pts
+        int64_t lastDts{INT64_MIN};
     };
     using GopDecodeTaskHolder = shared_ptr<GopDecodeTask>;
 
+    struct DemuxLoopState
+    {
+        AVPacket avpkt = {0};
+        bool avpktLoaded{false};
+        GopDecodeTaskHolder currTask;
+        int64_t lastPktPts{INT64_MIN};
+        int64_t prevTaskSeekPtsSecond{INT64_MIN};
+        bool fileDemuxEof{false};
+
+        void Release()
+        {
+            if (currTask && !currTask->demuxStopped)
+                currTask->demuxStopped = true;
+            currTask = nullptr;
+            if (avpktLoaded)
+                av_packet_unref(&avpkt);
+            avpktLoaded = false;
+        }
+    };
+
+    // shared by the video and audio decoding loops
+    struct DecodeLoopState
+    {
+        GopDecodeTaskHolder currTask;
+        AVFrame avfrm = {0};
+        bool avfrmLoaded{false};
+        bool needResetDecoder{false};
+        bool sentNullPacket{false};
+
+        void Release()
+        {
+            if (currTask && !currTask->decInputEof)
+                currTask->decInputEof = true;
+            currTask = nullptr;
+            if (avfrmLoaded)
+                av_frame_unref(&avfrm);
+            avfrmLoaded = false;
+        }
+    };
+
+    struct GopPlan
+    {
+        int64_t keyDts;
+        int64_t keyPos;
+        vector<int64_t> framePts;   // pts of all the frames displayed in this gop, in ascending order
+        int64_t lastDts;            // the largest dts of the frames in 'framePts'
+    };
+
+    void BuildGopPlansFromFrameIndex()
+    {
+        m_vidGopPlans.clear();
+        if (m_hParser->GetBestVideoStreamIndex() != m_vidStmIdx)
+            return;
+        // only use the frame index if it's already available (e.g. loaded from the index cache), parsing it here costs a whole file scan
+        auto hFrameIndex = m_hParser->GetVideoFrameIndex(false);
+        if (!hFrameIndex || hFrameIndex->empty())
+            return;
+
+        // every key frame can start a gop task, but too short tasks only bring more overhead on all-intra streams
+        const int64_t minIntvPts = av_rescale_q((int64_t)(m_minGopPlanIntvSec*1000), MILLISEC_TIMEBASE, m_vidTimeBase);
+        MediaParser::SeekPointsHolder hSeekPoints(new vector<int64_t>());
+        vector<GopPlan> gopPlans;
+        for (auto& entry : *hFrameIndex)
+        {
+            if (!entry.IsKeyFrame() || entry.pts == AV_NOPTS_VALUE)
+                continue;
+            if (!hSeekPoints->empty() && entry.pts < hSeekPoints->back()+minIntvPts)
+                continue;
+            hSeekPoints->push_back(entry.pts);
+            gopPlans.push_back({entry.dts, entry.pos, {}, INT64_MIN});
+        }
+        if (hSeekPoints->empty())
+            return;
+        // Assign frames to gops by pts rather than by decoding order, so the leading frames of an open gop go with the gop they are displayed in.
+        // Those frames follow the next key frame in decoding order, the task of the previous gop demuxes up to the last of them.
+        bool hasDts = true;
+        for (auto& entry : *hFrameIndex)
+        {
+            if (entry.pts == AV_NOPTS_VALUE)
+                continue;
+            auto iter = upper_bound(hSeekPoints->begin(), hSeekPoints->end(), entry.pts);
+            if (iter != hSeekPoints->begin())
+                iter--;
+            auto& plan = gopPlans[iter-hSeekPoints->begin()];
+            plan.framePts.push_back(entry.pts);
+            if (entry.dts == AV_NOPTS_VALUE)
+                hasDts = false;
+            else if (plan.lastDts < entry.dts)
+                plan.lastDts = entry.dts;
+        }
+        if (!hasDts)
+        {
+            for (auto& plan : gopPlans)
+                plan.lastDts = INT64_MIN;
+        }
+        for (auto& plan : gopPlans)
+            sort(plan.framePts.begin(), plan.framePts.end());
+
+        m_hSeekPoints = hSeekPoints;
+        m_vidGopPlans = std::move(gopPlans);
+        m_byteSeekable = (m_avfmtCtx->iformat->flags&AVFMT_NO_BYTE_SEEK) == 0;
+        m_logger->Log(DEBUG) << "Plan gop tasks from the video frame index, " << hFrameIndex->size() << " packets in "
+                << m_vidGopPlans.size() << " gops. Byte seeking is " << (m_byteSeekable ? "enabled" : "disabled") << "." << endl;
+    }
+
+    GopDecodeTaskHolder CreateVideoGopTask(int64_t first, int64_t second)
+    {
+        GopDecodeTaskHolder task = make_shared<GopDecodeTask>(*this);
+        task->seekPts = { first, second };
+        if (m_vidGopPlans.empty())
+            return task;
+        auto iter = lower_bound(m_hSeekPoints->begin(), m_hSeekPoints->end(), first);
+        if (iter == m_hSeekPoints->end() || *iter != first)
+            return task;
+        const auto& plan = m_vidGopPlans[iter-m_hSeekPoints->begin()];
+        if (plan.framePts.empty())
+            return task;
+        task->frmPtsAry.assign(plan.framePts.begin(), plan.framePts.end());
+        task->frmPtsRange = { plan.framePts.front(), plan.framePts.back()+m_vidfrmIntvPts };
+        task->keyDts = plan.keyDts;
+        task->keyPos = plan.keyPos;
+        task->lastDts = plan.lastDts;
+        task->framePlanned = true;
+        return task;
+    }
+
     GopDecodeTaskHolder FindNextDemuxTask()
     {
         GopDecodeTaskHolder nxttsk = nullptr;
@@ -1735,157 +1901,215 @@ private:
         return nxttsk;
     }
 
-    void DemuxThreadProc()
+    // One iteration of the demuxing loop, returns false if there is nothing to do
+    bool DemuxStep()
     {
-        m_logger->Log(DEBUG) << "Enter DemuxThreadProc()..." << endl;
-
-        if (!m_prepared && !Prepare())
+        if (!m_prepared)
         {
-            m_logger->Log(Error) << "Prepare() FAILED! Error is '" << m_errMsg << "'." << endl;
-            return;
+            // the api methods wait for the loops to stop with 'm_apiLock' held, so never block on it here
+            if (!m_apiLock.try_lock())
+                return false;
+            lock_guard<recursive_mutex> lk(m_apiLock, adopt_lock);
+            if (!Prepare())
+            {
+                m_logger->Log(Error) << "Prepare() FAILED! Error is '" << m_errMsg << "'." << endl;
+                return QuitLoop(m_hDemuxLoop, m_demuxState);
+            }
+            WakeupLoop(m_hDecodeLoop);
+            WakeupLoop(m_hGenFrameLoop);
         }
 
-        AVPacket avpkt = {0};
-        bool avpktLoaded = false;
-        GopDecodeTaskHolder currTask = nullptr;
-        int64_t lastPktPts, prevTaskSeekPtsSecond;
-        prevTaskSeekPtsSecond = INT64_MIN;
-        bool fileDemuxEof = false;
+        // the states kept across the iterations
+        AVPacket& avpkt = m_demuxState.avpkt;
+        bool& avpktLoaded = m_demuxState.avpktLoaded;
+        GopDecodeTaskHolder& currTask = m_demuxState.currTask;
+        int64_t& lastPktPts = m_demuxState.lastPktPts;
+        int64_t& prevTaskSeekPtsSecond = m_demuxState.prevTaskSeekPtsSecond;
+        bool& fileDemuxEof = m_demuxState.fileDemuxEof;
         int stmidx = m_isVideoReader ? m_vidStmIdx : m_audStmIdx;
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
 
-            UpdateBuildTask();
+        bool idleLoop = true;
+
+        const bool bldtskUpdated = m_needUpdateBldtsk;
+        m_needUpdateBldtsk = false;
+        UpdateBuildTask();
+        if (bldtskUpdated)
+        {
+            // tasks may have been canceled, wake up the downstream loops to check it
+            WakeupLoop(m_hDecodeLoop);
+            WakeupLoop(m_hGenFrameLoop);
+        }
 
-            bool taskChanged = false;
-            if (!currTask || currTask->cancel || currTask->demuxStopped)
+        bool taskChanged = false;
+        if (!currTask || currTask->cancel || currTask->demuxStopped)
+        {
+            if (currTask)
             {
-                if (currTask)
+                prevTaskSeekPtsSecond = currTask->seekPts.second;
+                if (currTask->cancel)
                 {
-                    prevTaskSeekPtsSecond = currTask->seekPts.second;
-                    if (currTask->cancel)
-                    {
-                        m_logger->Log(DEBUG) << "~~~~ Old demux task canceled, startPts=" 
-                            << currTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.first)) << ")"
-                            << ", endPts=" << currTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.second)) << ")" << endl;
-                    }
-                }
-                currTask = FindNextDemuxTask();
-                if (currTask)
-                {
-                    currTask->demuxStarted = true;
-                    taskChanged = true;
-                    m_logger->Log(DEBUG) << "--> Change demux task, startPts=" 
+                    m_logger->Log(DEBUG) << "~~~~ Old demux task canceled, startPts=" 
                         << currTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.first)) << ")"
                         << ", endPts=" << currTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.second)) << ")" << endl;
                 }
             }
-
+            currTask = FindNextDemuxTask();
             if (currTask)
             {
-                if (taskChanged)
+                currTask->demuxStarted = true;
+                taskChanged = true;
+                m_logger->Log(DEBUG) << "--> Change demux task, startPts=" 
+                    << currTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.first)) << ")"
+                    << ", endPts=" << currTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.second)) << ")" << endl;
+            }
+        }
+
+        if (currTask)
+        {
+            if (taskChanged)
+            {
+                // the previous task may have demuxed beyond the key frame of this one, to get the leading frames of its open gop
+                const bool pastKeyFrame = currTask->framePlanned && avpktLoaded && avpkt.dts != AV_NOPTS_VALUE && avpkt.dts > currTask->keyDts;
+                if (!avpktLoaded || prevTaskSeekPtsSecond != currTask->seekPts.first || avpkt.pts < currTask->seekPts.first || pastKeyFrame)
                 {
-                    if (!avpktLoaded || prevTaskSeekPtsSecond != currTask->seekPts.first || avpkt.pts < currTask->seekPts.first)
+                    if (avpktLoaded)
+                    {
+                        av_packet_unref(&avpkt);
+                        avpktLoaded = false;
+                    }
+                    lastPktPts = INT64_MIN;
+                    int fferr = 0;
+                    bool byteSeeked = false;
+                    if (!m_isImage)
+                    {
+                        if (m_byteSeekable && currTask->framePlanned && currTask->keyPos >= 0)
+                        {
+                            // the file offset of the key frame is known from the frame index, seek to it directly
+                            fferr = avformat_seek_file(m_avfmtCtx, stmidx, currTask->keyPos, currTask->keyPos, currTask->keyPos, AVSEEK_FLAG_BYTE);
+                            byteSeeked = fferr >= 0;
+                        }
+                        if (!byteSeeked)
+                            fferr = avformat_seek_file(m_avfmtCtx, stmidx, INT64_MIN, currTask->seekPts.first, currTask->seekPts.first, 0);
+                        if (fferr < 0)
+                        {
+                            m_logger->Log(Error) << "avformat_seek_file() FAILED for seeking to 'currTask->startPts'(" << currTask->seekPts.first << ")! fferr = " << fferr << "!" << endl;
+                            return QuitLoop(m_hDemuxLoop, m_demuxState);
+                        }
+                        currTask->demuxSeeked = true;
+                    }
+                    fileDemuxEof = false;
+                    int64_t ptsAfterSeek = INT64_MIN;
+                    if (!ReadNextStreamPacket(stmidx, &avpkt, &avpktLoaded, &ptsAfterSeek))
+                        return QuitLoop(m_hDemuxLoop, m_demuxState);
+                    if (byteSeeked && (!avpktLoaded || avpkt.dts != currTask->keyDts))
                     {
+                        m_logger->Log(DEBUG) << "Byte seeking does NOT land on the key frame packet(dts=" << currTask->keyDts << "), fallback to timestamp seeking." << endl;
+                        m_byteSeekable = false;
                         if (avpktLoaded)
                         {
                             av_packet_unref(&avpkt);
                             avpktLoaded = false;
                         }
-                        lastPktPts = INT64_MIN;
-                        int fferr = 0;
-                        if (!m_isImage)
+                        fferr = avformat_seek_file(m_avfmtCtx, stmidx, INT64_MIN, currTask->seekPts.first, currTask->seekPts.first, 0);
+                        if (fferr < 0)
                         {
-                            int fferr = avformat_seek_file(m_avfmtCtx, stmidx, INT64_MIN, currTask->seekPts.first, currTask->seekPts.first, 0);
-                            if (fferr < 0)
-                            {
-                                m_logger->Log(Error) << "avformat_seek_file() FAILED for seeking to 'currTask->startPts'(" << currTask->seekPts.first << ")! fferr = " << fferr << "!" << endl;
-                                break;
-                            }
-                            currTask->demuxSeeked = true;
+                            m_logger->Log(Error) << "avformat_seek_file() FAILED for seeking to 'currTask->startPts'(" << currTask->seekPts.first << ")! fferr = " << fferr << "!" << endl;
+                            return QuitLoop(m_hDemuxLoop, m_demuxState);
                         }
-                        fileDemuxEof = false;
-                        int64_t ptsAfterSeek = INT64_MIN;
                         if (!ReadNextStreamPacket(stmidx, &avpkt, &avpktLoaded, &ptsAfterSeek))
-                            break;
-                        if (ptsAfterSeek == INT64_MAX)
-                            fileDemuxEof = true;
-                        else if ((m_isVideoReader && ptsAfterSeek <= m_vidAvStm->start_time) ||
-                                 (!m_isVideoReader && ptsAfterSeek <= m_audAvStm->start_time))
-                            currTask->isFileBegin = true;
+                            return QuitLoop(m_hDemuxLoop, m_demuxState);
                     }
+                    if (ptsAfterSeek == INT64_MAX)
+                        fileDemuxEof = true;
+                    else if ((m_isVideoReader && ptsAfterSeek <= m_vidAvStm->start_time) ||
+                             (!m_isVideoReader && ptsAfterSeek <= m_audAvStm->start_time))
+                        currTask->isFileBegin = true;
                 }
+            }
 
-                if (!fileDemuxEof && !avpktLoaded)
+            if (!fileDemuxEof && !avpktLoaded)
+            {
+                int fferr = av_read_frame(m_avfmtCtx, &avpkt);
+                if (fferr == 0)
                 {
-                    int fferr = av_read_frame(m_avfmtCtx, &avpkt);
-                    if (fferr == 0)
-                    {
-                        avpktLoaded = true;
-                        idleLoop = false;
-                    }
-                    else
+                    avpktLoaded = true;
+                    idleLoop = false;
+                }
+                else
+                {
+                    if (fferr == AVERROR_EOF)
                     {
-                        if (fferr == AVERROR_EOF)
+                        currTask->isFileEnd = true;
+                        currTask->demuxStopped = true;
+                        if (taskChanged)
                         {
-                            currTask->isFileEnd = true;
-                            currTask->demuxStopped = true;
-                            if (taskChanged)
-                            {
-                                m_logger->Log(WARN) << "First AVPacket is EOF for this task! This task is INVALID." << endl;
-                                currTask->cancel = true;
-                            }
-                            fileDemuxEof = true;
-                            // cancel all the following tasks if there is any
+                            m_logger->Log(WARN) << "First AVPacket is EOF for this task! This task is INVALID." << endl;
+                            currTask->cancel = true;
+                        }
+                        fileDemuxEof = true;
+                        // cancel all the following tasks if there is any
+                        {
+                            lock_guard<mutex> lk(m_bldtskByPriLock);
+                            auto delIter = m_bldtskPriOrder.begin();
+                            while (delIter != m_bldtskPriOrder.end())
                             {
-                                lock_guard<mutex> lk(m_bldtskByPriLock);
-                                auto delIter = m_bldtskPriOrder.begin();
-                                while (delIter != m_bldtskPriOrder.end())
+                                auto& task = *delIter;
+                                if (task == currTask && currTask->cancel)
+                                    delIter = m_bldtskPriOrder.erase(delIter);
+                                else if (task->seekPts.first > currTask->seekPts.first)
                                 {
-                                    auto& task = *delIter;
-                                    if (task == currTask && currTask->cancel)
-                                        delIter = m_bldtskPriOrder.erase(delIter);
-                                    else if (task->seekPts.first > currTask->seekPts.first)
-                                    {
-                                        m_logger->Log(DEBUG) << "CANCEL invalid task after WHOLE FILE demux EOF, seekPts.first=" << task->seekPts.first << "." << endl;
-                                        task->cancel = true;
-                                        delIter = m_bldtskPriOrder.erase(delIter);
-                                    }
-                                    else
-                                        delIter++;
+                                    m_logger->Log(DEBUG) << "CANCEL invalid task after WHOLE FILE demux EOF, seekPts.first=" << task->seekPts.first << "." << endl;
+                                    task->cancel = true;
+                                    delIter = m_bldtskPriOrder.erase(delIter);
                                 }
-                                if (currTask->cancel && !m_bldtskPriOrder.empty())
-                                    m_bldtskPriOrder.back()->isFileEnd = true;
+                                else
+                                    delIter++;
                             }
-                        }
-                        else
-                        {
-                            m_errMsg = FFapiFailureMessage("av_read_frame", fferr);
-                            m_logger->Log(Error) << "Demuxer ERROR! 'av_read_frame' returns " << fferr << "." << endl;
+                            if (currTask->cancel && !m_bldtskPriOrder.empty())
+                                m_bldtskPriOrder.back()->isFileEnd = true;
                         }
                     }
+                    else
+                    {
+                        m_errMsg = FFapiFailureMessage("av_read_frame", fferr);
+                        m_logger->Log(Error) << "Demuxer ERROR! 'av_read_frame' returns " << fferr << "." << endl;
+                    }
                 }
+            }
 
-                if (avpktLoaded)
+            if (avpktLoaded)
+            {
+                if (avpkt.stream_index == stmidx && currTask->framePlanned && avpkt.dts != AV_NOPTS_VALUE && avpkt.dts < currTask->keyDts)
+                {
+                    // the demuxer has landed before the key frame of this task, skip these packets instead of decoding them
+                    av_packet_unref(&avpkt);
+                    avpktLoaded = false;
+                    idleLoop = false;
+                }
+                else if (avpkt.stream_index == stmidx)
                 {
-                    if (avpkt.stream_index == stmidx)
+                    const bool demuxEnd = currTask->lastDts != INT64_MIN && avpkt.dts != AV_NOPTS_VALUE
+                            ? avpkt.dts > currTask->lastDts : avpkt.pts >= currTask->seekPts.second;
+                    if (demuxEnd)
                     {
-                        if (avpkt.pts >= currTask->seekPts.second)
-                            currTask->demuxStopped = true;
+                        currTask->demuxStopped = true;
+                        WakeupLoop(m_hDecodeLoop);
+                    }
 
-                        if (!currTask->demuxStopped)
+                    if (!currTask->demuxStopped)
+                    {
+                        AVPacket* enqpkt = av_packet_clone(&avpkt);
+                        if (!enqpkt)
                         {
-                            AVPacket* enqpkt = av_packet_clone(&avpkt);
-                            if (!enqpkt)
-                            {
-                                m_logger->Log(Error) << "FAILED to invoke 'av_packet_clone(DemuxThreadProc)'!" << endl;
-                                break;
-                            }
+                            m_logger->Log(Error) << "FAILED to invoke 'av_packet_clone(DemuxStep)'!" << endl;
+                            return QuitLoop(m_hDemuxLoop, m_demuxState);
+                        }
+                        {
+                            lock_guard<mutex> lk(currTask->avpktQLock);
+                            // m_logger->Log(DEBUG) << "-> Queuing AVPacket of stream#" << stmidx << ", pts=" << enqpkt->pts << "." << endl;
+                            currTask->avpktQ.push_back(enqpkt);
+                            if (!currTask->framePlanned)
                             {
-                                lock_guard<mutex> lk(currTask->avpktQLock);
-                                // m_logger->Log(DEBUG) << "-> Queuing AVPacket of stream#" << stmidx << ", pts=" << enqpkt->pts << "." << endl;
-                                currTask->avpktQ.push_back(enqpkt);
                                 currTask->frmPtsAry.push_back(enqpkt->pts);
                                 if (currTask->frmPtsRange.first > enqpkt->pts)
                                     currTask->frmPtsRange.first = enqpkt->pts;
@@ -1893,28 +2117,23 @@ private:
                                 if (currTask->frmPtsRange.second < enqpkt->pts+pktDur)
                                     currTask->frmPtsRange.second = enqpkt->pts+pktDur;
                             }
-                            av_packet_unref(&avpkt);
-                            avpktLoaded = false;
-                            idleLoop = false;
                         }
-                    }
-                    else
-                    {
                         av_packet_unref(&avpkt);
                         avpktLoaded = false;
+                        idleLoop = false;
                     }
                 }
+                else
+                {
+                    av_packet_unref(&avpkt);
+                    avpktLoaded = false;
+                }
             }
-
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
         }
 
-        if (currTask && !currTask->demuxStopped)
-            currTask->demuxStopped = true;
-        if (avpktLoaded)
-            av_packet_unref(&avpkt);
-        m_logger->Log(DEBUG) << "Leave DemuxThreadProc()." << endl;
+        if (!idleLoop)
+            WakeupLoop(m_hDecodeLoop);
+        return !idleLoop;
     }
 
     bool ReadNextStreamPacket(int stmIdx, AVPacket* avpkt, bool* avpktLoaded, int64_t* pts)
@@ -2033,165 +2252,164 @@ private:
         return true;
     }
 
-    void VideoDecodeThreadProc()
+    // One iteration of the video decoding loop, returns false if there is nothing to do
+    bool VideoDecodeStep()
     {
-        m_logger->Log(DEBUG) << "Enter VideoDecodeThreadProc()..." << endl;
+        if (!m_prepared)
+            return false;
 
-        while (!m_prepared && !m_quitThread)
-            this_thread::sleep_for(chrono::milliseconds(5));
+        // the states kept across the iterations
+        GopDecodeTaskHolder& currTask = m_decodeState.currTask;
+        AVFrame& avfrm = m_decodeState.avfrm;
+        bool& avfrmLoaded = m_decodeState.avfrmLoaded;
+        bool& needResetDecoder = m_decodeState.needResetDecoder;
+        bool& sentNullPacket = m_decodeState.sentNullPacket;
 
-        GopDecodeTaskHolder currTask;
-        AVFrame avfrm = {0};
-        bool avfrmLoaded = false;
-        bool needResetDecoder = false;
-        bool sentNullPacket = false;
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
-            bool quitLoop = false;
+        bool idleLoop = true;
+        bool quitLoop = false;
+        bool waitForConsumer = false;
 
-            if (!currTask || currTask->cancel || currTask->decInputEof)
+        if (!currTask || currTask->cancel || currTask->decInputEof)
+        {
+            GopDecodeTaskHolder oldTask = currTask;
+            if (oldTask)
             {
-                GopDecodeTaskHolder oldTask = currTask;
-                if (oldTask)
-                {
-                    oldTask->decodeStopped = true;
-                    if (oldTask->cancel && avfrmLoaded)
-                    {
-                        m_logger->Log(DEBUG) << "~~~~ Old video task canceled, startPts="
-                            << oldTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(oldTask->seekPts.first)) << ")"
-                            << ", endPts=" << oldTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(oldTask->seekPts.second)) << ")" << endl;
-                        av_frame_unref(&avfrm);
-                        avfrmLoaded = false;
-                    }
-                }
-                currTask = FindNextDecoderTask();
-                if (currTask)
+                oldTask->decodeStopped = true;
+                m_frameReadySignal.Notify();
+                if (oldTask->cancel && avfrmLoaded)
                 {
-                    currTask->decodeStarted = true;
-                    m_logger->Log(DEBUG) << "==> Change decoding task, startPts="
-                        << currTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.first)) << ")"
-                        << ", endPts=" << currTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.second)) << ")" << endl;
-                }
-                if ((oldTask && (oldTask->cancel || oldTask->isFileEnd)) || (currTask && currTask->demuxSeeked))
-                {
-                    m_logger->Log(DEBUG) << ">>>--->>> Sending NULL ptr to video decoder <<<---<<<" << endl;
-                    avcodec_send_packet(m_viddecCtx, nullptr);
-                    sentNullPacket = true;
+                    m_logger->Log(DEBUG) << "~~~~ Old video task canceled, startPts="
+                        << oldTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(oldTask->seekPts.first)) << ")"
+                        << ", endPts=" << oldTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(oldTask->seekPts.second)) << ")" << endl;
+                    av_frame_unref(&avfrm);
+                    avfrmLoaded = false;
                 }
             }
-
-            if (needResetDecoder)
+            currTask = FindNextDecoderTask();
+            if (currTask)
+            {
+                currTask->decodeStarted = true;
+                m_logger->Log(DEBUG) << "==> Change decoding task, startPts="
+                    << currTask->seekPts.first << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.first)) << ")"
+                    << ", endPts=" << currTask->seekPts.second << "(" << MillisecToString(CvtPtsToMts(currTask->seekPts.second)) << ")" << endl;
+            }
+            if ((oldTask && (oldTask->cancel || oldTask->isFileEnd)) || (currTask && currTask->demuxSeeked))
             {
-                avcodec_flush_buffers(m_viddecCtx);
-                needResetDecoder = false;
-                sentNullPacket = false;
+                m_logger->Log(DEBUG) << ">>>--->>> Sending NULL ptr to video decoder <<<---<<<" << endl;
+                avcodec_send_packet(m_viddecCtx, nullptr);
+                sentNullPacket = true;
             }
+        }
 
-            // retrieve output frame
-            bool hasOutput;
-            do{
-                if (!avfrmLoaded)
+        if (needResetDecoder)
+        {
+            avcodec_flush_buffers(m_viddecCtx);
+            needResetDecoder = false;
+            sentNullPacket = false;
+        }
+
+        // retrieve output frame
+        bool hasOutput;
+        do{
+            if (!avfrmLoaded)
+            {
+                int fferr = avcodec_receive_frame(m_viddecCtx, &avfrm);
+                if (fferr == 0)
                 {
-                    int fferr = avcodec_receive_frame(m_viddecCtx, &avfrm);
-                    if (fferr == 0)
-                    {
-                        avfrm.pts = avfrm.best_effort_timestamp;
-                        // m_logger->Log(DEBUG) << "<<< Get video frame pts=" << avfrm.pts << "(" << MillisecToString(CvtPtsToMts(avfrm.pts)) << ")." << endl;
-                        avfrmLoaded = true;
-                        idleLoop = false;
-                    }
-                    else if (fferr != AVERROR(EAGAIN))
-                    {
-                        if (fferr != AVERROR_EOF)
-                        {
-                            m_errMsg = FFapiFailureMessage("avcodec_receive_frame", fferr);
-                            m_logger->Log(Error) << "FAILED to invoke 'avcodec_receive_frame'(VideoDecodeThreadProc)! return code is "
-                                << fferr << "." << endl;
-                            quitLoop = true;
-                            break;
-                        }
-                        else
-                        {
-                            idleLoop = false;
-                            needResetDecoder = true;
-                            m_logger->Log(VERBOSE) << "Video decoder current task reaches EOF!" << endl;
-                        }
-                    }
+                    avfrm.pts = avfrm.best_effort_timestamp;
+                    // m_logger->Log(DEBUG) << "<<< Get video frame pts=" << avfrm.pts << "(" << MillisecToString(CvtPtsToMts(avfrm.pts)) << ")." << endl;
+                    avfrmLoaded = true;
+                    idleLoop = false;
                 }
-
-                hasOutput = avfrmLoaded;
-                if (avfrmLoaded)
+                else if (fferr != AVERROR(EAGAIN))
                 {
-                    if (m_pendingVidfrmCnt < m_maxPendingVidfrmCnt)
+                    if (fferr != AVERROR_EOF)
                     {
-                        EnqueueSnapshotAVFrame(&avfrm);
-                        av_frame_unref(&avfrm);
-                        avfrmLoaded = false;
-                        idleLoop = false;
+                        m_errMsg = FFapiFailureMessage("avcodec_receive_frame", fferr);
+                        m_logger->Log(Error) << "FAILED to invoke 'avcodec_receive_frame'(VideoDecodeStep)! return code is "
+                            << fferr << "." << endl;
+                        quitLoop = true;
+                        break;
                     }
                     else
                     {
-                        this_thread::sleep_for(chrono::milliseconds(5));
+                        idleLoop = false;
+                        needResetDecoder = true;
+                        m_logger->Log(VERBOSE) << "Video decoder current task reaches EOF!" << endl;
                     }
                 }
-            } while (hasOutput && !m_quitThread && (!currTask || !currTask->cancel));
-            if (quitLoop)
-                break;
-            if (currTask && currTask->cancel)
-                continue;
+            }
 
-            if (currTask && !sentNullPacket)
+            hasOutput = avfrmLoaded;
+            if (avfrmLoaded)
             {
-                // input packet to decoder
-                if (!currTask->avpktQ.empty())
+                if (m_pendingVidfrmCnt < m_maxPendingVidfrmCnt)
                 {
-                    AVPacket* avpkt = currTask->avpktQ.front();
-                    int fferr = avcodec_send_packet(m_viddecCtx, avpkt);
-                    if (fferr == 0)
-                    {
-                        // m_logger->Log(DEBUG) << ">>> Send video packet pts=" << avpkt->pts << "(" << MillisecToString(CvtPtsToMts(avpkt->pts)) << ")." << endl;
-                        {
-                            lock_guard<mutex> lk(currTask->avpktQLock);
-                            currTask->avpktQ.pop_front();
-                        }
-                        av_packet_free(&avpkt);
-                        idleLoop = false;
-                    }
-                    else if (fferr == AVERROR_INVALIDDATA)
+                    EnqueueSnapshotAVFrame(&avfrm);
+                    av_frame_unref(&avfrm);
+                    WakeupLoop(m_hGenFrameLoop);
+                    avfrmLoaded = false;
+                    idleLoop = false;
+                }
+                else
+                {
+                    // 'GenerateVideoFrameStep()' wakes up this loop after consuming the pending frames
+                    waitForConsumer = true;
+                    break;
+                }
+            }
+        } while (hasOutput && !m_quitThread && (!currTask || !currTask->cancel));
+        if (quitLoop)
+            return QuitLoop(m_hDecodeLoop, m_decodeState);
+        if (currTask && currTask->cancel)
+            return true;
+        if (waitForConsumer)
+            return false;
+
+        if (currTask && !sentNullPacket)
+        {
+            // input packet to decoder
+            if (!currTask->avpktQ.empty())
+            {
+                AVPacket* avpkt = currTask->avpktQ.front();
+                int fferr = avcodec_send_packet(m_viddecCtx, avpkt);
+                if (fferr == 0)
+                {
+                    // m_logger->Log(DEBUG) << ">>> Send video packet pts=" << avpkt->pts << "(" << MillisecToString(CvtPtsToMts(avpkt->pts)) << ")." << endl;
                     {
-                        m_logger->Log(DEBUG) << "(VIDEO)avcodec_send_packet() return AVERROR_INVALIDDATA when decoding AVPacket with pts=" << avpkt->pts
-                            << " from file '" << m_hParser->GetUrl() << "'. DISCARD this PACKET." << endl;
-                        {
-                            lock_guard<mutex> lk(currTask->avpktQLock);
-                            currTask->avpktQ.pop_front();
-                        }
-                        av_packet_free(&avpkt);
-                        idleLoop = false;
+                        lock_guard<mutex> lk(currTask->avpktQLock);
+                        currTask->avpktQ.pop_front();
                     }
-                    else if (fferr != AVERROR(EAGAIN))
+                    av_packet_free(&avpkt);
+                    idleLoop = false;
+                }
+                else if (fferr == AVERROR_INVALIDDATA)
+                {
+                    m_logger->Log(DEBUG) << "(VIDEO)avcodec_send_packet() return AVERROR_INVALIDDATA when decoding AVPacket with pts=" << avpkt->pts
+                        << " from file '" << m_hParser->GetUrl() << "'. DISCARD this PACKET." << endl;
                     {
-                        m_errMsg = FFapiFailureMessage("avcodec_send_packet", fferr);
-                        m_logger->Log(Error) << "FAILED to invoke 'avcodec_send_packet'(VideoDecodeThreadProc)! return code is "
-                            << fferr << "." << endl;
-                        break;
+                        lock_guard<mutex> lk(currTask->avpktQLock);
+                        currTask->avpktQ.pop_front();
                     }
+                    av_packet_free(&avpkt);
+                    idleLoop = false;
                 }
-                else if (currTask->demuxStopped)
+                else if (fferr != AVERROR(EAGAIN))
                 {
-                    currTask->decInputEof = true;
-                    idleLoop = false;
+                    m_errMsg = FFapiFailureMessage("avcodec_send_packet", fferr);
+                    m_logger->Log(Error) << "FAILED to invoke 'avcodec_send_packet'(VideoDecodeStep)! return code is "
+                        << fferr << "." << endl;
+                    return QuitLoop(m_hDecodeLoop, m_decodeState);
                 }
             }
-
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+            else if (currTask->demuxStopped)
+            {
+                currTask->decInputEof = true;
+                idleLoop = false;
+            }
         }
-        if (currTask && !currTask->decInputEof)
-            currTask->decInputEof = true;
-        if (avfrmLoaded)
-            av_frame_unref(&avfrm);
-        m_logger->Log(DEBUG) << "Leave VideoDecodeThreadProc()." << endl;
+
+        return !idleLoop;
     }
 
     GopDecodeTaskHolder FindNextCfUpdateTask()
@@ -2207,51 +2425,48 @@ private:
         return nxttsk;
     }
 
-    void GenerateVideoFrameThreadProc()
+    // One iteration of the loop converting the decoded video frames, returns false if there is nothing to do
+    bool GenerateVideoFrameStep()
     {
-        m_logger->Log(DEBUG) << "Enter GenerateVideoFrameThreadProc()..." << endl;
+        if (!m_prepared)
+            return false;
 
-        while (!m_prepared && !m_quitThread)
-            this_thread::sleep_for(chrono::milliseconds(5));
-        if (m_quitThread)
-            return;
+        GopDecodeTaskHolder& currTask = m_genFrameTask;
+        bool idleLoop = true;
 
-        GopDecodeTaskHolder currTask;
-        while (!m_quitThread)
+        if (!currTask || currTask->cancel || currTask->frmCnt <= 0)
         {
-            bool idleLoop = true;
-
-            if (!currTask || currTask->cancel || currTask->frmCnt <= 0)
-            {
-                currTask = FindNextCfUpdateTask();
-            }
+            currTask = FindNextCfUpdateTask();
+        }
 
-            if (currTask)
+        if (currTask)
+        {
+            for (VideoFrame_Internal& vf : currTask->vfAry)
             {
-                for (VideoFrame_Internal& vf : currTask->vfAry)
+                if (vf.decfrm)
                 {
-                    if (vf.decfrm)
-                    {
-                        if (!m_pFrmCvt->ConvertImage(vf.decfrm.get(), vf.vmat, (double)vf.pos/1000))
-                            m_logger->Log(Error) << "FAILED to convert AVFrame to ImGui::ImMat for '" << m_hParser->GetUrl() << "' @pos " << vf.pos << "sec! Error is '" << m_pFrmCvt->GetError() << "'." << endl;
-                        vf.decfrm = nullptr;
-                        currTask->frmCnt--;
-                        if (currTask->frmCnt < 0)
-                            m_logger->Log(Error) << "!! ABNORMAL !! Task [" << currTask->seekPts.first << ", " << currTask->seekPts.second << "] has negative 'frmCnt'("
-                                << currTask->frmCnt << ")!" << endl;
-                        m_pendingVidfrmCnt--;
-                        if (m_pendingVidfrmCnt < 0)
-                            m_logger->Log(Error) << "Pending video AVFrame ptr count is NEGATIVE! " << m_pendingVidfrmCnt << endl;
+                    if (!m_pFrmCvt->ConvertImage(vf.decfrm.get(), vf.vmat, (double)vf.pos/1000))
+                        m_logger->Log(Error) << "FAILED to convert AVFrame to ImGui::ImMat for '" << m_hParser->GetUrl() << "' @pos " << vf.pos << "sec! Error is '" << m_pFrmCvt->GetError() << "'." << endl;
+                    vf.decfrm = nullptr;
+                    currTask->frmCnt--;
+                    if (currTask->frmCnt < 0)
+                        m_logger->Log(Error) << "!! ABNORMAL !! Task [" << currTask->seekPts.first << ", " << currTask->seekPts.second << "] has negative 'frmCnt'("
+                            << currTask->frmCnt << ")!" << endl;
+                    m_pendingVidfrmCnt--;
+                    if (m_pendingVidfrmCnt < 0)
+                        m_logger->Log(Error) << "Pending video AVFrame ptr count is NEGATIVE! " << m_pendingVidfrmCnt << endl;
 
-                        idleLoop = false;
-                    }
+                    idleLoop = false;
                 }
             }
+        }
 
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+        if (!idleLoop)
+        {
+            m_frameReadySignal.Notify();
+            WakeupLoop(m_hDecodeLoop);
         }
-        m_logger->Log(DEBUG) << "Leave GenerateVideoFrameThreadProc()." << endl;
+        return !idleLoop;
     }
 
     bool EnqueueAudioAVFrame(AVFrame* frm)
@@ -2319,256 +2534,244 @@ private:
         return false;
     }
 
-    void AudioDecodeThreadProc()
+    // One iteration of the audio decoding loop, returns false if there is nothing to do
+    bool AudioDecodeStep()
     {
-        m_logger->Log(DEBUG) << "Enter AudioDecodeThreadProc()..." << endl;
+        if (!m_prepared)
+            return false;
 
-        while (!m_prepared && !m_quitThread)
-            this_thread::sleep_for(chrono::milliseconds(5));
-        if (m_quitThread)
-            return;
+        // the states kept across the iterations
+        GopDecodeTaskHolder& currTask = m_decodeState.currTask;
+        AVFrame& avfrm = m_decodeState.avfrm;
+        bool& avfrmLoaded = m_decodeState.avfrmLoaded;
 
-        GopDecodeTaskHolder currTask;
-        AVFrame avfrm = {0};
-        bool avfrmLoaded = false;
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
-            bool quitLoop = false;
+        bool idleLoop = true;
+        bool quitLoop = false;
 
-            if (currTask && currTask->cancel)
+        if (currTask && currTask->cancel)
+        {
+            m_logger->Log(DEBUG) << "~~~~ Current audio task canceled" << endl;
+            if (avfrmLoaded)
             {
-                m_logger->Log(DEBUG) << "~~~~ Current audio task canceled" << endl;
-                if (avfrmLoaded)
-                {
-                    av_frame_unref(&avfrm);
-                    avfrmLoaded = false;
-                }
-                currTask = nullptr;
+                av_frame_unref(&avfrm);
+                avfrmLoaded = false;
             }
+            currTask = nullptr;
+        }
 
-            if (!currTask || currTask->decInputEof)
+        if (!currTask || currTask->decInputEof)
+        {
+            if (currTask)
             {
-                if (currTask)
-                {
-                    currTask->decodeStopped = true;
-                    if (!currTask->afAry.empty())
-                        currTask->afAry.back().endOfGop = true;
-                }
-                currTask = FindNextDecoderTask();
-                if (currTask)
-                {
-                    currTask->decodeStarted = true;
-                    // m_logger->Log(DEBUG) << "==> Change decoding task to build index (" << currTask->ssIdxPair.first << " ~ " << currTask->ssIdxPair.second << ")." << endl;
-                }
+                currTask->decodeStopped = true;
+                m_frameReadySignal.Notify();
+                if (!currTask->afAry.empty())
+                    currTask->afAry.back().endOfGop = true;
             }
-
+            currTask = FindNextDecoderTask();
             if (currTask)
             {
-                // retrieve output frame
-                bool hasOutput;
-                do{
-                    if (!avfrmLoaded)
+                currTask->decodeStarted = true;
+                // m_logger->Log(DEBUG) << "==> Change decoding task to build index (" << currTask->ssIdxPair.first << " ~ " << currTask->ssIdxPair.second << ")." << endl;
+            }
+        }
+
+        if (currTask)
+        {
+            // retrieve output frame
+            bool hasOutput;
+            do{
+                if (!avfrmLoaded)
+                {
+                    int fferr = avcodec_receive_frame(m_auddecCtx, &avfrm);
+                    if (fferr == 0)
+                    {
+                        // m_logger->Log(DEBUG) << "<<< Get audio frame pts=" << avfrm.pts << "(" << MillisecToString(CvtPtsToMts(avfrm.pts)) << ")." << endl;
+                        avfrmLoaded = true;
+                        idleLoop = false;
+                    }
+                    else if (fferr != AVERROR(EAGAIN))
                     {
-                        int fferr = avcodec_receive_frame(m_auddecCtx, &avfrm);
-                        if (fferr == 0)
+                        if (fferr != AVERROR_EOF)
                         {
-                            // m_logger->Log(DEBUG) << "<<< Get audio frame pts=" << avfrm.pts << "(" << MillisecToString(CvtPtsToMts(avfrm.pts)) << ")." << endl;
-                            avfrmLoaded = true;
-                            idleLoop = false;
+                            m_errMsg = FFapiFailureMessage("avcodec_receive_frame", fferr);
+                            m_logger->Log(Error) << "FAILED to invoke 'avcodec_receive_frame'(AudioDecodeStep)! return code is "
+                                << fferr << "." << endl;
+                            quitLoop = true;
+                            break;
                         }
-                        else if (fferr != AVERROR(EAGAIN))
+                        else
                         {
-                            if (fferr != AVERROR_EOF)
-                            {
-                                m_errMsg = FFapiFailureMessage("avcodec_receive_frame", fferr);
-                                m_logger->Log(Error) << "FAILED to invoke 'avcodec_receive_frame'(AudioDecodeThreadProc)! return code is "
-                                    << fferr << "." << endl;
-                                quitLoop = true;
-                                break;
-                            }
-                            else
-                            {
-                                idleLoop = false;
-                                // needResetDecoder = true;
-                                // m_logger->Log(DEBUG) << "Audio decoder current task reaches EOF!" << endl;
-                            }
+                            idleLoop = false;
+                            // needResetDecoder = true;
+                            // m_logger->Log(DEBUG) << "Audio decoder current task reaches EOF!" << endl;
                         }
                     }
+                }
 
-                    hasOutput = avfrmLoaded;
-                    if (avfrmLoaded)
-                    {
-                        EnqueueAudioAVFrame(&avfrm);
-                        av_frame_unref(&avfrm);
-                        avfrmLoaded = false;
-                        idleLoop = false;
-                    }
-                } while (hasOutput && !m_quitThread);
-                if (quitLoop)
-                    break;
+                hasOutput = avfrmLoaded;
+                if (avfrmLoaded)
+                {
+                    EnqueueAudioAVFrame(&avfrm);
+                    av_frame_unref(&avfrm);
+                    WakeupLoop(m_hGenFrameLoop);
+                    avfrmLoaded = false;
+                    idleLoop = false;
+                }
+            } while (hasOutput && !m_quitThread);
+            if (quitLoop)
+                return QuitLoop(m_hDecodeLoop, m_decodeState);
 
-                // input packet to decoder
-                if (!currTask->avpktQ.empty())
+            // input packet to decoder
+            if (!currTask->avpktQ.empty())
+            {
+                AVPacket* avpkt = currTask->avpktQ.front();
+                int fferr = avcodec_send_packet(m_auddecCtx, avpkt);
+                if (fferr == 0)
                 {
-                    AVPacket* avpkt = currTask->avpktQ.front();
-                    int fferr = avcodec_send_packet(m_auddecCtx, avpkt);
-                    if (fferr == 0)
-                    {
-                        // m_logger->Log(DEBUG) << ">>> Send audio packet pts=" << avpkt->pts << "(" << MillisecToString(CvtPtsToMts(avpkt->pts)) << ")." << endl;
-                        {
-                            lock_guard<mutex> lk(currTask->avpktQLock);
-                            currTask->avpktQ.pop_front();
-                        }
-                        av_packet_free(&avpkt);
-                        idleLoop = false;
-                    }
-                    else if (fferr != AVERROR(EAGAIN) && fferr != AVERROR_INVALIDDATA)
+                    // m_logger->Log(DEBUG) << ">>> Send audio packet pts=" << avpkt->pts << "(" << MillisecToString(CvtPtsToMts(avpkt->pts)) << ")." << endl;
                     {
-                        m_errMsg = FFapiFailureMessage("avcodec_send_packet", fferr);
-                        m_logger->Log(Error) << "FAILED to invoke 'avcodec_send_packet'(AudioDecodeThreadProc)! return code is "
-                            << fferr << "." << endl;
-                        break;
+                        lock_guard<mutex> lk(currTask->avpktQLock);
+                        currTask->avpktQ.pop_front();
                     }
+                    av_packet_free(&avpkt);
+                    idleLoop = false;
                 }
-                else if (currTask->demuxStopped)
+                else if (fferr != AVERROR(EAGAIN) && fferr != AVERROR_INVALIDDATA)
                 {
-                    currTask->decInputEof = true;
-                    idleLoop = false;
+                    m_errMsg = FFapiFailureMessage("avcodec_send_packet", fferr);
+                    m_logger->Log(Error) << "FAILED to invoke 'avcodec_send_packet'(AudioDecodeStep)! return code is "
+                        << fferr << "." << endl;
+                    return QuitLoop(m_hDecodeLoop, m_decodeState);
                 }
             }
-
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+            else if (currTask->demuxStopped)
+            {
+                currTask->decInputEof = true;
+                idleLoop = false;
+            }
         }
-        if (avfrmLoaded)
-            av_frame_unref(&avfrm);
-        m_logger->Log(DEBUG) << "Leave AudioDecodeThreadProc()." << endl;
+
+        return !idleLoop;
     }
 
-    void GenerateAudioSamplesThreadProc()
+    // One iteration of the loop resampling the decoded audio frames, returns false if there is nothing to do
+    bool GenerateAudioSamplesStep()
     {
-        m_logger->Log(DEBUG) << "Enter GenerateAudioSamplesThreadProc()..." << endl;
-
-        while (!m_prepared && !m_quitThread)
-            this_thread::sleep_for(chrono::milliseconds(5));
-        if (m_quitThread)
-            return;
+        if (!m_prepared)
+            return false;
 
-        GopDecodeTaskHolder currTask;
+        GopDecodeTaskHolder& currTask = m_genFrameTask;
         AVRational audTimebase = m_audAvStm->time_base;
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
+        bool idleLoop = true;
 
-            if (!currTask || currTask->cancel || currTask->frmCnt <= 0)
-            {
-                currTask = FindNextCfUpdateTask();
-            }
+        if (!currTask || currTask->cancel || currTask->frmCnt <= 0)
+        {
+            currTask = FindNextCfUpdateTask();
+        }
 
-            if (currTask)
+        if (currTask)
+        {
+            for (AudioFrame_Internal& af : currTask->afAry)
             {
-                for (AudioFrame_Internal& af : currTask->afAry)
+                int fferr;
+                SelfFreeAVFramePtr fwdfrm;
+                SelfFreeAVFramePtr bwdfrm;
+                if (af.decfrm)
                 {
-                    int fferr;
-                    SelfFreeAVFramePtr fwdfrm;
-                    SelfFreeAVFramePtr bwdfrm;
-                    if (af.decfrm)
+                    if (m_swrPassThrough)
+                    {
+                        fwdfrm = af.decfrm;
+                    }
+                    else
                     {
-                        if (m_swrPassThrough)
+                        fwdfrm = AllocSelfFreeAVFramePtr();
+                        if (!fwdfrm)
                         {
-                            fwdfrm = af.decfrm;
+                            m_logger->Log(Error) << "FAILED to allocate new AVFrame for 'swr_convert()'!" << endl;
+                            break;
                         }
-                        else
-                        {
-                            fwdfrm = AllocSelfFreeAVFramePtr();
-                            if (!fwdfrm)
-                            {
-                                m_logger->Log(Error) << "FAILED to allocate new AVFrame for 'swr_convert()'!" << endl;
-                                break;
-                            }
-                            AVFrame* srcfrm = af.decfrm.get();
-                            AVFrame* dstfrm = fwdfrm.get();
-                            av_frame_copy_props(dstfrm, srcfrm);
-                            dstfrm->format = (int)m_swrOutSmpfmt;
-                            dstfrm->sample_rate = m_swrOutSampleRate;
+                        AVFrame* srcfrm = af.decfrm.get();
+                        AVFrame* dstfrm = fwdfrm.get();
+                        av_frame_copy_props(dstfrm, srcfrm);
+                        dstfrm->format = (int)m_swrOutSmpfmt;
+                        dstfrm->sample_rate = m_swrOutSampleRate;
 #if !defined(FF_API_OLD_CHANNEL_LAYOUT) && (LIBAVUTIL_VERSION_MAJOR < 58)
-                            dstfrm->channels = m_swrOutChannels;
-                            dstfrm->channel_layout = m_swrOutChnLyt;
+                        dstfrm->channels = m_swrOutChannels;
+                        dstfrm->channel_layout = m_swrOutChnLyt;
 #else
-                            dstfrm->ch_layout = m_swrOutChlyt;
+                        dstfrm->ch_layout = m_swrOutChlyt;
 #endif
-                            dstfrm->nb_samples = swr_get_out_samples(m_swrCtx, srcfrm->nb_samples);
-                            fferr = av_frame_get_buffer(dstfrm, 0);
-                            if (fferr < 0)
-                            {
-                                m_logger->Log(Error) << "av_frame_get_buffer(UpdatePcmThreadProc1) FAILED with return code " << fferr << endl;
-                                break;
-                            }
-                            int64_t outpts = swr_next_pts(m_swrCtx, av_rescale(srcfrm->pts, audTimebase.num*(int64_t)dstfrm->sample_rate*srcfrm->sample_rate, audTimebase.den));
-                            dstfrm->pts = ROUNDED_DIV(outpts, srcfrm->sample_rate);
-                            fferr = swr_convert(m_swrCtx, dstfrm->data, dstfrm->nb_samples, (const uint8_t **)srcfrm->data, srcfrm->nb_samples);
-                            if (fferr < 0)
-                            {
-                                m_logger->Log(Error) << "swr_convert(GenerateAudioSamplesThreadProc) FAILED with return code " << fferr << endl;
-                                break;
-                            }
-                            if (fferr < dstfrm->nb_samples)
-                            {
-                                dstfrm->nb_samples = fferr;
-                            }
-                            af.pts = dstfrm->pts;
+                        dstfrm->nb_samples = swr_get_out_samples(m_swrCtx, srcfrm->nb_samples);
+                        fferr = av_frame_get_buffer(dstfrm, 0);
+                        if (fferr < 0)
+                        {
+                            m_logger->Log(Error) << "av_frame_get_buffer(UpdatePcmThreadProc1) FAILED with return code " << fferr << endl;
+                            break;
                         }
-                        if (m_fpPcmFile)
+                        int64_t outpts = swr_next_pts(m_swrCtx, av_rescale(srcfrm->pts, audTimebase.num*(int64_t)dstfrm->sample_rate*srcfrm->sample_rate, audTimebase.den));
+                        dstfrm->pts = ROUNDED_DIV(outpts, srcfrm->sample_rate);
+                        fferr = swr_convert(m_swrCtx, dstfrm->data, dstfrm->nb_samples, (const uint8_t **)srcfrm->data, srcfrm->nb_samples);
+                        if (fferr < 0)
+                        {
+                            m_logger->Log(Error) << "swr_convert(GenerateAudioSamplesStep) FAILED with return code " << fferr << endl;
+                            break;
+                        }
+                        if (fferr < dstfrm->nb_samples)
+                        {
+                            dstfrm->nb_samples = fferr;
+                        }
+                        af.pts = dstfrm->pts;
+                    }
+                    if (m_fpPcmFile)
+                    {
+                        int frameSize = m_outFrmSize;
+                        if (IsPlanar())
                         {
-                            int frameSize = m_outFrmSize;
-                            if (IsPlanar())
-                            {
 #if !defined(FF_API_OLD_CHANNEL_LAYOUT) && (LIBAVUTIL_VERSION_MAJOR < 58)
-                                int frmChannels = fwdfrm->channels;
+                            int frmChannels = fwdfrm->channels;
 #else
-                                int frmChannels = fwdfrm->ch_layout.nb_channels;
+                            int frmChannels = fwdfrm->ch_layout.nb_channels;
 #endif
-                                int bytesPerSample = frameSize/frmChannels;
-                                int offset = 0;
-                                for (int i = 0; i < fwdfrm->nb_samples; i++)
-                                {
-                                    for (int j = 0; j < frmChannels; j++)
-                                        fwrite(fwdfrm->data[j]+offset, 1, bytesPerSample, m_fpPcmFile);
-                                    offset += bytesPerSample;
-                                }
-                            }
-                            else
+                            int bytesPerSample = frameSize/frmChannels;
+                            int offset = 0;
+                            for (int i = 0; i < fwdfrm->nb_samples; i++)
                             {
-                                const int writeSize = fwdfrm->nb_samples*frameSize;
-                                fwrite(fwdfrm->data[0], 1, writeSize, m_fpPcmFile);
+                                for (int j = 0; j < frmChannels; j++)
+                                    fwrite(fwdfrm->data[j]+offset, 1, bytesPerSample, m_fpPcmFile);
+                                offset += bytesPerSample;
                             }
                         }
-
-                        bwdfrm = GenerateBackwardAudioFrame(fwdfrm);
-                        if (!bwdfrm)
+                        else
                         {
-                            m_logger->Log(Error) << "FAILED to GENERATE backward audio frame!" << endl;
-                            break;
+                            const int writeSize = fwdfrm->nb_samples*frameSize;
+                            fwrite(fwdfrm->data[0], 1, writeSize, m_fpPcmFile);
                         }
+                    }
 
-                        af.decfrm = nullptr;
-                        af.fwdfrm = fwdfrm;
-                        af.bwdfrm = bwdfrm;
-                        currTask->frmCnt--;
-                        if (currTask->frmCnt < 0)
-                            m_logger->Log(Error) << "!! ABNORMAL !! Task [" << currTask->seekPts.first << ", " << currTask->seekPts.second << "] has negative 'frmCnt'("
-                                << currTask->frmCnt << ")!" << endl;
-
-                        idleLoop = false;
+                    bwdfrm = GenerateBackwardAudioFrame(fwdfrm);
+                    if (!bwdfrm)
+                    {
+                        m_logger->Log(Error) << "FAILED to GENERATE backward audio frame!" << endl;
+                        break;
                     }
+
+                    af.decfrm = nullptr;
+                    af.fwdfrm = fwdfrm;
+                    af.bwdfrm = bwdfrm;
+                    currTask->frmCnt--;
+                    if (currTask->frmCnt < 0)
+                        m_logger->Log(Error) << "!! ABNORMAL !! Task [" << currTask->seekPts.first << ", " << currTask->seekPts.second << "] has negative 'frmCnt'("
+                            << currTask->frmCnt << ")!" << endl;
+
+                    idleLoop = false;
                 }
             }
-
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
         }
-        m_logger->Log(DEBUG) << "Leave GenerateAudioSamplesThreadProc()." << endl;
+
+        if (!idleLoop)
+            m_frameReadySignal.Notify();
+        return !idleLoop;
     }
 
     SelfFreeAVFramePtr GenerateBackwardAudioFrame(SelfFreeAVFramePtr fwdfrm)
@@ -2706,8 +2909,7 @@ private:
     pair<int64_t, int64_t> GetSeekPtsByMts(int64_t pos)
     {
         int64_t targetPts = CvtMtsToPts(pos);
-        auto iter = find_if(m_hSeekPoints->begin(), m_hSeekPoints->end(),
-            [targetPts](int64_t keyPts) { return keyPts > targetPts; });
+        auto iter = upper_bound(m_hSeekPoints->begin(), m_hSeekPoints->end(), targetPts);
         if (iter != m_hSeekPoints->begin())
             iter--;
         int64_t first = *iter++;
@@ -2747,6 +2949,8 @@ private:
         {
             m_cacheWnd = { readPos, cacheBeginMts, cacheEndMts, seekPosRead, seekPos00, seekPos10 };
             m_needUpdateBldtsk = true;
+            WakeupLoop(m_hDemuxLoop);
+            m_frameReadySignal.Notify();
         }
         m_cacheWnd.readPos = readPos;
         m_logger->Log(VERBOSE) << "Cache window updated: { readPos=" << readPos << ", cacheBeginTs=" << m_cacheWnd.cacheBeginMts << ", cacheEndTs=" << m_cacheWnd.cacheEndMts
@@ -2781,16 +2985,14 @@ private:
         }
 
         int64_t searchPts = CvtMtsToPts(currwnd.cacheBeginMts);
-        auto iter = find_if(m_hSeekPoints->begin(), m_hSeekPoints->end(),
-            [searchPts](int64_t keyPts) { return keyPts > searchPts; });
+        auto iter = upper_bound(m_hSeekPoints->begin(), m_hSeekPoints->end(), searchPts);
         if (iter != m_hSeekPoints->begin())
             iter--;
         do
         {
             int64_t first = *iter++;
             int64_t second = iter == m_hSeekPoints->end() ? INT64_MAX : *iter;
-            GopDecodeTaskHolder task = make_shared<GopDecodeTask>(*this);
-            task->seekPts = { first, second };
+            GopDecodeTaskHolder task = CreateVideoGopTask(first, second);
             m_bldtskTimeOrder.push_back(task);
             searchPts = second;
         } while (searchPts < INT64_MAX && CvtPtsToMts(searchPts) <= currwnd.cacheEndMts);
@@ -2846,8 +3048,7 @@ private:
 
                 if (beginPts < endPts)
                 {
-                    auto iter = find_if(m_hSeekPoints->begin(), m_hSeekPoints->end(),
-                        [beginPts](int64_t keyPts) { return keyPts > beginPts; });
+                    auto iter = upper_bound(m_hSeekPoints->begin(), m_hSeekPoints->end(), beginPts);
                     if (iter != m_hSeekPoints->begin())
                         iter--;
                     if (*iter < endPts)
@@ -2856,8 +3057,7 @@ private:
                         {
                             int64_t first = *iter++;
                             int64_t second = iter == m_hSeekPoints->end() ? INT64_MAX : *iter;
-                            GopDecodeTaskHolder task = make_shared<GopDecodeTask>(*this);
-                            task->seekPts = { first, second };
+                            GopDecodeTaskHolder task = CreateVideoGopTask(first, second);
                             m_bldtskTimeOrder.push_back(task);
                             taskListChanged = true;
                             beginPts = second;
@@ -2902,8 +3102,7 @@ private:
 
                 if (beginPts < endPts)
                 {
-                    auto iter = find_if(m_hSeekPoints->begin(), m_hSeekPoints->end(),
-                        [endPts](int64_t keyPts) { return keyPts >= endPts; });
+                    auto iter = lower_bound(m_hSeekPoints->begin(), m_hSeekPoints->end(), endPts);
                     if (iter != m_hSeekPoints->begin())
                     {
                         iter--;
@@ -2912,8 +3111,7 @@ private:
                             auto iter2 = iter; iter2++;
                             int64_t first = *iter;
                             int64_t second = iter2 == m_hSeekPoints->end() ? INT64_MAX : *iter2;
-                            GopDecodeTaskHolder task = make_shared<GopDecodeTask>(*this);
-                            task->seekPts = { first, second };
+                            GopDecodeTaskHolder task = CreateVideoGopTask(first, second);
                             m_bldtskTimeOrder.push_front(task);
                             taskListChanged = true;
                             if (iter != m_hSeekPoints->begin())
@@ -3320,63 +3518,46 @@ private:
         return m_audReadTask;
     }
 
-    void ReleaseResourceProc()
+    // One iteration of the loop releasing the decoding resources of an image, once the image is decoded
+    bool ReleaseResourceStep()
     {
-        if (!m_isImage)
-        {
-            m_logger->Log(VERBOSE) << "Quit 'ReleaseResourceProc()', this only works for IMAGE source." << endl;
-            return;
-        }
-        while (!m_quitThread)
+        bool imgEof = true;
         {
-            bool imgEof = true;
+            lock_guard<mutex> lk(m_bldtskByPriLock);
+            for (auto& tsk : m_bldtskPriOrder)
             {
-                lock_guard<mutex> lk(m_bldtskByPriLock);
-                GopDecodeTaskHolder nxttsk = nullptr;
-                for (auto& tsk : m_bldtskPriOrder)
+                if (!tsk->decodeStopped)
+                {
+                    imgEof = false;
+                    break;
+                }
+                for (auto& vf : tsk->vfAry)
                 {
-                    if (!tsk->decodeStopped)
+                    // if (!vf.ownfrm)
+                    if (vf.vmat.empty())
                     {
                         imgEof = false;
                         break;
                     }
-                    for (auto& vf : tsk->vfAry)
-                    {
-                        // if (!vf.ownfrm)
-                        if (vf.vmat.empty())
-                        {
-                            imgEof = false;
-                            break;
-                        }
-                    }
-                    if (!imgEof)
-                        break;
                 }
+                if (!imgEof)
+                    break;
             }
-            if (!m_prepared || !imgEof)
-                this_thread::sleep_for(chrono::milliseconds(100));
-            else
-                break;
-        }
-        if (!m_quitThread)
-        {
-            bool lockAquired = false;
-            while (!(lockAquired = m_apiLock.try_lock()) && !m_quitThread)
-                this_thread::sleep_for(chrono::milliseconds(5));
-            if (m_quitThread)
-            {
-                if (lockAquired) m_apiLock.unlock();
-                return;
-            }
-            lock_guard<recursive_mutex> lk(m_apiLock, adopt_lock);
-            m_logger->Log(DEBUG) << "AUTO RELEASE decoding resources." << endl;
-            ReleaseResources(true);
         }
+        if (!m_prepared || !imgEof)
+            return false;
+        // the api methods wait for the loops to stop with 'm_apiLock' held, so never block on it here
+        if (!m_apiLock.try_lock())
+            return false;
+        lock_guard<recursive_mutex> lk(m_apiLock, adopt_lock);
+        m_logger->Log(DEBUG) << "AUTO RELEASE decoding resources." << endl;
+        ReleaseResources();
+        return false;
     }
 
-    void ReleaseResources(bool callFromReleaseProc = false)
+    void ReleaseResources()
     {
-        WaitAllThreadsQuit(callFromReleaseProc);
+        WaitAllThreadsQuit();
         // DO NOT flush task queues here! Because ReadVideoFrame still need to find the target image frame in the queue.
         // This is only for IMAGE instance.
 
@@ -3422,6 +3603,10 @@ private:
     MediaParser::Holder m_hParser;
     MediaInfo::Holder m_hMediaInfo;
     MediaParser::SeekPointsHolder m_hSeekPoints;
+    // precise GOP layout derived from the video frame index, aligned with 'm_hSeekPoints'. empty if no frame index is available.
+    vector<GopPlan> m_vidGopPlans;
+    double m_minGopPlanIntvSec{0.5};
+    atomic_bool m_byteSeekable{false};
     bool m_opened{false};
     bool m_configured{false};
     bool m_streamInfoFound{false};
@@ -3462,18 +3647,20 @@ private:
     uint32_t m_outFrmSize{0};
     bool m_isOutFmtPlanar{false};
 
-    // demuxing thread
-    thread m_demuxThread;
-    // video decoding thread
-    thread m_viddecThread;
-    // update snapshots thread
-    thread m_genVfThread;
-    // audio decoding thread
-    thread m_auddecThread;
-    // swr thread
-    thread m_genAfThread;
-    // release resource thread
-    thread m_releaseThread;
+    TaskExecutor::Holder m_hExecutor;
+    // demuxing loop
+    TaskExecutor::Loop::Holder m_hDemuxLoop;
+    DemuxLoopState m_demuxState;
+    // video or audio decoding loop
+    TaskExecutor::Loop::Holder m_hDecodeLoop;
+    DecodeLoopState m_decodeState;
+    // update snapshots or swr loop
+    TaskExecutor::Loop::Holder m_hGenFrameLoop;
+    GopDecodeTaskHolder m_genFrameTask;
+    // release resource loop
+    TaskExecutor::Loop::Holder m_hReleaseLoop;
+    // wake-up signal for the readers waiting on output frames
+    BroadcastSignal m_frameReadySignal;
 
     int64_t m_prevReadPos{0};
     ImGui::ImMat m_prevReadImg;
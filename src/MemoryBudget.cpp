@@ -0,0 +1,359 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <algorithm>
+#include <utility>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
+#include "MemoryBudget.h"
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+static uint64_t GetPhysicalMemorySize()
+{
+#if defined(_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? (uint64_t)status.ullTotalPhys : 0;
+#elif defined(__APPLE__)
+    int64_t memSize = 0;
+    size_t len = sizeof(memSize);
+    return sysctlbyname("hw.memsize", &memSize, &len, nullptr, 0) == 0 ? (uint64_t)memSize : 0;
+#else
+    const long pageCount = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    return pageCount > 0 && pageSize > 0 ? (uint64_t)pageCount*pageSize : 0;
+#endif
+}
+
+class MemoryBudget_Impl : public MemoryBudget, public enable_shared_from_this<MemoryBudget_Impl>
+{
+public:
+    MemoryBudget_Impl(uint64_t maxBytes, const string& name)
+        : m_limit(maxBytes), m_name(name.empty() ? "MemBudget" : name)
+    {
+        m_logger = GetLogger("MemBudget");
+    }
+
+    MemoryBudget_Impl(const MemoryBudget_Impl&) = delete;
+    MemoryBudget_Impl(MemoryBudget_Impl&&) = delete;
+    MemoryBudget_Impl& operator=(const MemoryBudget_Impl&) = delete;
+
+    virtual ~MemoryBudget_Impl() {}
+
+    Consumer::Holder Register(const string& name, QuotaCallback onQuotaChanged) override
+    {
+        auto pConsumer = new Consumer_Impl(shared_from_this(), name, onQuotaChanged);
+        {
+            lock_guard<mutex> lk(m_lock);
+            m_consumers.push_back(pConsumer);
+        }
+        m_logger->Log(DEBUG) << "[" << m_name << "] Consumer '" << name << "' is registered." << endl;
+        Rebalance();
+        return Consumer::Holder(pConsumer, [] (Consumer* p) {
+            Consumer_Impl* ptr = dynamic_cast<Consumer_Impl*>(p);
+            auto owner = ptr->owner;
+            ptr->Unregister();
+            delete ptr;
+            // the released quota goes to the other consumers
+            owner->Rebalance();
+        });
+    }
+
+    void SetLimit(uint64_t maxBytes) override
+    {
+        m_limit = maxBytes;
+        Rebalance();
+    }
+
+    uint64_t GetLimit() const override
+    {
+        return m_limit;
+    }
+
+    uint64_t GetTotalUsage() const override
+    {
+        lock_guard<mutex> lk(m_lock);
+        uint64_t total = 0;
+        for (auto pConsumer : m_consumers)
+            total += pConsumer->usage;
+        return total;
+    }
+
+    vector<ConsumerStats> GetStats() const override
+    {
+        const auto now = Clock::now();
+        lock_guard<mutex> lk(m_lock);
+        vector<ConsumerStats> stats;
+        stats.reserve(m_consumers.size());
+        for (auto pConsumer : m_consumers)
+        {
+            ConsumerStats s;
+            s.name = pConsumer->name;
+            s.priority = pConsumer->priority;
+            s.demand = pConsumer->demand;
+            s.usage = pConsumer->usage;
+            s.quota = pConsumer->quota;
+            s.idleMillisec = chrono::duration_cast<chrono::milliseconds>(now-pConsumer->lastTouch).count();
+            stats.push_back(s);
+        }
+        return stats;
+    }
+
+    void SetLogLevel(Level l) override
+    {
+        m_logger->SetShowLevels(l);
+    }
+
+private:
+    using Clock = chrono::steady_clock;
+
+    struct Consumer_Impl final : public Consumer
+    {
+        Consumer_Impl(shared_ptr<MemoryBudget_Impl> _owner, const string& _name, QuotaCallback _onQuotaChanged)
+            : owner(_owner), name(_name), onQuotaChanged(_onQuotaChanged), lastTouch(Clock::now())
+        {}
+
+        void SetDemand(uint64_t bytes) override
+        {
+            {
+                lock_guard<mutex> lk(owner->m_lock);
+                if (demand == bytes)
+                    return;
+                demand = bytes;
+            }
+            owner->Rebalance();
+        }
+
+        void UpdateUsage(uint64_t bytes) override
+        {
+            {
+                lock_guard<mutex> lk(owner->m_lock);
+                usage = bytes;
+            }
+            owner->RebalanceIfOutdated();
+        }
+
+        void SetPriority(Priority _priority) override
+        {
+            {
+                lock_guard<mutex> lk(owner->m_lock);
+                if (priority == _priority)
+                    return;
+                priority = _priority;
+            }
+            owner->Rebalance();
+        }
+
+        void Touch() override
+        {
+            bool wasRecent;
+            {
+                lock_guard<mutex> lk(owner->m_lock);
+                const auto now = Clock::now();
+                wasRecent = now-lastTouch < RECENT_USE_PERIOD;
+                lastTouch = now;
+            }
+            if (!wasRecent)
+                owner->Rebalance();
+            else
+                owner->RebalanceIfOutdated();
+        }
+
+        uint64_t GetQuota() const override
+        {
+            return quota;
+        }
+
+        string GetName() const override
+        {
+            return name;
+        }
+
+        void Unregister()
+        {
+            {
+                lock_guard<mutex> lk(owner->m_lock);
+                auto iter = find(owner->m_consumers.begin(), owner->m_consumers.end(), this);
+                if (iter != owner->m_consumers.end())
+                    owner->m_consumers.erase(iter);
+            }
+            // wait for the quota callbacks in progress
+            lock_guard<mutex> lk(owner->m_callbackLock);
+            onQuotaChanged = nullptr;
+        }
+
+        shared_ptr<MemoryBudget_Impl> owner;
+        string name;
+        QuotaCallback onQuotaChanged;
+        Priority priority{PRIORITY_NORMAL};
+        uint64_t demand{0};
+        uint64_t usage{0};
+        atomic<uint64_t> quota{UINT64_MAX};
+        uint64_t newQuota{0};
+        Clock::time_point lastTouch;
+    };
+
+    double GetWeight(const Consumer_Impl* pConsumer, const Clock::time_point& now) const
+    {
+        static const double PRIORITY_WEIGHTS[PRIORITY_COUNT] = { 8., 2., 1. };
+        double weight = PRIORITY_WEIGHTS[pConsumer->priority];
+        const auto idleTime = now-pConsumer->lastTouch;
+        if (idleTime < RECENT_USE_PERIOD)
+            weight *= 4;
+        else if (idleTime < RECENT_USE_PERIOD*10)
+            weight *= 2;
+        return weight;
+    }
+
+    void RebalanceIfOutdated()
+    {
+        {
+            lock_guard<mutex> lk(m_lock);
+            if (Clock::now()-m_lastRebalance < RECENT_USE_PERIOD)
+                return;
+        }
+        Rebalance();
+    }
+
+    // Split the limit with weighted max-min fairness: a consumer demanding less than its weighted share gets its
+    // whole demand, the rest of the limit is shared among the other consumers by their weights.
+    void Rebalance()
+    {
+        list<pair<Consumer_Impl*, uint64_t>> changedQuotas;
+        {
+            lock_guard<mutex> lk(m_lock);
+            const auto now = Clock::now();
+            m_lastRebalance = now;
+            const uint64_t limit = m_limit;
+            list<pair<Consumer_Impl*, double>> pending;
+            for (auto pConsumer : m_consumers)
+            {
+                if (limit == 0)
+                    pConsumer->newQuota = UINT64_MAX;
+                else if (pConsumer->demand == 0)
+                    pConsumer->newQuota = 0;
+                else
+                    pending.push_back({pConsumer, GetWeight(pConsumer, now)});
+            }
+            double remaining = (double)limit;
+            while (!pending.empty())
+            {
+                double totalWeight = 0;
+                for (const auto& elem : pending)
+                    totalWeight += elem.second;
+                double satisfiedBytes = 0;
+                auto iter = pending.begin();
+                while (iter != pending.end())
+                {
+                    const double share = remaining*iter->second/totalWeight;
+                    if ((double)iter->first->demand <= share)
+                    {
+                        iter->first->newQuota = iter->first->demand;
+                        satisfiedBytes += (double)iter->first->demand;
+                        iter = pending.erase(iter);
+                    }
+                    else
+                        iter++;
+                }
+                if (satisfiedBytes == 0)
+                {
+                    for (const auto& elem : pending)
+                        elem.first->newQuota = (uint64_t)(remaining*elem.second/totalWeight);
+                    break;
+                }
+                remaining = max(remaining-satisfiedBytes, 0.);
+            }
+            for (auto pConsumer : m_consumers)
+            {
+                if (pConsumer->quota != pConsumer->newQuota)
+                {
+                    pConsumer->quota = pConsumer->newQuota;
+                    changedQuotas.push_back({pConsumer, pConsumer->newQuota});
+                }
+            }
+        }
+
+        if (changedQuotas.empty())
+            return;
+        lock_guard<mutex> lk(m_callbackLock);
+        for (const auto& elem : changedQuotas)
+        {
+            {
+                // skip the consumers unregistered meanwhile
+                lock_guard<mutex> lk2(m_lock);
+                if (find(m_consumers.begin(), m_consumers.end(), elem.first) == m_consumers.end())
+                    continue;
+            }
+            m_logger->Log(VERBOSE) << "[" << m_name << "] Quota of '" << elem.first->name << "' is changed to " << elem.second << " bytes." << endl;
+            if (elem.first->onQuotaChanged)
+                elem.first->onQuotaChanged(elem.second);
+        }
+    }
+
+private:
+    static const Clock::duration RECENT_USE_PERIOD;
+
+    ALogger* m_logger;
+    atomic<uint64_t> m_limit;
+    string m_name;
+    list<Consumer_Impl*> m_consumers;
+    mutable mutex m_lock;
+    mutex m_callbackLock;
+    Clock::time_point m_lastRebalance;
+};
+
+const MemoryBudget_Impl::Clock::duration MemoryBudget_Impl::RECENT_USE_PERIOD = chrono::seconds(1);
+
+static const auto MEMORY_BUDGET_DELETER = [] (MemoryBudget* p) {
+    MemoryBudget_Impl* ptr = dynamic_cast<MemoryBudget_Impl*>(p);
+    delete ptr;
+};
+
+MemoryBudget::Holder MemoryBudget::CreateInstance(uint64_t maxBytes, const string& name)
+{
+    return MemoryBudget::Holder(new MemoryBudget_Impl(maxBytes, name), MEMORY_BUDGET_DELETER);
+}
+
+static MemoryBudget::Holder _DEFAULT_MEMORY_BUDGET;
+static mutex _DEFAULT_MEMORY_BUDGET_ACCESS_LOCK;
+
+MemoryBudget::Holder MemoryBudget::GetDefaultInstance()
+{
+    lock_guard<mutex> lk(_DEFAULT_MEMORY_BUDGET_ACCESS_LOCK);
+    if (!_DEFAULT_MEMORY_BUDGET)
+    {
+        const uint64_t physMemSize = GetPhysicalMemorySize();
+        const uint64_t minLimit = 1024ULL*1024*1024;
+        _DEFAULT_MEMORY_BUDGET = MemoryBudget::CreateInstance(max(physMemSize/4, minLimit), "McMemBudget");
+    }
+    return _DEFAULT_MEMORY_BUDGET;
+}
+}
@@ -0,0 +1,316 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <algorithm>
+#include "MixedFrameCache.h"
+#include "FramePool.h"
+
+using namespace std;
+
+namespace MediaCore
+{
+///////////////////////////////////////////////////////////////////////////////////////////
+// Lossless frame compression
+///////////////////////////////////////////////////////////////////////////////////////////
+// Every byte is predicted by the same byte of the left pixel, then the residuals are run-length coded. A control byte
+// 0x80|(n-1) means n zero residuals, a control byte (n-1) is followed by n literal residuals, n is up to 128.
+// It's cheap and compresses the flat areas well, the natural images are mostly stored as is.
+static bool EncodeFrameBytes(const uint8_t* src, size_t size, size_t pixelBytes, vector<uint8_t>& out, size_t maxOutSize)
+{
+    out.clear();
+    out.reserve(min(size, maxOutSize)/4);
+    auto residual = [src, pixelBytes] (size_t i) {
+        return i < pixelBytes ? src[i] : (uint8_t)(src[i]-src[i-pixelBytes]);
+    };
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t run = 0;
+        while (i+run < size && run < 128 && residual(i+run) == 0)
+            run++;
+        if (run >= 2)
+        {
+            out.push_back((uint8_t)(0x80|(run-1)));
+            i += run;
+        }
+        else
+        {
+            // the literal run ends before two successive zero residuals
+            const size_t start = i;
+            size_t count = 0;
+            while (i < size && count < 128)
+            {
+                if (i+1 < size && residual(i) == 0 && residual(i+1) == 0)
+                    break;
+                i++; count++;
+            }
+            out.push_back((uint8_t)(count-1));
+            for (size_t j = start; j < start+count; j++)
+                out.push_back(residual(j));
+        }
+        if (out.size() > maxOutSize)
+            return false;
+    }
+    return true;
+}
+
+static bool DecodeFrameBytes(const vector<uint8_t>& packed, uint8_t* dst, size_t size, size_t pixelBytes)
+{
+    const uint8_t* p = packed.data();
+    const uint8_t* pEnd = p+packed.size();
+    size_t i = 0;
+    while (p < pEnd)
+    {
+        const uint8_t ctrl = *p++;
+        const size_t count = (ctrl&0x7f)+1;
+        if (i+count > size)
+            return false;
+        if (ctrl&0x80)
+        {
+            memset(dst+i, 0, count);
+        }
+        else
+        {
+            if (p+count > pEnd)
+                return false;
+            memcpy(dst+i, p, count);
+            p += count;
+        }
+        i += count;
+    }
+    if (i != size)
+        return false;
+    for (i = pixelBytes; i < size; i++)
+        dst[i] += dst[i-pixelBytes];
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// MixedFrameCache
+///////////////////////////////////////////////////////////////////////////////////////////
+MixedFrameCache::MixedFrameCache(const string& name)
+    : m_name(name)
+{}
+
+void MixedFrameCache::SetCapacity(uint64_t maxBytes)
+{
+    lock_guard<mutex> lk(m_lock);
+    m_capacity = maxBytes;
+    if (maxBytes > 0)
+    {
+        if (!m_hMemConsumer)
+        {
+            m_hMemConsumer = MemoryBudget::GetDefaultInstance()->Register(m_name, [this] (uint64_t quota) {
+                m_quota = quota;
+            });
+            m_quota = m_hMemConsumer->GetQuota();
+        }
+        m_hMemConsumer->SetDemand(maxBytes);
+        EvictOverLimit();
+    }
+    else
+    {
+        m_entries.clear();
+        m_entryTable.clear();
+        m_bytes = m_rawBytes = 0;
+        m_hMemConsumer = nullptr;
+        m_quota = UINT64_MAX;
+    }
+}
+
+bool MixedFrameCache::Get(int64_t frameIndex, uint64_t contentHash, ImGui::ImMat& vmat)
+{
+    if (m_capacity == 0)
+        return false;
+    lock_guard<mutex> lk(m_lock);
+    // the quota may be reduced by the memory budget
+    if (m_bytes > m_quota)
+    {
+        EvictOverLimit();
+        UpdateMemoryUsage();
+    }
+    auto iter = m_entryTable.find(frameIndex);
+    if (iter == m_entryTable.end() || iter->second->contentHash != contentHash)
+    {
+        m_missCount++;
+        return false;
+    }
+    auto entryIter = iter->second;
+    if (!entryIter->frame.empty())
+    {
+        vmat = entryIter->frame;
+    }
+    else if (!Unpack(*entryIter, vmat))
+    {
+        EraseEntry(entryIter);
+        UpdateMemoryUsage();
+        m_missCount++;
+        return false;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, entryIter);
+    m_hitCount++;
+    if (m_hMemConsumer)
+        m_hMemConsumer->Touch();
+    return true;
+}
+
+void MixedFrameCache::Put(int64_t frameIndex, uint64_t contentHash, const ImGui::ImMat& vmat)
+{
+    if (m_capacity == 0 || vmat.empty())
+        return;
+    Entry entry;
+    entry.frameIndex = frameIndex;
+    entry.contentHash = contentHash;
+    entry.w = vmat.w; entry.h = vmat.h; entry.c = vmat.c;
+    entry.dtype = vmat.type;
+    entry.colorFormat = vmat.color_format;
+    entry.colorSpace = vmat.color_space;
+    entry.colorRange = vmat.color_range;
+    entry.rawBytes = (uint64_t)vmat.total()*vmat.elemsize;
+    // compress outside the lock
+    if (m_compress && Pack(entry, vmat))
+    {
+        entry.bytes = entry.packed.size();
+    }
+    else
+    {
+        entry.frame = vmat;
+        entry.bytes = entry.rawBytes;
+    }
+    if (entry.bytes > min((uint64_t)m_capacity, (uint64_t)m_quota))
+        return;
+
+    lock_guard<mutex> lk(m_lock);
+    auto iter = m_entryTable.find(frameIndex);
+    if (iter != m_entryTable.end())
+        EraseEntry(iter->second);
+    m_bytes += entry.bytes;
+    m_rawBytes += entry.rawBytes;
+    m_entries.push_front(std::move(entry));
+    m_entryTable[frameIndex] = m_entries.begin();
+    EvictOverLimit();
+    UpdateMemoryUsage();
+}
+
+size_t MixedFrameCache::RemoveStale(const function<uint64_t(int64_t frameIndex)>& getHash)
+{
+    vector<pair<int64_t, uint64_t>> keys;
+    {
+        lock_guard<mutex> lk(m_lock);
+        keys.reserve(m_entries.size());
+        for (const auto& entry : m_entries)
+            keys.push_back({entry.frameIndex, entry.contentHash});
+    }
+    // the hashes are calculated without holding the lock, since they need to lock the tracks
+    vector<pair<int64_t, uint64_t>> staleKeys;
+    for (const auto& key : keys)
+    {
+        if (getHash(key.first) != key.second)
+            staleKeys.push_back(key);
+    }
+    if (staleKeys.empty())
+        return 0;
+    size_t removedCount = 0;
+    lock_guard<mutex> lk(m_lock);
+    for (const auto& key : staleKeys)
+    {
+        auto iter = m_entryTable.find(key.first);
+        if (iter != m_entryTable.end() && iter->second->contentHash == key.second)
+        {
+            EraseEntry(iter->second);
+            removedCount++;
+        }
+    }
+    UpdateMemoryUsage();
+    return removedCount;
+}
+
+void MixedFrameCache::Clear()
+{
+    lock_guard<mutex> lk(m_lock);
+    m_entries.clear();
+    m_entryTable.clear();
+    m_bytes = m_rawBytes = 0;
+    UpdateMemoryUsage();
+}
+
+MultiTrackVideoReader::FrameCacheStats MixedFrameCache::GetStats() const
+{
+    lock_guard<mutex> lk(m_lock);
+    MultiTrackVideoReader::FrameCacheStats stats;
+    stats.hitCount = m_hitCount;
+    stats.missCount = m_missCount;
+    stats.frameCount = (uint32_t)m_entries.size();
+    stats.bytes = m_bytes;
+    stats.rawBytes = m_rawBytes;
+    return stats;
+}
+
+bool MixedFrameCache::Pack(Entry& entry, const ImGui::ImMat& vmat)
+{
+    if (vmat.device != IM_DD_CPU)
+        return false;
+    // only keep the compressed data if it saves a quarter of the memory at least
+    const size_t rawSize = (size_t)entry.rawBytes;
+    if (!EncodeFrameBytes((const uint8_t*)vmat.data, rawSize, (size_t)vmat.c*vmat.elemsize, entry.packed, rawSize/4*3))
+    {
+        entry.packed.clear();
+        return false;
+    }
+    entry.packed.shrink_to_fit();
+    return true;
+}
+
+bool MixedFrameCache::Unpack(const Entry& entry, ImGui::ImMat& vmat)
+{
+    ImGui::ImMat unpacked;
+    if (!FramePool::GetDefaultInstance()->AcquireMat(unpacked, entry.w, entry.h, entry.c, entry.dtype))
+        return false;
+    if (!DecodeFrameBytes(entry.packed, (uint8_t*)unpacked.data, (size_t)entry.rawBytes, (size_t)unpacked.c*unpacked.elemsize))
+        return false;
+    unpacked.color_format = entry.colorFormat;
+    unpacked.color_space = entry.colorSpace;
+    unpacked.color_range = entry.colorRange;
+    vmat = unpacked;
+    return true;
+}
+
+void MixedFrameCache::EraseEntry(EntryList::iterator iter)
+{
+    m_bytes -= iter->bytes;
+    m_rawBytes -= iter->rawBytes;
+    m_entryTable.erase(iter->frameIndex);
+    m_entries.erase(iter);
+}
+
+void MixedFrameCache::EvictOverLimit()
+{
+    const uint64_t limit = min((uint64_t)m_capacity, (uint64_t)m_quota);
+    while (!m_entries.empty() && m_bytes > limit)
+    {
+        auto iter = m_entries.end(); iter--;
+        EraseEntry(iter);
+    }
+}
+
+void MixedFrameCache::UpdateMemoryUsage()
+{
+    if (m_hMemConsumer)
+        m_hMemConsumer->UpdateUsage(m_bytes);
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <immat.h>
+#include "MultiTrackVideoReader.h"
+#include "MemoryBudget.h"
+
+namespace MediaCore
+{
+// LRU cache of the mixed frames of 'MultiTrackVideoReader', it also holds the filtered frames of 'VideoClip'. Every frame
+// index holds one entry, which is returned only if its content hash is equal to the one computed from the current state.
+// The size is limited by the capacity and by the quota from the default 'MemoryBudget', the least recently used frames
+// are evicted first. The cpu frames can be stored with a lossless compression, which saves the memory of the frames
+// with flat areas, e.g. letterbox or title cards.
+class MixedFrameCache
+{
+public:
+    MixedFrameCache(const std::string& name);
+    MixedFrameCache(const MixedFrameCache&) = delete;
+    MixedFrameCache& operator=(const MixedFrameCache&) = delete;
+
+    // 'maxBytes' = 0 disables the cache
+    void SetCapacity(uint64_t maxBytes);
+    uint64_t GetCapacity() const { return m_capacity; }
+    bool IsEnabled() const { return m_capacity > 0; }
+    void EnableCompression(bool enable) { m_compress = enable; }
+    bool IsCompressionEnabled() const { return m_compress; }
+
+    bool Get(int64_t frameIndex, uint64_t contentHash, ImGui::ImMat& vmat);
+    void Put(int64_t frameIndex, uint64_t contentHash, const ImGui::ImMat& vmat);
+    // Remove the frames whose content hash is different from the one returned by 'getHash'. Return the count of the removed frames.
+    size_t RemoveStale(const std::function<uint64_t(int64_t frameIndex)>& getHash);
+    void Clear();
+    MultiTrackVideoReader::FrameCacheStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        int64_t frameIndex;
+        uint64_t contentHash;
+        ImGui::ImMat frame;             // the frame stored as is, it's empty if the frame is compressed
+        std::vector<uint8_t> packed;    // the compressed frame
+        int w, h, c;
+        ImDataType dtype;
+        ImColorFormat colorFormat;
+        ImColorSpace colorSpace;
+        ImColorRange colorRange;
+        uint64_t rawBytes;
+        uint64_t bytes;
+    };
+    using EntryList = std::list<Entry>;
+
+    static bool Pack(Entry& entry, const ImGui::ImMat& vmat);
+    static bool Unpack(const Entry& entry, ImGui::ImMat& vmat);
+    // 'm_lock' must be locked by the caller
+    void EraseEntry(EntryList::iterator iter);
+    void EvictOverLimit();
+    void UpdateMemoryUsage();
+
+private:
+    std::string m_name;
+    std::atomic<uint64_t> m_capacity{0};
+    std::atomic<uint64_t> m_quota{UINT64_MAX};
+    std::atomic_bool m_compress{false};
+    // the most recently used entry is at the front
+    EntryList m_entries;
+    std::unordered_map<int64_t, EntryList::iterator> m_entryTable;
+    uint64_t m_bytes{0};
+    uint64_t m_rawBytes{0};
+    uint64_t m_hitCount{0};
+    uint64_t m_missCount{0};
+    MemoryBudget::Consumer::Holder m_hMemConsumer;
+    mutable std::mutex m_lock;
+};
+}
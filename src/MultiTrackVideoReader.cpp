@@ -23,8 +23,11 @@
 #include <iomanip>
 #include "MultiTrackVideoReader.h"
 #include "VideoBlender.h"
+#include "MixedFrameCache.h"
+#include "HashUtils.h"
 #include "FFUtils.h"
 #include "ThreadUtils.h"
+#include "ThreadSignal.h"
 #include "DebugHelper.h"
 
 using namespace std;
@@ -161,6 +164,7 @@ public:
         }
 
         StartMixingThread();
+        m_frameCache.SetCapacity(m_frameCacheCapacity);
 
         m_started = true;
         return true;
@@ -170,8 +174,11 @@ public:
     {
         lock_guard<recursive_mutex> lk(m_apiLock);
         TerminateMixingThread();
+        m_frameCache.SetCapacity(0);
+        m_trackRevisions.clear();
 
         m_tracks.clear();
+        m_mixBlenders.clear();
         m_mixFrameTasks.clear();
         m_seekingTasks.clear();
         m_prevOutFrame = nullptr;
@@ -406,6 +413,7 @@ public:
         m_readFrameIdx = MillsecToFrameIndex(pos, 1);
         AddSeekingTask(m_readFrameIdx);
         m_inSeeking = true;
+        NotifyMixingThreads();
         return true;
     }
 
@@ -421,6 +429,9 @@ public:
         m_inSeeking = false;
         int step = m_readForward ? 1 : -1;
         auto reuseTask = ExtractSeekingTask(m_readFrameIdx);
+        // a scrubbing task may still output a preview, only reuse it if the exact frame is already mixed
+        if (reuseTask && reuseTask->scrubbing && (!reuseTask->outputReady || reuseTask->outputIsPreview))
+            reuseTask = nullptr;
         if (reuseTask && reuseTask->TriggerStart())
         {
             AddMixFrameTask(reuseTask, true);
@@ -436,10 +447,16 @@ public:
 
     bool SetTrackVisible(int64_t id, bool visible) override
     {
+        lock_guard<recursive_mutex> lk(m_apiLock);
         auto track = GetTrackById(id, false);
         if (track)
         {
+            // the frames being mixed are not cached, their content hashes are calculated with the previous visibility
+            m_cacheGeneration++;
             track->SetVisible(visible);
+            // the tracks under a hidden track may be uncovered
+            if (m_started && (UpdateOcclusion() || HasStaleCachedTasks()))
+                SeekToByIdx(m_readFrameIdx);
             return true;
         }
         ostringstream oss;
@@ -633,6 +650,15 @@ public:
         if (updateDuration)
             UpdateDuration();
 
+        // the caller doesn't tell what is changed, it may be a parameter inside a filter which is not covered by the
+        // content hashes, so the cached frames of all the tracks are invalidated
+        m_cacheGeneration++;
+        {
+            lock_guard<recursive_mutex> trackLk(m_trackLock);
+            for (auto& trk : m_tracks)
+                m_trackRevisions[trk->Id()]++;
+        }
+        RemoveStaleCachedFrames();
         SeekToByIdx(m_readFrameIdx);
         return true;
     }
@@ -646,6 +672,11 @@ public:
             return false;
         }
 
+        // the changes inside the filters are not covered by the content hashes, the track revisions are hashed instead
+        m_cacheGeneration++;
+        for (const auto trkid : trackIds)
+            m_trackRevisions[trkid]++;
+        RemoveStaleCachedFrames();
         {
             lock_guard<recursive_mutex> lk2(m_mixFrameTasksLock);
             for (auto& mft : m_mixFrameTasks)
@@ -664,9 +695,18 @@ public:
                     }
                 }
                 if (foundTrack)
-                    mft->outputReady = false;
+                {
+                    mft->ResetOutput();
+                    // in case the reprocessed frames are already done
+                    mft->OnOutputFrameReady();
+                }
             }
         }
+        // the refreshed tracks may not cover the tracks under them any more, whose frames are not read.
+        // the frames from the cache have no read frame task to reprocess, they must be read again.
+        if (UpdateOcclusion() || HasStaleCachedTasks())
+            return SeekToByIdx(m_readFrameIdx);
+        NotifyMixingThreads();
         return true;
     }
 
@@ -696,6 +736,8 @@ public:
         }
 
         TerminateMixingThread();
+        m_cacheGeneration++;
+        m_frameCache.Clear();
         for (auto& hTrack : m_tracks)
             hTrack->UpdateSettings(hSettings);
         m_hSettings->SyncVideoSettingsFrom(hSettings.get());
@@ -716,6 +758,89 @@ public:
             hTrack->SetPreReadMaxNum(szCacheNum);
     }
 
+    void SetMixingConcurrency(uint32_t concurrency) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (concurrency == 0)
+            concurrency = 1;
+        if (concurrency == m_mixingConcurrency)
+            return;
+        if (m_started)
+        {
+            TerminateMixingThread();
+            m_mixingConcurrency = concurrency;
+            StartMixingThread();
+        }
+        else
+        {
+            m_mixingConcurrency = concurrency;
+        }
+    }
+
+    uint32_t GetMixingConcurrency() const override
+    {
+        return m_mixingConcurrency;
+    }
+
+    void EnableOcclusionCulling(bool enable) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (m_occlusionCulling == enable)
+            return;
+        m_occlusionCulling = enable;
+        // the occluded tasks have no frame to mix
+        if (!enable && m_started && UpdateOcclusion())
+            SeekToByIdx(m_readFrameIdx);
+    }
+
+    bool IsOcclusionCullingEnabled() const override
+    {
+        return m_occlusionCulling;
+    }
+
+    void EnableScrubbingPreview(bool enable) override
+    {
+        m_scrubbingPreview = enable;
+    }
+
+    bool IsScrubbingPreviewEnabled() const override
+    {
+        return m_scrubbingPreview;
+    }
+
+    void SetFrameCacheCapacity(uint64_t maxBytes) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_frameCacheCapacity = maxBytes;
+        if (m_started)
+            m_frameCache.SetCapacity(maxBytes);
+    }
+
+    uint64_t GetFrameCacheCapacity() const override
+    {
+        return m_frameCacheCapacity;
+    }
+
+    void EnableFrameCacheCompression(bool enable) override
+    {
+        m_frameCache.EnableCompression(enable);
+    }
+
+    bool IsFrameCacheCompressionEnabled() const override
+    {
+        return m_frameCache.IsCompressionEnabled();
+    }
+
+    FrameCacheStats GetFrameCacheStats() const override
+    {
+        return m_frameCache.GetStats();
+    }
+
+    void ClearFrameCache() override
+    {
+        m_frameCache.Clear();
+    }
+
     uint32_t TrackCount() const override
     {
         return m_tracks.size();
@@ -978,9 +1103,11 @@ private:
                 m_prevOutFrame = hCandiFrame;
                 frames = hCandiFrame->GetOutputFrames();
             }
-            else if (!m_seekingFlash.empty())
+            else
             {
-                frames = m_seekingFlash;
+                lock_guard<mutex> lk(m_seekingFlashLock);
+                if (!m_seekingFlash.empty())
+                    frames = m_seekingFlash;
             }
         }
         else
@@ -1011,7 +1138,8 @@ private:
                 {
                     while (!m_quit)
                     {
-                        this_thread::sleep_for(chrono::milliseconds(5));
+                        // taken before checking the task, so the notification of its output is not missed
+                        const auto readySeq = m_outputReadySignal.Sequence();
                         hCandiFrame = FindCandidateAndRemoveDeprecatedTasks(frameIndex, precise);
                         if (!hCandiFrame)
                         {
@@ -1022,6 +1150,7 @@ private:
                         }
                         else if (hCandiFrame->outputReady)
                             break;
+                        m_outputReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
                     }
                 }
                 if (hCandiFrame)
@@ -1043,17 +1172,43 @@ private:
         m_quit = false;
         m_mixingThread = thread(&MultiTrackVideoReader_Impl::MixingThreadProc, this);
         SysUtils::SetThreadName(m_mixingThread, "MtvMixing");
-        m_mixingThread2 = thread(&MultiTrackVideoReader_Impl::MixingThreadProc2, this);
-        SysUtils::SetThreadName(m_mixingThread2, "MtvMixing2");
+        // every mixing worker owns a blender, since 'VideoBlender' is not thread-safe
+        m_mixBlenders.resize(m_mixingConcurrency);
+        m_mixBlenders[0] = m_hMixBlender;
+        for (uint32_t i = 0; i < m_mixingConcurrency; i++)
+        {
+            if (!m_mixBlenders[i])
+                m_mixBlenders[i] = VideoBlender::CreateInstance();
+            if (!m_mixBlenders[i])
+            {
+                m_logger->Log(Error) << "CANNOT create new 'VideoBlender' instance for mixing worker #" << i << "!" << endl;
+                break;
+            }
+            m_mixingThreads2.push_back(thread(&MultiTrackVideoReader_Impl::MixingThreadProc2, this, m_mixBlenders[i]));
+            ostringstream oss; oss << "MtvMixing2-" << i;
+            SysUtils::SetThreadName(m_mixingThreads2.back(), oss.str());
+        }
     }
 
     void TerminateMixingThread()
     {
         m_quit = true;
+        NotifyMixingThreads();
+        m_outputReadySignal.Notify();
         if (m_mixingThread.joinable())
             m_mixingThread.join();
-        if (m_mixingThread2.joinable())
-            m_mixingThread2.join();
+        for (auto& t : m_mixingThreads2)
+        {
+            if (t.joinable())
+                t.join();
+        }
+        m_mixingThreads2.clear();
+    }
+
+    void NotifyMixingThreads()
+    {
+        m_mixingSignal.Notify();
+        m_mixingSignal2.Notify();
     }
 
     struct MixFrameTask : public ReadFrameTask::Callback
@@ -1072,22 +1227,95 @@ private:
         }
 
         int64_t frameIndex;
+        // the order in which the tasks are created, it follows the frame index in playback and the requests in seeking
+        uint64_t seqNo{0};
         vector<pair<VideoTrack::Holder, ReadFrameTask::Holder>> readFrameTaskTable;
         bool processingStarted{false};
-        bool outputReady{false};
+        atomic_bool outputReady{false};
+        atomic_bool mixingStarted{false};
+        // increased by 'ResetOutput()', a mixing thread drops its result if this is changed since the task is claimed
+        atomic_uint32_t mixGeneration{0};
+        // set by the read-frame-task callbacks, so the mixing threads needn't poll every track
+        atomic_bool allSourceReady{false};
+        atomic_bool allOutputReady{false};
+        atomic_bool tableReady{false};
+        ThreadSignal* pSourceReadySignal{nullptr};
+        ThreadSignal* pOutputReadySignal{nullptr};
+        TimePoint createTime{GetTimePoint()};
+        // the read frame tasks of a scrubbing task may output the previews, see 'ReadFrameTask::IsPreview()'
+        bool scrubbing{false};
+        // the output is mixed from the previews, it's mixed again after all of them are refined
+        atomic_bool outputIsPreview{false};
+        // key of the frame cache, 0 means the output is not cached. 'cacheGeneration' is the value of 'm_cacheGeneration'
+        // when the hash is calculated, the output is not cached if the timeline is changed since then.
+        uint64_t contentHash{0};
+        uint32_t cacheGeneration{0};
+        bool fromCache{false};
         atomic_uint8_t state{0};  // lsb#1 means this task is dropped, lsb#2 means this task is started
         static const uint8_t DROP_BIT, START_BIT;
 
         bool IsProcessingStarted() const { return processingStarted; }
 
+        bool NeedRefine() const
+        {
+            if (!outputReady || !outputIsPreview)
+                return false;
+            for (auto& elem : readFrameTaskTable)
+            {
+                if (elem.second->IsPreview() || !elem.second->IsOutputFrameReady())
+                    return false;
+            }
+            return true;
+        }
+
+        // Invoked after 'readFrameTaskTable' is filled, the callbacks are ignored before that.
+        void SetTaskTableReady()
+        {
+            tableReady = true;
+            OnSourceFrameReady();
+            OnOutputFrameReady();
+        }
+
+        void OnSourceFrameReady() override
+        {
+            if (!tableReady || allSourceReady)
+                return;
+            for (auto& elem : readFrameTaskTable)
+            {
+                if (!elem.second->IsSourceFrameReady())
+                    return;
+            }
+            if (!allSourceReady.exchange(true) && pSourceReadySignal)
+                pSourceReadySignal->Notify();
+        }
+
+        void OnOutputFrameReady() override
+        {
+            if (!tableReady)
+                return;
+            if (allOutputReady)
+            {
+                if (NeedRefine() && pOutputReadySignal)
+                    pOutputReadySignal->Notify();
+                return;
+            }
+            for (auto& elem : readFrameTaskTable)
+            {
+                if (!elem.second->IsOutputFrameReady())
+                    return;
+            }
+            if (!allOutputReady.exchange(true) && pOutputReadySignal)
+                pOutputReadySignal->Notify();
+        }
+
         void StartProcessing()
         {
+            processingStarted = true;
             for (auto& elem : readFrameTaskTable)
             {
                 auto& rft = elem.second;
                 rft->StartProcessing();
             }
-            processingStarted = true;
         }
 
         bool TriggerDrop() override
@@ -1126,6 +1354,38 @@ private:
         void UpdateOutputFrames(const vector<CorrelativeVideoFrame::Holder>& corVidFrames) override
         {
             lock_guard<mutex> lg(m_mtxOutputFrames);
+            UpdateOutputFrames_Locked(corVidFrames);
+        }
+
+        // Invoked when the source frames are reprocessed, the task is mixed again. A mixing thread which is blending
+        // the old frames at the moment won't publish its result, see 'PublishMixedFrame()'.
+        void ResetOutput()
+        {
+            lock_guard<mutex> lg(m_mtxOutputFrames);
+            mixGeneration++;
+            outputReady = false;
+            allOutputReady = false;
+            mixingStarted = false;
+        }
+
+        // Return false if the task is reset after 'generation' is taken, then the mixed frame is dropped.
+        bool PublishMixedFrame(uint32_t generation, const CorrelativeVideoFrame::Holder& hCorVfrm, bool isPreview)
+        {
+            lock_guard<mutex> lg(m_mtxOutputFrames);
+            if (generation != mixGeneration)
+                return false;
+            UpdateOutputFrames_Locked({ hCorVfrm });
+            outputIsPreview = isPreview;
+            outputReady = true;
+            // a preview output is claimed again to be refined
+            if (isPreview)
+                mixingStarted = false;
+            return true;
+        }
+
+    private:
+        void UpdateOutputFrames_Locked(const vector<CorrelativeVideoFrame::Holder>& corVidFrames)
+        {
             for (const auto& elem : corVidFrames)
             {
                 auto iter = find(m_outputFrames.begin(), m_outputFrames.end(), elem);
@@ -1141,7 +1401,6 @@ private:
             }
         }
 
-    private:
         vector<CorrelativeVideoFrame::Holder> m_outputFrames;
         mutex m_mtxOutputFrames;
     };
@@ -1249,14 +1508,31 @@ private:
             }
             hTask = MixFrameTask::Holder(new MixFrameTask());
             hTask->frameIndex = frameIndex;
-            for (auto& trk : tracks)
+            hTask->seqNo = ++m_mixTaskSeqNo;
+            hTask->pSourceReadySignal = &m_mixingSignal;
+            hTask->pOutputReadySignal = &m_mixingSignal2;
+            if (!LoadCachedFrame(hTask, tracks))
             {
-                auto rft = trk->CreateReadFrameTask(frameIndex, canDrop, needSeek || needClearTaskList, false, dynamic_cast<ReadFrameTask::Callback*>(hTask.get()));
-                rft->SetVisible(trk->IsVisible());
-                hTask->readFrameTaskTable.push_back({trk, rft});
+                // the tracks are not read for the cached frames, they must be sought before reading the next frame
+                const bool seekTracks = needSeek || needClearTaskList || m_seekAfterCacheHit;
+                m_seekAfterCacheHit = false;
+                // the tracks are ordered from top to bottom, the ones under a covering track are occluded
+                bool covered = false;
+                for (auto& trk : tracks)
+                {
+                    const bool occluded = covered;
+                    if (!covered && m_occlusionCulling)
+                        covered = trk->IsCoveringCanvas(frameIndex);
+                    auto rft = trk->CreateReadFrameTask(frameIndex, canDrop, seekTracks, false, dynamic_cast<ReadFrameTask::Callback*>(hTask.get()));
+                    rft->SetVisible(trk->IsVisible());
+                    rft->SetOccluded(occluded);
+                    hTask->readFrameTaskTable.push_back({trk, rft});
+                }
             }
+            hTask->SetTaskTableReady();
             m_logger->Log(DEBUG) << "++ AddMixFrameTask: frameIndex=" << frameIndex << ", canDrop=" << canDrop << endl;
             m_mixFrameTasks.push_back(hTask);
+            m_mixingSignal.Notify();
         }
         else
         {
@@ -1269,10 +1545,13 @@ private:
     {
         int64_t frameIndex = hMft->frameIndex;
         lock_guard<recursive_mutex> lk(m_mixFrameTasksLock);
+        if (hMft->fromCache)
+            m_seekAfterCacheHit = true;
         if (clearBeforeAdd)
         {
             ClearAllMixFrameTasks();
             m_mixFrameTasks.push_back(hMft);
+            m_mixingSignal.Notify();
             m_logger->Log(DEBUG) << "++ AddMixFrameTask[2-0]: frameIndex=" << frameIndex << endl;
         }
         else
@@ -1293,6 +1572,7 @@ private:
 
                 m_logger->Log(DEBUG) << "++ AddMixFrameTask[2-1]: frameIndex=" << frameIndex << endl;
                 m_mixFrameTasks.push_back(hMft);
+                m_mixingSignal.Notify();
             }
             else
             {
@@ -1302,6 +1582,116 @@ private:
         return hMft;
     }
 
+    // Update the occluded state of the read frame tasks in the mix frame task list.
+    // Return true if any occluded task is uncovered, its source frame has not been read.
+    bool UpdateOcclusion()
+    {
+        lock_guard<recursive_mutex> lk(m_mixFrameTasksLock);
+        bool hasUncovered = false;
+        for (auto& mft : m_mixFrameTasks)
+        {
+            bool covered = false;
+            for (auto& elem : mft->readFrameTaskTable)
+            {
+                auto& trk = elem.first;
+                auto& rft = elem.second;
+                if (covered)
+                    rft->SetOccluded(true);
+                else if (rft->IsOccluded())
+                    hasUncovered = true;
+                if (!covered && m_occlusionCulling)
+                    covered = trk->IsCoveringCanvas(mft->frameIndex);
+            }
+        }
+        return hasUncovered;
+    }
+
+    // Hash of the visible contents at 'frameIndex', it's the key of the frame cache together with the frame index.
+    // The tracks with no clip at the frame are skipped, so a change of such tracks doesn't invalidate the cached frame.
+    uint64_t CalcFrameContentHash(int64_t frameIndex, const list<VideoTrack::Holder>& tracks)
+    {
+        uint64_t hash = HashCombine((uint64_t)m_hSettings->VideoOutWidth(), (uint64_t)m_hSettings->VideoOutHeight());
+        hash = HashCombine(hash, (uint64_t)m_hSettings->VideoOutDataType());
+        for (auto& trk : tracks)
+        {
+            if (!trk->IsVisible())
+                continue;
+            const uint64_t trkHash = trk->GetContentHash(frameIndex);
+            if (trkHash == 0)
+                continue;
+            hash = HashCombine(hash, (uint64_t)trk->Id());
+            auto iter = m_trackRevisions.find(trk->Id());
+            if (iter != m_trackRevisions.end())
+                hash = HashCombine(hash, (uint64_t)iter->second);
+            hash = HashCombine(hash, trkHash);
+        }
+        // 0 is reserved for the tasks whose output is not cached
+        return hash != 0 ? hash : 1;
+    }
+
+    // Calculate the content hash of 'hTask', and fill its output with the cached frame if there is one. Return true on cache hit.
+    bool LoadCachedFrame(MixFrameTask::Holder hTask, const list<VideoTrack::Holder>& tracks)
+    {
+        if (!m_frameCache.IsEnabled())
+            return false;
+        hTask->cacheGeneration = m_cacheGeneration;
+        hTask->contentHash = CalcFrameContentHash(hTask->frameIndex, tracks);
+        ImGui::ImMat vmat;
+        if (!m_frameCache.Get(hTask->frameIndex, hTask->contentHash, vmat))
+            return false;
+        SetMixedFrameAttributes(vmat, hTask->frameIndex);
+        hTask->UpdateOutputFrames({ CorrelativeVideoFrame::Holder(new CorrelativeVideoFrame(CorrelativeFrame::PHASE_AFTER_MIXING, 0, 0, VideoFrame::CreateMatInstance(vmat))) });
+        hTask->fromCache = true;
+        hTask->outputReady = true;
+        m_seekAfterCacheHit = true;
+        m_logger->Log(DEBUG) << "++ Read frameIndex=" << hTask->frameIndex << " from the frame cache." << endl;
+        m_outputReadySignal.Notify();
+        return true;
+    }
+
+    // Return true if any task in the mix frame task list is filled from the cache, but its content is changed.
+    bool HasStaleCachedTasks()
+    {
+        list<VideoTrack::Holder> tracks;
+        {
+            lock_guard<recursive_mutex> trackLk(m_trackLock);
+            tracks = m_tracks;
+        }
+        lock_guard<recursive_mutex> lk(m_mixFrameTasksLock);
+        for (auto& mft : m_mixFrameTasks)
+        {
+            if (mft->fromCache && CalcFrameContentHash(mft->frameIndex, tracks) != mft->contentHash)
+                return true;
+        }
+        return false;
+    }
+
+    void RemoveStaleCachedFrames()
+    {
+        if (!m_frameCache.IsEnabled())
+            return;
+        list<VideoTrack::Holder> tracks;
+        {
+            lock_guard<recursive_mutex> trackLk(m_trackLock);
+            tracks = m_tracks;
+        }
+        const auto removedCount = m_frameCache.RemoveStale([this, &tracks] (int64_t frameIndex) {
+            return CalcFrameContentHash(frameIndex, tracks);
+        });
+        if (removedCount > 0)
+            m_logger->Log(DEBUG) << "Removed " << removedCount << " stale frames from the frame cache." << endl;
+    }
+
+    void SetMixedFrameAttributes(ImGui::ImMat& vmat, int64_t frameIndex)
+    {
+        const auto frameRate = m_hSettings->VideoOutFrameRate();
+        vmat.time_stamp = (double)frameIndex*frameRate.den/frameRate.num;
+        vmat.flags |= IM_MAT_FLAGS_VIDEO_FRAME;
+        vmat.rate.num = frameRate.num;
+        vmat.rate.den = frameRate.den;
+        vmat.index_count = frameIndex;
+    }
+
     void ClearAllMixFrameTasks()
     {
         if (m_mixFrameTasks.empty())
@@ -1381,13 +1771,29 @@ private:
             }
             hTask = MixFrameTask::Holder(new MixFrameTask());
             hTask->frameIndex = frameIndex;
-            for (auto& trk : tracks)
+            hTask->seqNo = ++m_mixTaskSeqNo;
+            hTask->pSourceReadySignal = &m_mixingSignal;
+            hTask->pOutputReadySignal = &m_mixingSignal2;
+            hTask->scrubbing = m_scrubbingPreview;
+            // the seeking tasks bypass the background nodes of the filters, their outputs are read from the cache but not put into it
+            if (!LoadCachedFrame(hTask, tracks))
             {
-                auto rft = trk->CreateReadFrameTask(frameIndex, true, true, true, dynamic_cast<ReadFrameTask::Callback*>(hTask.get()));
-                hTask->readFrameTaskTable.push_back({trk, rft});
+                hTask->contentHash = 0;
+                bool covered = false;
+                for (auto& trk : tracks)
+                {
+                    const bool occluded = covered;
+                    if (!covered && m_occlusionCulling)
+                        covered = trk->IsCoveringCanvas(frameIndex);
+                    auto rft = trk->CreateReadFrameTask(frameIndex, true, true, true, dynamic_cast<ReadFrameTask::Callback*>(hTask.get()), hTask->scrubbing);
+                    rft->SetOccluded(occluded);
+                    hTask->readFrameTaskTable.push_back({trk, rft});
+                }
             }
+            hTask->SetTaskTableReady();
             m_logger->Log(DEBUG) << "++ AddSeekingTask: frameIndex=" << frameIndex << endl;
             m_seekingTasks.push_back(hTask);
+            m_mixingSignal.Notify();
         }
         else
         {
@@ -1452,6 +1858,54 @@ private:
         }
     }
 
+    // Return true if any task is started. 'taskList' must be locked by the caller.
+    bool StartProcessingSourceReadyTasks(list<MixFrameTask::Holder>& taskList)
+    {
+        bool anyStarted = false;
+        for (auto& mft : taskList)
+        {
+            if (mft->outputReady || mft->IsProcessingStarted() || !mft->allSourceReady)
+                continue;
+            for (auto& elem : mft->readFrameTaskTable)
+            {
+                auto& rft = elem.second;
+                rft->UpdateHostFrames();
+            }
+            mft->StartProcessing();
+            anyStarted = true;
+        }
+        return anyStarted;
+    }
+
+    // Claim the first task whose outputs are all ready, or whose preview output can be refined. 'hasMore' tells if
+    // there are other tasks to be mixed, 'generation' receives the 'mixGeneration' of the claimed task. 'taskList'
+    // must be locked by the caller.
+    MixFrameTask::Holder ClaimOutputReadyTask(list<MixFrameTask::Holder>& taskList, bool& hasMore, uint32_t& generation)
+    {
+        MixFrameTask::Holder hTask;
+        hasMore = false;
+        for (auto& mft : taskList)
+        {
+            if (mft->mixingStarted || !mft->IsProcessingStarted() || !mft->allOutputReady)
+                continue;
+            if (mft->outputReady && !mft->NeedRefine())
+                continue;
+            if (hTask)
+            {
+                hasMore = true;
+                break;
+            }
+            // taken before the claim, a reset in between makes the result stale
+            const uint32_t gen = mft->mixGeneration;
+            if (!mft->mixingStarted.exchange(true))
+            {
+                hTask = mft;
+                generation = gen;
+            }
+        }
+        return hTask;
+    }
+
     void MixingThreadProc()
     {
         m_logger->Log(DEBUG) << "Enter MixingThreadProc(VIDEO)..." << endl;
@@ -1466,7 +1920,6 @@ private:
         {
             bool idleLoop = true;
 
-            list<MixFrameTask::Holder> mixFrameTasks;
             if (m_inSeeking)
             {
                 if (prevInSeekingState != m_inSeeking)
@@ -1478,7 +1931,7 @@ private:
                 // auto statusLog = PrintMixFrameTaskListStatus(m_seekingTasks, "SeekingTasks");
                 // m_logger->Log(DEBUG) << statusLog << endl;
                 RemoveDiscardedTasks(m_seekingTasks);
-                mixFrameTasks = m_seekingTasks;
+                idleLoop = !StartProcessingSourceReadyTasks(m_seekingTasks);
             }
             else
             {
@@ -1491,46 +1944,21 @@ private:
                 // auto statusLog = PrintMixFrameTaskListStatus(m_mixFrameTasks, "MixFrameTasks");
                 // m_logger->Log(DEBUG) << statusLog << endl;
                 RemoveDiscardedTasks(m_mixFrameTasks);
-                mixFrameTasks = m_mixFrameTasks;
-            }
-            auto mftIter = mixFrameTasks.begin();
-            while (mftIter != mixFrameTasks.end())
-            {
-                auto& mft = *mftIter++;
-                if (mft->outputReady || mft->IsProcessingStarted())
-                    continue;
-
-                bool allSourceReady = true;
-                for (auto& elem : mft->readFrameTaskTable)
-                {
-                    auto& rft = elem.second;
-                    if (!rft->IsSourceFrameReady())
-                    {
-                        allSourceReady = false;
-                        break;
-                    }
-                }
-                if (!allSourceReady)
-                    continue;
-
-                for (auto& elem : mft->readFrameTaskTable)
-                {
-                    auto& rft = elem.second;
-                    rft->UpdateHostFrames();
-                }
-
-                mft->StartProcessing();
-                idleLoop = false;
+                idleLoop = !StartProcessingSourceReadyTasks(m_mixFrameTasks);
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_mixingSignal.WaitFor(THREAD_IDLE_TIME);
+            else
+                m_mixingSignal2.Notify();
         }
 
         m_logger->Log(DEBUG) << "Leave MixingThreadProc(VIDEO)." << endl;
     }
 
-    void MixingThreadProc2()
+    // Several 'MixingThreadProc2' may run concurrently, each one mixes a different task with its own blender.
+    // The frames are still handed out in order, since the readers wait for the task of the requested frame index.
+    void MixingThreadProc2(VideoBlender::Holder hMixBlender)
     {
         m_logger->Log(DEBUG) << "Enter MixingThreadProc2(VIDEO)..." << endl;
 
@@ -1544,47 +1972,38 @@ private:
         {
             bool idleLoop = true;
 
-            list<MixFrameTask::Holder> mixFrameTasks;
+            // only pick the first task whose outputs are all ready, instead of copying the task list
+            MixFrameTask::Holder mft;
+            bool hasMore;
+            uint32_t mixGen = 0;
             if (m_inSeeking)
             {
                 lock_guard<mutex> lk(m_seekingTasksLock);
-                mixFrameTasks = m_seekingTasks;
+                mft = ClaimOutputReadyTask(m_seekingTasks, hasMore, mixGen);
             }
             else
             {
                 lock_guard<recursive_mutex> lk(m_mixFrameTasksLock);
-                mixFrameTasks = m_mixFrameTasks;
+                mft = ClaimOutputReadyTask(m_mixFrameTasks, hasMore, mixGen);
             }
-            auto mftIter = mixFrameTasks.begin();
-            while (mftIter != mixFrameTasks.end())
+            // wake up another worker for the rest tasks
+            if (hasMore)
+                m_mixingSignal2.Notify();
+            if (mft)
             {
-                auto& mft = *mftIter++;
-                if (mft->outputReady || !mft->IsProcessingStarted())
-                    continue;
-
-                bool allProcessed = true;
-                for (auto& elem : mft->readFrameTaskTable)
-                {
-                    auto& rft = elem.second;
-                    if (!rft->IsOutputFrameReady())
-                    {
-                        allProcessed = false;
-                        break;
-                    }
-                }
-                if (!allProcessed)
-                    continue;
-
                 for (auto& elem : mft->readFrameTaskTable)
                 {
                     auto& rft = elem.second;
                     rft->UpdateHostFrames();
                 }
 
-                ImGui::ImMat mixedFrame;
+                // collect the visible layers from bottom to top, then blend them all in one pass
                 double timestamp = (double)mft->frameIndex*frameRate.den/frameRate.num;
+                vector<VideoBlender::Layer> layers;
+                layers.reserve(mft->readFrameTaskTable.size());
                 auto rftIter = mft->readFrameTaskTable.rbegin();
                 int mixFrameCnt = 0;
+                bool isPreview = false;
                 while (rftIter != mft->readFrameTaskTable.rend())
                 {
                     auto elem = *rftIter++;
@@ -1593,28 +2012,25 @@ private:
                     VideoFrame::Holder hVfrm;
                     if (trk->IsVisible())
                     {
-                        hVfrm = rft->GetVideoFrame();
+                        // checked before taking the frame, a preview may be refined meanwhile
+                        if (rft->IsPreview())
+                            isPreview = true;
+                        if (!rft->IsOccluded())
+                            hVfrm = rft->GetVideoFrame();
                         mixFrameCnt++;
                     }
-                    ImGui::ImMat vmat;
-                    if (hVfrm) hVfrm->GetMat(vmat);
-                    if (!vmat.empty())
+                    VideoBlender::Layer layer;
+                    if (hVfrm) hVfrm->GetMat(layer.image);
+                    if (!layer.image.empty())
                     {
-                        const auto fOpacity = hVfrm->Opacity();
-                        if (mixedFrame.empty() && fOpacity < 1.f)
-                        {
-                            mixedFrame.create_type(outWidth, outHeight, 4, matDtype);
-                            memset(mixedFrame.data, 0, mixedFrame.total()*mixedFrame.elemsize);
-                        }
-                        if (mixedFrame.empty())
-                            mixedFrame = vmat;
-                        else
-                            mixedFrame = m_hMixBlender->Blend(mixedFrame, vmat, fOpacity);
-                        if (abs(timestamp-vmat.time_stamp) > 0.001)
+                        layer.opacity = hVfrm->Opacity();
+                        if (abs(timestamp-layer.image.time_stamp) > 0.001)
                             m_logger->Log(WARN) << "'vmat' read from track #" << trk->Id() << " has WRONG TIMESTAMP! timestamp("
-                                << timestamp << ") != vmat(" << vmat.time_stamp << ")." << endl;
+                                << timestamp << ") != vmat(" << layer.image.time_stamp << ")." << endl;
+                        layers.push_back(layer);
                     }
                 }
+                ImGui::ImMat mixedFrame = hMixBlender->BlendLayers(layers, outWidth, outHeight, matDtype);
 
                 const bool bMixedFrameIsEmpty = mixedFrame.empty();
                 if (bMixedFrameIsEmpty)
@@ -1622,22 +2038,36 @@ private:
                     mixedFrame.create_type(outWidth, outHeight, 4, matDtype);
                     memset(mixedFrame.data, 0, mixedFrame.total()*mixedFrame.elemsize);
                 }
-                mixedFrame.time_stamp = timestamp;
-                mixedFrame.flags |= IM_MAT_FLAGS_VIDEO_FRAME;
-                mixedFrame.rate.num = frameRate.num;
-                mixedFrame.rate.den = frameRate.den;
-                mixedFrame.index_count = mft->frameIndex;
-                mft->UpdateOutputFrames({ CorrelativeVideoFrame::Holder(new CorrelativeVideoFrame(CorrelativeFrame::PHASE_AFTER_MIXING, 0, 0, VideoFrame::CreateMatInstance(mixedFrame))) });
-                mft->outputReady = true;
+                SetMixedFrameAttributes(mixedFrame, mft->frameIndex);
+                CorrelativeVideoFrame::Holder hMixedVfrm(new CorrelativeVideoFrame(CorrelativeFrame::PHASE_AFTER_MIXING, 0, 0, VideoFrame::CreateMatInstance(mixedFrame)));
+                if (!mft->PublishMixedFrame(mixGen, hMixedVfrm, isPreview))
+                {
+                    // the track view is refreshed while blending, the task is mixed again from the reprocessed frames
+                    m_logger->Log(DEBUG) << "Drop the stale mixed frame at frameIndex=" << mft->frameIndex << "." << endl;
+                    m_mixingSignal2.Notify();
+                    continue;
+                }
                 if (mixFrameCnt == 0 || !bMixedFrameIsEmpty)
-                    m_seekingFlash = mft->GetOutputFrames();
-                m_logger->Log(DEBUG) << "---------> Got mixed frame at frameIndex=" << mft->frameIndex << ", pos=" << (int64_t)(timestamp*1000) << endl;
+                {
+                    // the mixing threads may finish the tasks out of order, an older frame must not replace the flash
+                    lock_guard<mutex> lk(m_seekingFlashLock);
+                    if (mft->seqNo >= m_seekingFlashSeqNo)
+                    {
+                        m_seekingFlash = mft->GetOutputFrames();
+                        m_seekingFlashSeqNo = mft->seqNo;
+                    }
+                }
+                m_logger->Log(DEBUG) << "---------> Got mixed frame at frameIndex=" << mft->frameIndex << ", pos=" << (int64_t)(timestamp*1000)
+                        << ", latency=" << CountElapsedMillisec(mft->createTime, GetTimePoint()) << "ms" << (isPreview ? " (preview)" : "") << endl;
+                m_outputReadySignal.Notify();
+                // put into the cache after the output is notified, it may take a while to compress the frame
+                if (mft->contentHash != 0 && mft->cacheGeneration == m_cacheGeneration && !isPreview)
+                    m_frameCache.Put(mft->frameIndex, mft->contentHash, mixedFrame);
                 idleLoop = false;
-                break;
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_mixingSignal2.WaitFor(THREAD_IDLE_TIME);
         }
 
         m_logger->Log(DEBUG) << "Leave MixingThreadProc2(VIDEO)." << endl;
@@ -1736,10 +2166,24 @@ private:
     recursive_mutex m_apiLock;
 
     thread m_mixingThread;
-    thread m_mixingThread2;
+    vector<thread> m_mixingThreads2;
+    uint32_t m_mixingConcurrency{1};
+    bool m_occlusionCulling{true};
+    atomic_bool m_scrubbingPreview{true};
+    MixedFrameCache m_frameCache{"MtvFrameCache"};
+    uint64_t m_frameCacheCapacity{0};
+    // increased before the timeline changes which are not covered by the content hashes, e.g. the track visibility
+    atomic_uint32_t m_cacheGeneration{0};
+    // revisions of the tracks refreshed by 'Refresh()' and 'RefreshTrackView()'
+    unordered_map<int64_t, uint32_t> m_trackRevisions;
+    bool m_seekAfterCacheHit{false};
+    ThreadSignal m_mixingSignal;
+    ThreadSignal m_mixingSignal2;
+    BroadcastSignal m_outputReadySignal;
     list<VideoTrack::Holder> m_tracks;
     recursive_mutex m_trackLock;
     VideoBlender::Holder m_hMixBlender;
+    vector<VideoBlender::Holder> m_mixBlenders;
 
     list<MixFrameTask::Holder> m_mixFrameTasks;
     size_t m_szCacheFrameNum{1};
@@ -1749,6 +2193,9 @@ private:
     list<MixFrameTask::Holder> m_seekingTasks;
     mutex m_seekingTasksLock;
     vector<CorrelativeFrame> m_seekingFlash;
+    uint64_t m_seekingFlashSeqNo{0};
+    mutex m_seekingFlashLock;
+    atomic<uint64_t> m_mixTaskSeqNo{0};
 
     SharedSettings::Holder m_hSettings;
     Ratio m_outFrameRate;
@@ -1790,6 +2237,11 @@ MultiTrackVideoReader::Holder MultiTrackVideoReader_Impl::CloneAndConfigure(Shar
         newInstance->Close(); delete newInstance;
         return nullptr;
     }
+    newInstance->m_mixingConcurrency = m_mixingConcurrency;
+    newInstance->m_occlusionCulling = m_occlusionCulling;
+    newInstance->m_scrubbingPreview = m_scrubbingPreview.load();
+    newInstance->m_frameCacheCapacity = m_frameCacheCapacity;
+    newInstance->m_frameCache.EnableCompression(m_frameCache.IsCompressionEnabled());
 
     // clone all the video tracks
     {
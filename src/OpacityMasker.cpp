@@ -0,0 +1,226 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "OpacityMasker.h"
+#include "CpuFeatures.h"
+
+
+using namespace std;
+
+namespace MediaCore
+{
+// rounded v/255 for v in [0, 255*255]
+static inline uint32_t Div255(uint32_t v)
+{
+    v += 128;
+    return (v+(v>>8))>>8;
+}
+
+static void MaxRow_C(uint8_t* acc, const uint8_t* src, int count)
+{
+    for (int i = 0; i < count; i++)
+        acc[i] = max(acc[i], src[i]);
+}
+
+static void ScaleAlphaRow_C(uint8_t* rgba, const uint8_t* weights, uint32_t opacity, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t* a = rgba+(size_t)i*4+3;
+        *a = (uint8_t)Div255(Div255((uint32_t)*a*weights[i])*opacity);
+    }
+}
+
+#if MC_CPU_X86
+MC_TARGET("sse4.1") static void MaxRow_SSE4(uint8_t* acc, const uint8_t* src, int count)
+{
+    int i = 0;
+    for (; i+16 <= count; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(acc+i));
+        const __m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+        _mm_storeu_si128((__m128i*)(acc+i), _mm_max_epu8(a, s));
+    }
+    MaxRow_C(acc+i, src+i, count-i);
+}
+
+// 32-bit lanes holding values in [0, 255*255]
+MC_TARGET("sse4.1") static inline __m128i Div255_SSE4(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_set1_epi32(128));
+    return _mm_srli_epi32(_mm_add_epi32(v, _mm_srli_epi32(v, 8)), 8);
+}
+
+// 4 pixels per iteration, the alpha and the weight of a pixel are held by one 32-bit lane
+MC_TARGET("sse4.1") static void ScaleAlphaRow_SSE4(uint8_t* rgba, const uint8_t* weights, uint32_t opacity, int count)
+{
+    const __m128i vOpacity = _mm_set1_epi32((int)opacity);
+    const __m128i vColorMask = _mm_set1_epi32(0x00ffffff);
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        int32_t w4;
+        memcpy(&w4, weights+i, 4);
+        const __m128i w = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(w4));
+        const __m128i px = _mm_loadu_si128((const __m128i*)(rgba+(size_t)i*4));
+        __m128i a = _mm_srli_epi32(px, 24);
+        // the products fit in the low 16 bits of the lanes
+        a = Div255_SSE4(_mm_mullo_epi16(a, w));
+        a = Div255_SSE4(_mm_mullo_epi16(a, vOpacity));
+        _mm_storeu_si128((__m128i*)(rgba+(size_t)i*4), _mm_or_si128(_mm_and_si128(px, vColorMask), _mm_slli_epi32(a, 24)));
+    }
+    ScaleAlphaRow_C(rgba+(size_t)i*4, weights+i, opacity, count-i);
+}
+#endif
+
+#if MC_CPU_NEON
+static void MaxRow_NEON(uint8_t* acc, const uint8_t* src, int count)
+{
+    int i = 0;
+    for (; i+16 <= count; i += 16)
+        vst1q_u8(acc+i, vmaxq_u8(vld1q_u8(acc+i), vld1q_u8(src+i)));
+    MaxRow_C(acc+i, src+i, count-i);
+}
+
+static inline uint8x8_t Div255_NEON(uint16x8_t v)
+{
+    return vraddhn_u16(v, vrshrq_n_u16(v, 8));
+}
+
+static void ScaleAlphaRow_NEON(uint8_t* rgba, const uint8_t* weights, uint32_t opacity, int count)
+{
+    const uint8x8_t vOpacity = vdup_n_u8((uint8_t)opacity);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        uint8x8x4_t px = vld4_u8(rgba+(size_t)i*4);
+        const uint8x8_t a = Div255_NEON(vmull_u8(px.val[3], vld1_u8(weights+i)));
+        px.val[3] = Div255_NEON(vmull_u8(a, vOpacity));
+        vst4_u8(rgba+(size_t)i*4, px);
+    }
+    ScaleAlphaRow_C(rgba+(size_t)i*4, weights+i, opacity, count-i);
+}
+#endif
+
+OpacityMasker::OpacityMasker()
+{
+    m_kernelName = "C";
+    m_maxRow = MaxRow_C;
+    m_scaleAlphaRow = ScaleAlphaRow_C;
+#if MC_CPU_X86
+    static const bool s_hasSse41 = CpuHasSse41();
+    if (s_hasSse41)
+    {
+        m_kernelName = "SSE4.1";
+        m_maxRow = MaxRow_SSE4;
+        m_scaleAlphaRow = ScaleAlphaRow_SSE4;
+    }
+#elif MC_CPU_NEON
+    m_kernelName = "NEON";
+    m_maxRow = MaxRow_NEON;
+    m_scaleAlphaRow = ScaleAlphaRow_NEON;
+#endif
+}
+
+OpacityMasker::Rect OpacityMasker::CalcBounds(const ImGui::ImMat& mask)
+{
+    Rect bounds;
+    if (mask.empty() || mask.device != IM_DD_CPU || mask.c != 1 || mask.type != IM_DT_INT8)
+        return bounds;
+    int x0 = mask.w, x1 = 0, y0 = -1, y1 = -1;
+    for (int y = 0; y < mask.h; y++)
+    {
+        const uint8_t* row = (const uint8_t*)mask.data+(size_t)y*mask.w;
+        int x = 0;
+        while (x < mask.w && row[x] == 0)
+            x++;
+        if (x == mask.w)
+            continue;
+        x0 = min(x0, x);
+        // only the columns out of the bounds found so far need to be scanned from the right
+        x = mask.w;
+        while (x > x1 && row[x-1] == 0)
+            x--;
+        x1 = max(x1, x);
+        if (y0 < 0)
+            y0 = y;
+        y1 = y+1;
+    }
+    if (y0 < 0)
+        return bounds;
+    bounds.x = x0; bounds.y = y0;
+    bounds.w = x1-x0; bounds.h = y1-y0;
+    return bounds;
+}
+
+bool OpacityMasker::Apply(ImGui::ImMat& rgba, const vector<Mask>& masks, float opacity, TaskExecutor::Holder hExecutor)
+{
+    if (rgba.empty() || rgba.device != IM_DD_CPU || rgba.c != 4 || rgba.type != IM_DT_INT8)
+    {
+        m_errMsg = "INVALID argument! 'rgba' must be a 4-channel cpu image of type INT8.";
+        return false;
+    }
+    // the bounds clipped by the image, the empty ones are skipped
+    vector<pair<const Mask*, Rect>> validMasks;
+    for (const auto& mask : masks)
+    {
+        const auto& image = mask.image;
+        if (image.empty() || image.device != IM_DD_CPU || image.c != 1 || image.type != IM_DT_INT8 || image.w != rgba.w || image.h != rgba.h)
+        {
+            m_errMsg = "ONLY support masks in cpu memory, which are single channel images of type INT8 and of the same size as 'rgba'!";
+            return false;
+        }
+        Rect rect;
+        rect.x = max(mask.bounds.x, 0);
+        rect.y = max(mask.bounds.y, 0);
+        rect.w = min(mask.bounds.x+mask.bounds.w, rgba.w)-rect.x;
+        rect.h = min(mask.bounds.y+mask.bounds.h, rgba.h)-rect.y;
+        if (rect.w > 0 && rect.h > 0)
+            validMasks.push_back({&mask, rect});
+    }
+
+    const uint32_t u32Opacity = (uint32_t)roundf(min(max(opacity, 0.f), 1.f)*255.f);
+    const size_t rowSize = (size_t)rgba.w*4;
+    const int bandCount = (rgba.h+CPU_KERNEL_BAND_ROWS-1)/CPU_KERNEL_BAND_ROWS;
+    TaskExecutor::ParallelFor(hExecutor, bandCount, [&] (const TaskExecutor::ItemFetcher& fetchBand) {
+        vector<uint8_t> weights(rgba.w);
+        int32_t band;
+        while (fetchBand(band))
+        {
+            const int y0 = band*CPU_KERNEL_BAND_ROWS, y1 = min(y0+CPU_KERNEL_BAND_ROWS, rgba.h);
+            for (int y = y0; y < y1; y++)
+            {
+                memset(weights.data(), 0, weights.size());
+                for (const auto& item : validMasks)
+                {
+                    const Rect& rect = item.second;
+                    if (y < rect.y || y >= rect.y+rect.h)
+                        continue;
+                    const uint8_t* maskRow = (const uint8_t*)item.first->image.data+(size_t)y*rgba.w;
+                    m_maxRow(weights.data()+rect.x, maskRow+rect.x, rect.w);
+                }
+                m_scaleAlphaRow((uint8_t*)rgba.data+rowSize*y, weights.data(), u32Opacity, rgba.w);
+            }
+        }
+    });
+    return true;
+}
+}
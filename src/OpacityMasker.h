@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <immat.h>
+#include "TaskExecutor.h"
+
+namespace MediaCore
+{
+// Apply the opacity masks to the alpha channel of a RGBA image on cpu. The masks are combined by their maximum value,
+// and the alpha is scaled by the combined mask and the opacity in a single pass. The row kernels are chosen at runtime
+// by the cpu features (SSE4.1 or NEON), the scalar kernels are used if none of them is available.
+// The image must be of type IM_DT_INT8 with straight alpha, the masks are single channel images of type IM_DT_INT8.
+class OpacityMasker
+{
+public:
+    struct Rect
+    {
+        int32_t x{0};
+        int32_t y{0};
+        int32_t w{0};
+        int32_t h{0};
+    };
+
+    struct Mask
+    {
+        ImGui::ImMat image;
+        // the mask values out of this area are all 0, only the rows and the columns inside it are read
+        Rect bounds;
+    };
+
+    OpacityMasker();
+    OpacityMasker(const OpacityMasker&) = delete;
+    OpacityMasker& operator=(const OpacityMasker&) = delete;
+
+    // The bounding box of the non-zero values of a single channel INT8 image, it's empty if all the values are 0.
+    static Rect CalcBounds(const ImGui::ImMat& mask);
+
+    // 'masks' must have the same size as 'rgba', the alpha of the pixels out of all the masks' bounds becomes 0.
+    // Return false if the arguments are not supported, see 'GetError()'.
+    bool Apply(ImGui::ImMat& rgba, const std::vector<Mask>& masks, float opacity, TaskExecutor::Holder hExecutor = nullptr);
+
+    const char* GetKernelName() const { return m_kernelName; }
+    std::string GetError() const { return m_errMsg; }
+
+    using MaxRowFunc = void (*)(uint8_t* acc, const uint8_t* src, int count);
+    using ScaleAlphaRowFunc = void (*)(uint8_t* rgba, const uint8_t* weights, uint32_t opacity, int count);
+
+private:
+    const char* m_kernelName;
+    MaxRowFunc m_maxRow;
+    ScaleAlphaRowFunc m_scaleAlphaRow;
+    std::string m_errMsg;
+};
+}
@@ -26,6 +26,7 @@
 #include "FFUtils.h"
 #include "ThreadUtils.h"
 #include "ConditionalMutex.h"
+#include "ThreadSignal.h"
 extern "C"
 {
     #include "libavutil/avutil.h"
@@ -780,6 +781,12 @@ private:
     void WaitAllThreadsQuit(bool callFromReleaseProc = false)
     {
         m_quit = true;
+        m_demuxVidSignal.Notify();
+        m_viddecSignal.Notify();
+        m_genSsSignal.Notify();
+        m_demuxAudSignal.Notify();
+        m_auddecSignal.Notify();
+        m_genWfSignal.Notify();
         if (!callFromReleaseProc && m_releaseThread.joinable())
         {
             m_releaseThread.join();
@@ -946,6 +953,7 @@ private:
                                     lock_guard<mutex> lk(m_vidpktQLock);
                                     m_vidpktQ.push_back(enqpkt);
                                 }
+                                m_viddecSignal.Notify();
                                 av_packet_unref(&avpkt);
                                 avpktLoaded = false;
                                 idleLoop = idleLoop2 = false;
@@ -960,7 +968,7 @@ private:
                         }
                     }
                     if (idleLoop2)
-                        this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                        m_demuxVidSignal.WaitFor(THREAD_IDLE_TIME);
                 }
                 if (bEof)
                     break;
@@ -971,11 +979,12 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_demuxVidSignal.WaitFor(THREAD_IDLE_TIME);
         }
         if (avpktLoaded)
             av_packet_unref(&avpkt);
         m_demuxVidEof = true;
+        m_viddecSignal.Notify();
         m_logger->Log(DEBUG) << "Leave DemuxVideoThreadProc()." << endl;
     }
 
@@ -1048,13 +1057,14 @@ private:
                         lock_guard<mutex> lk(m_vidfrmQLock);
                         m_vidfrmQ.push_back(enqfrm);
                     }
+                    m_genSsSignal.Notify();
                     av_frame_unref(&avfrm);
                     avfrmLoaded = false;
                     idleLoop = idleLoop2 = false;
                 }
 
                 if (idleLoop2)
-                    this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                    m_viddecSignal.WaitFor(THREAD_IDLE_TIME);
             } while (hasOutput && !m_quit);
             if (quitLoop)
                 break;
@@ -1079,6 +1089,7 @@ private:
                             m_vidpktQ.pop_front();
                         }
                         av_packet_free(&avpkt);
+                        m_demuxVidSignal.Notify();
                         idleLoop = false;
                     }
                     else if (fferr != AVERROR(EAGAIN))
@@ -1102,9 +1113,10 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_viddecSignal.WaitFor(THREAD_IDLE_TIME);
         }
         m_viddecEof = true;
+        m_genSsSignal.Notify();
         m_logger->Log(DEBUG) << "Leave VideoDecodeThreadProc()." << endl;
     }
 
@@ -1181,6 +1193,7 @@ private:
                     lock_guard<mutex> lk(m_vidfrmQLock);
                     m_vidfrmQ.pop_front();
                 }
+                m_viddecSignal.Notify();
 
                 // do transpose if needed
                 if (m_hTransposeFilter)
@@ -1240,7 +1253,7 @@ private:
                 break;
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_genSsSignal.WaitFor(THREAD_IDLE_TIME);
         }
         FillBlankSsByDuplication();
 
@@ -1349,7 +1362,7 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_genSsSignal.WaitFor(THREAD_IDLE_TIME);
         }
 
         // wait for all decode context finish
@@ -1387,7 +1400,7 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_genSsSignal.WaitFor(THREAD_IDLE_TIME);
         }
 
         if (!m_quit)
@@ -1465,6 +1478,7 @@ private:
                             lock_guard<mutex> lk(m_audpktQLock);
                             m_audpktQ.push_back(enqpkt);
                         }
+                        m_auddecSignal.Notify();
                         av_packet_unref(&avpkt);
                         avpktLoaded = false;
                         idleLoop = false;
@@ -1478,13 +1492,14 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_demuxAudSignal.WaitFor(THREAD_IDLE_TIME);
         }
         if (avpktLoaded)
             av_packet_unref(&avpkt);
         if (avfmtCtx)
             avformat_close_input(&avfmtCtx);
         m_demuxAudEof = true;
+        m_auddecSignal.Notify();
         m_logger->Log(DEBUG) << "Leave DemuxAudioThreadProc()." << endl;
     }
 
@@ -1544,6 +1559,7 @@ private:
                         av_frame_unref(&avfrm);
                         avfrmLoaded = false;
                         idleLoop = false;
+                        m_genWfSignal.Notify();
                     }
                     else
                         break;
@@ -1567,6 +1583,7 @@ private:
                             m_audpktQ.pop_front();
                             av_packet_free(&avpkt);
                             idleLoop = false;
+                            m_demuxAudSignal.Notify();
                         }
                         else
                         {
@@ -1595,9 +1612,10 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_auddecSignal.WaitFor(THREAD_IDLE_TIME);
         }
         m_auddecEof = true;
+        m_genWfSignal.Notify();
         if (avfrmLoaded)
             av_frame_unref(&avfrm);
         m_logger->Log(DEBUG) << "Leave AudioDecodeThreadProc()." << endl;
@@ -1668,6 +1686,7 @@ private:
                     lock_guard<mutex> lk(m_audfrmQLock);
                     m_audfrmQ.pop_front();
                 }
+                m_auddecSignal.Notify();
 
                 float* ch1ptr = (float*)dstfrm->data[0];
                 float chMaxWf, chMinWf;
@@ -1756,7 +1775,7 @@ private:
                 break;
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_genWfSignal.WaitFor(THREAD_IDLE_TIME);
         }
         m_hWaveform->parseDone = true;
         m_genWfEof = true;
@@ -1882,16 +1901,19 @@ private:
     int m_vidpktQMaxSize{8};
     mutex m_vidpktQLock;
     bool m_demuxVidEof{false};
+    ThreadSignal m_demuxVidSignal;
     // video decoding thread
     thread m_viddecThread;
     list<AVFrame*> m_vidfrmQ;
     int m_vidfrmQMaxSize{4};
     mutex m_vidfrmQLock;
     bool m_viddecEof{false};
+    ThreadSignal m_viddecSignal;
     ConditionalMutex m_hwDecCtxLock;
     // generate snapshots thread
     thread m_genSsThread;
     bool m_genSsEof{false};
+    ThreadSignal m_genSsSignal;
     FFUtils::FFFilterGraph::Holder m_hTransposeFilter;
     // demux audio thread
     thread m_demuxAudThread;
@@ -1899,6 +1921,7 @@ private:
     int m_audpktQMaxSize{64};
     mutex m_audpktQLock;
     bool m_demuxAudEof{false};
+    ThreadSignal m_demuxAudSignal;
     // audio decoding thread
     thread m_auddecThread;
     list<AVFrame*> m_audfrmQ;
@@ -1908,10 +1931,12 @@ private:
     float m_audQDuration{5.f};
     mutex m_audfrmQLock;
     bool m_auddecEof{false};
+    ThreadSignal m_auddecSignal;
     // generate waveform samples thread
     thread m_genWfThread;
     bool m_swrPassThrough{false};
     bool m_genWfEof{false};
+    ThreadSignal m_genWfSignal;
     // thread to release computer resources after all snapshots are finished
     thread m_releaseThread;
 
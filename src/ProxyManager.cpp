@@ -0,0 +1,455 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "ProxyManager.h"
+#include "MediaReader.h"
+#include "MediaEncoder.h"
+#include "TaskExecutor.h"
+#include "MediaIndexCache.h"
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+static const char* PROXY_VIDEO_CODEC = "mjpeg";
+static const char* PROXY_FILE_EXTENSION = ".mkv";
+
+static bool IsFileExists(const string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (st.st_mode&S_IFREG) != 0;
+}
+
+class ProxyManager_Impl : public ProxyManager
+{
+public:
+    ProxyManager_Impl()
+    {
+        m_logger = GetLogger("ProxyMgr");
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
+    }
+
+    ProxyManager_Impl(const ProxyManager_Impl&) = delete;
+    ProxyManager_Impl(ProxyManager_Impl&&) = delete;
+    ProxyManager_Impl& operator=(const ProxyManager_Impl&) = delete;
+
+    virtual ~ProxyManager_Impl()
+    {
+        CancelAll();
+        unique_lock<mutex> lk(m_entriesLock);
+        m_runningTasks.Wait(lk);
+    }
+
+    void SetProxySize(uint32_t maxWidth, uint32_t maxHeight) override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        m_maxWidth = maxWidth;
+        m_maxHeight = maxHeight;
+    }
+
+    void GetProxySize(uint32_t& maxWidth, uint32_t& maxHeight) const override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        maxWidth = m_maxWidth;
+        maxHeight = m_maxHeight;
+    }
+
+    void EnableAutoGenerate(bool enable) override
+    {
+        m_autoGenerate = enable;
+    }
+
+    bool IsAutoGenerateEnabled() const override
+    {
+        return m_autoGenerate;
+    }
+
+    void SetMaxConcurrency(uint32_t maxConcurrency) override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        m_maxConcurrency = maxConcurrency > 0 ? maxConcurrency : 1;
+        ScheduleTasks();
+    }
+
+    State RequestProxy(MediaParser::Holder hParser) override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        auto hEntry = GetEntry(hParser);
+        if (!hEntry)
+            return PROXY_NONE;
+        const State state = hEntry->state;
+        if ((state == PROXY_NONE && hEntry->proxyWidth > 0) || state == PROXY_FAILED)
+        {
+            hEntry->state = PROXY_PENDING;
+            hEntry->cancelled = false;
+            hEntry->progress = 0.f;
+            m_pendingEntries.push_back(hEntry);
+            ScheduleTasks();
+        }
+        return hEntry->state.load();
+    }
+
+    State GetState(const string& url) override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        auto iter = m_entries.find(url);
+        return iter != m_entries.end() ? iter->second->state.load() : PROXY_NONE;
+    }
+
+    float GetProgress(const string& url) override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        auto iter = m_entries.find(url);
+        return iter != m_entries.end() ? iter->second->progress.load() : 0.f;
+    }
+
+    MediaParser::Holder GetProxyParser(MediaParser::Holder hParser, uint32_t& width, uint32_t& height) override
+    {
+        ProxyEntry::Holder hEntry;
+        {
+            lock_guard<mutex> lk(m_entriesLock);
+            hEntry = GetEntry(hParser);
+            if (!hEntry || hEntry->state != PROXY_READY)
+                return nullptr;
+        }
+        lock_guard<mutex> lk(hEntry->parserLock);
+        if (!hEntry->hProxyParser)
+        {
+            auto hProxyParser = MediaParser::CreateInstance();
+            if (!hProxyParser->Open(hEntry->proxyPath) || hProxyParser->GetBestVideoStreamIndex() < 0)
+            {
+                m_logger->Log(WARN) << "FAILED to open proxy file '" << hEntry->proxyPath << "' of '" << hEntry->url << "'! Error is '" << hProxyParser->GetError() << "'." << endl;
+                hEntry->state = PROXY_FAILED;
+                return nullptr;
+            }
+            hEntry->hProxyParser = hProxyParser;
+        }
+        width = hEntry->proxyWidth;
+        height = hEntry->proxyHeight;
+        return hEntry->hProxyParser;
+    }
+
+    void CancelProxy(const string& url) override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        auto iter = m_entries.find(url);
+        if (iter == m_entries.end())
+            return;
+        CancelEntry(iter->second);
+    }
+
+    void CancelAll() override
+    {
+        lock_guard<mutex> lk(m_entriesLock);
+        for (auto& elem : m_entries)
+            CancelEntry(elem.second);
+    }
+
+    void SetLogLevel(Logger::Level l) override
+    {
+        m_logger->SetShowLevels(l);
+    }
+
+    string GetError() const override
+    {
+        return m_errMsg;
+    }
+
+private:
+    struct ProxyEntry
+    {
+        using Holder = shared_ptr<ProxyEntry>;
+        string url;
+        MediaParser::Holder hParser;
+        string proxyPath;
+        uint32_t proxyWidth{0}, proxyHeight{0};  // 0 means the proxy is not needed
+        atomic<State> state{PROXY_NONE};
+        atomic<float> progress{0.f};
+        atomic_bool cancelled{false};
+        MediaParser::Holder hProxyParser;
+        mutex parserLock;
+    };
+
+    // Find or create the entry of 'hParser', an existing proxy file is picked up when the entry is created.
+    // Must be invoked with 'm_entriesLock' locked.
+    ProxyEntry::Holder GetEntry(MediaParser::Holder hParser)
+    {
+        if (!hParser || !hParser->IsOpened())
+        {
+            m_errMsg = "Argument 'hParser' is nullptr or not opened yet!";
+            return nullptr;
+        }
+        const string url = hParser->GetUrl();
+        auto iter = m_entries.find(url);
+        if (iter != m_entries.end())
+            return iter->second;
+
+        if (hParser->IsImageSequence() || hParser->GetBestVideoStreamIndex() < 0)
+        {
+            m_errMsg = "Only the video file can have a proxy!";
+            return nullptr;
+        }
+        auto pVidStm = hParser->GetBestVideoStream();
+        if (pVidStm->isImage || pVidStm->width == 0 || pVidStm->height == 0)
+        {
+            m_errMsg = "Only the video file can have a proxy!";
+            return nullptr;
+        }
+        MediaIndexCache::FileIdentity identity;
+        if (!MediaIndexCache::GetFileIdentity(url, identity))
+        {
+            m_errMsg = "FAILED to get the identity of file '"+url+"'!";
+            return nullptr;
+        }
+
+        ProxyEntry::Holder hEntry(new ProxyEntry());
+        hEntry->url = url;
+        hEntry->hParser = hParser;
+        if (pVidStm->width > m_maxWidth || pVidStm->height > m_maxHeight)
+        {
+            uint32_t proxyWidth, proxyHeight;
+            if ((uint64_t)m_maxWidth*pVidStm->height > (uint64_t)m_maxHeight*pVidStm->width)
+            {
+                proxyHeight = m_maxHeight;
+                proxyWidth = (uint32_t)((uint64_t)pVidStm->width*m_maxHeight/pVidStm->height);
+            }
+            else
+            {
+                proxyWidth = m_maxWidth;
+                proxyHeight = (uint32_t)((uint64_t)pVidStm->height*m_maxWidth/pVidStm->width);
+            }
+            hEntry->proxyWidth = proxyWidth+(proxyWidth&0x1);
+            hEntry->proxyHeight = proxyHeight+(proxyHeight&0x1);
+            ostringstream oss;
+            oss << "_" << hex << identity.contentHash << "_" << identity.mtime << dec << "_" << hEntry->proxyWidth << "x" << hEntry->proxyHeight << ".proxy" << PROXY_FILE_EXTENSION;
+            hEntry->proxyPath = MediaIndexCache::GetCacheFilePath(url, oss.str());
+            if (!hEntry->proxyPath.empty() && IsFileExists(hEntry->proxyPath))
+                hEntry->state = PROXY_READY;
+        }
+        m_entries[url] = hEntry;
+        return hEntry;
+    }
+
+    // must be invoked with 'm_entriesLock' locked
+    void CancelEntry(const ProxyEntry::Holder& hEntry)
+    {
+        hEntry->cancelled = true;
+        auto iter = find(m_pendingEntries.begin(), m_pendingEntries.end(), hEntry);
+        if (iter != m_pendingEntries.end())
+        {
+            m_pendingEntries.erase(iter);
+            hEntry->state = PROXY_NONE;
+        }
+    }
+
+    // must be invoked with 'm_entriesLock' locked
+    void ScheduleTasks()
+    {
+        while (m_runningTasks.Count() < m_maxConcurrency && !m_pendingEntries.empty())
+        {
+            auto hEntry = m_pendingEntries.front();
+            m_pendingEntries.pop_front();
+            m_runningTasks.Increase();
+            m_hExecutor->Submit([this, hEntry] { GenerateProxyTaskProc(hEntry); }, TaskExecutor::PRIORITY_BACKGROUND);
+        }
+    }
+
+    void GenerateProxyTaskProc(ProxyEntry::Holder hEntry)
+    {
+        hEntry->state = PROXY_GENERATING;
+        m_logger->Log(DEBUG) << "Start generating proxy for '" << hEntry->url << "'." << endl;
+        string errMsg;
+        if (GenerateProxy(hEntry, errMsg))
+        {
+            hEntry->progress = 1.f;
+            hEntry->state = PROXY_READY;
+            m_logger->Log(INFO) << "Proxy of '" << hEntry->url << "' is generated as '" << hEntry->proxyPath << "'." << endl;
+        }
+        else if (hEntry->cancelled)
+        {
+            hEntry->state = PROXY_NONE;
+            m_logger->Log(DEBUG) << "Proxy generation of '" << hEntry->url << "' is cancelled." << endl;
+        }
+        else
+        {
+            hEntry->state = PROXY_FAILED;
+            m_logger->Log(WARN) << "FAILED to generate proxy for '" << hEntry->url << "'! Error is '" << errMsg << "'." << endl;
+        }
+
+        lock_guard<mutex> lk(m_entriesLock);
+        m_runningTasks.Decrease();
+        ScheduleTasks();
+    }
+
+    bool GenerateProxy(const ProxyEntry::Holder& hEntry, string& errMsg)
+    {
+        if (hEntry->proxyPath.empty() || !MediaIndexCache::PrepareCacheDirectory())
+        {
+            errMsg = "Index cache directory is NOT available!";
+            return false;
+        }
+        auto pVidStm = hEntry->hParser->GetBestVideoStream();
+        Ratio frameRate = pVidStm->avgFrameRate;
+        if (frameRate.num <= 0 || frameRate.den <= 0)
+            frameRate = pVidStm->realFrameRate;
+        if (frameRate.num <= 0 || frameRate.den <= 0)
+            frameRate = Ratio(25, 1);
+        const int64_t durationMts = (int64_t)(pVidStm->duration*1000);
+        const uint32_t width = hEntry->proxyWidth;
+        const uint32_t height = hEntry->proxyHeight;
+
+        auto hReader = MediaReader::CreateVideoInstance("ProxyRdr");
+        if (!hReader->Open(hEntry->hParser) || !hReader->ConfigVideoReader(width, height, IM_CF_RGBA, IM_DT_INT8, IM_INTERPOLATE_AREA)
+            || !hReader->Start())
+        {
+            errMsg = hReader->GetError();
+            return false;
+        }
+
+        // write to a temporary file, so an incomplete proxy is never picked up
+        string tmpPath = hEntry->proxyPath;
+        tmpPath.insert(tmpPath.size()-strlen(PROXY_FILE_EXTENSION), ".part");
+        auto hEncoder = MediaEncoder::CreateInstance();
+        if (!hEncoder->Open(tmpPath))
+        {
+            errMsg = hEncoder->GetError();
+            return false;
+        }
+        string imageFormat;
+        const uint64_t bitRate = (uint64_t)width*height*frameRate.num/frameRate.den*2;
+        // every frame is a key frame, so seeking on the proxy never needs decoding the preceding frames
+        vector<MediaEncoder::Option> extraOpts = { {"g", Value((int32_t)1)} };
+        if (!hEncoder->ConfigureVideoStream(PROXY_VIDEO_CODEC, imageFormat, width, height, frameRate, bitRate, &extraOpts) || !hEncoder->Start())
+        {
+            errMsg = hEncoder->GetError();
+            hEncoder->Close();
+            remove(tmpPath.c_str());
+            return false;
+        }
+
+        bool success = true;
+        int64_t frameIndex = 0;
+        while (!hEntry->cancelled)
+        {
+            const int64_t pos = frameIndex*1000*frameRate.den/frameRate.num;
+            if (pos >= durationMts)
+                break;
+            bool eof = false;
+            auto hVf = hReader->ReadVideoFrame(pos, eof, true);
+            if (!hVf)
+            {
+                if (eof)
+                    break;
+                errMsg = hReader->GetError();
+                success = false;
+                break;
+            }
+            ImGui::ImMat vmat;
+            if (!hVf->GetMat(vmat) || vmat.empty())
+            {
+                errMsg = "FAILED to get the image of the source frame!";
+                success = false;
+                break;
+            }
+            vmat.time_stamp = (double)pos/1000;
+            bool consumed = false;
+            if (!hEncoder->EncodeVideoFrame(vmat, consumed, true))
+            {
+                errMsg = hEncoder->GetError();
+                success = false;
+                break;
+            }
+            frameIndex++;
+            hEntry->progress = durationMts > 0 ? (float)pos/durationMts : 0.f;
+        }
+        hReader->Close();
+        if (success && !hEntry->cancelled)
+        {
+            ImGui::ImMat eofMat;
+            bool consumed = false;
+            if (!hEncoder->EncodeVideoFrame(eofMat, consumed, true) || !hEncoder->FinishEncoding())
+            {
+                errMsg = hEncoder->GetError();
+                success = false;
+            }
+        }
+        if (!hEncoder->Close() && success)
+        {
+            errMsg = hEncoder->GetError();
+            success = false;
+        }
+        if (!success || hEntry->cancelled || frameIndex == 0)
+        {
+            if (success && frameIndex == 0)
+                errMsg = "No frame is read from the source!";
+            remove(tmpPath.c_str());
+            return false;
+        }
+        if (rename(tmpPath.c_str(), hEntry->proxyPath.c_str()) != 0)
+        {
+            errMsg = "FAILED to rename '"+tmpPath+"' to '"+hEntry->proxyPath+"'!";
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    ALogger* m_logger;
+    TaskExecutor::Holder m_hExecutor;
+    unordered_map<string, ProxyEntry::Holder> m_entries;
+    list<ProxyEntry::Holder> m_pendingEntries;
+    RunningTaskCounter m_runningTasks;
+    uint32_t m_maxConcurrency{1};
+    mutable mutex m_entriesLock;
+    uint32_t m_maxWidth{960}, m_maxHeight{540};
+    atomic_bool m_autoGenerate{false};
+    string m_errMsg;
+};
+
+static const auto PROXY_MANAGER_HOLDER_DELETER = [] (ProxyManager* p) {
+    ProxyManager_Impl* ptr = dynamic_cast<ProxyManager_Impl*>(p);
+    delete ptr;
+};
+
+ProxyManager::Holder ProxyManager::CreateInstance()
+{
+    return ProxyManager::Holder(new ProxyManager_Impl(), PROXY_MANAGER_HOLDER_DELETER);
+}
+
+static ProxyManager::Holder _DEFAULT_PROXY_MANAGER;
+static mutex _DEFAULT_PROXY_MANAGER_ACCESS_LOCK;
+
+ProxyManager::Holder ProxyManager::GetDefaultInstance()
+{
+    lock_guard<mutex> lk(_DEFAULT_PROXY_MANAGER_ACCESS_LOCK);
+    if (!_DEFAULT_PROXY_MANAGER)
+        _DEFAULT_PROXY_MANAGER = ProxyManager::CreateInstance();
+    return _DEFAULT_PROXY_MANAGER;
+}
+}
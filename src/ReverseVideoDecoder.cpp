@@ -0,0 +1,606 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <condition_variable>
+#include "ReverseVideoDecoder.h"
+#include "ThreadUtils.h"
+#include "TaskExecutor.h"
+#include "MemoryBudget.h"
+extern "C"
+{
+    #include "libavutil/avutil.h"
+    #include "libavutil/hwcontext.h"
+    #include "libavformat/avformat.h"
+    #include "libavcodec/avcodec.h"
+}
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+class ReverseVideoDecoder_Impl : public ReverseVideoDecoder
+{
+public:
+    ReverseVideoDecoder_Impl(ALogger* logger)
+        : m_logger(logger)
+    {
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
+    }
+
+    virtual ~ReverseVideoDecoder_Impl()
+    {
+        Close();
+    }
+
+    bool Open(MediaParser::Holder hParser, int videoStreamIndex, const FFUtils::OpenVideoDecoderOptions& decOpts) override
+    {
+        if (!hParser || !hParser->IsOpened())
+        {
+            m_errMsg = "Argument 'hParser' is nullptr or not opened yet!";
+            return false;
+        }
+        if (videoStreamIndex < 0)
+        {
+            m_errMsg = "Argument 'videoStreamIndex' is INVALID!";
+            return false;
+        }
+        Close();
+
+        m_hParser = hParser;
+        m_vidStmIdx = videoStreamIndex;
+        m_decOpts = decOpts;
+        // seek points are already parsed when the reader is prepared
+        m_hSeekPoints = hParser->GetVideoSeekPoints(false);
+        m_hMemConsumer = MemoryBudget::GetDefaultInstance()->Register("ReverseDecoder-"+SysUtils::ExtractFileName(hParser->GetUrl()), [this] (uint64_t quota) {
+            m_memQuota = quota;
+        });
+        m_memQuota = m_hMemConsumer->GetQuota();
+        m_hMemConsumer->SetPriority(MemoryBudget::PRIORITY_ACTIVE);
+        m_hMemConsumer->SetDemand(m_memLimit);
+        m_quit = false;
+        m_opened = true;
+        return true;
+    }
+
+    void Close() override
+    {
+        if (!m_opened)
+            return;
+        m_quit = true;
+        list<TaskExecutor::Task::Holder> decTasks;
+        {
+            lock_guard<mutex> lk(m_unitsLock);
+            ClearUnits();
+            decTasks.swap(m_decTasks);
+        }
+        for (auto& hTask : decTasks)
+        {
+            if (!hTask->Cancel())
+                hTask->Wait();
+        }
+
+        lock_guard<mutex> lk(m_decLock);
+        if (m_viddecCtx)
+        {
+            avcodec_free_context(&m_viddecCtx);
+            m_viddecCtx = nullptr;
+        }
+        if (m_decOpts.hHwaMgr && m_viddecDevType != AV_HWDEVICE_TYPE_NONE)
+        {
+            m_decOpts.hHwaMgr->DecreaseDecoderInstanceCount(av_hwdevice_get_type_name(m_viddecDevType));
+            m_viddecDevType = AV_HWDEVICE_TYPE_NONE;
+        }
+        if (m_avfmtCtx)
+        {
+            avformat_close_input(&m_avfmtCtx);
+            m_avfmtCtx = nullptr;
+        }
+        m_hParser = nullptr;
+        m_hSeekPoints = nullptr;
+        m_hMemConsumer = nullptr;
+        m_opened = false;
+    }
+
+    void SetMemoryLimit(uint64_t maxBytes) override
+    {
+        m_memLimit = maxBytes;
+        if (m_hMemConsumer)
+            m_hMemConsumer->SetDemand(maxBytes);
+    }
+
+    uint64_t GetMemoryLimit() const override
+    {
+        return m_memLimit;
+    }
+
+    uint64_t GetMemoryUsage() const override
+    {
+        lock_guard<mutex> lk(m_unitsLock);
+        uint64_t total = 0;
+        for (const auto& hUnit : m_units)
+            total += hUnit->bytes;
+        return total;
+    }
+
+    bool ReadFrame(int64_t pts, Frame& frame, bool wait) override
+    {
+        unique_lock<mutex> lk(m_unitsLock);
+        if (!m_opened)
+        {
+            m_errMsg = "This 'ReverseVideoDecoder' is NOT OPENED yet!";
+            return false;
+        }
+        while (!m_quit)
+        {
+            DecodeUnit::Holder hUnit;
+            bool needRestart = true;
+            // 'm_units' is ordered from the latest unit to the earliest one, each unit ends at the first frame of the previous one
+            for (auto& hCheckUnit : m_units)
+            {
+                if (pts >= hCheckUnit->endPts)
+                    break;
+                if (!hCheckUnit->done)
+                {
+                    needRestart = pts < hCheckUnit->seekPts && !hCheckUnit->isStreamHead;
+                    hUnit = hCheckUnit;
+                    break;
+                }
+                if (hCheckUnit->failed || hCheckUnit->frames.empty())
+                {
+                    needRestart = false;
+                    hUnit = hCheckUnit;
+                    break;
+                }
+                if (pts >= hCheckUnit->frames.front().pts || hCheckUnit->isStreamHead)
+                {
+                    needRestart = false;
+                    hUnit = hCheckUnit;
+                    break;
+                }
+                if (&hCheckUnit == &m_units.back())
+                {
+                    // the preceding unit is not scheduled yet, the passed units are released to give it the whole memory
+                    needRestart = false;
+                    hUnit = CreateUnit(hCheckUnit->frames.front().pts);
+                    ClearUnits();
+                    m_units.push_back(hUnit);
+                    SubmitUnit(hUnit);
+                    break;
+                }
+            }
+            if (needRestart)
+            {
+                m_logger->Log(DEBUG) << "[ReverseDecoder] Restart reverse decoding at pts " << pts << "." << endl;
+                ClearUnits();
+                hUnit = CreateUnit(pts+1);
+                m_units.push_back(hUnit);
+                SubmitUnit(hUnit);
+            }
+
+            if (hUnit->done)
+            {
+                if (hUnit->failed || hUnit->frames.empty())
+                {
+                    m_errMsg = hUnit->failed ? hUnit->errMsg : "No frame is decoded!";
+                    return false;
+                }
+                // the units after 'hUnit' are all passed
+                while (m_units.front() != hUnit)
+                {
+                    m_units.front()->cancelled = true;
+                    m_units.pop_front();
+                }
+                if (m_units.size() == 1)
+                    PrefetchPrecedingUnit(hUnit);
+                if (m_hMemConsumer)
+                {
+                    uint64_t usage = 0;
+                    for (const auto& hCheckUnit : m_units)
+                        usage += hCheckUnit->bytes;
+                    m_hMemConsumer->UpdateUsage(usage);
+                    m_hMemConsumer->Touch();
+                }
+
+                const auto& frames = hUnit->frames;
+                auto iter = upper_bound(frames.begin(), frames.end(), pts, [] (int64_t _pts, const Frame& elem) {
+                    return _pts < elem.pts;
+                });
+                if (iter != frames.begin())
+                    iter--;
+                frame = *iter;
+                return true;
+            }
+            if (!wait)
+            {
+                m_errMsg = "Frame is NOT READY yet!";
+                return false;
+            }
+            m_unitDoneCv.wait_for(lk, chrono::milliseconds(THREAD_IDLE_TIME));
+        }
+        m_errMsg = "This 'ReverseVideoDecoder' is closed!";
+        return false;
+    }
+
+    void Reset() override
+    {
+        lock_guard<mutex> lk(m_unitsLock);
+        ClearUnits();
+    }
+
+    string GetError() const override
+    {
+        return m_errMsg;
+    }
+
+private:
+    struct DecodeUnit
+    {
+        using Holder = shared_ptr<DecodeUnit>;
+        int64_t seekPts{INT64_MIN};     // the seek point where decoding starts
+        int64_t endPts{INT64_MAX};      // frames with pts >= 'endPts' are not kept
+        deque<Frame> frames;            // in pts order
+        atomic<uint64_t> bytes{0};
+        // a prefetched unit is decoded while the following one is being read, it takes half of the memory
+        bool prefetched{false};
+        bool isStreamHead{false};
+        bool done{false};
+        bool failed{false};
+        atomic_bool cancelled{false};
+        string errMsg;
+    };
+
+    // must be invoked with 'm_unitsLock' locked
+    DecodeUnit::Holder CreateUnit(int64_t endPts)
+    {
+        auto hUnit = make_shared<DecodeUnit>();
+        hUnit->endPts = endPts;
+        if (m_hSeekPoints && !m_hSeekPoints->empty())
+        {
+            // the largest seek point which is smaller than 'endPts'
+            const auto& seekPoints = *m_hSeekPoints;
+            auto iter = lower_bound(seekPoints.begin(), seekPoints.end(), endPts);
+            if (iter != seekPoints.begin())
+                iter--;
+            hUnit->seekPts = *iter;
+            hUnit->isStreamHead = iter == seekPoints.begin();
+        }
+        else
+        {
+            // without seek points, decode from the beginning of the stream
+            hUnit->isStreamHead = true;
+        }
+        return hUnit;
+    }
+
+    // must be invoked with 'm_unitsLock' locked
+    void SubmitUnit(DecodeUnit::Holder hUnit)
+    {
+        auto iter = m_decTasks.begin();
+        while (iter != m_decTasks.end())
+        {
+            if ((*iter)->IsDone())
+                iter = m_decTasks.erase(iter);
+            else
+                iter++;
+        }
+        m_decTasks.push_back(m_hExecutor->Submit([this, hUnit] { DecodeUnitProc(hUnit); }, TaskExecutor::PRIORITY_PLAYBACK));
+    }
+
+    // Start decoding the preceding unit while 'hUnit' is being read. If the preceding gop is estimated to take more
+    // than half of the memory, it's not prefetched but decoded once the reading passes 'hUnit', with the whole memory.
+    // Otherwise it would be truncated, and decoded again from the same seek point for the dropped frames.
+    // Must be invoked with 'm_unitsLock' locked.
+    void PrefetchPrecedingUnit(DecodeUnit::Holder hUnit)
+    {
+        if (hUnit->isStreamHead || hUnit->failed || hUnit->frames.empty() || m_units.back() != hUnit)
+            return;
+        auto hPrevUnit = CreateUnit(hUnit->frames.front().pts);
+        const int64_t frmIntvPts = m_frmIntvPts;
+        if (hPrevUnit->seekPts != INT64_MIN && frmIntvPts > 0)
+        {
+            const uint64_t avgFrameBytes = hUnit->bytes/hUnit->frames.size();
+            const uint64_t estFrameCount = (uint64_t)((hPrevUnit->endPts-hPrevUnit->seekPts+frmIntvPts-1)/frmIntvPts);
+            if (estFrameCount*avgFrameBytes > GetMemoryBudget()/2)
+                return;
+        }
+        hPrevUnit->prefetched = true;
+        m_units.push_back(hPrevUnit);
+        SubmitUnit(hPrevUnit);
+    }
+
+    uint64_t GetMemoryBudget() const
+    {
+        return min<uint64_t>(m_memLimit, m_memQuota);
+    }
+
+    // must be invoked with 'm_unitsLock' locked
+    void ClearUnits()
+    {
+        for (auto& hUnit : m_units)
+            hUnit->cancelled = true;
+        m_units.clear();
+    }
+
+    void DecodeUnitProc(DecodeUnit::Holder hUnit)
+    {
+        {
+            lock_guard<mutex> lk(m_decLock);
+            if (!hUnit->cancelled && !m_quit)
+            {
+                if (!m_avfmtCtx && !OpenMedia())
+                {
+                    hUnit->failed = true;
+                    hUnit->errMsg = m_errMsg;
+                }
+                else
+                {
+                    DecodeUnitFrames(hUnit);
+                }
+            }
+        }
+
+        {
+            lock_guard<mutex> lk(m_unitsLock);
+            hUnit->done = true;
+            // start decoding the preceding unit while this one is being read
+            if (!hUnit->cancelled && m_units.size() == 1)
+                PrefetchPrecedingUnit(hUnit);
+        }
+        m_unitDoneCv.notify_all();
+    }
+
+    bool OpenMedia()
+    {
+        int fferr = avformat_open_input(&m_avfmtCtx, m_hParser->GetUrl().c_str(), nullptr, nullptr);
+        if (fferr < 0)
+        {
+            m_avfmtCtx = nullptr;
+            ostringstream oss; oss << "FF api 'avformat_open_input' returns error! fferr=" << fferr << ".";
+            m_errMsg = oss.str();
+            return false;
+        }
+        fferr = avformat_find_stream_info(m_avfmtCtx, nullptr);
+        if (fferr < 0 || m_vidStmIdx >= (int)m_avfmtCtx->nb_streams)
+        {
+            ostringstream oss; oss << "FF api 'avformat_find_stream_info' returns error! fferr=" << fferr << ".";
+            m_errMsg = oss.str();
+            avformat_close_input(&m_avfmtCtx);
+            m_avfmtCtx = nullptr;
+            return false;
+        }
+        auto pAvStm = m_avfmtCtx->streams[m_vidStmIdx];
+        m_frmIntvPts = av_rescale_q(1, av_inv_q(pAvStm->r_frame_rate), pAvStm->time_base);
+
+        FFUtils::OpenVideoDecoderResult res;
+        if (!FFUtils::OpenVideoDecoder(m_avfmtCtx, m_vidStmIdx, &m_decOpts, &res))
+        {
+            ostringstream oss; oss << "Open video decoder FAILED! Error is '" << res.errMsg << "'.";
+            m_errMsg = oss.str();
+            avformat_close_input(&m_avfmtCtx);
+            m_avfmtCtx = nullptr;
+            return false;
+        }
+        m_viddecCtx = res.decCtx;
+        m_viddecDevType = res.hwDevType;
+        if (m_decOpts.hHwaMgr && m_viddecDevType != AV_HWDEVICE_TYPE_NONE)
+            m_decOpts.hHwaMgr->IncreaseDecoderInstanceCount(av_hwdevice_get_type_name(m_viddecDevType));
+        m_logger->Log(DEBUG) << "[ReverseDecoder] Opened video decoder '" << m_viddecCtx->codec->name << "'("
+                << (m_viddecDevType==AV_HWDEVICE_TYPE_NONE ? "SW" : av_hwdevice_get_type_name(m_viddecDevType)) << ")." << endl;
+        return true;
+    }
+
+    void DecodeUnitFrames(DecodeUnit::Holder hUnit)
+    {
+        while (!hUnit->cancelled && !m_quit)
+        {
+            if (DecodeFromSeekPoint(hUnit) && !hUnit->frames.empty())
+                break;
+            if (hUnit->failed || hUnit->isStreamHead)
+            {
+                if (hUnit->frames.empty() && !hUnit->failed)
+                {
+                    hUnit->failed = true;
+                    hUnit->errMsg = "No frame is decoded!";
+                }
+                break;
+            }
+            // no frame before 'endPts' is decoded from this seek point, move to the previous one
+            lock_guard<mutex> lk(m_unitsLock);
+            auto hPrevUnit = CreateUnit(hUnit->seekPts);
+            m_logger->Log(DEBUG) << "[ReverseDecoder] No frame is decoded from seek point " << hUnit->seekPts << ", retry from " << hPrevUnit->seekPts << "." << endl;
+            hUnit->seekPts = hPrevUnit->seekPts;
+            hUnit->isStreamHead = hPrevUnit->isStreamHead;
+        }
+    }
+
+    bool DecodeFromSeekPoint(DecodeUnit::Holder hUnit)
+    {
+        int fferr;
+        if (hUnit->seekPts != INT64_MIN)
+        {
+            fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, hUnit->seekPts, hUnit->seekPts, 0);
+            if (fferr < 0)
+                m_logger->Log(WARN) << "[ReverseDecoder] avformat_seek_file() FAILED to seek to pts " << hUnit->seekPts << "! fferr=" << fferr << "." << endl;
+        }
+        else
+        {
+            const auto pAvStm = m_avfmtCtx->streams[m_vidStmIdx];
+            fferr = av_seek_frame(m_avfmtCtx, m_vidStmIdx, pAvStm->start_time != AV_NOPTS_VALUE ? pAvStm->start_time : 0, AVSEEK_FLAG_BACKWARD);
+            if (fferr < 0)
+                m_logger->Log(WARN) << "[ReverseDecoder] av_seek_frame() FAILED to seek to the start of the stream! fferr=" << fferr << "." << endl;
+        }
+        avcodec_flush_buffers(m_viddecCtx);
+        hUnit->frames.clear();
+        hUnit->bytes = 0;
+
+        const uint64_t memBudget = hUnit->prefetched ? GetMemoryBudget()/2 : GetMemoryBudget();
+        int64_t stopPts = INT64_MIN;
+        bool truncated = false;
+        bool demuxEof = false;
+        SelfFreeAVPacketPtr hPkt = AllocSelfFreeAVPacketPtr();
+        while (!hUnit->cancelled && !m_quit && stopPts == INT64_MIN)
+        {
+            if (!demuxEof)
+            {
+                fferr = av_read_frame(m_avfmtCtx, hPkt.get());
+                if (fferr == AVERROR_EOF)
+                {
+                    demuxEof = true;
+                    avcodec_send_packet(m_viddecCtx, nullptr);
+                }
+                else if (fferr < 0)
+                {
+                    hUnit->failed = true;
+                    ostringstream oss; oss << "FF api 'av_read_frame' returns error! fferr=" << fferr << ".";
+                    hUnit->errMsg = oss.str();
+                    return false;
+                }
+                else
+                {
+                    if (hPkt->stream_index == m_vidStmIdx)
+                        fferr = avcodec_send_packet(m_viddecCtx, hPkt.get());
+                    av_packet_unref(hPkt.get());
+                    if (fferr < 0 && fferr != AVERROR(EAGAIN))
+                        m_logger->Log(WARN) << "[ReverseDecoder] avcodec_send_packet() FAILED! fferr=" << fferr << "." << endl;
+                }
+            }
+
+            while (!hUnit->cancelled)
+            {
+                SelfFreeAVFramePtr hFrm = AllocSelfFreeAVFramePtr();
+                fferr = avcodec_receive_frame(m_viddecCtx, hFrm.get());
+                if (fferr == AVERROR(EAGAIN))
+                    break;
+                if (fferr == AVERROR_EOF)
+                {
+                    stopPts = INT64_MAX;
+                    break;
+                }
+                if (fferr < 0)
+                {
+                    m_logger->Log(WARN) << "[ReverseDecoder] avcodec_receive_frame() FAILED! fferr=" << fferr << "." << endl;
+                    break;
+                }
+                hFrm->pts = hFrm->best_effort_timestamp;
+                if (hFrm->pts >= hUnit->endPts)
+                {
+                    stopPts = hFrm->pts;
+                    break;
+                }
+                // frames before the seek point belong to the preceding unit
+                if (hFrm->pts < hUnit->seekPts && !hUnit->isStreamHead)
+                    continue;
+
+                if (IsHwFrame(hFrm.get()))
+                {
+                    SelfFreeAVFramePtr hSwfrm = AllocSelfFreeAVFramePtr();
+                    if (!TransferHwFrameToSwFrame(hSwfrm.get(), hFrm.get()))
+                    {
+                        m_logger->Log(WARN) << "[ReverseDecoder] TransferHwFrameToSwFrame() FAILED at pts " << hFrm->pts << "!" << endl;
+                        continue;
+                    }
+                    hFrm = hSwfrm;
+                }
+                Frame frm;
+                frm.frmPtr = hFrm;
+                frm.pts = hFrm->pts;
+                hUnit->frames.push_back(frm);
+                hUnit->bytes += GetFrameBytes(hFrm.get());
+                while (hUnit->bytes > memBudget && hUnit->frames.size() > 1)
+                {
+                    hUnit->bytes -= GetFrameBytes(hUnit->frames.front().frmPtr.get());
+                    hUnit->frames.pop_front();
+                    truncated = true;
+                }
+            }
+        }
+        if (hUnit->cancelled || m_quit)
+            return false;
+
+        auto& frames = hUnit->frames;
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            if (i+1 < frames.size())
+                frames[i].dur = frames[i+1].pts-frames[i].pts;
+            else if (stopPts != INT64_MAX)
+                frames[i].dur = stopPts-frames[i].pts;
+            else
+                frames[i].dur = m_frmIntvPts;
+        }
+        if (truncated)
+        {
+            lock_guard<mutex> lk(m_unitsLock);
+            hUnit->isStreamHead = false;
+        }
+        if (hUnit->isStreamHead && !frames.empty())
+            frames.front().isStartFrame = true;
+        m_logger->Log(DEBUG) << "[ReverseDecoder] Decoded unit [" << hUnit->seekPts << ", " << hUnit->endPts << "), " << frames.size()
+                << " frames kept (" << hUnit->bytes/1024 << " KB)" << (truncated ? ", truncated by memory limit." : ".") << endl;
+        return true;
+    }
+
+    static uint64_t GetFrameBytes(const AVFrame* avfrm)
+    {
+        uint64_t bytes = 0;
+        for (int i = 0; i < AV_NUM_DATA_POINTERS && avfrm->buf[i]; i++)
+            bytes += avfrm->buf[i]->size;
+        return bytes;
+    }
+
+private:
+    ALogger* m_logger;
+    TaskExecutor::Holder m_hExecutor;
+    MediaParser::Holder m_hParser;
+    MediaParser::SeekPointsHolder m_hSeekPoints;
+    int m_vidStmIdx{-1};
+    FFUtils::OpenVideoDecoderOptions m_decOpts;
+    AVFormatContext* m_avfmtCtx{nullptr};
+    AVCodecContext* m_viddecCtx{nullptr};
+    AVHWDeviceType m_viddecDevType{AV_HWDEVICE_TYPE_NONE};
+    atomic<int64_t> m_frmIntvPts{1};
+    mutex m_decLock;
+    list<DecodeUnit::Holder> m_units;
+    mutable mutex m_unitsLock;
+    condition_variable m_unitDoneCv;
+    list<TaskExecutor::Task::Holder> m_decTasks;
+    atomic<uint64_t> m_memLimit{512ULL*1024*1024};
+    MemoryBudget::Consumer::Holder m_hMemConsumer;
+    atomic<uint64_t> m_memQuota{UINT64_MAX};
+    bool m_opened{false};
+    atomic_bool m_quit{false};
+    string m_errMsg;
+};
+
+static const auto REVERSE_VIDEO_DECODER_HOLDER_DELETER = [] (ReverseVideoDecoder* p) {
+    ReverseVideoDecoder_Impl* ptr = dynamic_cast<ReverseVideoDecoder_Impl*>(p);
+    delete ptr;
+};
+
+ReverseVideoDecoder::Holder ReverseVideoDecoder::CreateInstance(ALogger* logger)
+{
+    return ReverseVideoDecoder::Holder(new ReverseVideoDecoder_Impl(logger), REVERSE_VIDEO_DECODER_HOLDER_DELETER);
+}
+}
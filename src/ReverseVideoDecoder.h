@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "MediaParser.h"
+#include "FFUtils.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+// Decoder for backward playback. The stream is split into decode units, each one starts at a seek point
+// and is decoded only once. The decoded frames are kept in their native pixel format, and are returned
+// from the last one to the first. While the frames of a unit are being read, the preceding unit is decoded
+// on the shared 'TaskExecutor'.
+struct ReverseVideoDecoder
+{
+    using Holder = std::shared_ptr<ReverseVideoDecoder>;
+    static Holder CreateInstance(Logger::ALogger* logger);
+
+    // 'decOpts' are the options used to open the decoder, the media is opened on the first decoding task.
+    virtual bool Open(MediaParser::Holder hParser, int videoStreamIndex, const FFUtils::OpenVideoDecoderOptions& decOpts) = 0;
+    virtual void Close() = 0;
+
+    // Maximum bytes of the decoded frames held by this decoder. A unit is decoded in advance while the following
+    // one is being read if it's estimated to fit in half of the memory, otherwise it's decoded with the whole memory
+    // after the following one is passed. A unit exceeding its share drops its earliest frames, which are decoded
+    // again by the preceding unit. The limit is also bounded by the quota assigned from the default 'MemoryBudget'.
+    virtual void SetMemoryLimit(uint64_t maxBytes) = 0;
+    virtual uint64_t GetMemoryLimit() const = 0;
+    virtual uint64_t GetMemoryUsage() const = 0;
+
+    struct Frame
+    {
+        SelfFreeAVFramePtr frmPtr;  // a software frame
+        int64_t pts{0};
+        int64_t dur{0};
+        bool isStartFrame{false};
+    };
+    // Read the frame with the largest pts not larger than 'pts'. Reading a pts which is not adjacent
+    // to the previous reading position restarts the decoding at 'pts'.
+    virtual bool ReadFrame(int64_t pts, Frame& frame, bool wait) = 0;
+    // Release all the decoded frames
+    virtual void Reset() = 0;
+
+    virtual std::string GetError() const = 0;
+};
+}
@@ -52,6 +52,11 @@ class SharedSettings_Impl : public SharedSettings
         return m_isVidsrcKeepOrgSize;
     }
 
+    bool IsVideoProxyEnabled() const override
+    {
+        return m_isVidProxyEnabled;
+    }
+
     uint32_t AudioOutChannels() const override
     {
         return m_audOutChannels;
@@ -118,6 +123,11 @@ class SharedSettings_Impl : public SharedSettings
         m_isVidsrcKeepOrgSize = enable;
     }
 
+    void SetVideoProxyEnabled(bool enable) override
+    {
+        m_isVidProxyEnabled = enable;
+    }
+
     void SetAudioOutSampleRate(uint32_t sampleRate) override
     {
         m_audOutSampleRate = sampleRate;
@@ -146,6 +156,7 @@ class SharedSettings_Impl : public SharedSettings
         SetVideoOutFrameRate(pSettings->VideoOutFrameRate());
         SetVideoOutColorFormat(pSettings->VideoOutColorFormat());
         SetVideoOutDataType(pSettings->VideoOutDataType());
+        SetVideoProxyEnabled(pSettings->IsVideoProxyEnabled());
     }
 
     void SyncAudioSettingsFrom(const SharedSettings* pSettings) override
@@ -185,6 +196,7 @@ private:
     ImDataType m_vidOutDataType{IM_DT_FLOAT32};
     HwaccelManager::Holder m_hHwaMgr;
     bool m_isVidsrcKeepOrgSize{ false };
+    bool m_isVidProxyEnabled{true};
     uint32_t m_audOutChannels{0};
     uint32_t m_audOutSampleRate{0};
     ImDataType m_audOutDataType{IM_DT_FLOAT32};
@@ -613,6 +613,50 @@ public:
         if (m_track) m_track->SetPreReadMaxNum(szCacheNum);
     }
 
+    // there is only one track to output, no mixing work to be parallelized
+    void SetMixingConcurrency(uint32_t concurrency) override {}
+
+    uint32_t GetMixingConcurrency() const override
+    {
+        return 1;
+    }
+
+    void EnableOcclusionCulling(bool enable) override {}
+
+    bool IsOcclusionCullingEnabled() const override
+    {
+        return false;
+    }
+
+    void EnableScrubbingPreview(bool enable) override {}
+
+    bool IsScrubbingPreviewEnabled() const override
+    {
+        return false;
+    }
+
+    // the frames of a single track are cached by the track's readers, no mixed frame cache is needed
+    void SetFrameCacheCapacity(uint64_t maxBytes) override {}
+
+    uint64_t GetFrameCacheCapacity() const override
+    {
+        return 0;
+    }
+
+    void EnableFrameCacheCompression(bool enable) override {}
+
+    bool IsFrameCacheCompressionEnabled() const override
+    {
+        return false;
+    }
+
+    FrameCacheStats GetFrameCacheStats() const override
+    {
+        return FrameCacheStats();
+    }
+
+    void ClearFrameCache() override {}
+
     uint32_t TrackCount() const override
     {
         return m_track ? 1 : 0;
@@ -33,6 +33,7 @@
 #include "FFUtils.h"
 #include "ThreadUtils.h"
 #include "ConditionalMutex.h"
+#include "ThreadSignal.h"
 #include "DebugHelper.h"
 extern "C"
 {
@@ -329,6 +330,7 @@ public:
         m_setSnapWindowSize = windowSize;
         m_setWndFrmCnt = frameCount;
         if (forceRefresh) m_refreshSnapshots = true;
+        NotifyTaskListUpdated();
         m_logger->Log(DEBUG) << ">>>> Config window: m_setSnapWindowSize=" << m_setSnapWindowSize << ", m_setWndFrmCnt=" << m_setWndFrmCnt << endl;
 
         if (!m_started)
@@ -735,6 +737,7 @@ private:
         m_logger->Log(DEBUG) << ">>>> Prepared: m_snapWindowSize=" << m_snapWindowSize << ", m_wndFrmCnt=" << m_wndFrmCnt
             << ", m_vidMaxIndex=" << m_vidMaxIndex << ", m_maxCacheSize=" << m_maxCacheSize << ", m_prevWndCacheSize=" << m_prevWndCacheSize << endl;
         m_prepared = true;
+        m_viddecSignal.Notify();
         return true;
     }
 
@@ -878,6 +881,7 @@ private:
                                         currTask->avpktQ.push_back(enqpkt);
                                     }
                                 }
+                                m_viddecSignal.Notify();
                                 av_packet_unref(&avpkt);
                                 avpktLoaded = false;
                                 idleLoop = false;
@@ -897,7 +901,9 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_demuxSignal.WaitFor(THREAD_IDLE_TIME);
+            else
+                m_viddecSignal.Notify();
         }
         if (currTask && !currTask->demuxerEof)
             currTask->demuxerEof = true;
@@ -946,7 +952,7 @@ private:
         m_logger->Log(VERBOSE) << "Enter VideoDecodeThreadProc()..." << endl;
 
         while (!m_prepared && !m_quit)
-            this_thread::sleep_for(chrono::milliseconds(5));
+            m_viddecSignal.WaitFor(THREAD_IDLE_TIME);
 
         GopDecodeTaskHolder currTask;
         AVFrame avfrm = {0};
@@ -1073,11 +1079,13 @@ private:
                             av_frame_unref(&avfrm);
                             avfrmLoaded = false;
                             idleLoop = false;
+                            m_updateSsSignal.Notify();
                             break;
                         }
                         else
                         {
-                            this_thread::sleep_for(chrono::milliseconds(5));
+                            // wait for the pending snapshot frames to be released
+                            m_viddecSignal.WaitFor(THREAD_IDLE_TIME);
                         }
                     }
                 }
@@ -1127,13 +1135,14 @@ private:
                 {
                     currTask->decoderEof = true;
                     idleLoop = false;
+                    m_demuxSignal.Notify();
                 }
                 if (quitLoop)
                     break;
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_viddecSignal.WaitFor(THREAD_IDLE_TIME);
         }
         if (currTask && !currTask->decoderEof)
             currTask->decoderEof = true;
@@ -1207,7 +1216,9 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_updateSsSignal.WaitFor(THREAD_IDLE_TIME);
+            else
+                m_viddecSignal.Notify();
         }
         m_logger->Log(VERBOSE) << "Leave UpdateSnapshotThreadProc()." << endl;
     }
@@ -1304,7 +1315,7 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                m_updateSsSignal.WaitFor(THREAD_IDLE_TIME);
         }
         imgsqDecCtxList.clear();
         m_logger->Log(VERBOSE) << "Leave BuildSnapshotFromImageSequence()." << endl;
@@ -1335,10 +1346,20 @@ private:
         }
     }
 
+    void NotifyTaskListUpdated()
+    {
+        // 'DemuxThreadProc' rebuilds the video task list, while 'BuildSnapshotFromImageSequenceProc' does it for image sequence
+        m_demuxSignal.Notify();
+        m_updateSsSignal.Notify();
+    }
+
     void WaitAllThreadsQuit()
     {
         // AutoSection _as("WATQ");
         m_quit = true;
+        m_demuxSignal.Notify();
+        m_viddecSignal.Notify();
+        m_updateSsSignal.Notify();
         if (m_demuxThread.joinable())
         {
             m_demuxThread.join();
@@ -2204,6 +2225,7 @@ private:
             lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
             av_frame_free(&p);
             m_pendingVidfrmCnt--;
+            m_viddecSignal.Notify();
         });
         m_pendingVidfrmCnt++;
 
@@ -2433,6 +2455,7 @@ public:
                 lock_guard<mutex> lk(m_taskRangeLock);
                 m_taskRanges = taskRanges;
                 m_taskRangeChanged = true;
+                m_owner->NotifyTaskListUpdated();
             }
         }
 
@@ -2471,11 +2494,14 @@ private:
 
     // demuxing thread
     thread m_demuxThread;
+    ThreadSignal m_demuxSignal;
     uint32_t m_maxPendingTaskCountForDecoding = 8;
     // video decoding thread
     thread m_viddecThread;
+    ThreadSignal m_viddecSignal;
     // update snapshots thread
     thread m_updateSsThread;
+    ThreadSignal m_updateSsSignal;
     FFUtils::FFFilterGraph::Holder m_hTransposeFilter;
 
     int64_t m_vidStartMts{0};
@@ -0,0 +1,651 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <deque>
+#include <queue>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <exception>
+#include "TaskExecutor.h"
+#include "ThreadUtils.h"
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+class TaskExecutor_Impl;
+
+// identify the executor and worker index of the current thread
+struct _WorkerThreadInfo
+{
+    TaskExecutor_Impl* executor{nullptr};
+    uint32_t index{0};
+};
+static thread_local _WorkerThreadInfo _CURR_WORKER_INFO;
+// the loop whose iteration is running on the current thread
+static thread_local TaskExecutor::Loop* _CURR_LOOP = nullptr;
+
+class TaskExecutor_Impl : public TaskExecutor
+{
+public:
+    TaskExecutor_Impl(uint32_t threadCount, const string& name)
+    {
+        m_logger = GetLogger("TaskExec");
+        if (threadCount == 0)
+            threadCount = thread::hardware_concurrency();
+        if (threadCount == 0)
+            threadCount = 2;
+        m_name = name.empty() ? "Exec" : name;
+        m_hHelperSignal = GetSharedHelperSignal();
+        for (auto& cnt : m_pendingTaskCount)
+            cnt = 0;
+        m_workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++)
+            m_workers.push_back(unique_ptr<Worker>(new Worker()));
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            auto& worker = m_workers[i];
+            worker->thd = thread(&TaskExecutor_Impl::WorkerThreadProc, this, i);
+            ostringstream thnOss; thnOss << m_name << "-" << i;
+            SysUtils::SetThreadName(worker->thd, thnOss.str());
+        }
+        m_timerThread = thread(&TaskExecutor_Impl::TimerThreadProc, this);
+        SysUtils::SetThreadName(m_timerThread, m_name+"-timer");
+        m_logger->Log(DEBUG) << "TaskExecutor '" << m_name << "' is started with " << threadCount << " worker threads." << endl;
+    }
+
+    TaskExecutor_Impl(const TaskExecutor_Impl&) = delete;
+    TaskExecutor_Impl(TaskExecutor_Impl&&) = delete;
+    TaskExecutor_Impl& operator=(const TaskExecutor_Impl&) = delete;
+
+    virtual ~TaskExecutor_Impl()
+    {
+        {
+            lock_guard<mutex> lk(m_idleLock);
+            m_quit = true;
+        }
+        m_idleCv.notify_all();
+        {
+            lock_guard<mutex> lk(m_timerLock);
+            m_timerCv.notify_all();
+        }
+        if (m_timerThread.joinable())
+            m_timerThread.join();
+        for (auto& worker : m_workers)
+        {
+            if (worker->thd.joinable())
+                worker->thd.join();
+        }
+        // cancel all the tasks which have not been executed
+        for (auto& worker : m_workers)
+        {
+            for (auto& q : worker->taskQ)
+            {
+                for (auto& hTask : q)
+                    hTask->Cancel();
+                q.clear();
+            }
+        }
+    }
+
+    Task::Holder Submit(const TaskProc& proc, Priority priority) override
+    {
+        if (priority < PRIORITY_INTERACTIVE || priority >= PRIORITY_COUNT)
+            priority = PRIORITY_BACKGROUND;
+        TaskImplHolder hTask(new Task_Impl(proc, priority, m_hHelperSignal));
+        // tasks submitted from a worker thread go to its own queue, others are distributed round-robin
+        uint32_t workerIdx;
+        if (_CURR_WORKER_INFO.executor == this)
+            workerIdx = _CURR_WORKER_INFO.index;
+        else
+            workerIdx = m_nextWorkerIdx.fetch_add(1)%m_workers.size();
+        auto& worker = m_workers[workerIdx];
+        {
+            lock_guard<mutex> lk(worker->lock);
+            worker->taskQ[priority].push_back(hTask);
+        }
+        m_pendingTaskCount[priority]++;
+        {
+            lock_guard<mutex> lk(m_idleLock);
+            m_totalPendingCount++;
+        }
+        m_idleCv.notify_one();
+        // the worker threads waiting inside a task may be able to run this one
+        m_hHelperSignal->NotifyIfWaiting();
+        return hTask;
+    }
+
+    Loop::Holder StartLoop(const LoopProc& proc, Priority priority, uint32_t idleMillisec) override
+    {
+        if (priority < PRIORITY_INTERACTIVE || priority >= PRIORITY_COUNT)
+            priority = PRIORITY_BACKGROUND;
+        auto hLoop = make_shared<Loop_Impl>(this, proc, priority, idleMillisec);
+        hLoop->Start();
+        // the pending iteration holds the loop as well, so stop it when the caller releases the holder
+        return Loop::Holder(hLoop.get(), [hLoop] (Loop*) { hLoop->Stop(); });
+    }
+
+    uint32_t GetThreadCount() const override
+    {
+        return m_workers.size();
+    }
+
+    uint32_t GetPendingTaskCount(Priority priority) const override
+    {
+        if (priority < PRIORITY_INTERACTIVE || priority >= PRIORITY_COUNT)
+            return 0;
+        return m_pendingTaskCount[priority].load();
+    }
+
+    bool IsWorkerThread() const override
+    {
+        return _CURR_WORKER_INFO.executor == this;
+    }
+
+    void SetLogLevel(Logger::Level l) override
+    {
+        m_logger->SetShowLevels(l);
+    }
+
+    // execute one pending task whose priority is not lower than 'lowestPriority' on the calling worker thread,
+    // return false if there is no such task
+    bool RunOnePendingTask(uint32_t workerIdx, Priority lowestPriority)
+    {
+        auto hTask = PickTask(workerIdx, lowestPriority);
+        if (!hTask)
+            return false;
+        hTask->Run(m_logger);
+        return true;
+    }
+
+    bool HasPendingTask(Priority lowestPriority) const
+    {
+        for (int p = PRIORITY_INTERACTIVE; p <= lowestPriority; p++)
+        {
+            if (m_pendingTaskCount[p].load() > 0)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    // Wakes up the worker threads which wait for a task inside another task, when a task is done or a new
+    // task is submitted. It's shared with the tasks since they can be cancelled after the executor is gone,
+    // and by all the executors, since a worker may wait for a task of another executor.
+    struct HelperSignal
+    {
+        mutex lock;
+        condition_variable cv;
+        atomic_int waitingCount{0};
+
+        void NotifyIfWaiting()
+        {
+            if (waitingCount.load() > 0)
+            {
+                lock_guard<mutex> lk(lock);
+                cv.notify_all();
+            }
+        }
+    };
+    using HelperSignalHolder = shared_ptr<HelperSignal>;
+
+    static HelperSignalHolder GetSharedHelperSignal()
+    {
+        static HelperSignalHolder s_hHelperSignal = make_shared<HelperSignal>();
+        return s_hHelperSignal;
+    }
+
+    class Task_Impl : public Task
+    {
+    public:
+        enum State
+        {
+            PENDING = 0,
+            RUNNING,
+            DONE,
+            CANCELLED,
+        };
+
+        Task_Impl(const TaskProc& proc, Priority priority, const HelperSignalHolder& hHelperSignal)
+            : m_proc(proc), m_priority(priority), m_hHelperSignal(hHelperSignal) {}
+
+        bool Cancel() override
+        {
+            {
+                lock_guard<mutex> lk(m_doneLock);
+                int expected = PENDING;
+                if (!m_state.compare_exchange_strong(expected, CANCELLED))
+                    return expected == CANCELLED;
+            }
+            m_proc = nullptr;
+            m_doneCv.notify_all();
+            m_hHelperSignal->NotifyIfWaiting();
+            return true;
+        }
+
+        bool IsDone() const override
+        {
+            const int state = m_state.load();
+            return state == DONE || state == CANCELLED;
+        }
+
+        bool IsCancelled() const override
+        {
+            return m_state.load() == CANCELLED;
+        }
+
+        void Wait() override
+        {
+            if (_CURR_WORKER_INFO.executor)
+            {
+                // avoid dead-lock when all the workers are waiting for the tasks in queue. Only the tasks with
+                // a priority not lower than this one are executed, a background job must not delay the waiter.
+                auto pExecutor = _CURR_WORKER_INFO.executor;
+                const uint32_t workerIdx = _CURR_WORKER_INFO.index;
+                auto& signal = *m_hHelperSignal;
+                while (!IsDone())
+                {
+                    if (pExecutor->RunOnePendingTask(workerIdx, m_priority))
+                        continue;
+                    unique_lock<mutex> lk(signal.lock);
+                    signal.waitingCount++;
+                    signal.cv.wait(lk, [this, pExecutor] { return IsDone() || pExecutor->HasPendingTask(m_priority); });
+                    signal.waitingCount--;
+                }
+                return;
+            }
+            unique_lock<mutex> lk(m_doneLock);
+            m_doneCv.wait(lk, [this] { return IsDone(); });
+        }
+
+        bool WaitFor(uint32_t millisec) override
+        {
+            unique_lock<mutex> lk(m_doneLock);
+            return m_doneCv.wait_for(lk, chrono::milliseconds(millisec), [this] { return IsDone(); });
+        }
+
+        Priority GetPriority() const override
+        {
+            return m_priority;
+        }
+
+        void Run(ALogger* logger)
+        {
+            int expected = PENDING;
+            if (!m_state.compare_exchange_strong(expected, RUNNING))
+                return;
+            try
+            {
+                m_proc();
+            }
+            catch (const exception& e)
+            {
+                logger->Log(Error) << "Exception is thrown while executing task! Message is '" << e.what() << "'." << endl;
+            }
+            m_proc = nullptr;
+            {
+                lock_guard<mutex> lk(m_doneLock);
+                m_state = DONE;
+            }
+            m_doneCv.notify_all();
+            m_hHelperSignal->NotifyIfWaiting();
+        }
+
+    private:
+        TaskProc m_proc;
+        Priority m_priority;
+        atomic_int m_state{PENDING};
+        mutex m_doneLock;
+        condition_variable m_doneCv;
+        HelperSignalHolder m_hHelperSignal;
+    };
+    using TaskImplHolder = shared_ptr<Task_Impl>;
+
+    class Loop_Impl : public Loop, public enable_shared_from_this<Loop_Impl>
+    {
+    public:
+        enum State
+        {
+            IDLE = 0,
+            SUBMITTED,
+            RUNNING,
+        };
+
+        Loop_Impl(TaskExecutor_Impl* owner, const LoopProc& proc, Priority priority, uint32_t idleMillisec)
+            : m_owner(owner), m_proc(proc), m_priority(priority), m_idleTime(idleMillisec) {}
+
+        void Start()
+        {
+            lock_guard<mutex> lk(m_lock);
+            SubmitIteration();
+        }
+
+        void Wakeup() override
+        {
+            lock_guard<mutex> lk(m_lock);
+            if (m_stopped)
+                return;
+            if (m_state == RUNNING)
+                m_wakeup = true;
+            else if (m_state == IDLE)
+                SubmitIteration();
+        }
+
+        void Stop() override
+        {
+            unique_lock<mutex> lk(m_lock);
+            m_stopped = true;
+            // an iteration which can not be cancelled any more sees 'm_stopped' before invoking 'm_proc'
+            if (m_state == SUBMITTED && m_hTask->Cancel())
+            {
+                m_state = IDLE;
+                m_hTask = nullptr;
+            }
+            if (_CURR_LOOP != this)
+                m_stoppedCv.wait(lk, [this] { return m_state != RUNNING; });
+        }
+
+        bool IsStopped() const override
+        {
+            lock_guard<mutex> lk(m_lock);
+            return m_stopped;
+        }
+
+        void OnTimer(uint64_t timerGen)
+        {
+            lock_guard<mutex> lk(m_lock);
+            if (!m_stopped && m_state == IDLE && timerGen == m_timerGen)
+                SubmitIteration();
+        }
+
+    private:
+        // must be invoked with 'm_lock' locked
+        void SubmitIteration()
+        {
+            auto hLoop = shared_from_this();
+            m_state = SUBMITTED;
+            m_hTask = m_owner->Submit([hLoop] { hLoop->RunIteration(); }, m_priority);
+        }
+
+        void RunIteration()
+        {
+            {
+                lock_guard<mutex> lk(m_lock);
+                m_hTask = nullptr;
+                if (m_stopped)
+                {
+                    m_state = IDLE;
+                    m_stoppedCv.notify_all();
+                    return;
+                }
+                m_state = RUNNING;
+                m_wakeup = false;
+            }
+            // a waiting task may run the iteration of another loop inside this one
+            auto pPrevLoop = _CURR_LOOP;
+            _CURR_LOOP = this;
+            bool busy = false;
+            try
+            {
+                busy = m_proc();
+            }
+            catch (const exception& e)
+            {
+                m_owner->m_logger->Log(Error) << "Exception is thrown while executing loop! Message is '" << e.what() << "'." << endl;
+            }
+            _CURR_LOOP = pPrevLoop;
+            // notify with the lock held, the object running this loop may be destroyed once 'Stop()' returns
+            lock_guard<mutex> lk(m_lock);
+            m_state = IDLE;
+            if (!m_stopped)
+            {
+                if (busy || m_wakeup)
+                    SubmitIteration();
+                else
+                    m_owner->AddTimer(shared_from_this(), ++m_timerGen, m_idleTime);
+            }
+            m_stoppedCv.notify_all();
+        }
+
+    private:
+        TaskExecutor_Impl* m_owner;
+        LoopProc m_proc;
+        Priority m_priority;
+        uint32_t m_idleTime;
+        mutable mutex m_lock;
+        condition_variable m_stoppedCv;
+        State m_state{IDLE};
+        bool m_stopped{false};
+        bool m_wakeup{false};
+        uint64_t m_timerGen{0};
+        Task::Holder m_hTask;
+    };
+    using LoopImplHolder = shared_ptr<Loop_Impl>;
+
+    struct TimerItem
+    {
+        chrono::steady_clock::time_point dueTime;
+        weak_ptr<Loop_Impl> wpLoop;
+        uint64_t timerGen;
+
+        // 'priority_queue' keeps the largest item on top, so the earliest due time is the largest
+        bool operator<(const TimerItem& b) const
+        { return dueTime > b.dueTime; }
+    };
+
+    // resume the idle loop after 'millisec', unless it's woken up or stopped before that
+    void AddTimer(const LoopImplHolder& hLoop, uint64_t timerGen, uint32_t millisec)
+    {
+        {
+            lock_guard<mutex> lk(m_timerLock);
+            m_timerQ.push({chrono::steady_clock::now()+chrono::milliseconds(millisec), hLoop, timerGen});
+        }
+        m_timerCv.notify_one();
+    }
+
+    void TimerThreadProc()
+    {
+        unique_lock<mutex> lk(m_timerLock);
+        while (!m_quit)
+        {
+            if (m_timerQ.empty())
+            {
+                m_timerCv.wait(lk);
+                continue;
+            }
+            const auto dueTime = m_timerQ.top().dueTime;
+            if (chrono::steady_clock::now() < dueTime)
+            {
+                m_timerCv.wait_until(lk, dueTime);
+                continue;
+            }
+            auto item = m_timerQ.top();
+            m_timerQ.pop();
+            lk.unlock();
+            auto hLoop = item.wpLoop.lock();
+            if (hLoop)
+                hLoop->OnTimer(item.timerGen);
+            lk.lock();
+        }
+    }
+
+    struct Worker
+    {
+        thread thd;
+        deque<TaskImplHolder> taskQ[PRIORITY_COUNT];
+        mutex lock;
+    };
+
+    TaskImplHolder PopTask(Worker* worker, int priority, bool steal)
+    {
+        lock_guard<mutex> lk(worker->lock);
+        auto& q = worker->taskQ[priority];
+        if (q.empty())
+            return nullptr;
+        TaskImplHolder hTask;
+        if (steal)
+        {
+            hTask = q.back();
+            q.pop_back();
+        }
+        else
+        {
+            hTask = q.front();
+            q.pop_front();
+        }
+        return hTask;
+    }
+
+    TaskImplHolder PickTask(uint32_t workerIdx, Priority lowestPriority = PRIORITY_BACKGROUND)
+    {
+        const uint32_t workerCnt = m_workers.size();
+        // a higher priority task in any queue is preferred to a lower priority one in the own queue
+        for (int p = PRIORITY_INTERACTIVE; p <= lowestPriority; p++)
+        {
+            if (m_pendingTaskCount[p].load() == 0)
+                continue;
+            for (uint32_t i = 0; i < workerCnt; i++)
+            {
+                const uint32_t idx = (workerIdx+i)%workerCnt;
+                auto hTask = PopTask(m_workers[idx].get(), p, i > 0);
+                if (hTask)
+                {
+                    m_pendingTaskCount[p]--;
+                    {
+                        lock_guard<mutex> lk(m_idleLock);
+                        m_totalPendingCount--;
+                    }
+                    return hTask;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void WorkerThreadProc(uint32_t workerIdx)
+    {
+        _CURR_WORKER_INFO.executor = this;
+        _CURR_WORKER_INFO.index = workerIdx;
+        while (!m_quit)
+        {
+            auto hTask = PickTask(workerIdx);
+            if (hTask)
+            {
+                hTask->Run(m_logger);
+                continue;
+            }
+            unique_lock<mutex> lk(m_idleLock);
+            m_idleCv.wait(lk, [this] { return m_quit || m_totalPendingCount > 0; });
+        }
+        _CURR_WORKER_INFO.executor = nullptr;
+    }
+
+private:
+    ALogger* m_logger;
+    string m_name;
+    vector<unique_ptr<Worker>> m_workers;
+    atomic_uint32_t m_nextWorkerIdx{0};
+    atomic_uint32_t m_pendingTaskCount[PRIORITY_COUNT];
+    uint32_t m_totalPendingCount{0};
+    mutex m_idleLock;
+    condition_variable m_idleCv;
+    HelperSignalHolder m_hHelperSignal;
+    thread m_timerThread;
+    priority_queue<TimerItem> m_timerQ;
+    mutex m_timerLock;
+    condition_variable m_timerCv;
+    atomic_bool m_quit{false};
+};
+
+static const auto TASK_EXECUTOR_DELETER = [] (TaskExecutor* p) {
+    TaskExecutor_Impl* ptr = dynamic_cast<TaskExecutor_Impl*>(p);
+    delete ptr;
+};
+
+TaskExecutor::Holder TaskExecutor::CreateInstance(uint32_t threadCount, const string& name)
+{
+    return TaskExecutor::Holder(new TaskExecutor_Impl(threadCount, name), TASK_EXECUTOR_DELETER);
+}
+
+static TaskExecutor::Holder _DEFAULT_TASK_EXECUTOR;
+static uint32_t _DEFAULT_TASK_EXECUTOR_THREAD_COUNT = 0;
+static mutex _DEFAULT_TASK_EXECUTOR_ACCESS_LOCK;
+
+TaskExecutor::Holder TaskExecutor::GetDefaultInstance()
+{
+    lock_guard<mutex> lk(_DEFAULT_TASK_EXECUTOR_ACCESS_LOCK);
+    if (!_DEFAULT_TASK_EXECUTOR)
+        _DEFAULT_TASK_EXECUTOR = TaskExecutor::CreateInstance(_DEFAULT_TASK_EXECUTOR_THREAD_COUNT, "McExec");
+    return _DEFAULT_TASK_EXECUTOR;
+}
+
+void TaskExecutor::SetDefaultThreadCount(uint32_t threadCount)
+{
+    lock_guard<mutex> lk(_DEFAULT_TASK_EXECUTOR_ACCESS_LOCK);
+    _DEFAULT_TASK_EXECUTOR_THREAD_COUNT = threadCount;
+}
+
+static TaskExecutor::Holder _IO_TASK_EXECUTOR;
+static uint32_t _IO_TASK_EXECUTOR_THREAD_COUNT = 2;
+
+TaskExecutor::Holder TaskExecutor::GetIoInstance()
+{
+    lock_guard<mutex> lk(_DEFAULT_TASK_EXECUTOR_ACCESS_LOCK);
+    if (!_IO_TASK_EXECUTOR)
+        _IO_TASK_EXECUTOR = TaskExecutor::CreateInstance(_IO_TASK_EXECUTOR_THREAD_COUNT, "McIoExec");
+    return _IO_TASK_EXECUTOR;
+}
+
+void TaskExecutor::SetIoThreadCount(uint32_t threadCount)
+{
+    lock_guard<mutex> lk(_DEFAULT_TASK_EXECUTOR_ACCESS_LOCK);
+    _IO_TASK_EXECUTOR_THREAD_COUNT = threadCount > 0 ? threadCount : 1;
+}
+
+void TaskExecutor::ParallelFor(Holder hExecutor, int32_t itemCount, const ParallelProc& proc, Priority priority)
+{
+    if (itemCount <= 0)
+        return;
+    atomic_int32_t nextItem{0};
+    const ItemFetcher fetchItem = [&nextItem, itemCount] (int32_t& item) {
+        item = nextItem++;
+        return item < itemCount;
+    };
+    vector<Task::Holder> tasks;
+    if (hExecutor && itemCount > 1)
+    {
+        const int32_t taskCount = min((int32_t)hExecutor->GetThreadCount(), itemCount)-1;
+        tasks.reserve(taskCount);
+        for (int32_t i = 0; i < taskCount; i++)
+            tasks.push_back(hExecutor->Submit([&proc, &fetchItem] { proc(fetchItem); }, priority));
+    }
+    proc(fetchItem);
+    // the tasks not started yet have nothing left to do
+    for (auto& hTask : tasks)
+    {
+        if (!hTask->Cancel())
+            hTask->Wait();
+    }
+}
+}
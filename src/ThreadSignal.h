@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+namespace MediaCore
+{
+// Auto-reset event used to wake up a worker thread when its input state changes.
+// A notification is latched until it is consumed by 'Wait()/WaitFor()', so a producer
+// signaling before the consumer starts waiting will not be lost.
+class ThreadSignal
+{
+public:
+    ThreadSignal() = default;
+    ThreadSignal(const ThreadSignal&) = delete;
+    ThreadSignal& operator=(const ThreadSignal&) = delete;
+
+    void Notify()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_signaled = true;
+        }
+        m_cv.notify_all();
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        m_cv.wait(lk, [this] { return m_signaled; });
+        m_signaled = false;
+    }
+
+    // return true if woken up by 'Notify()', false if the timeout is reached
+    bool WaitFor(uint32_t millisec)
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        const bool signaled = m_cv.wait_for(lk, std::chrono::milliseconds(millisec), [this] { return m_signaled; });
+        m_signaled = false;
+        return signaled;
+    }
+
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_signaled = false;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_signaled{false};
+};
+
+// Event for a state waited by several threads, e.g. the frames ready for the callers of a reader. A notification wakes
+// up all the waiters instead of being consumed by one of them. A waiter takes the 'Sequence()' before checking the
+// state, then waits for the sequence to be changed, so a notification in between is not lost.
+class BroadcastSignal
+{
+public:
+    BroadcastSignal() = default;
+    BroadcastSignal(const BroadcastSignal&) = delete;
+    BroadcastSignal& operator=(const BroadcastSignal&) = delete;
+
+    void Notify()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_seq++;
+        }
+        m_cv.notify_all();
+    }
+
+    uint64_t Sequence() const
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        return m_seq;
+    }
+
+    // return true if 'Notify()' is called after 'seq' is taken, false if the timeout is reached
+    bool WaitFor(uint64_t seq, uint32_t millisec)
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        return m_cv.wait_for(lk, std::chrono::milliseconds(millisec), [this, seq] { return m_seq != seq; });
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    uint64_t m_seq{0};
+};
+}
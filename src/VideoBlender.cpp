@@ -15,12 +15,16 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <cstring>
 #include "VideoBlender.h"
 #include <imconfig.h>
 #if IMGUI_VULKAN_SHADER
 #include <imvk_mat.h>
 #include <AlphaBlending_vulkan.h>
 #endif
+#include "AlphaCompositor.h"
+#include "FramePool.h"
+#include "TaskExecutor.h"
 #include "FFUtils.h"
 #include "Logger.h"
 
@@ -39,6 +43,8 @@ public:
 #else
         m_useVulkan = false;
 #endif
+        m_logger = GetLogger("VideoBlender");
+        m_logger->Log(DEBUG) << "Use '" << m_cpuCompositor.GetKernelName() << "' kernels for cpu blending." << endl;
     }
 
     ImGui::ImMat Blend(ImGui::ImMat& baseImage, ImGui::ImMat& overlayImage, int32_t x, int32_t y, float fOpacity) override
@@ -70,7 +76,7 @@ public:
         }
         else
         {
-            res = m_ffBlender.Blend(baseImage, overlayImage, x, y);
+            res = BlendOnCpu(baseImage, overlayImage, x, y, fOpacity);
         }
         return res;
     }
@@ -104,7 +110,7 @@ public:
         }
         else
         {
-            res = m_ffBlender.Blend(baseImage, overlayImage, m_ovlyX, m_ovlyY);
+            res = BlendOnCpu(baseImage, overlayImage, m_ovlyX, m_ovlyY, fOpacity);
         }
         return res;
     }
@@ -134,7 +140,48 @@ public:
         }
         else
         {
-            throw runtime_error("NOT SUPPORTED!");
+            if (!m_cpuCompositor.Composite(res, baseImage, overlayImage, m_ovlyX, m_ovlyY, 1.f, m_alphaMode == ALPHA_PREMULTIPLIED, &alphaMat))
+            {
+                m_errMsg = m_cpuCompositor.GetError();
+                throw runtime_error("Blending with alpha mask is NOT SUPPORTED! "+m_errMsg);
+            }
+            CopyFrameAttributes(res, baseImage);
+        }
+        return res;
+    }
+
+    ImGui::ImMat BlendLayers(const vector<Layer>& layers, uint32_t width, uint32_t height, ImDataType dtype) override
+    {
+        if (layers.empty())
+            return ImGui::ImMat();
+        const auto& bottom = layers.front();
+        const bool bottomIsOpaqueFrame = bottom.x == 0 && bottom.y == 0 && bottom.image.w == (int)width && bottom.image.h == (int)height && bottom.opacity >= 1.f;
+        // a single opaque frame is returned as is, no copy is needed
+        if (layers.size() == 1 && bottomIsOpaqueFrame)
+            return bottom.image;
+
+        ImGui::ImMat res;
+        if (!m_useVulkan && BlendLayersOnCpu(res, layers, width, height, dtype))
+            return res;
+
+        // blend the layers one by one
+        for (const auto& layer : layers)
+        {
+            if (layer.image.empty())
+                continue;
+            if (res.empty())
+            {
+                if (&layer == &bottom && bottomIsOpaqueFrame)
+                {
+                    res = layer.image;
+                    continue;
+                }
+                res.create_type(width, height, 4, dtype);
+                memset(res.data, 0, res.total()*res.elemsize);
+                CopyFrameAttributes(res, layer.image);
+            }
+            ImGui::ImMat ovly = layer.image;
+            res = Blend(res, ovly, layer.x, layer.y, layer.opacity);
         }
         return res;
     }
@@ -154,17 +201,78 @@ public:
         return true;
     }
 
+    void SetAlphaMode(AlphaMode mode) override
+    {
+        m_alphaMode = mode;
+    }
+
+    AlphaMode GetAlphaMode() const override
+    {
+        return m_alphaMode;
+    }
+
     std::string GetError() const override
     {
         return m_errMsg;
     }
 
 private:
+    ImGui::ImMat BlendOnCpu(ImGui::ImMat& baseImage, ImGui::ImMat& overlayImage, int32_t x, int32_t y, float fOpacity)
+    {
+        ImGui::ImMat res;
+        if (m_cpuCompositor.Composite(res, baseImage, overlayImage, x, y, fOpacity, m_alphaMode == ALPHA_PREMULTIPLIED))
+        {
+            CopyFrameAttributes(res, baseImage);
+            return res;
+        }
+        // fall back to the ffmpeg 'overlay' filter for the images the compositor can not handle, e.g. images of different data types
+        m_logger->Log(VERBOSE) << "Cpu compositor is NOT applicable: " << m_cpuCompositor.GetError() << " Use 'FFOverlayBlender' instead." << endl;
+        return m_ffBlender.Blend(baseImage, overlayImage, x, y);
+    }
+
+    bool BlendLayersOnCpu(ImGui::ImMat& res, const vector<Layer>& layers, uint32_t width, uint32_t height, ImDataType dtype)
+    {
+        vector<AlphaCompositor::Layer> cpuLayers;
+        cpuLayers.reserve(layers.size());
+        for (const auto& layer : layers)
+        {
+            if (layer.image.empty())
+                continue;
+            if (layer.image.device != IM_DD_CPU)
+                return false;
+            cpuLayers.push_back({ &layer.image, layer.x, layer.y, layer.opacity });
+        }
+        // the output buffer is taken from the frame pool, to avoid allocating a full frame for each mixed frame
+        if (!FramePool::GetDefaultInstance()->AcquireMat(res, width, height, 4, dtype))
+            res.create_type(width, height, 4, dtype);
+        if (!m_cpuCompositor.CompositeLayers(res, cpuLayers, m_alphaMode == ALPHA_PREMULTIPLIED, TaskExecutor::GetDefaultInstance()))
+        {
+            m_logger->Log(VERBOSE) << "Cpu compositor is NOT applicable: " << m_cpuCompositor.GetError() << " Blend the layers one by one instead." << endl;
+            res.release();
+            return false;
+        }
+        if (!cpuLayers.empty())
+            CopyFrameAttributes(res, *cpuLayers.front().image);
+        return true;
+    }
+
+    static void CopyFrameAttributes(ImGui::ImMat& dst, const ImGui::ImMat& src)
+    {
+        dst.time_stamp = src.time_stamp;
+        dst.duration = src.duration;
+        dst.color_space = src.color_space;
+        dst.color_range = src.color_range;
+    }
+
+private:
+    ALogger* m_logger;
     bool m_useVulkan;
+    AlphaMode m_alphaMode{ALPHA_STRAIGHT};
     int32_t m_ovlyX{0}, m_ovlyY{0};
 #if IMGUI_VULKAN_SHADER
     ImGui::AlphaBlending_vulkan m_vulkanBlender;
 #endif
+    AlphaCompositor m_cpuCompositor;
     FFOverlayBlender m_ffBlender;
     string m_errMsg;
 };
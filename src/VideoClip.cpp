@@ -15,6 +15,8 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <cmath>
+#include <algorithm>
 #include <imconfig.h>
 #if IMGUI_VULKAN_SHADER
 #include <ColorConvert_vulkan.h>
@@ -22,6 +24,11 @@
 #endif
 #include "VideoClip.h"
 #include "VideoTransformFilter.h"
+#include "ProxyManager.h"
+#include "FFUtils.h"
+#include "HashUtils.h"
+#include "MixedFrameCache.h"
+#include "MemoryBudget.h"
 #include "Logger.h"
 #include "DebugHelper.h"
 
@@ -72,9 +79,103 @@ struct FailedRead
 
 bool VideoClip::USE_HWACCEL = true;
 
+// A reverse decoder keeps the frames of one or two gops, its usage is also bounded by its quota from the budget
+static uint64_t GetDefaultReverseDecodeMemoryLimit()
+{
+    const uint64_t maxLimit = 256ULL*1024*1024;
+    const uint64_t budgetLimit = MemoryBudget::GetDefaultInstance()->GetLimit();
+    return budgetLimit > 0 ? min(budgetLimit/16, maxLimit) : maxLimit;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 // VideoClip_VideoImpl
 ///////////////////////////////////////////////////////////////////////////////////////////
+// Check if the output of the transform filter at 'pos' covers the whole canvas, assuming the input image is opaque.
+static bool IsTransformCoveringCanvas(const VideoTransformFilter* pWarpFilter, int64_t pos, uint32_t canvasWidth, uint32_t canvasHeight)
+{
+    if (pWarpFilter->GetOpacityMaskCount() > 0 || pWarpFilter->GetOpacity(pos) < 1.f)
+        return false;
+    ImVec2 aCornerPoints[4];
+    if (!pWarpFilter->CalcCornerPoints(pos, aCornerPoints))
+        return false;
+    // Without scaling and rotation the edges are pixel exact, otherwise the edge pixels are interpolated with
+    // the transparent border, so the canvas must be 1 pixel inside the edges.
+    const auto v2Scale = pWarpFilter->GetFinalScale(pos);
+    const bool bAxisAligned = abs(aCornerPoints[0].y-aCornerPoints[1].y) < 1e-3f && abs(aCornerPoints[1].x-aCornerPoints[2].x) < 1e-3f;
+    const float fMargin = bAxisAligned && v2Scale.x == 1.f && v2Scale.y == 1.f ? 0.f : 1.f;
+    // the corner points use the canvas center as the origin
+    const float fHalfW = (float)canvasWidth/2, fHalfH = (float)canvasHeight/2;
+    const ImVec2 aCanvasCorners[4] = { ImVec2(-fHalfW, -fHalfH), ImVec2(fHalfW, -fHalfH), ImVec2(fHalfW, fHalfH), ImVec2(-fHalfW, fHalfH) };
+    // the winding of the corner points is reversed if the image is flipped
+    float fArea = 0.f;
+    for (int i = 0; i < 4; i++)
+    {
+        const auto& a = aCornerPoints[i];
+        const auto& b = aCornerPoints[(i+1)%4];
+        fArea += a.x*b.y-b.x*a.y;
+    }
+    const float fWinding = fArea >= 0.f ? 1.f : -1.f;
+    for (int i = 0; i < 4; i++)
+    {
+        const auto& a = aCornerPoints[i];
+        const auto& b = aCornerPoints[(i+1)%4];
+        const float fEdgeX = b.x-a.x, fEdgeY = b.y-a.y;
+        const float fEdgeLen = sqrt(fEdgeX*fEdgeX+fEdgeY*fEdgeY);
+        if (fEdgeLen < 1.f)
+            return false;
+        for (const auto& p : aCanvasCorners)
+        {
+            const float fDist = (fEdgeX*(p.y-a.y)-fEdgeY*(p.x-a.x))/fEdgeLen*fWinding;
+            if (fDist < fMargin)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Hash the transform parameters at 'pos', the corner points cover the position, the scale, the rotation and the aspect fit type.
+static uint64_t HashTransformState(uint64_t seed, const VideoTransformFilter* pWarpFilter, int64_t pos)
+{
+    ImVec2 aCornerPoints[4];
+    if (pWarpFilter->CalcCornerPoints(pos, aCornerPoints))
+    {
+        for (const auto& pt : aCornerPoints)
+        {
+            seed = HashCombineFloat(seed, pt.x);
+            seed = HashCombineFloat(seed, pt.y);
+        }
+    }
+    seed = HashCombineFloat(seed, pWarpFilter->GetCropRatioL(pos));
+    seed = HashCombineFloat(seed, pWarpFilter->GetCropRatioT(pos));
+    seed = HashCombineFloat(seed, pWarpFilter->GetCropRatioR(pos));
+    seed = HashCombineFloat(seed, pWarpFilter->GetCropRatioB(pos));
+    seed = HashCombineFloat(seed, pWarpFilter->GetOpacity(pos));
+    seed = HashCombine(seed, (uint64_t)pWarpFilter->GetOpacityMaskCount());
+    return seed;
+}
+
+// Run the external filter, the output is taken from 'filterCache' if it is there with the same 'cacheHash'.
+static VideoFrame::Holder FilterImageWithCache(VideoFilter* pFilter, MixedFrameCache& filterCache, int64_t cacheKey, uint64_t cacheHash,
+        VideoFrame::Holder hInVf, int64_t pos, const unordered_map<string, string>* pExtraArgs)
+{
+    // the preview frames of scrubbing skip the filter, see 'ReadFrameTask::IsPreview()'
+    if (pExtraArgs)
+    {
+        auto iter = pExtraArgs->find("bypass_filter");
+        if (iter != pExtraArgs->end() && iter->second == "true")
+            return hInVf;
+    }
+    // the extra arguments may change the output, the frames filtered with them are not cached
+    const bool useCache = filterCache.IsEnabled() && !pExtraArgs;
+    ImGui::ImMat tImgMat;
+    if (useCache && filterCache.Get(cacheKey, cacheHash, tImgMat))
+        return VideoFrame::CreateMatInstance(tImgMat);
+    auto hOutVfrm = pFilter->FilterImage(hInVf, pos, pExtraArgs);
+    if (hOutVfrm && useCache && hOutVfrm->GetMat(tImgMat) && !tImgMat.empty())
+        filterCache.Put(cacheKey, cacheHash, tImgMat);
+    return hOutVfrm;
+}
+
 class VideoClip_VideoImpl : public VideoClip
 {
 public:
@@ -98,15 +199,10 @@ public:
         auto vidStm = hParser->GetBestVideoStream();
         if (vidStm->isImage)
             throw invalid_argument("This video stream is an IMAGE, it should be instantiated with a 'VideoClip_ImageImpl' instance!");
+        m_hParser = hParser;
+        m_srcHasAlpha = IsPixelFormatWithAlpha(GetAVPixelFormatByName(vidStm->format));
         loggerNameOss.str(""); loggerNameOss << "VRdr-" << fileName.substr(0, 4) << "-" << idstr;
-        if (hParser->IsImageSequence())
-            m_hReader = MediaReader::CreateImageSequenceInstance(loggerNameOss.str());
-        else
-            m_hReader = MediaReader::CreateVideoInstance(loggerNameOss.str());
-        // m_hReader->SetLogLevel(DEBUG);
-        m_hReader->EnableHwAccel(VideoClip::USE_HWACCEL);
-        if (!m_hReader->Open(hParser))
-            throw runtime_error(m_hReader->GetError());
+        m_readerLoggerName = loggerNameOss.str();
         uint32_t readerWidth, readerHeight;
         if (hSettings->IsVideoSrcKeepOriginalSize())
         {
@@ -135,13 +231,12 @@ public:
             interpMode = IM_INTERPOLATE_AREA;
         m_outClrfmt = hSettings->VideoOutColorFormat();
         m_outDtype = hSettings->VideoOutDataType();
-        if (!m_hReader->ConfigVideoReader(readerWidth, readerHeight, m_outClrfmt, m_outDtype, interpMode, hSettings->GetHwaccelManager()))
-            throw runtime_error(m_hReader->GetError());
         const auto frameRate = hSettings->VideoOutFrameRate();
         if (frameRate.num <= 0 || frameRate.den <= 0)
             throw invalid_argument("Invalid argument value for 'frameRate'!");
         m_frameRate = frameRate;
-        m_srcDuration = static_cast<int64_t>(m_hReader->GetVideoStream()->duration*1000);
+        // the duration is always taken from the original stream, the proxy may end a little earlier
+        m_srcDuration = static_cast<int64_t>(vidStm->duration*1000);
         if (startOffset < 0)
             throw invalid_argument("Argument 'startOffset' can NOT be NEGATIVE!");
         if (endOffset < 0)
@@ -151,14 +246,25 @@ public:
         m_startOffset = startOffset;
         m_endOffset = endOffset;
         m_padding = (end-start)+startOffset+endOffset-m_srcDuration;
-        m_hReader->SetDirection(forward);
         auto seekPos = startOffset;
         if (seekPos >= m_srcDuration) seekPos = m_srcDuration;
-        if (!m_hReader->SeekTo(seekPos))
-            throw runtime_error(m_hReader->GetError());
         bool suspend = readpos < -m_wakeupRange || readpos > Duration()+m_wakeupRange;
-        if (!m_hReader->Start(suspend))
-            throw runtime_error(m_hReader->GetError());
+        auto hProxyParser = GetProxyParser(hSettings, readerWidth, readerHeight);
+        if (hProxyParser)
+        {
+            try
+            {
+                m_hReader = CreateReader(hProxyParser, readerWidth, readerHeight, interpMode, hSettings->GetHwaccelManager(), forward, seekPos, suspend);
+                m_isReadingProxy = true;
+                m_logger->Log(DEBUG) << "Read from proxy '" << hProxyParser->GetUrl() << "'." << endl;
+            }
+            catch (const runtime_error& e)
+            {
+                m_logger->Log(WARN) << "FAILED to read from proxy '" << hProxyParser->GetUrl() << "', use the original file. Error is '" << e.what() << "'." << endl;
+            }
+        }
+        if (!m_hReader)
+            m_hReader = CreateReader(hParser, readerWidth, readerHeight, interpMode, hSettings->GetHwaccelManager(), forward, seekPos, suspend);
         m_hWarpFilter = VideoTransformFilter::CreateInstance();
         if (!m_hWarpFilter->Initialize(hSettings))
             throw runtime_error(m_hWarpFilter->GetError());
@@ -173,7 +279,7 @@ public:
 
     MediaParser::Holder GetMediaParser() const override
     {
-        return m_hReader->GetMediaParser();
+        return m_hParser;
     }
 
     int64_t Id() const override
@@ -321,7 +427,7 @@ public:
         auto hFilter = m_hFilter;
         if (hFilter)
         {
-            hFilteredVfrm = hFilter->FilterImage(hInVf, pos);
+            hFilteredVfrm = FilterImageWithCache(hFilter.get(), m_filterCache, FilterCacheKey(pos), FilterCacheHash(pos), hInVf, pos, nullptr);
             if (hFilteredVfrm) hFilteredVfrm->GetMat(tImgMat);
             if (!hFilteredVfrm || tImgMat.empty())
                 return nullptr;
@@ -372,7 +478,7 @@ public:
         VideoFrame::Holder hFilteredVfrm;
         if (hFilter)
         {
-            hFilteredVfrm = hFilter->FilterImage(hInVf, pos, pExtraArgs);
+            hFilteredVfrm = FilterImageWithCache(hFilter.get(), m_filterCache, FilterCacheKey(pos), FilterCacheHash(pos), hInVf, pos, pExtraArgs);
             if (!hFilteredVfrm)
                 return nullptr;
         }
@@ -389,21 +495,50 @@ public:
         return hFilteredVfrm;
     }
 
-    void SeekTo(int64_t pos) override
+    void SeekTo(int64_t pos, bool bSeekingMode) override
     {
         if (pos < 0) pos = 0;
         else if (pos > Duration()) pos = Duration();
         auto seekPos = pos+m_startOffset;
         if (seekPos > m_srcDuration) seekPos = m_srcDuration;
-        if (seekPos != m_hReader->GetReadPos())
+        m_seekingPos = seekPos;
+        if (seekPos != m_hReader->GetReadPos() || bSeekingMode != m_bSeekingMode)
         {
-            m_logger->Log(DEBUG) << "-> VidClip.SeekTo(" << seekPos << ")" << endl;
-            if (!m_hReader->SeekTo(seekPos))
+            m_logger->Log(DEBUG) << "-> VidClip.SeekTo(" << seekPos << ", seekingMode=" << bSeekingMode << ")" << endl;
+            if (!m_hReader->SeekTo(seekPos, bSeekingMode))
                 throw runtime_error(m_hReader->GetError());
+            m_bSeekingMode = bSeekingMode;
             m_eof = false;
         }
     }
 
+    VideoFrame::Holder GetSeekingFlash() const override
+    {
+        if (!m_bSeekingMode)
+            return nullptr;
+        auto hVf = m_hReader->GetSeekingFlash();
+        // the flash may be left by a previous seek, which is outside the clip after trimming
+        if (!hVf || hVf->Pos() < m_startOffset || hVf->Pos() >= m_startOffset+Duration())
+            return nullptr;
+        // it's also stale if it's not in the gop of the current seek position, the decoding of that gop has not output any frame yet
+        const int64_t seekPos = m_seekingPos;
+        if (hVf->Pos() > seekPos)
+            return nullptr;
+        auto hSeekPoints = m_hReader->GetMediaParser()->GetVideoSeekPoints(false);
+        auto vidStm = m_hReader->GetVideoStream();
+        if (hSeekPoints && !hSeekPoints->empty() && vidStm && vidStm->timebase.den > 0)
+        {
+            const auto& tb = vidStm->timebase;
+            // the key frame at or before the seek position, the reader starts decoding from it
+            auto iter = upper_bound(hSeekPoints->begin(), hSeekPoints->end(), seekPos, [&tb, vidStm] (int64_t mts, int64_t pts) {
+                return mts < (double)(pts-vidStm->startPts)*1000*tb.num/tb.den;
+            });
+            if (iter != hSeekPoints->begin() && hVf->Pts() < *(--iter))
+                return nullptr;
+        }
+        return hVf;
+    }
+
     void NotifyReadPos(int64_t trackPos) override
     {
         auto clipPos = trackPos-m_start;
@@ -421,13 +556,45 @@ public:
             int64_t seekPos = clipPos < 0 ? 0 : (clipPos > dur ? dur : clipPos);
             seekPos += m_startOffset;
             if (seekPos > m_srcDuration) seekPos = m_srcDuration;
-            if (seekPos != m_hReader->GetReadPos())
+            if (seekPos != m_hReader->GetReadPos() || m_bSeekingMode)
                 m_hReader->SeekTo(seekPos);
+            m_bSeekingMode = false;
             m_hReader->Wakeup();
             m_logger->Log(DEBUG) << ">>>> Clip#" << m_id <<" is WAKEUP." << endl;
         }
     }
 
+    bool IsCoveringCanvas(int64_t pos) const override
+    {
+        if (m_srcHasAlpha || pos < 0 || pos >= Duration())
+            return false;
+        // no frame is read beyond the end of the source, the padding part is transparent
+        const int64_t frameDur = (int64_t)ceil((double)m_frameRate.den*1000/m_frameRate.num);
+        if (pos+m_startOffset+frameDur > m_srcDuration)
+            return false;
+        auto hFilter = m_hFilter;
+        if (hFilter && !hFilter->IsOpaquePreserving())
+            return false;
+        return IsTransformCoveringCanvas(m_hWarpFilter.get(), pos, m_hSettings->VideoOutWidth(), m_hSettings->VideoOutHeight());
+    }
+
+    uint64_t GetContentHash(int64_t pos) const override
+    {
+        const uint64_t urlHash = std::hash<string>()(m_hParser->GetUrl());
+        uint64_t hash = HashCombine(urlHash, (uint64_t)m_id);
+        // the source position instead of the clip position, so the trimming doesn't change the hash of the rest frames
+        hash = HashCombine(hash, (uint64_t)(pos+m_startOffset));
+        hash = HashCombine(hash, m_isReadingProxy ? 1 : 0);
+        hash = HashCombine(hash, m_filterRevision);
+        // the filter may depend on the clip range, e.g. fading out at the end
+        if (m_hFilter)
+        {
+            hash = HashCombine(hash, (uint64_t)pos);
+            hash = HashCombine(hash, (uint64_t)Duration());
+        }
+        return HashTransformState(hash, m_hWarpFilter.get(), pos);
+    }
+
     void SetDirection(bool forward) override
     {
         m_hReader->SetDirection(forward);
@@ -444,6 +611,8 @@ public:
         {
             m_hFilter = nullptr;
         }
+        m_filterRevision++;
+        m_filterCache.Clear();
     }
 
     VideoFilter::Holder GetFilter() const override
@@ -451,6 +620,38 @@ public:
         return m_hFilter;
     }
 
+    void SetFilterCacheCapacity(uint64_t maxBytes) override
+    {
+        m_filterCache.SetCapacity(maxBytes);
+    }
+
+    uint64_t GetFilterCacheCapacity() const override
+    {
+        return m_filterCache.GetCapacity();
+    }
+
+    void InvalidateFilterCache() override
+    {
+        m_filterRevision++;
+        m_filterCache.Clear();
+    }
+
+    bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) override
+    {
+        m_rvsDecMemLimit = maxBytes;
+        if (!m_hParser->IsImageSequence() && !m_hReader->SetReverseDecodeMemoryLimit(maxBytes))
+        {
+            m_logger->Log(WARN) << "FAILED to set the reverse-decode memory limit! Error is '" << m_hReader->GetError() << "'." << endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t GetReverseDecodeMemoryLimit() const override
+    {
+        return m_rvsDecMemLimit;
+    }
+
     VideoTransformFilter::Holder GetTransformFilter() override
     {
         return m_hWarpFilter;
@@ -482,10 +683,33 @@ public:
         ImInterpolateMode interpMode = IM_INTERPOLATE_BICUBIC;
         if (readerWidth*readerHeight < vidStm->width*vidStm->height)
             interpMode = IM_INTERPOLATE_AREA;
-        m_hReader->ChangeVideoOutputSize(readerWidth, readerHeight, interpMode);
+        // switch between the proxy and the original file if the new output size requires
+        auto hProxyParser = GetProxyParser(hSettings, readerWidth, readerHeight);
+        if ((bool)hProxyParser != m_isReadingProxy)
+        {
+            auto hNewParser = hProxyParser ? hProxyParser : m_hParser;
+            try
+            {
+                // the owner seeks the clip again after updating the settings, start at the beginning of the clip
+                m_hReader = CreateReader(hNewParser, readerWidth, readerHeight, interpMode, m_hSettings->GetHwaccelManager(),
+                        m_hReader->IsDirectionForward(), min(m_startOffset, m_srcDuration), m_hReader->IsSuspended());
+                m_isReadingProxy = (bool)hProxyParser;
+                m_bSeekingMode = false;
+                m_logger->Log(DEBUG) << "Switch to read from '" << hNewParser->GetUrl() << "'." << endl;
+            }
+            catch (const runtime_error& e)
+            {
+                m_logger->Log(WARN) << "FAILED to switch to read from '" << hNewParser->GetUrl() << "'! Error is '" << e.what() << "'." << endl;
+                m_hReader->ChangeVideoOutputSize(readerWidth, readerHeight, interpMode);
+            }
+        }
+        else
+            m_hReader->ChangeVideoOutputSize(readerWidth, readerHeight, interpMode);
         if (m_hFilter)
             m_hFilter = m_hFilter->Clone(hSettings);
         m_hWarpFilter = m_hWarpFilter->Clone(hSettings);
+        m_filterRevision++;
+        m_filterCache.Clear();
     }
 
     void SetLogLevel(Level l) override
@@ -493,23 +717,93 @@ public:
         m_logger->SetShowLevels(l);
     }
 
+private:
+    // Return the proxy parser if the reader output fits in the proxy. If there is no proxy yet, request to generate it
+    // when the automatic generation is enabled.
+    MediaParser::Holder GetProxyParser(SharedSettings::Holder hSettings, uint32_t readerWidth, uint32_t readerHeight)
+    {
+        if (!hSettings->IsVideoProxyEnabled() || hSettings->IsVideoSrcKeepOriginalSize() || m_hParser->IsImageSequence())
+            return nullptr;
+        auto hProxyMgr = ProxyManager::GetDefaultInstance();
+        uint32_t proxyWidth = 0, proxyHeight = 0;
+        auto hProxyParser = hProxyMgr->GetProxyParser(m_hParser, proxyWidth, proxyHeight);
+        if (!hProxyParser)
+        {
+            if (hProxyMgr->IsAutoGenerateEnabled())
+                hProxyMgr->RequestProxy(m_hParser);
+            return nullptr;
+        }
+        return readerWidth <= proxyWidth && readerHeight <= proxyHeight ? hProxyParser : nullptr;
+    }
+
+    // The filter cache is keyed by the source position, so the filtered frames are kept when the clip is trimmed.
+    // The filter input also includes the clip position and the duration, they are hashed with the filter revision.
+    int64_t FilterCacheKey(int64_t pos) const
+    {
+        return pos+m_startOffset;
+    }
+
+    uint64_t FilterCacheHash(int64_t pos) const
+    {
+        uint64_t hash = HashCombine((uint64_t)pos, (uint64_t)Duration());
+        hash = HashCombine(hash, m_isReadingProxy ? 1 : 0);
+        return HashCombine(hash, m_filterRevision);
+    }
+
+    MediaReader::Holder CreateReader(MediaParser::Holder hParser, uint32_t readerWidth, uint32_t readerHeight, ImInterpolateMode interpMode,
+            HwaccelManager::Holder hHwaMgr, bool forward, int64_t seekPos, bool suspend)
+    {
+        MediaReader::Holder hReader;
+        if (hParser->IsImageSequence())
+            hReader = MediaReader::CreateImageSequenceInstance(m_readerLoggerName);
+        else
+            hReader = MediaReader::CreateVideoInstance(m_readerLoggerName);
+        // hReader->SetLogLevel(DEBUG);
+        hReader->EnableHwAccel(VideoClip::USE_HWACCEL);
+        if (!hReader->Open(hParser))
+            throw runtime_error(hReader->GetError());
+        if (!hReader->ConfigVideoReader(readerWidth, readerHeight, m_outClrfmt, m_outDtype, interpMode, hHwaMgr))
+            throw runtime_error(hReader->GetError());
+        hReader->SetDirection(forward);
+        // the image sequence reader has no reverse decoder, its frames are decoded independently
+        if (!hParser->IsImageSequence() && !hReader->SetReverseDecodeMemoryLimit(m_rvsDecMemLimit))
+            throw runtime_error(hReader->GetError());
+        const int64_t readerDuration = static_cast<int64_t>(hReader->GetVideoStream()->duration*1000);
+        if (!hReader->SeekTo(seekPos < readerDuration ? seekPos : readerDuration))
+            throw runtime_error(hReader->GetError());
+        if (!hReader->Start(suspend))
+            throw runtime_error(hReader->GetError());
+        return hReader;
+    }
+
 private:
     ALogger* m_logger;
     int64_t m_id;
     int64_t m_trackId{-1};
     SharedSettings::Holder m_hSettings;
     MediaInfo::Holder m_hInfo;
+    MediaParser::Holder m_hParser;
     MediaReader::Holder m_hReader;
+    string m_readerLoggerName;
+    bool m_isReadingProxy{false};
+    bool m_srcHasAlpha{true};
     int64_t m_srcDuration;
     int64_t m_start;
     int64_t m_startOffset;
     int64_t m_endOffset;
     int32_t m_padding;
     bool m_eof{false};
+    atomic_bool m_bSeekingMode{false};
+    // the source position of the last seek, the seeking flash must be in the gop of it
+    atomic<int64_t> m_seekingPos{0};
     Ratio m_frameRate;
     uint32_t m_frameIndex{0};
     VideoFilter::Holder m_hFilter;
+    atomic<uint32_t> m_filterRevision{0};
+    MixedFrameCache m_filterCache{"VidClipFilterCache"};
     VideoTransformFilter::Holder m_hWarpFilter;
+    // initialized before the reader is created in the constructor
+    uint64_t m_rvsDecMemLimit{GetDefaultReverseDecodeMemoryLimit()};
     int64_t m_wakeupRange{1000};
     ImColorFormat m_outClrfmt{IM_CF_RGBA};
     ImDataType m_outDtype{IM_DT_FLOAT32};
@@ -532,8 +826,10 @@ VideoClip::Holder VideoClip::CreateVideoInstance(
 VideoClip::Holder VideoClip_VideoImpl::Clone(SharedSettings::Holder hSettings) const
 {
     VideoClip_VideoImpl* newInstance = new VideoClip_VideoImpl(
-        m_id, m_hReader->GetMediaParser(), hSettings, m_start, End(), m_startOffset, m_endOffset, 0, true);
+        m_id, m_hParser, hSettings, m_start, End(), m_startOffset, m_endOffset, 0, true);
     if (m_hFilter) newInstance->SetFilter(m_hFilter->Clone(hSettings));
+    newInstance->SetFilterCacheCapacity(m_filterCache.GetCapacity());
+    newInstance->SetReverseDecodeMemoryLimit(m_rvsDecMemLimit);
     newInstance->m_hWarpFilter = m_hWarpFilter->Clone(hSettings);
     newInstance->m_hWarpFilter->ApplyTo(newInstance);
     return VideoClip::Holder(newInstance, VIDEO_CLIP_HOLDER_VIDEOIMPL_DELETER);
@@ -553,6 +849,7 @@ public:
         auto vidStm = hParser->GetBestVideoStream();
         if (!vidStm->isImage)
             throw invalid_argument("This video stream is NOT an IMAGE, it should be instantiated with a 'VideoClip_VideoImpl' instance!");
+        m_srcHasAlpha = IsPixelFormatWithAlpha(GetAVPixelFormatByName(vidStm->format));
         m_hReader = MediaReader::CreateVideoInstance();
         if (!m_hReader->Open(hParser))
             throw runtime_error(m_hReader->GetError());
@@ -710,7 +1007,7 @@ public:
         auto hFilter = m_hFilter;
         if (hFilter)
         {
-            hFilteredVfrm = hFilter->FilterImage(hInVf, pos);
+            hFilteredVfrm = FilterImageWithCache(hFilter.get(), m_filterCache, FilterCacheKey(pos), FilterCacheHash(pos), hInVf, pos, nullptr);
             if (hFilteredVfrm) hFilteredVfrm->GetMat(tImgMat);
             if (!hFilteredVfrm || tImgMat.empty())
                 return nullptr;
@@ -751,7 +1048,7 @@ public:
         auto hFilter = m_hFilter;
         if (hFilter)
         {
-            hFilteredVfrm = hFilter->FilterImage(hInVf, pos, pExtraArgs);
+            hFilteredVfrm = FilterImageWithCache(hFilter.get(), m_filterCache, FilterCacheKey(pos), FilterCacheHash(pos), hInVf, pos, pExtraArgs);
             if (!hFilteredVfrm)
                 return nullptr;
         }
@@ -768,12 +1065,41 @@ public:
         return hFilteredVfrm;
     }
 
-    void SeekTo(int64_t pos) override
+    void SeekTo(int64_t pos, bool bSeekingMode) override
     {}
 
+    VideoFrame::Holder GetSeekingFlash() const override
+    {
+        // the image is decoded only once, it has no seeking flash
+        return nullptr;
+    }
+
     void NotifyReadPos(int64_t pos) override
     {}
 
+    bool IsCoveringCanvas(int64_t pos) const override
+    {
+        if (m_srcHasAlpha || pos < 0 || pos >= Duration())
+            return false;
+        auto hFilter = m_hFilter;
+        if (hFilter && !hFilter->IsOpaquePreserving())
+            return false;
+        return IsTransformCoveringCanvas(m_hWarpFilter.get(), pos, m_hSettings->VideoOutWidth(), m_hSettings->VideoOutHeight());
+    }
+
+    uint64_t GetContentHash(int64_t pos) const override
+    {
+        const uint64_t urlHash = std::hash<string>()(m_hReader->GetMediaParser()->GetUrl());
+        uint64_t hash = HashCombine(urlHash, (uint64_t)m_id);
+        hash = HashCombine(hash, m_filterRevision);
+        if (m_hFilter)
+        {
+            hash = HashCombine(hash, (uint64_t)pos);
+            hash = HashCombine(hash, (uint64_t)Duration());
+        }
+        return HashTransformState(hash, m_hWarpFilter.get(), pos);
+    }
+
     void SetDirection(bool forward) override
     {}
 
@@ -788,6 +1114,8 @@ public:
         {
             m_hFilter = nullptr;
         }
+        m_filterRevision++;
+        m_filterCache.Clear();
     }
 
     VideoFilter::Holder GetFilter() const override
@@ -795,6 +1123,33 @@ public:
         return m_hFilter;
     }
 
+    void SetFilterCacheCapacity(uint64_t maxBytes) override
+    {
+        m_filterCache.SetCapacity(maxBytes);
+    }
+
+    uint64_t GetFilterCacheCapacity() const override
+    {
+        return m_filterCache.GetCapacity();
+    }
+
+    void InvalidateFilterCache() override
+    {
+        m_filterRevision++;
+        m_filterCache.Clear();
+    }
+
+    bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) override
+    {
+        m_rvsDecMemLimit = maxBytes;
+        return true;
+    }
+
+    uint64_t GetReverseDecodeMemoryLimit() const override
+    {
+        return m_rvsDecMemLimit;
+    }
+
     VideoTransformFilter::Holder GetTransformFilter() override
     {
         return m_hWarpFilter;
@@ -830,12 +1185,26 @@ public:
         if (m_hFilter)
             m_hFilter = m_hFilter->Clone(hSettings);
         m_hWarpFilter = m_hWarpFilter->Clone(hSettings);
+        m_filterRevision++;
+        m_filterCache.Clear();
     }
 
     void SetLogLevel(Level l) override
     {
     }
 
+private:
+    // the source image is the same at any position, only the filter input varies with the position and the duration
+    int64_t FilterCacheKey(int64_t pos) const
+    {
+        return pos;
+    }
+
+    uint64_t FilterCacheHash(int64_t pos) const
+    {
+        return HashCombine((uint64_t)Duration(), m_filterRevision);
+    }
+
 private:
     int64_t m_id;
     int64_t m_trackId{-1};
@@ -843,10 +1212,14 @@ private:
     MediaInfo::Holder m_hInfo;
     MediaReader::Holder m_hReader;
     VideoFrame::Holder m_hVf;
+    bool m_srcHasAlpha{true};
     int64_t m_srcDuration;
     int64_t m_start;
     VideoFilter::Holder m_hFilter;
+    atomic<uint32_t> m_filterRevision{0};
+    MixedFrameCache m_filterCache{"VidClipFilterCache"};
     VideoTransformFilter::Holder m_hWarpFilter;
+    uint64_t m_rvsDecMemLimit{GetDefaultReverseDecodeMemoryLimit()};
     ImColorFormat m_outClrfmt{IM_CF_RGBA};
     ImDataType m_outDtype{IM_DT_FLOAT32};
 };
@@ -869,6 +1242,8 @@ VideoClip::Holder VideoClip_ImageImpl::Clone(SharedSettings::Holder hSettings) c
     VideoClip_ImageImpl* newInstance = new VideoClip_ImageImpl(
         m_id, m_hReader->GetMediaParser(), hSettings, m_start, m_srcDuration);
     if (m_hFilter) newInstance->SetFilter(m_hFilter->Clone(hSettings));
+    newInstance->SetFilterCacheCapacity(m_filterCache.GetCapacity());
+    newInstance->SetReverseDecodeMemoryLimit(m_rvsDecMemLimit);
     newInstance->m_hWarpFilter = m_hWarpFilter->Clone(hSettings);
     newInstance->m_hWarpFilter->ApplyTo(newInstance);
     return VideoClip::Holder(newInstance, VIDEO_CLIP_HOLDER_IMAGEIMPL_DELETER);
@@ -943,6 +1318,7 @@ public:
         m_logger = GetLogger(loggerNameOss.str());
         Update();
         m_hTrans->ApplyTo(this);
+        m_transRevision = ++s_transRevisionCounter;
     }
 
     int64_t Id() const override
@@ -1094,6 +1470,12 @@ public:
             defaultTrans->ApplyTo(this);
             m_hTrans = defaultTrans;
         }
+        m_transRevision = ++s_transRevisionCounter;
+    }
+
+    uint32_t TransitionRevision() const override
+    {
+        return m_transRevision;
     }
 
 private:
@@ -1104,8 +1486,12 @@ private:
     int64_t m_start{0};
     int64_t m_end{0};
     VideoTransition::Holder m_hTrans;
+    atomic<uint32_t> m_transRevision{0};
+    static atomic<uint32_t> s_transRevisionCounter;
 };
 
+atomic<uint32_t> VideoOverlap_Impl::s_transRevisionCounter{0};
+
 bool VideoOverlap::HasOverlap(VideoClip::Holder hClip1, VideoClip::Holder hClip2)
 {
     return (hClip1->Start() >= hClip2->Start() && hClip1->Start() < hClip2->End()) ||
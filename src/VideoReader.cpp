@@ -27,6 +27,10 @@
 #include "FFUtils.h"
 #include "ThreadUtils.h"
 #include "ConditionalMutex.h"
+#include "ThreadSignal.h"
+#include "TaskExecutor.h"
+#include "ReverseVideoDecoder.h"
+#include "MemoryBudget.h"
 #include "DebugHelper.h"
 extern "C"
 {
@@ -55,6 +59,7 @@ public:
             m_logger = GetVideoLogger();
         else
             m_logger = Logger::GetLogger(loggerName);
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
         int n;
         Level l = GetVideoLogger()->GetShowLevels(n);
         m_logger->SetShowLevels(l, n);
@@ -232,6 +237,9 @@ public:
             m_viddecDevType = AV_HWDEVICE_TYPE_NONE;
         }
         m_vidAvStm = nullptr;
+        m_hRvsDecoder = nullptr;
+        m_rvsDecActive = false;
+        m_hMemConsumer = nullptr;
         m_readPts = 0;
         m_prevReadResult = {0., nullptr};
         m_readForward = true;
@@ -250,6 +258,7 @@ public:
     void Close() override
     {
         m_close = true;
+        m_vfrmReadySignal.Notify();
         lock_guard<recursive_mutex> lk(m_apiLock);
         WaitAllThreadsQuit();
         FlushAllQueues();
@@ -271,6 +280,9 @@ public:
         }
         m_vidStmIdx = -1;
         m_vidAvStm = nullptr;
+        m_hRvsDecoder = nullptr;
+        m_rvsDecActive = false;
+        m_hMemConsumer = nullptr;
         m_hParser = nullptr;
         m_hMediaInfo = nullptr;
         m_readPts = 0;
@@ -310,11 +322,13 @@ public:
         lock_guard<mutex> lk(m_seekPosLock);
         m_bSeekingMode = bSeekingMode;
         if (!bSeekingMode) m_hSeekingFlash = nullptr;
+        UpdateReverseDecodeState();
         m_seekPts = CvtMtsToPts(pos);
                 m_inSeeking = true;
         m_seekPosUpdated = true;
         if (m_prepared)
             UpdateReadPts(m_seekPts);
+        WakeupLoop(m_hDemuxLoop);
         return true;
     }
 
@@ -329,6 +343,11 @@ public:
             return;
         }
         m_readForward = forward;
+        {
+            lock_guard<mutex> _lk(m_seekPosLock);
+            UpdateReverseDecodeState();
+        }
+        NotifyWorkerThreads();
         m_logger->Log(DEBUG) << "---> Direction changed: forward=" << forward << endl;
     }
 
@@ -344,6 +363,11 @@ public:
             return;
 
         ReleaseVideoResource();
+        if (m_hMemConsumer)
+        {
+            m_hMemConsumer->SetPriority(MemoryBudget::PRIORITY_IDLE);
+            m_hMemConsumer->UpdateUsage(0);
+        }
     }
 
     void Wakeup() override
@@ -437,7 +461,11 @@ public:
         }
         if (m_readForward && pts > m_readPts || !m_readForward && pts < m_readPts)
             UpdateReadPts(pts);
+        if (m_hMemConsumer)
+            m_hMemConsumer->Touch();
         m_logger->Log(DEBUG) << ">> TO READ frame: pts=" << pts << ", ts=" << pos << "." << endl;
+        if (m_rvsDecActive)
+            return ReadVideoFrameByPtsReverse(pts, pos, wait);
 
         auto wait1 = GetTimePoint();
         auto wait0 = wait1;
@@ -445,6 +473,7 @@ public:
         VideoFrame::Holder hVfrm;
         while (!m_quitThread)
         {
+            const auto readySeq = m_vfrmReadySignal.Sequence();
             // if (pts < m_cacheRange.first || pts > m_cacheRange.second)
             //     break;
             if (!m_inSeeking)
@@ -476,7 +505,7 @@ public:
             }
             if (!wait)
                 break;
-            this_thread::sleep_for(chrono::milliseconds(2));
+            m_vfrmReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
             auto wait2 = GetTimePoint();
             if (CountElapsedMillisec(wait1, wait2) > 3000)
             {
@@ -524,6 +553,19 @@ public:
         lock_guard<recursive_mutex> lk(m_apiLock);
         int64_t i64CurrFramePts, i64NextFramePts;
         const auto& prevReadResult = m_prevReadResult;
+        if (m_rvsDecActive)
+        {
+            // under reverse-decode mode, the next frame is the one right before the previous read frame
+            if (!prevReadResult.second)
+                return ReadVideoFrameByPts(m_readPts, eof, wait);
+            auto pVf = dynamic_cast<VideoFrame_Impl*>(prevReadResult.second.get());
+            if (pVf && pVf->isStartFrame)
+            {
+                eof = true;
+                return nullptr;
+            }
+            return ReadVideoFrameByPts(prevReadResult.second->Pts()-1, eof, wait);
+        }
         if (prevReadResult.second)
             i64CurrFramePts = prevReadResult.second->Pts();
         else
@@ -531,6 +573,7 @@ public:
         bool bFoundNextFrame = false;
         while (!m_quitThread)
         {
+            const auto readySeq = m_vfrmReadySignal.Sequence();
             {
                 lock_guard<mutex> _lk(m_vfrmQLock);
                 if (!m_vfrmQ.empty())
@@ -581,7 +624,7 @@ public:
             }
             if (!wait)
                 break;
-            this_thread::sleep_for(chrono::milliseconds(5));
+            m_vfrmReadySignal.WaitFor(readySeq, THREAD_IDLE_TIME);
         }
         if (!bFoundNextFrame)
             return nullptr;
@@ -640,6 +683,21 @@ public:
             m_backwardCacheFrameCount.first = forwardFrames;
             m_backwardCacheFrameCount.second = backwardFrames;
         }
+        UpdateMemoryDemand();
+        return true;
+    }
+
+    bool SetReverseDecodeMemoryLimit(uint64_t maxBytes) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_rvsDecMemLimit = maxBytes;
+        if (m_hRvsDecoder)
+            m_hRvsDecoder->SetMemoryLimit(maxBytes);
+        {
+            lock_guard<mutex> _lk(m_seekPosLock);
+            UpdateReverseDecodeState();
+        }
+        NotifyWorkerThreads();
         return true;
     }
 
@@ -871,6 +929,7 @@ private:
             m_avfmtCtx = nullptr;
         }
         m_vidAvStm = nullptr;
+        m_hRvsDecoder = nullptr;
 
         m_prepared = false;
     }
@@ -1008,6 +1067,7 @@ private:
         }
 
         m_hParser->GetVideoSeekPoints();
+        RegisterMemoryConsumer();
         m_prepared = true;
         {
             lock_guard<mutex> lk(m_seekPosLock);
@@ -1017,43 +1077,44 @@ private:
         return true;
     }
 
+    // The demuxing, decoding and hw-frame transferring loops run on the shared executor. They are started and
+    // stopped with 'm_apiLock' held, and the demuxing loop can not prepare before the lock is released.
     void StartAllThreads()
     {
-        string fileName = SysUtils::ExtractFileName(m_hParser->GetUrl());
-        ostringstream thnOss;
         m_quitThread = false;
-        m_dmxThdRunning = true;
-        m_demuxThread = thread(&VideoReader_Impl::DemuxThreadProc, this);
-        thnOss << "VrdrDmx-" << fileName;
-        SysUtils::SetThreadName(m_demuxThread, thnOss.str());
-        m_decThdRunning = true;
-        m_decodeThread = thread(&VideoReader_Impl::DecodeThreadProc, this);
-        thnOss.str(""); thnOss << "VrdrDec-" << fileName;
-        SysUtils::SetThreadName(m_decodeThread, thnOss.str());
-        m_cnvThdRunning = true;
-        m_cnvMatThread = thread(&VideoReader_Impl::ConvertMatThreadProc, this);
-        thnOss.str(""); thnOss << "VrdrCmt-" << fileName;
-        SysUtils::SetThreadName(m_cnvMatThread, thnOss.str());
+        m_demuxState = DemuxLoopState();
+        m_demuxState.readForward = m_readForward;
+        m_decodeState = DecodeLoopState();
+        atomic_store(&m_hCnvMatLoop, m_hExecutor->StartLoop([this] { return ConvertMatStep(); }));
+        atomic_store(&m_hDecodeLoop, m_hExecutor->StartLoop([this] { return DecodeStep(); }));
+        atomic_store(&m_hDemuxLoop, m_hExecutor->StartLoop([this] { return DemuxStep(); }));
     }
 
     void WaitAllThreadsQuit(bool callFromReleaseProc = false)
     {
         m_quitThread = true;
-        if (m_demuxThread.joinable())
-        {
-            m_demuxThread.join();
-            m_demuxThread = thread();
-        }
-        if (m_decodeThread.joinable())
-        {
-            m_decodeThread.join();
-            m_decodeThread = thread();
-        }
-        if (m_cnvMatThread.joinable())
+        m_vfrmReadySignal.Notify();
+        for (auto phLoop : {&m_hDemuxLoop, &m_hDecodeLoop, &m_hCnvMatLoop})
         {
-            m_cnvMatThread.join();
-            m_cnvMatThread = thread();
+            auto hLoop = atomic_exchange(phLoop, TaskExecutor::Loop::Holder());
+            if (hLoop)
+                hLoop->Stop();
         }
+        m_decodeState.hPrevFrm = nullptr;
+    }
+
+    void WakeupLoop(const TaskExecutor::Loop::Holder& hLoopRef)
+    {
+        auto hLoop = atomic_load(&hLoopRef);
+        if (hLoop)
+            hLoop->Wakeup();
+    }
+
+    void NotifyWorkerThreads()
+    {
+        WakeupLoop(m_hDemuxLoop);
+        WakeupLoop(m_hDecodeLoop);
+        WakeupLoop(m_hCnvMatLoop);
     }
 
     void FlushAllQueues()
@@ -1071,11 +1132,38 @@ private:
         bool isStartPacket{false};
     };
 
+    struct DemuxLoopState
+    {
+        bool demuxEof{false};
+        bool needSeek{false};
+        bool needFlushVfrmQ{false};
+        bool afterSeek{false};
+        bool readForward{true};
+        int64_t lastPktPts{INT64_MIN};
+        int64_t minPtsAfterSeek{INT64_MAX};
+        int64_t prevMinPtsAfterSeek{INT64_MAX};
+        int64_t backwardReadLimitPts{0};
+        int64_t seekPts{INT64_MIN};
+        list<int64_t> ptsList;
+        bool needPtsSafeCheck{true};
+        bool nullPktSent{false};
+        bool isStartPacket{true};
+    };
+
+    struct DecodeLoopState
+    {
+        bool decoderEof{false};
+        bool nullPktSent{false};
+        bool isStartFrame{false};
+        VideoFrame::Holder hPrevFrm;
+    };
+
     void UpdateReadPts(int64_t readPts)
     {
         lock_guard<mutex> _lk(m_cacheRangeLock);
         m_readPts = readPts;
-        auto& cacheFrameCount = m_readForward ? m_forwardCacheFrameCount : m_backwardCacheFrameCount;
+        auto cacheFrameCount = m_readForward ? m_forwardCacheFrameCount : m_backwardCacheFrameCount;
+        ClampCacheFrameCountByQuota(cacheFrameCount);
         m_cacheRange.first = readPts-cacheFrameCount.first*m_vidfrmIntvPts;
         m_cacheRange.second = readPts+cacheFrameCount.second*m_vidfrmIntvPts;
         // m_logger->Log(VERBOSE) << "~~~~~ UpdateReadPts: first(" << m_cacheRange.first << ") = readPts(" << readPts << ") - cachFrmCnt1(" << cacheFrameCount.first << ") * intvPts(" << m_vidfrmIntvPts << ")" << endl;
@@ -1085,6 +1173,110 @@ private:
             m_cacheRange.first--;
             m_cacheRange.second++;
         }
+        NotifyWorkerThreads();
+    }
+
+    // The cache is a consumer of the default 'MemoryBudget', its demand is the bytes of all the cached frames after conversion.
+    void RegisterMemoryConsumer()
+    {
+        const uint32_t w = m_outWidth > 0 ? m_outWidth : m_vidAvStm->codecpar->width;
+        const uint32_t h = m_outHeight > 0 ? m_outHeight : m_vidAvStm->codecpar->height;
+        const uint64_t elemSize = m_outDtype == IM_DT_INT8 ? 1 : (m_outDtype == IM_DT_FLOAT32 ? 4 : 2);
+        m_frameBytes = (uint64_t)w*h*4*elemSize;
+        if (!m_hMemConsumer)
+        {
+            string consumerName = "VideoReader-"+SysUtils::ExtractFileName(m_hParser->GetUrl());
+            m_hMemConsumer = MemoryBudget::GetDefaultInstance()->Register(consumerName, [this] (uint64_t quota) {
+                m_memQuota = quota;
+                m_memQuotaChanged = true;
+                WakeupLoop(m_hDemuxLoop);
+            });
+        }
+        m_memQuota = m_hMemConsumer->GetQuota();
+        m_hMemConsumer->SetPriority(MemoryBudget::PRIORITY_NORMAL);
+        UpdateMemoryDemand();
+    }
+
+    void UpdateMemoryDemand()
+    {
+        if (!m_hMemConsumer)
+            return;
+        const auto& cacheFrameCount = m_readForward ? m_forwardCacheFrameCount : m_backwardCacheFrameCount;
+        m_hMemConsumer->SetDemand((uint64_t)(cacheFrameCount.first+cacheFrameCount.second+1)*m_frameBytes);
+    }
+
+    // Shrink the cache range to fit the memory quota. The frames behind the reading direction are dropped first,
+    // and at least one frame ahead is kept.
+    void ClampCacheFrameCountByQuota(pair<int32_t, int32_t>& cacheFrameCount)
+    {
+        const uint64_t quota = m_memQuota;
+        if (m_frameBytes == 0 || quota == UINT64_MAX)
+            return;
+        int32_t maxFrames = (int32_t)min<uint64_t>(quota/m_frameBytes, INT32_MAX);
+        if (maxFrames < 2)
+            maxFrames = 2;
+        if (cacheFrameCount.first+cacheFrameCount.second+1 <= maxFrames)
+            return;
+        auto& aheadCount = m_readForward ? cacheFrameCount.second : cacheFrameCount.first;
+        auto& behindCount = m_readForward ? cacheFrameCount.first : cacheFrameCount.second;
+        behindCount = max(min(behindCount, maxFrames-1-aheadCount), 0);
+        aheadCount = max(min(aheadCount, maxFrames-1-behindCount), 1);
+    }
+
+    // Under backward playback (not in seeking mode), the frames are read from 'm_hRvsDecoder', and the demux/decode
+    // loops stay idle. Must be invoked with 'm_seekPosLock' locked.
+    void UpdateReverseDecodeState()
+    {
+        const bool active = !m_readForward && !m_bSeekingMode && m_rvsDecMemLimit > 0 && !m_isImage;
+        if (active == m_rvsDecActive)
+            return;
+        m_rvsDecActive = active;
+        if (!active)
+        {
+            if (m_hRvsDecoder)
+                m_hRvsDecoder->Reset();
+            // let the demuxing loop continue from the position where reverse decoding stops
+            m_seekPts = m_readPts;
+            m_seekPosUpdated = true;
+            m_inSeeking = true;
+        }
+        m_logger->Log(DEBUG) << "---> Reverse-decode mode " << (active ? "ON" : "OFF") << endl;
+    }
+
+    VideoFrame::Holder ReadVideoFrameByPtsReverse(int64_t pts, int64_t pos, bool wait)
+    {
+        if (!m_hRvsDecoder)
+        {
+            auto hRvsDecoder = ReverseVideoDecoder::CreateInstance(m_logger);
+            hRvsDecoder->SetMemoryLimit(m_rvsDecMemLimit);
+            if (!hRvsDecoder->Open(m_hParser, m_vidStmIdx, m_viddecOpenOpts))
+            {
+                m_errMsg = hRvsDecoder->GetError();
+                return nullptr;
+            }
+            m_hRvsDecoder = hRvsDecoder;
+        }
+        ReverseVideoDecoder::Frame frame;
+        if (!m_hRvsDecoder->ReadFrame(pts, frame, wait))
+        {
+            m_errMsg = m_hRvsDecoder->GetError();
+            return nullptr;
+        }
+
+        VideoFrame::Holder hVfrm;
+        auto hPrevVfrm = m_prevReadResult.second;
+        if (hPrevVfrm && hPrevVfrm->Pts() == frame.pts)
+            hVfrm = hPrevVfrm;
+        else
+        {
+            // the decoded frame is kept by the reverse decoder, use a new reference since 'VideoFrame_Impl' releases it after conversion
+            auto pVf = new VideoFrame_Impl(this, CloneSelfFreeAVFramePtr(frame.frmPtr.get()), CvtPtsToMts(frame.pts), frame.pts, frame.dur, false);
+            pVf->isStartFrame = frame.isStartFrame;
+            hVfrm = VideoFrame::Holder(pVf, VIDEO_READER_VIDEO_FRAME_HOLDER_DELETER);
+        }
+        m_prevReadResult = {pos, hVfrm};
+        m_logger->Log(DEBUG) << "<< RETURN frame(reverse): pts=" << hVfrm->Pts() << ", ts=" << hVfrm->Pos() << "." << endl;
+        return hVfrm;
     }
 
     struct VideoFrame_Impl : public VideoFrame
@@ -1175,7 +1367,9 @@ private:
             double ts = (double)pos/1000;
             if (!owner->m_pFrmCvt->ConvertImage(frmPtr.get(), vmat, ts))
                 owner->m_logger->Log(Error) << "AVFrameToImMatConverter::ConvertImage() FAILED at pos " << pos << "(" << pts << ")!" << endl;
-            frmPtr = nullptr;
+            // keep the avframe if the mat shares its buffer, so the native data is still available without extra memory
+            if (vmat.empty() || vmat.data != frmPtr->data[0])
+                frmPtr = nullptr;
             frmPtrInUse = false;
 
             if (vmat.empty())
@@ -1217,718 +1411,744 @@ private:
 
     static const function<void (VideoFrame*)> VIDEO_READER_VIDEO_FRAME_HOLDER_DELETER;
 
-    void DemuxThreadProc()
+    // One iteration of the demuxing loop, returns false if there is nothing to do
+    bool DemuxStep()
     {
-        m_logger->Log(DEBUG) << "Enter DemuxThreadProc()..." << endl;
-
-        if (!m_prepared && !Prepare())
+        if (!m_prepared)
         {
-            m_logger->Log(Error) << "Prepare() FAILED! Error is '" << m_errMsg << "'." << endl;
-            return;
+            // the api methods wait for the loops to stop with 'm_apiLock' held, so never block on it here
+            if (!m_apiLock.try_lock())
+                return false;
+            lock_guard<recursive_mutex> lk(m_apiLock, adopt_lock);
+            if (!Prepare())
+            {
+                m_logger->Log(Error) << "Prepare() FAILED! Error is '" << m_errMsg << "'." << endl;
+                atomic_load(&m_hDemuxLoop)->Stop();
+                return false;
+            }
+            NotifyWorkerThreads();
         }
 
         int fferr;
-        bool demuxEof = false;
-        bool needSeek = false;
-        bool needFlushVfrmQ = false;
-        bool afterSeek = false;
-        bool readForward = m_readForward;
-        int64_t lastPktPts = INT64_MIN, minPtsAfterSeek = INT64_MAX, prevMinPtsAfterSeek = INT64_MAX;
-        int64_t backwardReadLimitPts;
-        int64_t seekPts = INT64_MIN;
-        list<int64_t> ptsList;
-        bool needPtsSafeCheck = true;
-        bool nullPktSent = false;
-        bool isStartPacket = true;
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
+        // the states kept across the iterations
+        bool& demuxEof = m_demuxState.demuxEof;
+        bool& needSeek = m_demuxState.needSeek;
+        bool& needFlushVfrmQ = m_demuxState.needFlushVfrmQ;
+        bool& afterSeek = m_demuxState.afterSeek;
+        bool& readForward = m_demuxState.readForward;
+        int64_t& lastPktPts = m_demuxState.lastPktPts;
+        int64_t& minPtsAfterSeek = m_demuxState.minPtsAfterSeek;
+        int64_t& prevMinPtsAfterSeek = m_demuxState.prevMinPtsAfterSeek;
+        int64_t& backwardReadLimitPts = m_demuxState.backwardReadLimitPts;
+        int64_t& seekPts = m_demuxState.seekPts;
+        list<int64_t>& ptsList = m_demuxState.ptsList;
+        bool& needPtsSafeCheck = m_demuxState.needPtsSafeCheck;
+        bool& nullPktSent = m_demuxState.nullPktSent;
+        bool& isStartPacket = m_demuxState.isStartPacket;
+
+        bool idleLoop = true;
+
+        bool testVal = true;
+        if (m_memQuotaChanged.compare_exchange_strong(testVal, false))
+            UpdateReadPts(m_readPts);
+
+        if (m_rvsDecActive)
+            return false;
 
-            // query seek points if not ready
-            if (!m_bSeekPointsReady)
+        // query seek points if not ready
+        if (!m_bSeekPointsReady)
+        {
+            auto hParsedSeekPoints = m_hParser->GetVideoSeekPoints(false);
+            if (hParsedSeekPoints)
             {
-                auto hParsedSeekPoints = m_hParser->GetVideoSeekPoints(false);
-                if (hParsedSeekPoints)
+                list<int64_t> aSeekPoints;
+                for (auto pts : *hParsedSeekPoints)
+                    aSeekPoints.push_back(pts);
+                if (!m_aSeekPoints.empty())
                 {
-                    list<int64_t> aSeekPoints;
-                    for (auto pts : *hParsedSeekPoints)
-                        aSeekPoints.push_back(pts);
-                    if (!m_aSeekPoints.empty())
+                    for (auto pts : m_aSeekPoints)
                     {
-                        for (auto pts : m_aSeekPoints)
+                        auto iter = find_if(aSeekPoints.begin(), aSeekPoints.end(), [pts] (const auto& elem) {
+                            return elem >= pts;
+                        });
+                        if (iter != aSeekPoints.end())
                         {
-                            auto iter = find_if(aSeekPoints.begin(), aSeekPoints.end(), [pts] (const auto& elem) {
-                                return elem >= pts;
-                            });
-                            if (iter != aSeekPoints.end())
-                            {
-                                if (*iter > pts)
-                                    aSeekPoints.insert(iter, pts);
-                            }
-                            else
-                                aSeekPoints.push_back(pts);
+                            if (*iter > pts)
+                                aSeekPoints.insert(iter, pts);
                         }
+                        else
+                            aSeekPoints.push_back(pts);
                     }
-                    m_aSeekPoints = std::move(aSeekPoints);
-                    m_bSeekPointsReady = true;
                 }
+                m_aSeekPoints = std::move(aSeekPoints);
+                m_bSeekPointsReady = true;
             }
+        }
 
-            // handle read direction change
-            bool directionChanged = readForward != m_readForward;
-            readForward = m_readForward;
-            if (directionChanged)
+        // handle read direction change
+        bool directionChanged = readForward != m_readForward;
+        readForward = m_readForward;
+        if (directionChanged)
+        {
+            m_logger->Log(VERBOSE) << "            >>>> DIRECTION CHANGE DETECTED <<<<" << endl;
+            UpdateReadPts(m_readPts);
+            needSeek = needFlushVfrmQ = true;
+            if (readForward)
             {
-                m_logger->Log(VERBOSE) << "            >>>> DIRECTION CHANGE DETECTED <<<<" << endl;
-                UpdateReadPts(m_readPts);
-                needSeek = needFlushVfrmQ = true;
-                if (readForward)
-                {
-                    seekPts = m_readPts;
-                }
-                else
+                seekPts = m_readPts;
+            }
+            else
+            {
+                lock_guard<mutex> _lk(m_vfrmQLock);
+                auto iter = m_vfrmQ.begin();
+                bool firstGreaterPts = true;
+                while (iter != m_vfrmQ.end())
                 {
-                    lock_guard<mutex> _lk(m_vfrmQLock);
-                    auto iter = m_vfrmQ.begin();
-                    bool firstGreaterPts = true;
-                    while (iter != m_vfrmQ.end())
+                    bool remove = false;
+                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(iter->get());
+                    if (pVf->pts < m_cacheRange.first)
+                        remove = true;
+                    else if (pVf->pts > m_cacheRange.second)
                     {
-                        bool remove = false;
-                        VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(iter->get());
-                        if (pVf->pts < m_cacheRange.first)
-                            remove = true;
-                        else if (pVf->pts > m_cacheRange.second)
-                        {
-                            if (firstGreaterPts)
-                                firstGreaterPts = false;
-                            else
-                                remove = true;
-                        }
-                        if (remove)
-                            iter = m_vfrmQ.erase(iter);
+                        if (firstGreaterPts)
+                            firstGreaterPts = false;
                         else
-                            iter++;
+                            remove = true;
                     }
-                    if (m_vfrmQ.empty())
-                        backwardReadLimitPts = m_readPts;
+                    if (remove)
+                        iter = m_vfrmQ.erase(iter);
                     else
-                    {
-                        VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.front().get());
-                        backwardReadLimitPts = pVf->pts > m_readPts ? m_readPts : pVf->pts-1;
-                    }
-                    seekPts = backwardReadLimitPts;
-                    m_logger->Log(VERBOSE) << "          ---[1] backwardReadLimitPts=" << backwardReadLimitPts << endl;
+                        iter++;
                 }
-            }
-
-            bool seekOpTriggered = false;
-            // handle seek operation
-            {
-                lock_guard<mutex> _lk(m_seekPosLock);
-                if (m_seekPosUpdated)
+                if (m_vfrmQ.empty())
+                    backwardReadLimitPts = m_readPts;
+                else
                 {
-                    seekPts = m_seekPts;
-                    m_seekPosUpdated = false;
-                    seekOpTriggered = true;
+                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.front().get());
+                    backwardReadLimitPts = pVf->pts > m_readPts ? m_readPts : pVf->pts-1;
                 }
+                seekPts = backwardReadLimitPts;
+                m_logger->Log(VERBOSE) << "          ---[1] backwardReadLimitPts=" << backwardReadLimitPts << endl;
             }
-            // discard unnecessary seek
-            if (seekOpTriggered)
+        }
+
+        bool seekOpTriggered = false;
+        // handle seek operation
+        {
+            lock_guard<mutex> _lk(m_seekPosLock);
+            if (m_seekPosUpdated)
             {
-                if (m_bSeekPointsReady && !m_aSeekPoints.empty())
-                {
-                    auto iter = find_if(m_aSeekPoints.begin(), m_aSeekPoints.end(), [seekPts] (const auto& elem) {
-                        return elem > seekPts;
-                    });
-                    if (iter != m_aSeekPoints.begin())
-                        iter--;
-                    const auto i64SeekPointPts = *iter;
-                    const auto i64PktPtsTail = ptsList.empty() ? INT64_MIN : ptsList.back();
-                    int64_t i64VfrmPtsHead = INT64_MAX;
-                    {
-                        lock_guard<mutex> _lk(m_vfrmQLock);
-                        if (!m_vfrmQ.empty())
-                            i64VfrmPtsHead = m_vfrmQ.front()->Pts();
-                    }
-                    if (i64SeekPointPts <= i64PktPtsTail && seekPts >= i64VfrmPtsHead)
-                    {
-                        // in this case, the seek operation can be discarded
-                        m_logger->Log(DEBUG) << "DISCARD SEEK-OP, seekPts=" << seekPts << "(mts=" << CvtPtsToMts(seekPts)
-                                << "), readPts=" << m_readPts << "(mts=" << CvtPtsToMts(m_readPts) << ")" << endl;
-                        seekOpTriggered = false;
-                        m_inSeeking = false;
-                    }
-                }
+                seekPts = m_seekPts;
+                m_seekPosUpdated = false;
+                seekOpTriggered = true;
             }
-
-            if (seekOpTriggered)
+        }
+        // discard unnecessary seek
+        if (seekOpTriggered)
+        {
+            if (m_bSeekPointsReady && !m_aSeekPoints.empty())
             {
-                needSeek = needFlushVfrmQ = true;
-                // clear avpacket queue
+                auto iter = find_if(m_aSeekPoints.begin(), m_aSeekPoints.end(), [seekPts] (const auto& elem) {
+                    return elem > seekPts;
+                });
+                if (iter != m_aSeekPoints.begin())
+                    iter--;
+                const auto i64SeekPointPts = *iter;
+                const auto i64PktPtsTail = ptsList.empty() ? INT64_MIN : ptsList.back();
+                int64_t i64VfrmPtsHead = INT64_MAX;
                 {
-                    m_logger->Log(DEBUG) << "--> Flush vpacket Queue." << endl;
-                    lock_guard<mutex> _lk(m_vpktQLock);
-                    m_vpktQ.clear();
+                    lock_guard<mutex> _lk(m_vfrmQLock);
+                    if (!m_vfrmQ.empty())
+                        i64VfrmPtsHead = m_vfrmQ.front()->Pts();
                 }
-                if (!m_readForward)
+                if (i64SeekPointPts <= i64PktPtsTail && seekPts >= i64VfrmPtsHead)
                 {
-                    backwardReadLimitPts = m_cacheRange.second;
-                    m_logger->Log(VERBOSE) << "          ---[2] backwardReadLimitPts=" << backwardReadLimitPts << endl;
+                    // in this case, the seek operation can be discarded
+                    m_logger->Log(DEBUG) << "DISCARD SEEK-OP, seekPts=" << seekPts << "(mts=" << CvtPtsToMts(seekPts)
+                            << "), readPts=" << m_readPts << "(mts=" << CvtPtsToMts(m_readPts) << ")" << endl;
+                    seekOpTriggered = false;
+                    m_inSeeking = false;
                 }
-                needPtsSafeCheck = true;
-                ptsList.clear();
             }
-            if (needSeek)
+        }
+
+        if (seekOpTriggered)
+        {
+            needSeek = needFlushVfrmQ = true;
+            // clear avpacket queue
             {
-                needSeek = false;
-                // seek to the new position
-                m_logger->Log(VERBOSE) << "--> Seek[1]: Demux seek to " << (double)CvtPtsToMts(seekPts)/1000 << "(" << seekPts << ")." << endl;
-                fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, seekPts, seekPts, 0);
-                if (fferr < 0)
-                {
-                    double seekTs = (double)CvtPtsToMts(seekPts)/1000;
-                    m_logger->Log(WARN) << "avformat_seek_file() FAILED to seek to time " << seekTs << "(" << seekPts << ")! fferr=" << fferr << "." << endl;
-                }
-                lastPktPts = INT64_MIN;
-                minPtsAfterSeek = prevMinPtsAfterSeek = INT64_MAX;
-                demuxEof = false;
-                afterSeek = true;
-                if (m_readForward || seekPts <= m_vidStartPts)
-                    isStartPacket = true;
+                m_logger->Log(DEBUG) << "--> Flush vpacket Queue." << endl;
+                lock_guard<mutex> _lk(m_vpktQLock);
+                m_vpktQ.clear();
             }
-
-            // check read packet condition
-            bool doReadPacket;
-            if (m_readForward)
+            if (!m_readForward)
             {
-                doReadPacket = m_vpktQ.size() < m_vpktQMaxSize;
+                backwardReadLimitPts = m_cacheRange.second;
+                m_logger->Log(VERBOSE) << "          ---[2] backwardReadLimitPts=" << backwardReadLimitPts << endl;
             }
-            else
+            needPtsSafeCheck = true;
+            ptsList.clear();
+        }
+        if (needSeek)
+        {
+            needSeek = false;
+            // seek to the new position
+            m_logger->Log(VERBOSE) << "--> Seek[1]: Demux seek to " << (double)CvtPtsToMts(seekPts)/1000 << "(" << seekPts << ")." << endl;
+            fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, seekPts, seekPts, 0);
+            if (fferr < 0)
             {
-                doReadPacket = lastPktPts < backwardReadLimitPts;
+                double seekTs = (double)CvtPtsToMts(seekPts)/1000;
+                m_logger->Log(WARN) << "avformat_seek_file() FAILED to seek to time " << seekTs << "(" << seekPts << ")! fferr=" << fferr << "." << endl;
             }
-            // do pts safe check: ensure we've already got at least 'm_minGreaterPtsCountThanReadPos' packets with pts that are greater than m_readPos
-            if (needPtsSafeCheck)
+            lastPktPts = INT64_MIN;
+            minPtsAfterSeek = prevMinPtsAfterSeek = INT64_MAX;
+            demuxEof = false;
+            afterSeek = true;
+            if (m_readForward || seekPts <= m_vidStartPts)
+                isStartPacket = true;
+        }
+
+        // check read packet condition
+        bool doReadPacket;
+        if (m_readForward)
+        {
+            doReadPacket = m_vpktQ.size() < m_vpktQMaxSize;
+        }
+        else
+        {
+            doReadPacket = lastPktPts < backwardReadLimitPts;
+        }
+        // do pts safe check: ensure we've already got at least 'm_minGreaterPtsCountThanReadPos' packets with pts that are greater than m_readPos
+        if (needPtsSafeCheck)
+        {
+            const int64_t readPts = m_readPts;
+            int cnt = 0;
+            auto iter = ptsList.begin();
+            while (iter != ptsList.end())
             {
-                const int64_t readPts = m_readPts;
-                int cnt = 0;
-                auto iter = ptsList.begin();
-                while (iter != ptsList.end())
+                if (*iter < readPts)
+                    iter = ptsList.erase(iter);
+                else if (*iter == readPts)
                 {
-                    if (*iter < readPts)
-                        iter = ptsList.erase(iter);
-                    else if (*iter == readPts)
-                    {
-                        cnt = m_minGreaterPtsCountThanReadPos;
-                        break;
-                    }
-                    else
-                    {
-                        cnt++;
+                    cnt = m_minGreaterPtsCountThanReadPos;
+                    break;
+                }
+                else
+                {
+                    cnt++;
+                }
+                iter++;
+            }
+            if (cnt < m_minGreaterPtsCountThanReadPos) // if greater-than-readpos pts is not enough, force to read more packets
+                doReadPacket = true;
+            else if (!m_readForward)  // under backward playback state, we only need to do pts-safecheck once per seek op is triggered
+                needPtsSafeCheck = false;
+        }
+        if (demuxEof) doReadPacket = false;
+        if (!doReadPacket)
+        {
+            if (minPtsAfterSeek != INT64_MAX && seekPts != INT64_MIN
+                && minPtsAfterSeek > seekPts && minPtsAfterSeek > m_readPts)
+            {
+                if (seekPts <= m_vidStartPts)
+                {
+                    if (minPtsAfterSeek != prevMinPtsAfterSeek) {
+                        m_logger->Log(WARN) << "!!! >>>> minPtsAfterSeek(" << minPtsAfterSeek << ") > seekPts(" << seekPts
+                                << "), BUT already reach the START TIME." << endl;
+                        prevMinPtsAfterSeek = minPtsAfterSeek;
                     }
-                    iter++;
                 }
-                if (cnt < m_minGreaterPtsCountThanReadPos) // if greater-than-readpos pts is not enough, force to read more packets
-                    doReadPacket = true;
-                else if (!m_readForward)  // under backward playback state, we only need to do pts-safecheck once per seek op is triggered
-                    needPtsSafeCheck = false;
+                else
+                {
+                    m_logger->Log(WARN) << "!!! >>>> minPtsAfterSeek(" << minPtsAfterSeek << ") > seekPts(" << seekPts << "), ";
+                    seekPts = m_readPts < seekPts ? m_readPts : seekPts-m_vidfrmIntvPts*4;
+                    if (seekPts < m_vidStartPts) seekPts = m_vidStartPts;
+                    m_logger->Log(WARN) << "try to seek to earlier position " << seekPts << "!" << endl;
+                    lock_guard<mutex> _lk(m_seekPosLock);
+                    m_seekPts = seekPts;
+                    m_inSeeking = true;
+                    m_seekPosUpdated = true;
+                    idleLoop = false;
+                }
             }
-            if (demuxEof) doReadPacket = false;
-            if (!doReadPacket)
+            else if (!m_readForward)
             {
-                if (minPtsAfterSeek != INT64_MAX && seekPts != INT64_MIN
-                    && minPtsAfterSeek > seekPts && minPtsAfterSeek > m_readPts)
+                // under backward playback state, we need to pre-read and decode frames before the read-pos
+                if (minPtsAfterSeek >= m_cacheRange.first && minPtsAfterSeek > m_vidStartPts)
                 {
                     if (seekPts <= m_vidStartPts)
                     {
-                        if (minPtsAfterSeek != prevMinPtsAfterSeek) {
-                            m_logger->Log(WARN) << "!!! >>>> minPtsAfterSeek(" << minPtsAfterSeek << ") > seekPts(" << seekPts
-                                    << "), BUT already reach the START TIME." << endl;
-                            prevMinPtsAfterSeek = minPtsAfterSeek;
-                        }
+                        m_logger->Log(WARN) << "!!! >>>> Backward variables update FAILED! Already reach the START TIME." << endl;
                     }
                     else
                     {
-                        m_logger->Log(WARN) << "!!! >>>> minPtsAfterSeek(" << minPtsAfterSeek << ") > seekPts(" << seekPts << "), ";
-                        seekPts = m_readPts < seekPts ? m_readPts : seekPts-m_vidfrmIntvPts*4;
+                        backwardReadLimitPts = minPtsAfterSeek-1;
+                        if (backwardReadLimitPts > m_readPts)
+                        {
+                            backwardReadLimitPts = m_readPts;
+                            needPtsSafeCheck = true;
+                        }
+                        seekPts = backwardReadLimitPts != seekPts ? backwardReadLimitPts : backwardReadLimitPts-m_vidfrmIntvPts*4;
                         if (seekPts < m_vidStartPts) seekPts = m_vidStartPts;
-                        m_logger->Log(WARN) << "try to seek to earlier position " << seekPts << "!" << endl;
-                        lock_guard<mutex> _lk(m_seekPosLock);
-                        m_seekPts = seekPts;
-                        m_inSeeking = true;
-                        m_seekPosUpdated = true;
+                        needSeek = true;
                         idleLoop = false;
+                        m_logger->Log(VERBOSE) << "          --- Backward variables update: backwardReadLimitPts=" << backwardReadLimitPts
+                                << ", lastPktPts=" << lastPktPts << ", minPtsAfterSeek=" << minPtsAfterSeek
+                                << ", m_cacheRange={" << m_cacheRange.first << ", " << m_cacheRange.second << "}" << "." << endl;
                     }
                 }
-                else if (!m_readForward)
+                else if (!nullPktSent)
                 {
-                    // under backward playback state, we need to pre-read and decode frames before the read-pos
-                    if (minPtsAfterSeek >= m_cacheRange.first && minPtsAfterSeek > m_vidStartPts)
-                    {
-                        if (seekPts <= m_vidStartPts)
-                        {
-                            m_logger->Log(WARN) << "!!! >>>> Backward variables update FAILED! Already reach the START TIME." << endl;
-                        }
-                        else
-                        {
-                            backwardReadLimitPts = minPtsAfterSeek-1;
-                            if (backwardReadLimitPts > m_readPts)
-                            {
-                                backwardReadLimitPts = m_readPts;
-                                needPtsSafeCheck = true;
-                            }
-                            seekPts = backwardReadLimitPts != seekPts ? backwardReadLimitPts : backwardReadLimitPts-m_vidfrmIntvPts*4;
-                            if (seekPts < m_vidStartPts) seekPts = m_vidStartPts;
-                            needSeek = true;
-                            idleLoop = false;
-                            m_logger->Log(VERBOSE) << "          --- Backward variables update: backwardReadLimitPts=" << backwardReadLimitPts
-                                    << ", lastPktPts=" << lastPktPts << ", minPtsAfterSeek=" << minPtsAfterSeek
-                                    << ", m_cacheRange={" << m_cacheRange.first << ", " << m_cacheRange.second << "}" << "." << endl;
-                        }
-                    }
-                    else if (!nullPktSent)
-                    {
-                        // add a null packet to make sure that decoder will output all the preserved frames inside
-                        VideoPacket::Holder hVpkt(new VideoPacket({nullptr, false, false}));
-                        lock_guard<mutex> _lk(m_vpktQLock);
-                        m_vpktQ.push_back(hVpkt);
-                        nullPktSent = true;
-                    }
+                    // add a null packet to make sure that decoder will output all the preserved frames inside
+                    VideoPacket::Holder hVpkt(new VideoPacket({nullptr, false, false}));
+                    lock_guard<mutex> _lk(m_vpktQLock);
+                    m_vpktQ.push_back(hVpkt);
+                    nullPktSent = true;
                 }
             }
+        }
 
-            // read avpacket
-            if (doReadPacket)
+        // read avpacket
+        if (doReadPacket)
+        {
+            SelfFreeAVPacketPtr pktPtr = AllocSelfFreeAVPacketPtr();
+            fferr = av_read_frame(m_avfmtCtx, pktPtr.get());
+            if (fferr == 0)
             {
-                SelfFreeAVPacketPtr pktPtr = AllocSelfFreeAVPacketPtr();
-                fferr = av_read_frame(m_avfmtCtx, pktPtr.get());
-                if (fferr == 0)
+                if (pktPtr->stream_index == m_vidStmIdx)
                 {
-                    if (pktPtr->stream_index == m_vidStmIdx)
-                    {
-                        m_logger->Log(VERBOSE) << "=== Get video packet: pts=" << pktPtr->pts << ", ts=" << (double)CvtPtsToMts(pktPtr->pts)/1000 << "." << endl;
-                        auto iterPts = find(ptsList.begin(), ptsList.end(), pktPtr->pts);
-                        if (iterPts == ptsList.end()) ptsList.push_back(pktPtr->pts);
-                        if (pktPtr->pts >= m_vidStartPts && pktPtr->pts < minPtsAfterSeek) minPtsAfterSeek = pktPtr->pts;
-                        if (ptsList.size() >= 16)
-                        {  // add new seek point to table if this one is newly found.
-                            auto iterCheck = find_if(m_aSeekPoints.begin(), m_aSeekPoints.end(), [minPtsAfterSeek] (const auto& elem) {
-                                return elem >= minPtsAfterSeek;
-                            });
-                            if (iterCheck == m_aSeekPoints.end() || *iterCheck > minPtsAfterSeek)
-                            {
-                                m_aSeekPoints.insert(iterCheck, minPtsAfterSeek);
-                                m_logger->Log(DEBUG) << "FOUND NEW SEEK POINT. pts=" << minPtsAfterSeek << "(mts=" << CvtPtsToMts(minPtsAfterSeek) << ")." << endl;
-                            }
+                    m_logger->Log(VERBOSE) << "=== Get video packet: pts=" << pktPtr->pts << ", ts=" << (double)CvtPtsToMts(pktPtr->pts)/1000 << "." << endl;
+                    auto iterPts = find(ptsList.begin(), ptsList.end(), pktPtr->pts);
+                    if (iterPts == ptsList.end()) ptsList.push_back(pktPtr->pts);
+                    if (pktPtr->pts >= m_vidStartPts && pktPtr->pts < minPtsAfterSeek) minPtsAfterSeek = pktPtr->pts;
+                    if (ptsList.size() >= 16)
+                    {  // add new seek point to table if this one is newly found.
+                        auto iterCheck = find_if(m_aSeekPoints.begin(), m_aSeekPoints.end(), [minPtsAfterSeek] (const auto& elem) {
+                            return elem >= minPtsAfterSeek;
+                        });
+                        if (iterCheck == m_aSeekPoints.end() || *iterCheck > minPtsAfterSeek)
+                        {
+                            m_aSeekPoints.insert(iterCheck, minPtsAfterSeek);
+                            m_logger->Log(DEBUG) << "FOUND NEW SEEK POINT. pts=" << minPtsAfterSeek << "(mts=" << CvtPtsToMts(minPtsAfterSeek) << ")." << endl;
                         }
-                        nullPktSent = false;
-                        VideoPacket::Holder hVpkt(new VideoPacket({pktPtr, afterSeek, needFlushVfrmQ}));
-                        hVpkt->isStartPacket = isStartPacket; isStartPacket = false;
-                        afterSeek = needFlushVfrmQ = false;
-                        if (pktPtr->pts >= m_vidStartPts && pktPtr->pts <= m_vidDurationPts) lastPktPts = pktPtr->pts;
-                        lock_guard<mutex> _lk(m_vpktQLock);
-                        m_vpktQ.push_back(hVpkt);
-                    }
-                    idleLoop = false;
-                }
-                else if (fferr == AVERROR_EOF)
-                {
-                    demuxEof = true;
-                    if (!nullPktSent)
-                    {
-                        VideoPacket::Holder hVpkt(new VideoPacket({nullptr, afterSeek, needFlushVfrmQ}));
-                        afterSeek = needFlushVfrmQ = false;
-                        nullPktSent = true;
-                        lastPktPts = INT64_MAX;
-                        lock_guard<mutex> _lk(m_vpktQLock);
-                        m_vpktQ.push_back(hVpkt);
                     }
+                    nullPktSent = false;
+                    VideoPacket::Holder hVpkt(new VideoPacket({pktPtr, afterSeek, needFlushVfrmQ}));
+                    hVpkt->isStartPacket = isStartPacket; isStartPacket = false;
+                    afterSeek = needFlushVfrmQ = false;
+                    if (pktPtr->pts >= m_vidStartPts && pktPtr->pts <= m_vidDurationPts) lastPktPts = pktPtr->pts;
+                    lock_guard<mutex> _lk(m_vpktQLock);
+                    m_vpktQ.push_back(hVpkt);
                 }
-                else
+                idleLoop = false;
+            }
+            else if (fferr == AVERROR_EOF)
+            {
+                demuxEof = true;
+                if (!nullPktSent)
                 {
-                    m_logger->Log(WARN) << "av_read_frame() FAILED! fferr=" << fferr << "." << endl;
+                    VideoPacket::Holder hVpkt(new VideoPacket({nullptr, afterSeek, needFlushVfrmQ}));
+                    afterSeek = needFlushVfrmQ = false;
+                    nullPktSent = true;
+                    lastPktPts = INT64_MAX;
+                    lock_guard<mutex> _lk(m_vpktQLock);
+                    m_vpktQ.push_back(hVpkt);
                 }
             }
-
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+            else
+            {
+                m_logger->Log(WARN) << "av_read_frame() FAILED! fferr=" << fferr << "." << endl;
+            }
         }
-        m_dmxThdRunning = false;
-        m_logger->Log(DEBUG) << "Leave DemuxThreadProc()." << endl;
+
+        if (!idleLoop)
+            WakeupLoop(m_hDecodeLoop);
+        return !idleLoop;
     }
 
-    void DecodeThreadProc()
+    // One iteration of the decoding loop, returns false if there is nothing to do
+    bool DecodeStep()
     {
-        m_logger->Log(DEBUG) << "Enter DecodeThreadProc()..." << endl;
-        while (!m_prepared && !m_quitThread)
-            this_thread::sleep_for(chrono::milliseconds(5));
+        if (!m_prepared)
+            return false;
 
         int fferr;
-        bool decoderEof = false;
-        bool nullPktSent = false;
-        bool isStartFrame = false;
-        VideoFrame::Holder hPrevFrm;
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
+        // the states kept across the iterations
+        bool& decoderEof = m_decodeState.decoderEof;
+        bool& nullPktSent = m_decodeState.nullPktSent;
+        bool& isStartFrame = m_decodeState.isStartFrame;
+        VideoFrame::Holder& hPrevFrm = m_decodeState.hPrevFrm;
 
-            // retrieve avpacket and reset decoder if needed
-            VideoPacket::Holder hVpkt;
-            {
-                lock_guard<mutex> _lk(m_vpktQLock);
-                if (!m_vpktQ.empty())
-                    hVpkt = m_vpktQ.front();
-            }
-            if (hVpkt)
+        bool idleLoop = true;
+
+        // retrieve avpacket and reset decoder if needed
+        VideoPacket::Holder hVpkt;
+        {
+            lock_guard<mutex> _lk(m_vpktQLock);
+            if (!m_vpktQ.empty())
+                hVpkt = m_vpktQ.front();
+        }
+        if (hVpkt)
+        {
+            if (hVpkt->isAfterSeek)
             {
-                if (hVpkt->isAfterSeek)
+                if (hVpkt->needFlushVfrmQ || decoderEof)
                 {
-                    if (hVpkt->needFlushVfrmQ || decoderEof)
+                    if (hVpkt->pktPtr)
                     {
-                        if (hVpkt->pktPtr)
-                        {
-                            m_logger->Log(VERBOSE) << "--> Seek[2]: Decoder reset. pts=" << hVpkt->pktPtr->pts << "." << endl;
-                            lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                            avcodec_flush_buffers(m_viddecCtx);
-                            decoderEof = false;
-                            nullPktSent = false;
-                        }
-                        else
-                        {
-                            decoderEof = true;
-                        }
-                        if (hVpkt->needFlushVfrmQ)
-                        {
-                            m_logger->Log(VERBOSE) << ">>> Flush vframe queue." << endl;
-                            hPrevFrm = nullptr;
-                            isStartFrame = false;
-                            lock_guard<mutex> _lk(m_vfrmQLock);
-                            m_vfrmQ.clear();
-                        }
-                        m_inSeeking = false;
+                        m_logger->Log(VERBOSE) << "--> Seek[2]: Decoder reset. pts=" << hVpkt->pktPtr->pts << "." << endl;
+                        lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
+                        avcodec_flush_buffers(m_viddecCtx);
+                        decoderEof = false;
+                        nullPktSent = false;
                     }
-                    else if (!nullPktSent)
+                    else
                     {
-                        m_logger->Log(VERBOSE) << "======= Send video packet: pts=(null) [2]" << endl;
-                        lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                        avcodec_send_packet(m_viddecCtx, nullptr);
-                        nullPktSent = true;
+                        decoderEof = true;
                     }
+                    if (hVpkt->needFlushVfrmQ)
+                    {
+                        m_logger->Log(VERBOSE) << ">>> Flush vframe queue." << endl;
+                        hPrevFrm = nullptr;
+                        isStartFrame = false;
+                        lock_guard<mutex> _lk(m_vfrmQLock);
+                        m_vfrmQ.clear();
+                    }
+                    m_inSeeking = false;
                 }
-                else if (decoderEof)
+                else if (!nullPktSent)
                 {
-                    m_logger->Log(VERBOSE) << ">>> Decoder reset. pts=" << hVpkt->pktPtr->pts << "." << endl;
+                    m_logger->Log(VERBOSE) << "======= Send video packet: pts=(null) [2]" << endl;
                     lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                    avcodec_flush_buffers(m_viddecCtx);
-                    decoderEof = false;
-                    nullPktSent = false;
+                    avcodec_send_packet(m_viddecCtx, nullptr);
+                    nullPktSent = true;
                 }
             }
+            else if (decoderEof)
+            {
+                m_logger->Log(VERBOSE) << ">>> Decoder reset. pts=" << hVpkt->pktPtr->pts << "." << endl;
+                lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
+                avcodec_flush_buffers(m_viddecCtx);
+                decoderEof = false;
+                nullPktSent = false;
+            }
+        }
 
-            // retrieve decoded frame
-            int64_t tailFramePts = INT64_MIN;
+        // retrieve decoded frame
+        int64_t tailFramePts = INT64_MIN;
+        {
+            lock_guard<mutex> _lk(m_vfrmQLock);
+            if (!m_vfrmQ.empty())
             {
-                lock_guard<mutex> _lk(m_vfrmQLock);
-                if (!m_vfrmQ.empty())
-                {
-                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
-                    tailFramePts = pVf->pts;
-                }
+                VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
+                tailFramePts = pVf->pts;
             }
-            bool doDecode = !decoderEof && m_pendingHwfrmCnt <= m_maxPendingHwfrmCnt
-                    && (tailFramePts < m_cacheRange.second || !m_readForward);
-            if (doDecode)
+        }
+        bool doDecode = !decoderEof && m_pendingHwfrmCnt <= m_maxPendingHwfrmCnt
+                && (tailFramePts < m_cacheRange.second || !m_readForward);
+        if (doDecode)
+        {
+            AVFrame* pAvfrm = av_frame_alloc();
             {
-                AVFrame* pAvfrm = av_frame_alloc();
+                lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
+                fferr = avcodec_receive_frame(m_viddecCtx, pAvfrm);
+            }
+            if (fferr == 0)
+            {
+                m_logger->Log(VERBOSE) << "========== Got video frame: pts=" << pAvfrm->pts << ", bets=" << pAvfrm->best_effort_timestamp
+                        << ", mts=" << CvtPtsToMts(pAvfrm->pts) << "." << endl;
+                pAvfrm->pts = pAvfrm->best_effort_timestamp;
+                if (pAvfrm->pts < m_vidStartPts || pAvfrm->pts > m_vidDurationPts)
                 {
-                    lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                    fferr = avcodec_receive_frame(m_viddecCtx, pAvfrm);
+                    m_logger->Log(WARN) << "!! Got BAD video frame, pts=" << pAvfrm->pts << ", which is out of the video stream time range ["
+                            << m_vidStartPts << ", " << m_vidDurationPts << "]. DISCARD THIS FRAME." << endl;
                 }
-                if (fferr == 0)
+                else
                 {
-                    m_logger->Log(VERBOSE) << "========== Got video frame: pts=" << pAvfrm->pts << ", bets=" << pAvfrm->best_effort_timestamp
-                            << ", mts=" << CvtPtsToMts(pAvfrm->pts) << "." << endl;
-                    pAvfrm->pts = pAvfrm->best_effort_timestamp;
-                    if (pAvfrm->pts < m_vidStartPts || pAvfrm->pts > m_vidDurationPts)
+#if DONOT_CACHE_HWAVFRAME
+                    if (IsHwFrame(pAvfrm))
                     {
-                        m_logger->Log(WARN) << "!! Got BAD video frame, pts=" << pAvfrm->pts << ", which is out of the video stream time range ["
-                                << m_vidStartPts << ", " << m_vidDurationPts << "]. DISCARD THIS FRAME." << endl;
+                        AVFrame* pTmp = av_frame_clone(pAvfrm);
+                        av_frame_unref(pAvfrm);
+                        TransferHwFrameToSwFrame(pAvfrm, pTmp);
+                        av_frame_free(&pTmp);
+                    }
+#endif
+                    SelfFreeAVFramePtr frmPtr;
+                    bool isHwfrm = false;
+                    if (IsHwFrame(pAvfrm))
+                    {
+                        frmPtr = SelfFreeAVFramePtr(pAvfrm, [this] (AVFrame* p) {
+                            lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
+                            av_frame_free(&p);
+                            m_pendingHwfrmCnt--;
+                        });
+                        m_pendingHwfrmCnt++;
+                        isHwfrm = true;
                     }
                     else
                     {
-#if DONOT_CACHE_HWAVFRAME
-                        if (IsHwFrame(pAvfrm))
-                        {
-                            AVFrame* pTmp = av_frame_clone(pAvfrm);
-                            av_frame_unref(pAvfrm);
-                            TransferHwFrameToSwFrame(pAvfrm, pTmp);
-                            av_frame_free(&pTmp);
-                        }
-#endif
-                        SelfFreeAVFramePtr frmPtr;
-                        bool isHwfrm = false;
-                        if (IsHwFrame(pAvfrm))
-                        {
-                            frmPtr = SelfFreeAVFramePtr(pAvfrm, [this] (AVFrame* p) {
-                                lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                                av_frame_free(&p);
-                                m_pendingHwfrmCnt--;
-                            });
-                            m_pendingHwfrmCnt++;
-                            isHwfrm = true;
-                        }
-                        else
-                        {
-                            frmPtr = SelfFreeAVFramePtr(pAvfrm, [this] (AVFrame* p) {
-                                av_frame_free(&p);
-                            });
-                        }
-                        const int64_t pts = pAvfrm->pts;
+                        frmPtr = SelfFreeAVFramePtr(pAvfrm, [this] (AVFrame* p) {
+                            av_frame_free(&p);
+                        });
+                    }
+                    const int64_t pts = pAvfrm->pts;
 #if LIBAVUTIL_VERSION_MAJOR > 57 || (LIBAVUTIL_VERSION_MAJOR == 57 && LIBAVUTIL_VERSION_MINOR > 29)
-                        const int64_t dur = pAvfrm->duration;
+                    const int64_t dur = pAvfrm->duration;
 #else
-                        const int64_t dur = pAvfrm->pkt_duration;
+                    const int64_t dur = pAvfrm->pkt_duration;
 #endif
-                        pAvfrm = nullptr;
+                    pAvfrm = nullptr;
 
-                        auto pVf = new VideoFrame_Impl(this, frmPtr, CvtPtsToMts(pts), pts, dur, isHwfrm);
-                        if (isStartFrame)
-                        {
-                            pVf->isStartFrame = true;
-                            isStartFrame = false;
-                        }
-                        if (m_readForward && hPrevFrm && hPrevFrm->Pts() >= pVf->pts)
-                            m_logger->Log(WARN) << "!! Video decoder output is NON-MONOTONIC !! prev-pts=" << hPrevFrm->Pts() << " >= pts=" << pVf->pts << endl;
+                    auto pVf = new VideoFrame_Impl(this, frmPtr, CvtPtsToMts(pts), pts, dur, isHwfrm);
+                    if (isStartFrame)
+                    {
+                        pVf->isStartFrame = true;
+                        isStartFrame = false;
+                    }
+                    if (m_readForward && hPrevFrm && hPrevFrm->Pts() >= pVf->pts)
+                        m_logger->Log(WARN) << "!! Video decoder output is NON-MONOTONIC !! prev-pts=" << hPrevFrm->Pts() << " >= pts=" << pVf->pts << endl;
 
-                        VideoFrame::Holder hVfrm(pVf, VIDEO_READER_VIDEO_FRAME_HOLDER_DELETER);
-                        hPrevFrm = hVfrm;
-                        lock_guard<mutex> _lk(m_vfrmQLock);
-                        auto riter = find_if(m_vfrmQ.rbegin(), m_vfrmQ.rend(), [pts] (auto& vf) {
-                            return vf->Pts() < pts;
-                        });
-                        auto iter = riter.base();
-                        if (iter != m_vfrmQ.end() && (*iter)->Pts() == pts)
-                            m_logger->Log(DEBUG) << "DISCARD duplicated VF@" << hVfrm->Pos() << "(" << hVfrm->Pts() << ")." << endl;
-                        else
+                    VideoFrame::Holder hVfrm(pVf, VIDEO_READER_VIDEO_FRAME_HOLDER_DELETER);
+                    hPrevFrm = hVfrm;
+                    lock_guard<mutex> _lk(m_vfrmQLock);
+                    auto riter = find_if(m_vfrmQ.rbegin(), m_vfrmQ.rend(), [pts] (auto& vf) {
+                        return vf->Pts() < pts;
+                    });
+                    auto iter = riter.base();
+                    if (iter != m_vfrmQ.end() && (*iter)->Pts() == pts)
+                        m_logger->Log(DEBUG) << "DISCARD duplicated VF@" << hVfrm->Pos() << "(" << hVfrm->Pts() << ")." << endl;
+                    else
+                    {
+                        if (m_bSeekingMode)
                         {
-                            if (m_bSeekingMode)
+                            bool bRefreshCache = m_vfrmQ.empty() ||
+                                    m_hSeekingFlash && abs(hVfrm->Pos()-m_hSeekingFlash->Pos()) >= m_seekingFlashCacheRefreshThresh;
+                            if (bRefreshCache)
                             {
-                                bool bRefreshCache = m_vfrmQ.empty() ||
-                                        m_hSeekingFlash && abs(hVfrm->Pos()-m_hSeekingFlash->Pos()) >= m_seekingFlashCacheRefreshThresh;
-                                if (bRefreshCache)
-                                {
-                                    m_logger->Log(DEBUG) << "UPDATE SEEKING FLASH. pts=" << hVfrm->Pts() << "(mts=" << CvtPtsToMts(hVfrm->Pts()) << ")." << endl;
-                                    m_hSeekingFlash = hVfrm;
-                                }
+                                m_logger->Log(DEBUG) << "UPDATE SEEKING FLASH. pts=" << hVfrm->Pts() << "(mts=" << CvtPtsToMts(hVfrm->Pts()) << ")." << endl;
+                                m_hSeekingFlash = hVfrm;
                             }
-                            m_vfrmQ.insert(iter, hVfrm);
                         }
+                        m_vfrmQ.insert(iter, hVfrm);
                     }
-                    idleLoop = false;
                 }
-                else if (fferr == AVERROR_EOF)
+                idleLoop = false;
+            }
+            else if (fferr == AVERROR_EOF)
+            {
+                m_logger->Log(VERBOSE) << ">>> Decoder EOF <<<" << endl;
+                decoderEof = true;
+                lock_guard<mutex> _lk(m_vfrmQLock);
+                if (!m_vfrmQ.empty())
                 {
-                    m_logger->Log(VERBOSE) << ">>> Decoder EOF <<<" << endl;
-                    decoderEof = true;
-                    lock_guard<mutex> _lk(m_vfrmQLock);
-                    if (!m_vfrmQ.empty())
-                    {
-                        VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
-                        pVf->isEofFrame = true;
-                    }
-                    else if (hPrevFrm)
-                    {
-                        VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(hPrevFrm.get());
-                        pVf->isEofFrame = true;
-                        m_vfrmQ.push_back(hPrevFrm);
-                    }
+                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
+                    pVf->isEofFrame = true;
                 }
-                else if (fferr != AVERROR(EAGAIN))
+                else if (hPrevFrm)
                 {
-                    m_logger->Log(WARN) << "avcodec_receive_frame() FAILED! fferr=" << fferr << "." << endl;
+                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(hPrevFrm.get());
+                    pVf->isEofFrame = true;
+                    m_vfrmQ.push_back(hPrevFrm);
                 }
-                if (pAvfrm) av_frame_free(&pAvfrm);
             }
+            else if (fferr != AVERROR(EAGAIN))
+            {
+                m_logger->Log(WARN) << "avcodec_receive_frame() FAILED! fferr=" << fferr << "." << endl;
+            }
+            if (pAvfrm) av_frame_free(&pAvfrm);
+        }
 
-            // send avpacket data to the decoder
-            if (hVpkt && !nullPktSent)
+        // send avpacket data to the decoder
+        if (hVpkt && !nullPktSent)
+        {
+            AVPacket* pPkt = hVpkt->pktPtr ? hVpkt->pktPtr.get() : nullptr;
+            if (!pPkt) nullPktSent = true;
             {
-                AVPacket* pPkt = hVpkt->pktPtr ? hVpkt->pktPtr.get() : nullptr;
-                if (!pPkt) nullPktSent = true;
-                {
-                    lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                    fferr = avcodec_send_packet(m_viddecCtx, pPkt);
-                }
-                if (fferr != AVERROR(EAGAIN))
-                {
-                    m_logger->Log(VERBOSE) << "======= Send video packet: pts=";
-                    if (pPkt)
-                        m_logger->Log(VERBOSE) << pPkt->pts << ", ts=" << (double)CvtPtsToMts(pPkt->pts)/1000;
-                    else
-                        m_logger->Log(VERBOSE) << "(null)";
-                    m_logger->Log(VERBOSE) << ", fferr=" << fferr << "." << endl;
-                }
-                bool popPkt = false;
-                if (fferr == 0)
-                {
-                    if (hVpkt->isStartPacket)
-                        isStartFrame = true;
-                    popPkt = true;
-                    idleLoop = false;
-                }
-                else if (fferr != AVERROR(EAGAIN))
-                {
-                    m_logger->Log(WARN) << "avcodec_send_packet() FAILED! fferr=" << fferr << "." << endl;
-                    popPkt = true;
-                    idleLoop = false;
-                }
-                if (popPkt)
-                {
-                    lock_guard<mutex> _lk(m_vpktQLock);
-                    if (!m_vpktQ.empty() && hVpkt == m_vpktQ.front())
-                        m_vpktQ.pop_front();
-                }
+                lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
+                fferr = avcodec_send_packet(m_viddecCtx, pPkt);
+            }
+            if (fferr != AVERROR(EAGAIN))
+            {
+                m_logger->Log(VERBOSE) << "======= Send video packet: pts=";
+                if (pPkt)
+                    m_logger->Log(VERBOSE) << pPkt->pts << ", ts=" << (double)CvtPtsToMts(pPkt->pts)/1000;
+                else
+                    m_logger->Log(VERBOSE) << "(null)";
+                m_logger->Log(VERBOSE) << ", fferr=" << fferr << "." << endl;
+            }
+            bool popPkt = false;
+            if (fferr == 0)
+            {
+                if (hVpkt->isStartPacket)
+                    isStartFrame = true;
+                popPkt = true;
+                idleLoop = false;
+            }
+            else if (fferr != AVERROR(EAGAIN))
+            {
+                m_logger->Log(WARN) << "avcodec_send_packet() FAILED! fferr=" << fferr << "." << endl;
+                popPkt = true;
+                idleLoop = false;
             }
+            if (popPkt)
+            {
+                lock_guard<mutex> _lk(m_vpktQLock);
+                if (!m_vpktQ.empty() && hVpkt == m_vpktQ.front())
+                    m_vpktQ.pop_front();
+            }
+        }
 
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+        if (!idleLoop)
+        {
+            WakeupLoop(m_hDemuxLoop);
+            WakeupLoop(m_hCnvMatLoop);
+            m_vfrmReadySignal.Notify();
         }
-        m_decThdRunning = false;
-        m_logger->Log(DEBUG) << "Leave DecodeThreadProc()." << endl;
+        return !idleLoop;
     }
 
-    void ConvertMatThreadProc()
+    // One iteration of the loop transferring the hardware frames, returns false if there is nothing to do
+    bool ConvertMatStep()
     {
-        m_logger->Log(DEBUG) << "Enter ConvertMatThreadProc()..." << endl;
-        while (!m_prepared && !m_quitThread)
-            this_thread::sleep_for(chrono::milliseconds(5));
+        if (!m_prepared)
+            return false;
 
-        while (!m_quitThread)
-        {
-            bool idleLoop = true;
+        bool idleLoop = true;
 
-            // remove unused frames and find the next frame needed to do the conversion
-            VideoFrame::Holder hVfrm;
-            if (m_bSeekingMode)
-            {  // in seeking mode, we don't remove frames
-                lock_guard<mutex> _lk(m_vfrmQLock);
-                auto iter = find_if(m_vfrmQ.begin(), m_vfrmQ.end(), [] (const auto& elem) {
-                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(elem.get());
-                    return pVf->isHwfrm;
-                });
-                if (iter != m_vfrmQ.end())
-                    hVfrm = *iter;
+        // remove unused frames and find the next frame needed to do the conversion
+        VideoFrame::Holder hVfrm;
+        if (m_bSeekingMode)
+        {  // in seeking mode, we don't remove frames
+            lock_guard<mutex> _lk(m_vfrmQLock);
+            auto iter = find_if(m_vfrmQ.begin(), m_vfrmQ.end(), [] (const auto& elem) {
+                VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(elem.get());
+                return pVf->isHwfrm;
+            });
+            if (iter != m_vfrmQ.end())
+                hVfrm = *iter;
+        }
+        else
+        {
+            lock_guard<mutex> _lk(m_vfrmQLock);
+            auto iter = m_vfrmQ.begin();
+            bool firstGreaterPts = true;
+            bool backIsEof = false;
+            bool startIsEof = false;
+            if (!m_vfrmQ.empty())
+            {
+                VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
+                backIsEof = pVf->isEofFrame;
+                pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.front().get());
+                startIsEof = pVf->isStartFrame;
             }
-            else
+            while (iter != m_vfrmQ.end())
             {
-                lock_guard<mutex> _lk(m_vfrmQLock);
-                auto iter = m_vfrmQ.begin();
-                bool firstGreaterPts = true;
-                bool backIsEof = false;
-                bool startIsEof = false;
-                if (!m_vfrmQ.empty())
-                {
-                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
-                    backIsEof = pVf->isEofFrame;
-                    pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.front().get());
-                    startIsEof = pVf->isStartFrame;
-                }
-                while (iter != m_vfrmQ.end())
+                VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(iter->get());
+                bool remove = false;
+                if (pVf->pts+pVf->dur < m_cacheRange.first)
                 {
-                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(iter->get());
-                    bool remove = false;
-                    if (pVf->pts+pVf->dur < m_cacheRange.first)
+                    if (m_readForward)
                     {
-                        if (m_readForward)
+                        auto itNxtFrm = iter; itNxtFrm++;
+                        VideoFrame_Impl* pNxtVf = itNxtFrm == m_vfrmQ.end() ? nullptr : dynamic_cast<VideoFrame_Impl*>(iter->get());
+                        if (pNxtVf && pNxtVf->pts <= m_cacheRange.first)
                         {
-                            auto itNxtFrm = iter; itNxtFrm++;
-                            VideoFrame_Impl* pNxtVf = itNxtFrm == m_vfrmQ.end() ? nullptr : dynamic_cast<VideoFrame_Impl*>(iter->get());
-                            if (pNxtVf && pNxtVf->pts <= m_cacheRange.first)
-                            {
-                                // m_logger->Log(VERBOSE) << "   --------- Set remove=true : pVf->pts(" << pVf->pts << ")+pVf->dur(" << pVf->dur << ") < cacheRange.first(" << m_cacheRange.first
-                                //         << "), readForward=" << m_readForward << ", pNxtVf->pts=" << (pNxtVf ? std::to_string(pNxtVf->pts) : "NULL") << endl;;
-                                remove = true;
-                            }
-                        }
-                    }
-                    else if (pVf->pts > m_cacheRange.second)
-                    {
-                        if (firstGreaterPts)
-                            firstGreaterPts = false;
-                        else
-                        {
-                            // m_logger->Log(VERBOSE) << "   --------- Set remove=true : pVf->pts(" << pVf->pts << ") > cacheRange.second(" << m_cacheRange.second << ")" << endl;
+                            // m_logger->Log(VERBOSE) << "   --------- Set remove=true : pVf->pts(" << pVf->pts << ")+pVf->dur(" << pVf->dur << ") < cacheRange.first(" << m_cacheRange.first
+                            //         << "), readForward=" << m_readForward << ", pNxtVf->pts=" << (pNxtVf ? std::to_string(pNxtVf->pts) : "NULL") << endl;;
                             remove = true;
                         }
                     }
-                    if (remove)
-                    {
-                        m_logger->Log(VERBOSE) << "   --------- Remove video frame: pts=" << pVf->pts << ", pos=" << pVf->pos << "." << endl;
-                        iter = m_vfrmQ.erase(iter);
-                        continue;
-                    }
-                    if (!hVfrm && pVf->isHwfrm)
-                        hVfrm = *iter;
-                    iter++;
                 }
-                if (!m_vfrmQ.empty())
+                else if (pVf->pts > m_cacheRange.second)
                 {
-                    if (m_readForward)
+                    if (firstGreaterPts)
+                        firstGreaterPts = false;
+                    else
                     {
-                        if (startIsEof)
-                        {
-                            VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.front().get());
-                            pVf->isStartFrame = true;
-                        }
+                        // m_logger->Log(VERBOSE) << "   --------- Set remove=true : pVf->pts(" << pVf->pts << ") > cacheRange.second(" << m_cacheRange.second << ")" << endl;
+                        remove = true;
                     }
-                    else if (backIsEof)
+                }
+                if (remove)
+                {
+                    m_logger->Log(VERBOSE) << "   --------- Remove video frame: pts=" << pVf->pts << ", pos=" << pVf->pos << "." << endl;
+                    iter = m_vfrmQ.erase(iter);
+                    continue;
+                }
+                if (!hVfrm && pVf->isHwfrm)
+                    hVfrm = *iter;
+                iter++;
+            }
+            if (!m_vfrmQ.empty())
+            {
+                if (m_readForward)
+                {
+                    if (startIsEof)
                     {
-                        VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
-                        pVf->isEofFrame = true;
+                        VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.front().get());
+                        pVf->isStartFrame = true;
                     }
                 }
+                else if (backIsEof)
+                {
+                    VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(m_vfrmQ.back().get());
+                    pVf->isEofFrame = true;
+                }
             }
+        }
 
-            // transfer hardware frame to software frame, to reduce the count of frames referenced from decoder
-            if (hVfrm)
+        if (m_hMemConsumer)
+        {
+            size_t cachedFrameCount;
             {
-                VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(hVfrm.get());
-                // acquire the lock of 'frmPtr'
-                while (!m_quitThread)
+                lock_guard<mutex> _lk(m_vfrmQLock);
+                cachedFrameCount = m_vfrmQ.size();
+            }
+            m_hMemConsumer->UpdateUsage(cachedFrameCount*m_frameBytes);
+        }
+
+        // transfer hardware frame to software frame, to reduce the count of frames referenced from decoder
+        if (hVfrm)
+        {
+            VideoFrame_Impl* pVf = dynamic_cast<VideoFrame_Impl*>(hVfrm.get());
+            // acquire the lock of 'frmPtr'
+            while (!m_quitThread)
+            {
+                bool testVal = false;
+                if (pVf->frmPtrInUse.compare_exchange_strong(testVal, true))
+                    break;
+                this_thread::sleep_for(chrono::milliseconds(5));
+            }
+
+            if (!m_quitThread && pVf->frmPtr)
+            {
+                SelfFreeAVFramePtr swfrm = AllocSelfFreeAVFramePtr();
+                lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
+                if (!TransferHwFrameToSwFrame(swfrm.get(), pVf->frmPtr.get()))
                 {
-                    bool testVal = false;
-                    if (pVf->frmPtrInUse.compare_exchange_strong(testVal, true))
-                        break;
-                    this_thread::sleep_for(chrono::milliseconds(5));
+                    m_logger->Log(Error) << "TransferHwFrameToSwFrame() FAILED at pos " << pVf->pos << "(" << pVf->pts << ")! Discard this frame." << endl;
+                    pVf->frmPtr = nullptr;
+                    lock_guard<mutex> _lk(m_vfrmQLock);
+                    auto iter = find(m_vfrmQ.begin(), m_vfrmQ.end(), hVfrm);
+                    if (iter != m_vfrmQ.end()) m_vfrmQ.erase(iter);
                 }
-
-                if (!m_quitThread && pVf->frmPtr)
+                else
                 {
-                    SelfFreeAVFramePtr swfrm = AllocSelfFreeAVFramePtr();
-                    lock_guard<ConditionalMutex> lk(m_hwDecCtxLock);
-                    if (!TransferHwFrameToSwFrame(swfrm.get(), pVf->frmPtr.get()))
-                    {
-                        m_logger->Log(Error) << "TransferHwFrameToSwFrame() FAILED at pos " << pVf->pos << "(" << pVf->pts << ")! Discard this frame." << endl;
-                        pVf->frmPtr = nullptr;
-                        lock_guard<mutex> _lk(m_vfrmQLock);
-                        auto iter = find(m_vfrmQ.begin(), m_vfrmQ.end(), hVfrm);
-                        if (iter != m_vfrmQ.end()) m_vfrmQ.erase(iter);
-                    }
-                    else
-                    {
-                        pVf->frmPtr = swfrm;
-                    }
+                    pVf->frmPtr = swfrm;
                 }
-                pVf->isHwfrm = false;
-                pVf->frmPtrInUse = false;
-                idleLoop = false;
             }
+            pVf->isHwfrm = false;
+            pVf->frmPtrInUse = false;
+            idleLoop = false;
+        }
 
-            if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+        if (!idleLoop)
+        {
+            WakeupLoop(m_hDecodeLoop);
+            m_vfrmReadySignal.Notify();
         }
-        m_cnvThdRunning = false;
-        m_logger->Log(DEBUG) << "Leave ConvertMatThreadProc()." << endl;
+        return !idleLoop;
     }
 
 private:
@@ -1958,25 +2178,27 @@ private:
     int64_t m_vidDurationPts{0};
     AVRational m_vidTimeBase;
 
-    // demuxing thread
-    thread m_demuxThread;
-    bool m_dmxThdRunning{false};
+    TaskExecutor::Holder m_hExecutor;
+    // demuxing loop
+    TaskExecutor::Loop::Holder m_hDemuxLoop;
+    DemuxLoopState m_demuxState;
     list<VideoPacket::Holder> m_vpktQ;
     mutex m_vpktQLock;
     size_t m_vpktQMaxSize{8};
     int m_minGreaterPtsCountThanReadPos{2};
-    // video decoding thread
-    thread m_decodeThread;
-    bool m_decThdRunning{false};
+    // video decoding loop
+    TaskExecutor::Loop::Holder m_hDecodeLoop;
+    DecodeLoopState m_decodeState;
     list<VideoFrame::Holder> m_vfrmQ;
     mutex m_vfrmQLock;
     atomic_int32_t m_pendingHwfrmCnt{0};
     int32_t m_maxPendingHwfrmCnt{2};
     ConditionalMutex m_hwDecCtxLock;
-    // convert hw frame to sw frame thread
-    thread m_cnvMatThread;
-    bool m_cnvThdRunning{false};
+    // convert hw frame to sw frame loop
+    TaskExecutor::Loop::Holder m_hCnvMatLoop;
     FFUtils::FFFilterGraph::Holder m_hTransposeFilter;
+    // wake-up signal for the readers waiting on output frames
+    BroadcastSignal m_vfrmReadySignal;
 
     int64_t m_readPts{0};
     pair<int64_t, int64_t> m_cacheRange;
@@ -2006,6 +2228,14 @@ private:
     ImInterpolateMode m_interpMode;
     HwaccelManager::Holder m_hHwaMgr;
     AVFrameToImMatConverter* m_pFrmCvt{nullptr};
+
+    ReverseVideoDecoder::Holder m_hRvsDecoder;
+    uint64_t m_rvsDecMemLimit{0};
+    atomic_bool m_rvsDecActive{false};
+    MemoryBudget::Consumer::Holder m_hMemConsumer;
+    uint64_t m_frameBytes{0};
+    atomic<uint64_t> m_memQuota{UINT64_MAX};
+    atomic_bool m_memQuotaChanged{false};
 };
 
 const function<void (VideoFrame*)> VideoReader_Impl::VIDEO_READER_VIDEO_FRAME_HOLDER_DELETER = [] (VideoFrame* p) {
@@ -17,6 +17,7 @@
 
 #include <sstream>
 #include <algorithm>
+#include <unordered_map>
 #include <atomic>
 #include <thread>
 #include <cmath>
@@ -24,6 +25,9 @@
 #include "VideoTrack.h"
 #include "MediaCore.h"
 #include "ThreadUtils.h"
+#include "TaskExecutor.h"
+#include "HashUtils.h"
+#include "IntervalList.h"
 #include "DebugHelper.h"
 #include "Logger.h"
 
@@ -35,12 +39,13 @@ namespace MediaCore
 class ReadFrameTask_Impl : public ReadFrameTask
 {
 public:
-    ReadFrameTask_Impl(int64_t frameIndex, int64_t readPos, bool canDrop, bool needSeek, bool bypassBgNode)
+    ReadFrameTask_Impl(int64_t frameIndex, int64_t readPos, bool canDrop, bool needSeek, bool bypassBgNode, bool scrubbing)
         : m_frameIndex(frameIndex)
         , m_readPos(readPos)
         , m_canDrop(canDrop)
         , m_needSeek(needSeek)
         , m_bypassBgNode(bypassBgNode)
+        , m_scrubbing(scrubbing)
     {}
 
     int64_t FrameIndex() const override
@@ -55,7 +60,12 @@ public:
 
     bool CanDrop() const
     {
-        return m_discarded || (m_canDrop && (!m_pCb || m_pCb->TriggerDrop()));
+        if (m_discarded)
+            return true;
+        if (!m_canDrop)
+            return false;
+        lock_guard<mutex> lk(m_cbLock);
+        return m_discarded || !m_pCb || m_pCb->TriggerDrop();
     }
 
     bool NeedSeek() const
@@ -73,29 +83,52 @@ public:
         m_seeked = true;
     }
 
+    bool IsScrubbing() const
+    {
+        return m_scrubbing;
+    }
+
+    // the preview source is taken as ready, so the task can be processed before the exact source frame is decoded
     bool IsSourceFrameReady() const override
     {
-        return m_src1Ready && (!m_hasOvlp || m_src2Ready);
+        return NeedReadSource() ? (bool)m_previewReady : true;
+    }
+
+    bool NeedReadSource() const
+    {
+        return !m_src1Ready || (m_hasOvlp && !m_src2Ready);
+    }
+
+    bool IsPreview() const override
+    {
+        return m_preview;
     }
 
     void StartProcessing() override
     {
         m_needProcess = true;
+        WakeupProcessLoop();
     }
 
     void Reprocess() override
     {
         m_outputReady = false;
+        WakeupProcessLoop();
     }
 
     VideoFrame::Holder GetVideoFrame() override
     {
+        lock_guard<mutex> lk(m_mtxOutFrames);
         return m_hOutVfrm;
     }
 
+    // The callback is detached, and the invocation in progress is waited for. So the owner of the callback
+    // can be destroyed after this call.
     void SetDiscarded() override
     {
+        lock_guard<mutex> lk(m_cbLock);
         m_discarded = true;
+        m_pCb = nullptr;
     }
 
     bool IsDiscarded() const override
@@ -115,6 +148,7 @@ public:
 
     bool Start()
     {
+        lock_guard<mutex> lk(m_cbLock);
         if (m_discarded)
             return false;
         m_started = !m_pCb || m_pCb->TriggerStart();
@@ -131,14 +165,22 @@ public:
         m_visible = visible;
     }
 
+    void SetOccluded(bool occluded) override
+    {
+        m_occluded = occluded;
+    }
+
+    bool IsOccluded() const override
+    {
+        return m_occluded;
+    }
+
     void UpdateHostFrames() override
     {
-        if (!m_pCb)
-            return;
         unique_lock<mutex> lk(m_mtxOutFrames);
         const auto outFrames(m_outFrames);
         lk.unlock();
-        m_pCb->UpdateOutputFrames(outFrames);
+        InvokeCallback([&outFrames] (Callback* pCb) { pCb->UpdateOutputFrames(outFrames); });
     }
 
     bool IsInited() const
@@ -146,12 +188,17 @@ public:
         return m_inited;
     }
 
-    void Initialize(VideoClip::Holder hClip1, VideoClip::Holder hClip2, VideoOverlap::Holder hOvlp)
+    // The start times are taken from the snapshot which the clips and the overlap are found in, the clip objects are
+    // shared with the edits and may have been moved since then.
+    void Initialize(VideoClip::Holder hClip1, int64_t clipStart1, VideoClip::Holder hClip2, int64_t clipStart2, VideoOverlap::Holder hOvlp, int64_t ovlpStart)
     {
         m_hClip1 = hClip1;
+        m_clipStart1 = clipStart1;
         m_hClip2 = hClip2;
+        m_clipStart2 = clipStart2;
         m_hasOvlp = hOvlp != nullptr;
         m_hOvlp = hOvlp;
+        m_ovlpStart = ovlpStart;
         m_inited = true;
     }
 
@@ -163,15 +210,23 @@ public:
     void SetOutputReady()
     {
         m_outputReady = true;
+        InvokeCallback([] (Callback* pCb) { pCb->OnOutputFrameReady(); });
     }
 
     void DoReadSourceFrame()
     {
+        if (m_occluded)
+        {
+            // the frame is covered by the upper layers, no need to decode it
+            m_src1Ready = m_src2Ready = true;
+            InvokeCallback([] (Callback* pCb) { pCb->OnSourceFrameReady(); });
+            return;
+        }
         if (m_hClip1)
         {
             if (!m_src1Ready)
             {
-                auto clipPos = m_readPos-m_hClip1->Start();
+                auto clipPos = m_readPos-m_clipStart1;
                 m_srcVf1 = m_hClip1->ReadSourceFrame(clipPos, m_eof1, false);
                 if (m_srcVf1 || m_eof1)
                 {
@@ -190,7 +245,7 @@ public:
         {
             if (!m_src2Ready)
             {
-                auto clipPos = m_readPos-m_hClip2->Start();
+                auto clipPos = m_readPos-m_clipStart2;
                 m_srcVf2 = m_hClip2->ReadSourceFrame(clipPos, m_eof2, false);
                 if (m_srcVf2 || m_eof2)
                 {
@@ -205,41 +260,58 @@ public:
         }
         else
             m_src2Ready = true;
+        if (!NeedReadSource())
+        {
+            // refine the preview output with the exact source frame
+            if (m_previewReady)
+            {
+                m_previewReady = false;
+                m_hPreviewVf = nullptr;
+                m_outputReady = false;
+                WakeupProcessLoop();
+            }
+        }
+        else if (m_scrubbing && !m_previewReady && !m_hasOvlp && m_hClip1)
+        {
+            // the overlaps are not previewed, the transitions need the frames of both clips at the same time
+            m_hPreviewVf = m_hClip1->GetSeekingFlash();
+            m_previewReady = (bool)m_hPreviewVf;
+        }
+        if (IsSourceFrameReady())
+            InvokeCallback([] (Callback* pCb) { pCb->OnSourceFrameReady(); });
     }
 
     void ProcessFrame()
     {
-        if (!m_visible)
+        if (!m_visible || m_occluded)
         {
-            m_outputReady = true;
+            SetOutputReady();
             return;
         }
         if (!IsSourceFrameReady())
             return;
         if (!m_hClip1)
         {
-            m_outputReady = true;
+            SetOutputReady();
             return;
         }
 
         unordered_map<string, string> extraArgs;
         if (m_bypassBgNode)
             extraArgs["bypass_bg_node"] = "true";
+        // the preview is made from the nearest keyframe with the clip filter skipped, only the transform is applied
+        const bool preview = NeedReadSource();
+        if (preview)
+            extraArgs["bypass_filter"] = "true";
         vector<CorrelativeVideoFrame::Holder> outFrames;
         VideoFrame::Holder hOutVfrm;
         if (m_hasOvlp)
-        {
-            m_outFrames.clear();
-            hOutVfrm = m_hOvlp->ProcessSourceFrame(m_readPos-m_hOvlp->Start(), outFrames, m_srcVf1, m_srcVf2, &extraArgs);
-        }
-        else if (m_hClip1)
-        {
-            m_outFrames.clear();
-            hOutVfrm = m_hClip1->ProcessSourceFrame(m_readPos-m_hClip1->Start(), outFrames, m_srcVf1, &extraArgs);
-        }
+            hOutVfrm = m_hOvlp->ProcessSourceFrame(m_readPos-m_ovlpStart, outFrames, m_srcVf1, m_srcVf2, &extraArgs);
+        else
+            hOutVfrm = m_hClip1->ProcessSourceFrame(m_readPos-m_clipStart1, outFrames, preview ? m_hPreviewVf : m_srcVf1, &extraArgs);
         {
             lock_guard<mutex> lg(m_mtxOutFrames);
-            m_outFrames.insert(m_outFrames.end(), outFrames.begin(), outFrames.end());
+            m_outFrames.assign(outFrames.begin(), outFrames.end());
         }
         if (!hOutVfrm)
             return;
@@ -247,43 +319,86 @@ public:
         if (!hOutVfrm->GetMat(tOutMat))
             return;
         tOutMat.time_stamp = (double)m_readPos/1000;
-        m_hOutVfrm = VideoFrame::CreateMatInstance(tOutMat);
-        m_hOutVfrm->SetOpacity(hOutVfrm->Opacity());
-        m_outputReady = true;
+        // the mixers read the output with 'GetVideoFrame()', so the frame is completed before it's published
+        auto hNewOutVfrm = VideoFrame::CreateMatInstance(tOutMat);
+        hNewOutVfrm->SetOpacity(hOutVfrm->Opacity());
+        {
+            lock_guard<mutex> lg(m_mtxOutFrames);
+            m_hOutVfrm = hNewOutVfrm;
+        }
+        // cleared after the exact output is set, so the mixer never takes a preview frame as the exact one
+        m_preview = preview;
+        SetOutputReady();
     }
 
     void SetCallback(Callback* pCallback) override
     {
+        lock_guard<mutex> lk(m_cbLock);
         m_pCb = pCallback;
     }
 
+    // the loop to wake up when the task needs to be processed
+    void SetProcessLoop(TaskExecutor::Loop::Holder hLoop)
+    {
+        m_wpProcessLoop = hLoop;
+    }
+
+private:
+    void WakeupProcessLoop()
+    {
+        auto hLoop = m_wpProcessLoop.lock();
+        if (hLoop)
+            hLoop->Wakeup();
+    }
+
+    // invoke 'fn' on the callback unless the task is discarded, 'm_cbLock' is held during the invocation
+    template<typename Fn>
+    void InvokeCallback(Fn&& fn) const
+    {
+        lock_guard<mutex> lk(m_cbLock);
+        if (!m_discarded && m_pCb)
+            fn(m_pCb);
+    }
+
 private:
     int64_t m_frameIndex;
     int64_t m_readPos;
     bool m_canDrop;
     bool m_needSeek;
     bool m_bypassBgNode;
+    bool m_scrubbing;
     bool m_seeked{false};
     bool m_started{false};
     bool m_inited{false};
-    bool m_needProcess{false};
+    atomic_bool m_needProcess{false};
     bool m_visible{true};
+    atomic_bool m_occluded{false};
     VideoFrame::Holder m_srcVf1;
     bool m_eof1{false};
     VideoClip::Holder m_hClip1;
-    bool m_src1Ready{false};
+    int64_t m_clipStart1{0};
+    atomic_bool m_src1Ready{false};
     bool m_hasOvlp{false};
     VideoFrame::Holder m_srcVf2;
     bool m_eof2{false};
     VideoClip::Holder m_hClip2;
-    bool m_src2Ready{false};
+    int64_t m_clipStart2{0};
+    atomic_bool m_src2Ready{false};
     VideoOverlap::Holder m_hOvlp;
+    int64_t m_ovlpStart{0};
+    // the seeking flash of the clip used as the source of the preview output
+    VideoFrame::Holder m_hPreviewVf;
+    atomic_bool m_previewReady{false};
+    atomic_bool m_preview{false};
+    // 'm_outFrames' and 'm_hOutVfrm' are guarded by 'm_mtxOutFrames'
     vector<CorrelativeVideoFrame::Holder> m_outFrames;
-    mutex m_mtxOutFrames;
     VideoFrame::Holder m_hOutVfrm;
-    bool m_outputReady{false};
-    bool m_discarded{false};
+    mutex m_mtxOutFrames;
+    atomic_bool m_outputReady{false};
+    atomic_bool m_discarded{false};
     Callback* m_pCb{nullptr};
+    mutable mutex m_cbLock;
+    weak_ptr<TaskExecutor::Loop> m_wpProcessLoop;
 };
 
 static const auto READ_FRAME_TASK_HOLDER_DELETER = [] (ReadFrameTask* p) {
@@ -291,12 +406,34 @@ static const auto READ_FRAME_TASK_HOLDER_DELETER = [] (ReadFrameTask* p) {
     delete ptr;
 };
 
-static const auto CLIP_SORT_CMP = [] (const VideoClip::Holder& a, const VideoClip::Holder& b){
-    return a->Start() < b->Start();
-};
+// An immutable state of the clips and the overlaps on a track. Every edit publishes a new snapshot, the read path
+// pins the current one without taking the edit lock.
+// The clip and overlap objects are shared with the edits, only their ranges on the track are copied into the indices.
+// So the read path takes the positions from the snapshot with 'ClipStart()' and 'OverlapStart()', instead of calling
+// 'Start()' on the objects. The states inside a clip, such as the offsets in the source and the filters, are not
+// copied, an edit on them is seen by the read path at once.
+struct VideoTrackSnapshot
+{
+    using Holder = shared_ptr<const VideoTrackSnapshot>;
+
+    IntervalList<VideoClip::Holder> clips;
+    unordered_map<int64_t, VideoClip::Holder> clipTable;
+    IntervalList<VideoOverlap::Holder> overlaps;
+    int64_t duration{0};
+    uint32_t version{0};
+    TimePoint publishTime;
+
+    int64_t ClipStart(const VideoClip::Holder& hClip) const
+    {
+        int64_t start, end;
+        return clips.GetIndexedRange(hClip, start, end) ? start : hClip->Start();
+    }
 
-static const auto OVERLAP_SORT_CMP = [] (const VideoOverlap::Holder& a, const VideoOverlap::Holder& b) {
-    return a->Start() < b->Start();
+    int64_t OverlapStart(const VideoOverlap::Holder& hOvlp) const
+    {
+        int64_t start, end;
+        return overlaps.GetIndexedRange(hOvlp, start, end) ? start : hOvlp->Start();
+    }
 };
 
 class VideoTrack_Impl : public VideoTrack
@@ -314,16 +451,15 @@ public:
         string tag = loggerNameOss.str();
         m_logger = GetLogger(tag);
 
-        m_readClipIter = m_clips.begin();
-        m_readThread = thread(&VideoTrack_Impl::ReadFrameProc, this);
-        SysUtils::SetThreadName(m_readThread, tag);
+        m_hSnapshot = make_shared<VideoTrackSnapshot>();
+        m_hExecutor = TaskExecutor::GetDefaultInstance();
+        m_hReadLoop = m_hExecutor->StartLoop([this] { return ReadFrameStep(); });
     }
 
     ~VideoTrack_Impl()
     {
-        m_quitThread = true;
-        if (m_readThread.joinable())
-            m_readThread.join();
+        m_hReadLoop->Stop();
+        m_hReadLoop = nullptr;
         for (auto& rft : m_readFrameTasks)
             rft->SetDiscarded();
         m_readFrameTasks.clear();
@@ -361,11 +497,9 @@ public:
         // add this clip into clip list 2
         hClip->SetDirection(m_readForward);
         hClip->SetTrackId(m_id);
-        m_clips2.push_back(hClip);
-        if (hClip->End() > m_duration2)
-            m_duration2 = hClip->End();
-        UpdateClipOverlap();
-        m_clipChanged = true;
+        m_clipTable2[hClip->Id()] = hClip;
+        UpdateClipIndex(hClip);
+        PublishSnapshot();
     }
 
     void MoveClip(int64_t id, int64_t start) override
@@ -377,25 +511,12 @@ public:
         if (hClip->Start() == start)
             return;
 
-        bool isTailClip = hClip->End() == m_duration2;
         hClip->SetStart(start);
         if (!CheckClipRangeValid(id, hClip->Start(), hClip->End()))
             throw invalid_argument("Invalid argument for moving clip!");
 
-        if (hClip->End() >= m_duration2)
-            m_duration2 = hClip->End();
-        else if (isTailClip)
-        {
-            int64_t newDuration = 0;
-            for (auto& clip : m_clips2)
-            {
-                if (clip->End() > newDuration)
-                    newDuration = clip->End();
-            }
-            m_duration2 = newDuration;
-        }
-        UpdateClipOverlap();
-        m_clipChanged = true;
+        UpdateClipIndex(hClip);
+        PublishSnapshot();
     }
 
     void ChangeClipRange(int64_t id, int64_t startOffset, int64_t endOffset) override
@@ -405,7 +526,6 @@ public:
         if (!hClip)
             throw invalid_argument("Invalid value for argument 'id'!");
 
-        bool isTailClip = hClip->End() == m_duration2;
         bool rangeChanged = false;
         if (hClip->IsImage())
         {
@@ -443,48 +563,21 @@ public:
         if (!CheckClipRangeValid(id, hClip->Start(), hClip->End()))
             throw invalid_argument("Invalid argument for changing clip range!");
 
-        if (hClip->End() >= m_duration2)
-            m_duration2 = hClip->End();
-        else if (isTailClip)
-        {
-            int64_t newDuration = 0;
-            for (auto& clip : m_clips2)
-            {
-                if (clip->End() > newDuration)
-                    newDuration = clip->End();
-            }
-            m_duration2 = newDuration;
-        }
-        UpdateClipOverlap();
-        m_clipChanged = true;
+        UpdateClipIndex(hClip);
+        PublishSnapshot();
     }
 
     VideoClip::Holder RemoveClipById(int64_t clipId) override
     {
         lock_guard<recursive_mutex> lk(m_clipChangeLock);
-        auto iter = find_if(m_clips2.begin(), m_clips2.end(), [clipId](const VideoClip::Holder& clip) {
-            return clip->Id() == clipId;
-        });
-        if (iter == m_clips2.end())
+        auto hClip = GetClipById2(clipId);
+        if (!hClip)
             return nullptr;
 
-        auto hClip = *iter;
-        bool isTailClip = hClip->End() == m_duration2;
-        m_clips2.erase(iter);
+        UpdateClipIndex(hClip, true);
+        m_clipTable2.erase(clipId);
         hClip->SetTrackId(-1);
-
-        if (isTailClip)
-        {
-            int64_t newDuration = 0;
-            for (auto& clip : m_clips2)
-            {
-                if (clip->End() > newDuration)
-                    newDuration = clip->End();
-            }
-            m_duration2 = newDuration;
-        }
-        UpdateClipOverlap();
-        m_clipChanged = true;
+        PublishSnapshot();
         return hClip;
     }
 
@@ -494,42 +587,24 @@ public:
         if (index >= m_clips2.size())
             throw invalid_argument("Argument 'index' exceeds the count of clips!");
 
-        auto iter = m_clips2.begin();
-        while (index > 0)
-        {
-            iter++; index--;
-        }
-
-        auto hClip = *iter;
-        bool isTailClip = hClip->End() == m_duration2;
-        m_clips2.erase(iter);
+        auto hClip = m_clips2.At(index);
+        UpdateClipIndex(hClip, true);
+        m_clipTable2.erase(hClip->Id());
         hClip->SetTrackId(-1);
-
-        if (isTailClip)
-        {
-            int64_t newDuration = 0;
-            for (auto& clip : m_clips2)
-            {
-                if (clip->End() > newDuration)
-                    newDuration = clip->End();
-            }
-            m_duration2 = newDuration;
-        }
-        UpdateClipOverlap();
-        m_clipChanged = true;
+        PublishSnapshot();
         return hClip;
     }
 
     list<VideoClip::Holder> GetClipList() override
     {
         lock_guard<recursive_mutex> lk(m_clipChangeLock);
-        return list<VideoClip::Holder>(m_clips);
+        return GetSnapshot()->clips.List();
     }
 
     list<VideoOverlap::Holder> GetOverlapList() override
     {
         lock_guard<recursive_mutex> lk(m_clipChangeLock);
-        return list<VideoOverlap::Holder>(m_overlaps);
+        return GetSnapshot()->overlaps.List();
     }
 
     int64_t Id() const override
@@ -554,9 +629,7 @@ public:
 
     int64_t Duration() const override
     {
-        if (m_clipChanged)
-            return m_duration2;
-        return m_duration;
+        return GetSnapshot()->duration;
     }
 
     int64_t ReadPos(int64_t frameIndex) const
@@ -570,15 +643,49 @@ public:
         return m_readForward;
     }
 
-    ReadFrameTask::Holder CreateReadFrameTask(int64_t frameIndex, bool canDrop, bool needSeek, bool bypassBgNode, ReadFrameTask::Callback* pCb) override
+    bool IsCoveringCanvas(int64_t frameIndex) override
+    {
+        if (!m_visible || frameIndex < 0)
+            return false;
+        const int64_t readPos = ReadPos(frameIndex);
+        auto hSnapshot = GetSnapshot();
+        // the transitions are not checked, they may mix the two clips in any way
+        if (hSnapshot->overlaps.FindAt(readPos))
+            return false;
+        auto hClip = hSnapshot->clips.FindAt(readPos);
+        return hClip ? hClip->IsCoveringCanvas(readPos-hSnapshot->ClipStart(hClip)) : false;
+    }
+
+    uint64_t GetContentHash(int64_t frameIndex) override
+    {
+        if (frameIndex < 0)
+            return 0;
+        const int64_t readPos = ReadPos(frameIndex);
+        auto hSnapshot = GetSnapshot();
+        auto hOvlp = hSnapshot->overlaps.FindAt(readPos);
+        if (hOvlp)
+        {
+            auto hFrontClip = hOvlp->FrontClip();
+            auto hRearClip = hOvlp->RearClip();
+            uint64_t hash = HashCombine(hFrontClip->GetContentHash(readPos-hSnapshot->ClipStart(hFrontClip)), hRearClip->GetContentHash(readPos-hSnapshot->ClipStart(hRearClip)));
+            hash = HashCombine(hash, (uint64_t)(readPos-hSnapshot->OverlapStart(hOvlp)));
+            hash = HashCombine(hash, (uint64_t)hOvlp->Duration());
+            return HashCombine(hash, (uint64_t)hOvlp->TransitionRevision());
+        }
+        auto hClip = hSnapshot->clips.FindAt(readPos);
+        return hClip ? hClip->GetContentHash(readPos-hSnapshot->ClipStart(hClip)) : 0;
+    }
+
+    ReadFrameTask::Holder CreateReadFrameTask(int64_t frameIndex, bool canDrop, bool needSeek, bool bypassBgNode, ReadFrameTask::Callback* pCb, bool scrubbing) override
     {
         lock_guard<recursive_mutex> lk(m_apiLock);
         if (frameIndex < 0)
             return nullptr;
         const int64_t readPos = ReadPos(frameIndex);
-        ReadFrameTask_Impl* pTask = new ReadFrameTask_Impl(frameIndex, readPos, canDrop, needSeek, bypassBgNode);
+        ReadFrameTask_Impl* pTask = new ReadFrameTask_Impl(frameIndex, readPos, canDrop, needSeek, bypassBgNode, scrubbing);
         ReadFrameTask::Holder hTask(pTask, READ_FRAME_TASK_HOLDER_DELETER);
         if (pCb) pTask->SetCallback(pCb);
+        pTask->SetProcessLoop(m_hReadLoop);
         {
             lock_guard<mutex> lk2(m_readFrameTasksLock);
             if (!m_readFrameTasks.empty())
@@ -593,6 +700,7 @@ public:
             }
             m_readFrameTasks.push_back(hTask);
         }
+        m_hReadLoop->Wakeup();
         return hTask;
     }
 
@@ -601,7 +709,7 @@ public:
         if (m_readForward == forward)
             return;
         m_readForward = forward;
-        for (auto& clip : m_clips)
+        for (auto& clip : GetSnapshot()->clips)
             clip->SetDirection(forward);
     }
 
@@ -617,63 +725,43 @@ public:
 
     VideoClip::Holder GetClipByIndex(uint32_t index) override
     {
-        lock_guard<recursive_mutex> lk(m_apiLock);
-        if (index >= m_clips.size())
+        auto hSnapshot = GetSnapshot();
+        if (index >= hSnapshot->clips.size())
             return nullptr;
-        auto iter = m_clips.begin();
-        while (index > 0)
-        {
-            iter++; index--;
-        }
-        return *iter;
+        return hSnapshot->clips.At(index);
     }
 
     VideoClip::Holder GetClipById(int64_t id) override
     {
-        lock_guard<recursive_mutex> lk(m_apiLock);
-        auto iter = find_if(m_clips.begin(), m_clips.end(), [id] (const VideoClip::Holder& clip) {
-            return clip->Id() == id;
-        });
-        if (iter != m_clips.end())
-            return *iter;
-        return nullptr;
+        auto hSnapshot = GetSnapshot();
+        auto iter = hSnapshot->clipTable.find(id);
+        return iter != hSnapshot->clipTable.end() ? iter->second : nullptr;
     }
 
     VideoOverlap::Holder GetOverlapById(int64_t id) override
     {
-        lock_guard<recursive_mutex> lk(m_apiLock);
-        auto iter = find_if(m_overlaps.begin(), m_overlaps.end(), [id] (const VideoOverlap::Holder& ovlp) {
+        auto hSnapshot = GetSnapshot();
+        auto iter = find_if(hSnapshot->overlaps.begin(), hSnapshot->overlaps.end(), [id] (const VideoOverlap::Holder& ovlp) {
             return ovlp->Id() == id;
         });
-        if (iter != m_overlaps.end())
+        if (iter != hSnapshot->overlaps.end())
             return *iter;
         return nullptr;
     }
 
     void UpdateClipState() override
     {
-        if (!m_clipChanged)
-            return;
-        {
-            lock_guard<recursive_mutex> lk2(m_clipChangeLock);
-            if (!m_clipChanged)
-                return;
-            m_clips = m_clips2;
-            m_overlaps = m_overlaps2;
-            m_clipChanged = false;
-        }
-        // udpate duration
-        if (m_clips.empty())
-        {
-            m_duration = 0;
-        }
-        else
-        {
-            m_clips.sort(CLIP_SORT_CMP);
-            auto& tail = m_clips.back();
-            m_duration = tail->End();
-        }
-        m_needUpdateReadIter = true;
+        // the edits are published as soon as they are done, nothing is pending
+    }
+
+    EditLatencyStats GetEditLatencyStats() const override
+    {
+        EditLatencyStats stats;
+        stats.count = m_editLatencyCount;
+        if (stats.count > 0)
+            stats.averageMillisec = (double)m_editLatencySumUs/stats.count/1000;
+        stats.maxMillisec = (double)m_editLatencyMaxUs/1000;
+        return stats;
     }
 
     void UpdateSettings(SharedSettings::Holder hSettings) override
@@ -696,20 +784,42 @@ public:
     friend ostream& operator<<(ostream& os, VideoTrack_Impl& track);
 
 private:
-    void ReadFrameProc()
+    // One iteration of the read loop, returns false if there is nothing to do
+    bool ReadFrameStep()
     {
-        while (!m_quitThread)
+        bool idleLoop = true;
+
+        ReadFrameTask::Holder hTask;
+        ReadFrameTask_Impl* pTask = nullptr;
+        // check if there is a task need to be processed
         {
-            bool idleLoop = true;
+            lock_guard<mutex> lk(m_readFrameTasksLock);
+            // 1st, try to find a task that needs to be processed
+            auto iter = m_readFrameTasks.begin();
+            while (iter != m_readFrameTasks.end())
+            {
+                // remove this task if it's discarded
+                if ((*iter)->IsDiscarded())
+                {
+                    iter = m_readFrameTasks.erase(iter);
+                    continue;
+                }
 
-            ReadFrameTask::Holder hTask;
-            ReadFrameTask_Impl* pTask = nullptr;
-            // check if there is a task need to be processed
+                ReadFrameTask_Impl* pt = dynamic_cast<ReadFrameTask_Impl*>(iter->get());
+                if (pt->NeedProcess())
+                {
+                    hTask = *iter;
+                    pTask = pt;
+                    break;
+                }
+                iter++;
+            }
+            if (!hTask)
             {
-                lock_guard<mutex> lk(m_readFrameTasksLock);
-                // 1st, try to find a task that needs to be processed
-                auto iter = m_readFrameTasks.begin();
-                while (iter != m_readFrameTasks.end())
+                // 2nd, if no frame needs to be processed, then try to find a frame that needs to read the source mat
+                int index = 0;
+                iter = m_readFrameTasks.begin();
+                while (iter != m_readFrameTasks.end() && index < m_iPreReadMaxNum)
                 {
                     // remove this task if it's discarded
                     if ((*iter)->IsDiscarded())
@@ -719,125 +829,139 @@ private:
                     }
 
                     ReadFrameTask_Impl* pt = dynamic_cast<ReadFrameTask_Impl*>(iter->get());
-                    if (pt->NeedProcess())
-                    {
-                        hTask = *iter;
-                        pTask = pt;
-                        break;
-                    }
-                    iter++;
-                }
-                if (!hTask)
-                {
-                    // 2nd, if no frame needs to be processed, then try to find a frame that needs to read the source mat
-                    int index = 0;
-                    iter = m_readFrameTasks.begin();
-                    while (iter != m_readFrameTasks.end() && index < m_iPreReadMaxNum)
+                    // a task with the preview source still reads the exact one
+                    if (pt->NeedReadSource())
                     {
-                        // remove this task if it's discarded
-                        if ((*iter)->IsDiscarded())
-                        {
-                            iter = m_readFrameTasks.erase(iter);
-                            continue;
-                        }
-
-                        ReadFrameTask_Impl* pt = dynamic_cast<ReadFrameTask_Impl*>(iter->get());
-                        if (!pt->IsSourceFrameReady())
+                        if (!pt->IsStarted())
                         {
-                            if (!pt->IsStarted())
+                            if (!pt->Start())
                             {
-                                if (!pt->Start())
-                                {
-                                    iter = m_readFrameTasks.erase(iter);
-                                    pt->SetDiscarded();
-                                    continue;
-                                }
-                            }
-                            if (pt->IsStarted())
-                            {
-                                hTask = *iter;
-                                pTask = pt;
-                                break;
+                                iter = m_readFrameTasks.erase(iter);
+                                pt->SetDiscarded();
+                                continue;
                             }
                         }
-                        iter++; index++;
+                        if (pt->IsStarted())
+                        {
+                            hTask = *iter;
+                            pTask = pt;
+                            break;
+                        }
                     }
+                    iter++; index++;
                 }
             }
+        }
 
-            // if clip changed, update m_clips
-            if (m_clipChanged)
-                UpdateClipState();
-
-            // handle read frame task
-            if (pTask && !pTask->IsDiscarded())
+        // handle read frame task
+        if (pTask && !pTask->IsDiscarded())
+        {
+            // pin the current snapshot for this task, the edits publish new snapshots without waiting for it
+            auto hSnapshot = AcquireSnapshot();
+            const int64_t readPos = pTask->ReadPos();
+            if (!pTask->IsInited() && !pTask->IsDiscarded())
             {
-                const int64_t readPos = pTask->ReadPos();
-                if (!pTask->IsInited() && !pTask->IsDiscarded())
+                VideoClip::Holder hClip1, hClip2;
+                VideoOverlap::Holder hOvlp = hSnapshot->overlaps.FindAt(readPos);
+                if (hOvlp)
                 {
-                    UpdateReadIterator(readPos);
-                    VideoClip::Holder hClip1, hClip2;
-                    VideoOverlap::Holder hOvlp;
-                    if (m_readOverlapIter != m_overlaps.end() && readPos >= (*m_readOverlapIter)->Start() && readPos < (*m_readOverlapIter)->End())
-                    {
-                        hOvlp = *m_readOverlapIter;
-                        hClip1 = hOvlp->FrontClip();
-                        hClip2 = hOvlp->RearClip();
-                    }
-                    else if (m_readClipIter != m_clips.end() && readPos >= (*m_readClipIter)->Start() && readPos < (*m_readClipIter)->End())
-                    {
-                        hClip1 = *m_readClipIter;
-                    }
-                    pTask->Initialize(hClip1, hClip2, hOvlp);
-                    list<VideoClip::Holder> clips;
-                    {
-                        lock_guard<recursive_mutex> lk(m_clipChangeLock);
-                        clips = m_clips;
-                    }
-                    for (auto& c : clips)
-                        c->NotifyReadPos(readPos);
+                    hClip1 = hOvlp->FrontClip();
+                    hClip2 = hOvlp->RearClip();
                 }
-                if (!pTask->IsSourceFrameReady() && !pTask->IsDiscarded())
+                else
                 {
-                    if (pTask->NeedSeek() && !pTask->HasSeeked())
-                    {
-                        SeekClipPos(readPos);
-                        pTask->SetSeeked();
-                    }
-                    pTask->DoReadSourceFrame();
-                    if (pTask->IsSourceFrameReady())
-                    {
-                        // m_logger->Log(DEBUG) << "Track#" << m_id << ", frameIndex=" << pTask->FrameIndex() << "  SOURCE READY" << endl;
-                        idleLoop = false;
-                    }
+                    hClip1 = hSnapshot->clips.FindAt(readPos);
                 }
-                if (pTask->IsSourceFrameReady() && pTask->NeedProcess() && !pTask->IsDiscarded())
+                pTask->Initialize(hClip1, hClip1 ? hSnapshot->ClipStart(hClip1) : 0, hClip2, hClip2 ? hSnapshot->ClipStart(hClip2) : 0,
+                        hOvlp, hOvlp ? hSnapshot->OverlapStart(hOvlp) : 0);
+                for (auto& c : hSnapshot->clips)
+                    c->NotifyReadPos(readPos);
+            }
+            if (pTask->NeedReadSource() && !pTask->IsDiscarded())
+            {
+                if (pTask->NeedSeek() && !pTask->HasSeeked())
                 {
-                    pTask->ProcessFrame();
-                    // m_logger->Log(DEBUG) << "Track#" << m_id << ", frameIndex=" << pTask->FrameIndex() << "  OUTPUT READY" << endl;
+                    m_seekPending = true;
+                    pTask->SetSeeked();
+                }
+                // the clips leave the seeking mode once the scrubbing is over
+                if (m_clipsInSeekingMode && !pTask->IsScrubbing())
+                    m_seekPending = true;
+                // an occluded task reads nothing, the clips are sought when the track is uncovered
+                if (m_seekPending && !pTask->IsOccluded())
+                {
+                    SeekClipPos(hSnapshot, readPos, pTask->IsScrubbing());
+                    m_seekPending = false;
+                }
+                const bool previewReady = pTask->IsSourceFrameReady();
+                pTask->DoReadSourceFrame();
+                if (!pTask->NeedReadSource() || pTask->IsSourceFrameReady() != previewReady)
+                {
+                    // m_logger->Log(DEBUG) << "Track#" << m_id << ", frameIndex=" << pTask->FrameIndex() << "  SOURCE READY" << endl;
                     idleLoop = false;
                 }
             }
-
-            if (idleLoop)
+            if (pTask->IsSourceFrameReady() && pTask->NeedProcess() && !pTask->IsDiscarded())
             {
-                // m_logger->Log(DEBUG) << "Track#" << m_id << " slept" << endl;
-                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+                pTask->ProcessFrame();
+                // m_logger->Log(DEBUG) << "Track#" << m_id << ", frameIndex=" << pTask->FrameIndex() << "  OUTPUT READY" << endl;
+                idleLoop = false;
             }
         }
+
+        return !idleLoop;
+    }
+
+    // In seeking mode, the clips keep the nearest keyframes as the preview sources of the scrubbing tasks
+    void SeekClipPos(const VideoTrackSnapshot::Holder& hSnapshot, int64_t readPos, bool bSeekingMode)
+    {
+        m_logger->Log(DEBUG) << "----> SeekClipPos(" << readPos << ", seekingMode=" << bSeekingMode << ")" << endl;
+        for (auto& c : hSnapshot->clips)
+            c->SeekTo(readPos-hSnapshot->ClipStart(c), bSeekingMode);
+        m_clipsInSeekingMode = bSeekingMode;
+    }
+
+    VideoTrackSnapshot::Holder GetSnapshot() const
+    {
+        return atomic_load(&m_hSnapshot);
     }
 
-    void SeekClipPos(int64_t readPos)
+    // Publish the edited clips and overlaps as a new snapshot, 'm_clipChangeLock' must be locked by the caller.
+    // It copies the indices, so an edit costs O(n) no matter how long the read path holds the previous snapshot.
+    void PublishSnapshot()
     {
-        m_logger->Log(DEBUG) << "----> SeekClipPos(" << readPos << ")" << endl;
-        for (auto& c : m_clips)
-            c->SeekTo(readPos-c->Start());
+        auto hSnapshot = make_shared<VideoTrackSnapshot>();
+        hSnapshot->clips = m_clips2;
+        hSnapshot->clipTable = m_clipTable2;
+        hSnapshot->overlaps = m_overlaps2;
+        hSnapshot->duration = m_clips2.MaxEnd();
+        hSnapshot->version = ++m_snapshotVersion;
+        hSnapshot->publishTime = SysClock::now();
+        atomic_store(&m_hSnapshot, VideoTrackSnapshot::Holder(hSnapshot));
+    }
+
+    // Get the current snapshot on the read loop, the latency from publishing to reading is counted for a new one.
+    VideoTrackSnapshot::Holder AcquireSnapshot()
+    {
+        auto hSnapshot = GetSnapshot();
+        if (hSnapshot->version != m_readSnapshotVersion)
+        {
+            m_readSnapshotVersion = hSnapshot->version;
+            const int64_t latencyUs = chrono::duration_cast<chrono::microseconds>(SysClock::now()-hSnapshot->publishTime).count();
+            m_editLatencySumUs += latencyUs;
+            if (latencyUs > m_editLatencyMaxUs)
+                m_editLatencyMaxUs = latencyUs;
+            m_editLatencyCount++;
+            if (latencyUs > EDIT_LATENCY_WARN_US)
+                m_logger->Log(DEBUG) << "Snapshot#" << hSnapshot->version << " becomes visible to the read loop after " << latencyUs/1000 << "ms." << endl;
+        }
+        return hSnapshot;
     }
 
     bool CheckClipRangeValid(int64_t clipId, int64_t start, int64_t end)
     {
         // make sure a time span can only be overlapped by two clips at most, no more layers of overlap is allowed
-        for (auto& overlap : m_overlaps2)
+        for (auto& overlap : m_overlaps2.FindInRange(start, end))
         {
             if (clipId == overlap->FrontClip()->Id() || clipId == overlap->RearClip()->Id())
                 continue;
@@ -848,227 +972,16 @@ private:
         return true;
     }
 
-    void UpdateClipOverlap()
+    // Update the position of 'hClip' in the index and the overlaps on it, see 'UpdateTrackIndex()'
+    void UpdateClipIndex(VideoClip::Holder hClip, bool remove = false)
     {
-        if (m_clips2.empty())
-        {
-            m_overlaps2.clear();
-            return;
-        }
-
-        list<VideoOverlap::Holder> newOverlaps;
-        auto clipIter1 = m_clips2.begin();
-        auto clipIter2 = clipIter1; clipIter2++;
-        while (clipIter2 != m_clips2.end())
-        {
-            const auto& clip1 = *clipIter1;
-            const auto& clip2 = *clipIter2++;
-            const auto cid1 = clip1->Id();
-            const auto cid2 = clip2->Id();
-            if (VideoOverlap::HasOverlap(clip1, clip2))
-            {
-                auto ovlpIter = m_overlaps2.begin();
-                while (ovlpIter != m_overlaps2.end())
-                {
-                    const auto& ovlp = *ovlpIter;
-                    const auto fid = ovlp->FrontClip()->Id();
-                    const auto rid = ovlp->RearClip()->Id();
-                    if (cid1 != fid && cid1 != rid || cid2 != fid && cid2 != rid)
-                    {
-                        ovlpIter++;
-                        continue;
-                    }
-                    break;
-                }
-                if (ovlpIter != m_overlaps2.end())
-                {
-                    auto& ovlp = *ovlpIter;
-                    ovlp->Update();
-                    assert(ovlp->Duration() > 0);
-                    newOverlaps.push_back(*ovlpIter);
-                }
-                else
-                {
-                    newOverlaps.push_back(VideoOverlap::CreateInstance(0, clip1, clip2));
-                }
-            }
-            if (clipIter2 == m_clips2.end())
-            {
-                clipIter1++;
-                clipIter2 = clipIter1;
-                clipIter2++;
-            }
-        }
-
-        m_overlaps2 = std::move(newOverlaps);
-        m_overlaps2.sort(OVERLAP_SORT_CMP);
-    }
-
-    void UpdateReadIterator(int64_t readPos)
-    {
-        if (m_needUpdateReadIter.exchange(false))
-        {
-            if (m_readForward)
-            {
-                // update read clip iterator
-                m_readClipIter = m_clips.end();
-                {
-                    auto iter = m_clips.begin();
-                    while (iter != m_clips.end())
-                    {
-                        const VideoClip::Holder& hClip = *iter;
-                        int64_t clipPos = readPos-hClip->Start();
-                        if (m_readClipIter == m_clips.end() && clipPos < hClip->Duration())
-                            m_readClipIter = iter;
-                        iter++;
-                    }
-                }
-                // update read overlap iterator
-                m_readOverlapIter = m_overlaps.end();
-                {
-                    auto iter = m_overlaps.begin();
-                    while (iter != m_overlaps.end())
-                    {
-                        const VideoOverlap::Holder& hOverlap = *iter;
-                        int64_t overlapPos = readPos-hOverlap->Start();
-                        if (m_readOverlapIter == m_overlaps.end() && overlapPos < hOverlap->Duration())
-                        {
-                            m_readOverlapIter = iter;
-                            break;
-                        }
-                        iter++;
-                    }
-                }
-            }
-            else
-            {
-                m_readClipIter = m_clips.end();
-                {
-                    auto riter = m_clips.rbegin();
-                    while (riter != m_clips.rend())
-                    {
-                        const VideoClip::Holder& hClip = *riter;
-                        int64_t clipPos = readPos-hClip->Start();
-                        if (m_readClipIter == m_clips.end() && clipPos >= 0)
-                            m_readClipIter = riter.base();
-                        riter++;
-                    }
-                }
-                m_readOverlapIter = m_overlaps.end();
-                {
-                    auto riter = m_overlaps.rbegin();
-                    while (riter != m_overlaps.rend())
-                    {
-                        const VideoOverlap::Holder& hOverlap = *riter;
-                        int64_t overlapPos = readPos-hOverlap->Start();
-                        if (m_readOverlapIter == m_overlaps.end() && overlapPos >= 0)
-                            m_readOverlapIter = riter.base();
-                        riter++;
-                    }
-                }
-            }
-        }
-        else
-        {
-            if (!m_clips.empty())
-            {
-                if (m_readClipIter == m_clips.end())
-                    m_readClipIter--;
-                if (m_readForward)
-                {
-                    if (m_readClipIter != m_clips.begin())
-                    {
-                        auto prevClipIter = m_readClipIter;
-                        prevClipIter--;
-                        while (m_readClipIter != m_clips.begin() && readPos < (*prevClipIter)->End())
-                        {
-                            m_readClipIter = prevClipIter;
-                            if (prevClipIter == m_clips.begin())
-                                break;
-                            prevClipIter--;
-                        }
-                    }
-                    if (readPos >= (*m_readClipIter)->End())
-                    {
-                        while (m_readClipIter != m_clips.end() && readPos >= (*m_readClipIter)->End())
-                            m_readClipIter++;
-                    }
-                }
-                else
-                {
-                    auto nextClipIter = m_readClipIter;
-                    nextClipIter++;
-                    while (nextClipIter != m_clips.end() && readPos >= (*nextClipIter)->Start())
-                    {
-                        m_readClipIter = nextClipIter;
-                        nextClipIter++;
-                    }
-                    if (readPos < (*m_readClipIter)->Start())
-                    {
-                        while (m_readClipIter != m_clips.begin() && readPos < (*m_readClipIter)->Start())
-                            m_readClipIter--;
-                    }
-                }
-            }
-            else
-            {
-                m_readClipIter = m_clips.end();
-            }
-            if (!m_overlaps.empty())
-            {
-                if (m_readOverlapIter == m_overlaps.end())
-                    m_readOverlapIter--;
-                if (m_readForward)
-                {
-                    if (m_readOverlapIter != m_overlaps.begin())
-                    {
-                        auto prevOvlpIter = m_readOverlapIter;
-                        prevOvlpIter--;
-                        while (m_readOverlapIter != m_overlaps.begin() && readPos < (*prevOvlpIter)->End())
-                        {
-                            m_readOverlapIter = prevOvlpIter;
-                            if (prevOvlpIter == m_overlaps.begin())
-                                break;
-                            prevOvlpIter--;
-                        }
-                    }
-                    if (readPos >= (*m_readOverlapIter)->End())
-                    {
-                        while (m_readOverlapIter != m_overlaps.end() && readPos >= (*m_readOverlapIter)->End())
-                            m_readOverlapIter++;
-                    }
-                }
-                else
-                {
-                    auto nextOvlpIter = m_readOverlapIter;
-                    nextOvlpIter++;
-                    while (nextOvlpIter != m_overlaps.end() && readPos >= (*nextOvlpIter)->Start())
-                    {
-                        m_readOverlapIter = nextOvlpIter;
-                        nextOvlpIter++;
-                    }
-                    if (readPos < (*m_readOverlapIter)->Start())
-                    {
-                        while (m_readOverlapIter != m_overlaps.begin() && readPos < (*m_readOverlapIter)->Start())
-                            m_readOverlapIter--;
-                    }
-                }
-            }
-            else
-            {
-                m_readOverlapIter = m_overlaps.end();
-            }
-        }
+        UpdateTrackIndex(m_clips2, m_overlaps2, hClip, remove);
     }
 
     VideoClip::Holder GetClipById2(int64_t id)
     {
-        auto iter = find_if(m_clips2.begin(), m_clips2.end(), [id] (const VideoClip::Holder& clip) {
-            return clip->Id() == id;
-        });
-        if (iter != m_clips2.end())
-            return *iter;
-        return nullptr;
+        auto iter = m_clipTable2.find(id);
+        return iter != m_clipTable2.end() ? iter->second : nullptr;
     }
 
 private:
@@ -1076,25 +989,32 @@ private:
     recursive_mutex m_apiLock;
     int64_t m_id;
     SharedSettings::Holder m_hSettings;
-    list<VideoClip::Holder> m_clips;
-    list<VideoClip::Holder>::iterator m_readClipIter;
-    list<VideoClip::Holder> m_clips2;
-    bool m_clipChanged{false};
-    atomic_bool m_needUpdateReadIter{false};
+    // the clips and the overlaps being edited, they are only accessed with 'm_clipChangeLock'
+    IntervalList<VideoClip::Holder> m_clips2;
+    unordered_map<int64_t, VideoClip::Holder> m_clipTable2;
+    IntervalList<VideoOverlap::Holder> m_overlaps2;
     recursive_mutex m_clipChangeLock;
-    list<VideoOverlap::Holder> m_overlaps;
-    list<VideoOverlap::Holder>::iterator m_readOverlapIter;
-    list<VideoOverlap::Holder> m_overlaps2;
-    int64_t m_duration{0}, m_duration2{0};
+    // the published state, it's accessed with 'atomic_load()' and 'atomic_store()'
+    VideoTrackSnapshot::Holder m_hSnapshot;
+    uint32_t m_snapshotVersion{0};
+    uint32_t m_readSnapshotVersion{0};
+    static const int64_t EDIT_LATENCY_WARN_US;
+    atomic<uint32_t> m_editLatencyCount{0};
+    atomic<int64_t> m_editLatencySumUs{0};
+    atomic<int64_t> m_editLatencyMaxUs{0};
     bool m_readForward{true};
     bool m_visible{true};
-    thread m_readThread;
-    bool m_quitThread{false};
+    TaskExecutor::Holder m_hExecutor;
+    TaskExecutor::Loop::Holder m_hReadLoop;
     list<ReadFrameTask::Holder> m_readFrameTasks;
     int m_iPreReadMaxNum{4};
+    bool m_seekPending{false};
+    bool m_clipsInSeekingMode{false};
     mutex m_readFrameTasksLock;
 };
 
+const int64_t VideoTrack_Impl::EDIT_LATENCY_WARN_US = 100000;
+
 static const auto VIDEO_TRACK_HOLDER_DELETER = [] (VideoTrack* p) {
     VideoTrack_Impl* ptr = dynamic_cast<VideoTrack_Impl*>(p);
     delete ptr;
@@ -1108,56 +1028,56 @@ VideoTrack::Holder VideoTrack::CreateInstance(int64_t id, SharedSettings::Holder
 VideoTrack::Holder VideoTrack_Impl::Clone(SharedSettings::Holder hSettings)
 {
     lock_guard<recursive_mutex> lk(m_apiLock);
-    if (m_clipChanged)
-        UpdateClipState();
+    auto hSnapshot = GetSnapshot();
 
     VideoTrack_Impl* newInstance = new VideoTrack_Impl(m_id, hSettings);
+    lock_guard<recursive_mutex> lk2(newInstance->m_clipChangeLock);
     // duplicate the clips
-    for (auto clip : m_clips)
+    for (auto clip : hSnapshot->clips)
     {
         auto newClip = clip->Clone(hSettings);
         newClip->SetTrackId(m_id);
-        newInstance->m_clips2.push_back(newClip);
+        newInstance->m_clipTable2[newClip->Id()] = newClip;
+        newInstance->UpdateClipIndex(newClip);
     }
-    newInstance->UpdateClipOverlap();
-    newInstance->m_clipChanged = true;
-    newInstance->UpdateClipState();
     // clone the transitions on the overlaps
-    for (auto overlap : m_overlaps)
+    for (auto overlap : hSnapshot->overlaps)
     {
-        auto iter = find_if(newInstance->m_overlaps.begin(), newInstance->m_overlaps.end(), [overlap] (auto& ovlp) {
+        auto iter = find_if(newInstance->m_overlaps2.begin(), newInstance->m_overlaps2.end(), [overlap] (auto& ovlp) {
             return overlap->FrontClip()->Id() == ovlp->FrontClip()->Id() && overlap->RearClip()->Id() == ovlp->RearClip()->Id();
         });
-        if (iter != newInstance->m_overlaps.end())
+        if (iter != newInstance->m_overlaps2.end())
         {
             auto trans = overlap->GetTransition();
             if (trans)
                 (*iter)->SetTransition(trans->Clone());
         }
     }
+    newInstance->PublishSnapshot();
     return VideoTrack::Holder(newInstance, VIDEO_TRACK_HOLDER_DELETER);
 }
 
 ostream& operator<<(ostream& os, VideoTrack_Impl& track)
 {
-    os << "{ clips(" << track.m_clips.size() << "): [";
-    auto clipIter = track.m_clips.begin();
-    while (clipIter != track.m_clips.end())
+    auto hSnapshot = track.GetSnapshot();
+    os << "{ clips(" << hSnapshot->clips.size() << "): [";
+    auto clipIter = hSnapshot->clips.begin();
+    while (clipIter != hSnapshot->clips.end())
     {
         os << *clipIter;
         clipIter++;
-        if (clipIter != track.m_clips.end())
+        if (clipIter != hSnapshot->clips.end())
             os << ", ";
         else
             break;
     }
-    os << "], overlaps(" << track.m_overlaps.size() << "): [";
-    auto ovlpIter = track.m_overlaps.begin();
-    while (ovlpIter != track.m_overlaps.end())
+    os << "], overlaps(" << hSnapshot->overlaps.size() << "): [";
+    auto ovlpIter = hSnapshot->overlaps.begin();
+    while (ovlpIter != hSnapshot->overlaps.end())
     {
         os << *ovlpIter;
         ovlpIter++;
-        if (ovlpIter != track.m_overlaps.end())
+        if (ovlpIter != hSnapshot->overlaps.end())
             os << ", ";
         else
             break;
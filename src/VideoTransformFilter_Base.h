@@ -18,9 +18,13 @@
 #pragma once
 #include <cmath>
 #include <utility>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include <MatUtilsImVecHelper.h>
 #include "VideoClip.h"
 #include "VideoTransformFilter.h"
+#include "OpacityMasker.h"
 
 using namespace std;
 namespace LibCurve = ImGui::ImNewCurve;
@@ -127,6 +131,8 @@ public:
 
     void ApplyTo(VideoClip* pVClip) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         m_i64ClipStartOffset = pVClip->StartOffset();
         m_i64ClipEndOffset = pVClip->EndOffset();
         m_i64ClipDuration = pVClip->Duration();
@@ -151,6 +157,8 @@ public:
 
     void UpdateClipRange() override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (!m_pOwnerClip)
             return;
         const MatUtils::Vec2<int64_t> tNewTimeRange(0, m_pOwnerClip->SrcDuration());
@@ -187,17 +195,15 @@ public:
         if (m_u32InWidth == 0 || m_u32InHeight == 0 || m_u32OutWidth == 0 || m_u32OutHeight == 0)
             return false;
 
-        float fTick;
+        const auto tParams = GetKeyFrameParams(i64Tick);
         LibCurve::KeyPoint::ValType tKpVal;
         // Position offset
-        fTick = m_bEnableKeyFramesOnPosOffset ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tPosOffRatio = m_hPosOffsetCurve->CalcPointVal(fTick, false);
+        const auto tPosOffRatio = tParams.tPosOffsetRatio;
         // Crop
-        fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_aCropCurves[0]->CalcPointVal(fTick, false);
+        tKpVal = tParams.tCropRatioLT;
         const auto _u32CropL = (uint32_t)round((float)m_u32InWidth*tKpVal.x);
         const auto _u32CropT = (uint32_t)round((float)m_u32InHeight*tKpVal.y);
-        tKpVal = m_aCropCurves[1]->CalcPointVal(fTick, false);
+        tKpVal = tParams.tCropRatioRB;
         const auto _u32CropR = (uint32_t)round((float)m_u32InWidth*tKpVal.x);
         const auto _u32CropB = (uint32_t)round((float)m_u32InHeight*tKpVal.y);
         uint32_t u32CropL, u32CropT, u32CropR, u32CropB;
@@ -222,17 +228,14 @@ public:
             u32CropB = m_u32InHeight-_u32CropT;
         }
         // Scale
-        fTick = m_bEnableKeyFramesOnScale ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_hScaleCurve->CalcPointVal(fTick, false);
+        tKpVal = tParams.tScale;
         const auto v2FinalScale = MatUtils::ToImVec2(CalcFinalScale(tKpVal.x, tKpVal.y));
         const ImVec2 v2PosOffset(
             (int32_t)round(((float)m_u32InWidth*v2FinalScale.x+(float)m_u32OutWidth)*tPosOffRatio.x/2.f),
             (int32_t)round(((float)m_u32InHeight*v2FinalScale.y+(float)m_u32OutHeight)*tPosOffRatio.y/2.f)
             );
         // Rotation
-        fTick = m_bEnableKeyFramesOnRotation ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_hRotationCurve->CalcPointVal(fTick, false);
-        const auto fRotationAngle = tKpVal.x;
+        const auto fRotationAngle = tParams.fRotationAngle;
 
         // calc corner points
         ImVec2 aInCornerPoints[4];  // TopLeft, TopRight, BottomRight, BottomLeft
@@ -365,6 +368,7 @@ public:
     bool SetPosOffsetRatio(int64_t i64Tick, float fPosOffRatioX, float fPosOffRatioY) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -402,6 +406,7 @@ public:
     bool SetPosOffsetRatioX(int64_t i64Tick, float fPosOffRatioX) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -440,6 +445,7 @@ public:
     bool SetPosOffsetRatioY(int64_t i64Tick, float fPosOffRatioY) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -482,8 +488,7 @@ public:
 
     MatUtils::Vec2<float> GetPosOffsetRatio(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnPosOffset ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_hPosOffsetCurve->CalcPointVal(fTick, false);
+        const auto tKpVal = GetKeyFrameParams(i64Tick).tPosOffsetRatio;
         return {tKpVal.x, tKpVal.y};
     }
 
@@ -491,6 +496,7 @@ public:
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -517,6 +523,8 @@ public:
 
     void EnableKeyFramesOnPosOffset(bool bEnable) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (m_bEnableKeyFramesOnPosOffset != bEnable)
         {
             if (!bEnable)
@@ -533,7 +541,9 @@ public:
     { return m_bEnableKeyFramesOnPosOffset; }
 
     LibCurve::Curve::Holder GetKeyFramesCurveOnPosOffset() const override
-    { return m_hPosOffsetCurve; }
+    {
+        return m_hPosOffsetCurve;
+    }
 
     // Crop
     bool SetCrop(uint32_t u32CropL, uint32_t u32CropT, uint32_t u32CropR, uint32_t u32CropB) override
@@ -668,6 +678,7 @@ public:
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -769,6 +780,7 @@ public:
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -811,15 +823,14 @@ public:
 
     float GetCropRatioL(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_aCropCurves[0]->CalcPointVal(fTick, false);
-        return tKpVal.x;
+        return GetKeyFrameParams(i64Tick).tCropRatioLT.x;
     }
 
     bool SetCropRatioT(int64_t i64Tick, float fCropRatioT, bool bClipValue, bool* pParamUpdated) override
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -862,15 +873,14 @@ public:
 
     float GetCropRatioT(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_aCropCurves[0]->CalcPointVal(fTick, false);
-        return tKpVal.y;
+        return GetKeyFrameParams(i64Tick).tCropRatioLT.y;
     }
 
     bool SetCropRatioR(int64_t i64Tick, float fCropRatioR, bool bClipValue, bool* pParamUpdated) override
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -913,15 +923,14 @@ public:
 
     float GetCropRatioR(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_aCropCurves[1]->CalcPointVal(fTick, false);
-        return tKpVal.x;
+        return GetKeyFrameParams(i64Tick).tCropRatioRB.x;
     }
 
     bool SetCropRatioB(int64_t i64Tick, float fCropRatioB, bool bClipValue, bool* pParamUpdated) override
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -964,14 +973,13 @@ public:
 
     float GetCropRatioB(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_aCropCurves[1]->CalcPointVal(fTick, false);
-        return tKpVal.y;
+        return GetKeyFrameParams(i64Tick).tCropRatioRB.y;
     }
 
     bool ChangeCropL(int64_t i64Tick, int32_t i32Delta) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1001,6 +1009,7 @@ public:
     bool ChangeCropT(int64_t i64Tick, int32_t i32Delta) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1030,6 +1039,7 @@ public:
     bool ChangeCropR(int64_t i64Tick, int32_t i32Delta) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1059,6 +1069,7 @@ public:
     bool ChangeCropB(int64_t i64Tick, int32_t i32Delta) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1087,6 +1098,8 @@ public:
 
     void EnableKeyFramesOnCrop(bool bEnable) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (m_bEnableKeyFramesOnCrop != bEnable)
         {
             if (!bEnable)
@@ -1106,7 +1119,9 @@ public:
     { return m_bEnableKeyFramesOnCrop; }
 
     vector<LibCurve::Curve::Holder> GetKeyFramesCurveOnCrop() const override
-    { return m_aCropCurves; }
+    {
+        return m_aCropCurves;
+    }
 
     // Scale
     bool SetScale(float fScaleX, float fScaleY) override
@@ -1127,6 +1142,7 @@ public:
     bool SetScale(int64_t i64Tick, float fScaleX, float fScaleY) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1165,6 +1181,7 @@ public:
     bool SetScaleX(int64_t i64Tick, float fScaleX) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1204,6 +1221,7 @@ public:
     bool SetScaleY(int64_t i64Tick, float fScaleY) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1247,15 +1265,13 @@ public:
 
     MatUtils::Vec2<float> GetScale(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnScale ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_hScaleCurve->CalcPointVal(fTick, false);
+        const auto tKpVal = GetKeyFrameParams(i64Tick).tScale;
         return m_bKeepAspectRatio ? MatUtils::Vec2<float>(tKpVal.x, tKpVal.x) : MatUtils::Vec2<float>(tKpVal.x, tKpVal.y);
     }
 
     MatUtils::Vec2<float> GetFinalScale(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnScale ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_hScaleCurve->CalcPointVal(fTick, false);
+        const auto tKpVal = GetKeyFrameParams(i64Tick).tScale;
         return CalcFinalScale(tKpVal.x, tKpVal.y);
     }
 
@@ -1263,6 +1279,7 @@ public:
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (i64Tick < m_tTimeRange.x || i64Tick > m_tTimeRange.y)
         {
             ostringstream oss; oss << "INVALID argument 'i64Tick'! Argument value " << i64Tick << " is out of the time range [" << m_tTimeRange.x << ", " << m_tTimeRange.y << "]!";
@@ -1323,6 +1340,8 @@ public:
 
     void EnableKeyFramesOnScale(bool bEnable) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (m_bEnableKeyFramesOnScale != bEnable)
         {
             if (!bEnable)
@@ -1339,7 +1358,9 @@ public:
     { return m_bEnableKeyFramesOnScale; }
 
     LibCurve::Curve::Holder GetKeyFramesCurveOnScale() const override
-    { return m_hScaleCurve; }
+    {
+        return m_hScaleCurve;
+    }
 
     // Rotation
     bool SetRotation(float fAngle) override
@@ -1352,6 +1373,7 @@ public:
     {
         if (pParamUpdated) *pParamUpdated = false;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         // int32_t n = (int32_t)trunc(fAngle/360);
         // fAngle -= n*360;
         auto fTick = m_bEnableKeyFramesOnRotation ? (float)i64Tick : (float)m_tTimeRange.x;
@@ -1374,13 +1396,13 @@ public:
 
     float GetRotation(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnRotation ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_hRotationCurve->CalcPointVal(fTick, false);
-        return tKpVal.x;
+        return GetKeyFrameParams(i64Tick).fRotationAngle;
     }
 
     void EnableKeyFramesOnRotation(bool bEnable) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (m_bEnableKeyFramesOnRotation != bEnable)
         {
             if (!bEnable)
@@ -1397,7 +1419,9 @@ public:
     { return m_bEnableKeyFramesOnRotation; }
 
     LibCurve::Curve::Holder GetKeyFramesCurveOnRotation() const override
-    { return m_hRotationCurve; }
+    {
+        return m_hRotationCurve;
+    }
 
     // Opacity
     bool SetOpacity(float opacity) override
@@ -1413,6 +1437,7 @@ public:
     bool SetOpacity(int64_t i64Tick, float fOpacity) override
     {
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (m_fOpacity == fOpacity)
             return true;
         const auto tMinVal = m_hOpacityCurve->GetMinVal();
@@ -1438,13 +1463,13 @@ public:
 
     float GetOpacity(int64_t i64Tick) const override
     {
-        const auto fTick = m_bEnableKeyFramesOnOpacity ? (float)i64Tick : (float)m_tTimeRange.x;
-        const auto tKpVal = m_hOpacityCurve->CalcPointVal(fTick, false);
-        return tKpVal.x;
+        return GetKeyFrameParams(i64Tick).fOpacity;
     }
 
     void EnableKeyFramesOnOpacity(bool bEnable) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         if (m_bEnableKeyFramesOnOpacity != bEnable)
         {
             if (!bEnable)
@@ -1461,10 +1486,19 @@ public:
     { return m_bEnableKeyFramesOnOpacity; }
 
     LibCurve::Curve::Holder GetKeyFramesCurveOnOpacity() const override
-    { return m_hOpacityCurve; }
+    {
+        return m_hOpacityCurve;
+    }
+
+    void NotifyKeyFramesChanged() override
+    {
+        InvalidateKeyFrameParams();
+    }
 
     ImGui::MaskCreator::Holder CreateNewOpacityMask(const std::string& name) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateOpacityMasks();
         const MatUtils::Size2i szMaskSize(m_pOwnerClip->OutWidth(), m_pOwnerClip->OutHeight());
         auto hMaskCreator = ImGui::MaskCreator::CreateInstance(szMaskSize, name);
         hMaskCreator->SetTickRange(0, m_pOwnerClip->Duration());
@@ -1479,6 +1513,8 @@ public:
 
     const ImGui::MaskCreator::Holder GetOpacityMaskCreator(size_t index) const override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateOpacityMasks();
         const auto szMaskCnt = m_ahMaskCreators.size();
         if (index >= szMaskCnt)
             return nullptr;
@@ -1487,6 +1523,8 @@ public:
 
     bool RemoveOpacityMask(size_t index) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateOpacityMasks();
         const auto szMaskCnt = m_ahMaskCreators.size();
         if (index >= szMaskCnt)
             return false;
@@ -1537,6 +1575,8 @@ public:
 
     bool LoadFromJson(const imgui_json::value& j) override
     {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        InvalidateKeyFrameParams();
         string strAttrName;
         strAttrName = "output_format";
         if (j.contains(strAttrName) && j[strAttrName].is_string())
@@ -1592,6 +1632,7 @@ public:
         strAttrName = "opacity_masks";
         if (j.contains(strAttrName) && j[strAttrName].is_array())
         {
+            InvalidateOpacityMasks();
             const auto& ajnMasks = j[strAttrName].get<imgui_json::array>();
             for (const auto& jnMask : ajnMasks)
             {
@@ -1607,14 +1648,137 @@ public:
     { return m_strErrMsg; }
 
 protected:
+    // The curve values at a time tick, the switches of the key frames are already applied.
+    struct KeyFrameParams
+    {
+        LibCurve::KeyPoint::ValType tPosOffsetRatio;
+        LibCurve::KeyPoint::ValType tCropRatioLT;
+        LibCurve::KeyPoint::ValType tCropRatioRB;
+        LibCurve::KeyPoint::ValType tScale;
+        float fRotationAngle;
+        float fOpacity;
+    };
+
+    // The parameters of the evaluated ticks are kept in a table, so the curves are evaluated once for every frame tick.
+    // The table is dropped when a curve or a switch of the key frames is changed through this filter, or when an edit
+    // through a curve holder from 'GetKeyFramesCurveOnXXX()' is reported with 'NotifyKeyFramesChanged()'.
+    KeyFrameParams GetKeyFrameParams(int64_t i64Tick) const
+    {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        const uint32_t u32Version = m_u32KeyFrameParamsVersion;
+        if (u32Version != m_u32KeyFrameTableVersion)
+        {
+            m_mapKeyFrameParams.clear();
+            m_u32KeyFrameTableVersion = u32Version;
+        }
+        auto iter = m_mapKeyFrameParams.find(i64Tick);
+        if (iter != m_mapKeyFrameParams.end())
+            return iter->second;
+
+        KeyFrameParams tParams;
+        float fTick = m_bEnableKeyFramesOnPosOffset ? (float)i64Tick : (float)m_tTimeRange.x;
+        tParams.tPosOffsetRatio = m_hPosOffsetCurve->CalcPointVal(fTick, false);
+        fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
+        tParams.tCropRatioLT = m_aCropCurves[0]->CalcPointVal(fTick, false);
+        tParams.tCropRatioRB = m_aCropCurves[1]->CalcPointVal(fTick, false);
+        fTick = m_bEnableKeyFramesOnScale ? (float)i64Tick : (float)m_tTimeRange.x;
+        tParams.tScale = m_hScaleCurve->CalcPointVal(fTick, false);
+        fTick = m_bEnableKeyFramesOnRotation ? (float)i64Tick : (float)m_tTimeRange.x;
+        tParams.fRotationAngle = m_hRotationCurve->CalcPointVal(fTick, false).x;
+        fTick = m_bEnableKeyFramesOnOpacity ? (float)i64Tick : (float)m_tTimeRange.x;
+        tParams.fOpacity = m_hOpacityCurve->CalcPointVal(fTick, false).x;
+        // don't keep the values if a curve is changed during the evaluation
+        if (u32Version == m_u32KeyFrameParamsVersion)
+        {
+            if (m_mapKeyFrameParams.size() >= MAX_KEYFRAME_PARAMS_COUNT)
+                m_mapKeyFrameParams.clear();
+            m_mapKeyFrameParams[i64Tick] = tParams;
+        }
+        return tParams;
+    }
+
+    void InvalidateKeyFrameParams() const
+    { m_u32KeyFrameParamsVersion++; }
+
+    // Rasterise the opacity masks for an image of 'i32Width' x 'i32Height' at 'i64Tick', the masks not ready are skipped.
+    // The masks are kept after rasterising, and one is only rasterised again when the tick, the image size, the warp
+    // parameters or the mask itself is changed. Like the curves, a mask may be edited through the holder returned by
+    // 'GetOpacityMaskCreator()', so the kept masks are dropped whenever a holder is handed out.
+    // 'bChanged' is set to true if the result is different from the previous call. The bounds of the masks are only
+    // calculated for IM_DT_INT8.
+    bool GetOpacityMasks(int64_t i64Tick, int32_t i32Width, int32_t i32Height, ImDataType eDataType, vector<OpacityMasker::Mask>& aMasks, bool& bChanged)
+    {
+        lock_guard<recursive_mutex> lk(m_mtxProcessLock);
+        aMasks.clear();
+        bChanged = false;
+        const uint32_t u32Version = m_u32OpacityMaskVersion;
+        const MatUtils::Size2i szImageSize(i32Width, i32Height);
+        const auto v2WaOffsetRatio = MatUtils::ToImVec2(GetPosOffsetRatio());
+        const auto v2WaScale = MatUtils::ToImVec2(GetScale());
+        const auto v2OutSize = MatUtils::ToImVec2(GetOutSize());
+        const auto v2WaOffset = v2WaOffsetRatio*(v2WaScale+ImVec2(1,1))*v2OutSize/2.f;
+        const auto fWaRotAngle = GetRotation();
+        const auto szMaskCnt = m_ahMaskCreators.size();
+        if (m_aOpacityMaskCaches.size() != szMaskCnt)
+        {
+            m_aOpacityMaskCaches.resize(szMaskCnt);
+            bChanged = true;
+        }
+        for (auto i = 0; i < szMaskCnt; i++)
+        {
+            auto& hMaskCreator = m_ahMaskCreators[i];
+            auto& tCache = m_aOpacityMaskCaches[i];
+            if (tCache.pMaskCreator == hMaskCreator.get() && tCache.u32Version == u32Version && tCache.i64Tick == i64Tick
+                    && tCache.i32Width == i32Width && tCache.i32Height == i32Height && tCache.eDataType == eDataType
+                    && tCache.v2WaOffset.x == v2WaOffset.x && tCache.v2WaOffset.y == v2WaOffset.y
+                    && tCache.v2WaScale.x == v2WaScale.x && tCache.v2WaScale.y == v2WaScale.y && tCache.fWaRotAngle == fWaRotAngle)
+            {
+                aMasks.push_back(tCache.tMask);
+                continue;
+            }
+            if (!tCache.tMask.image.empty())
+                bChanged = true;
+            tCache = OpacityMaskCache();
+            if (szImageSize != hMaskCreator->GetMaskSize())
+                hMaskCreator->ChangeMaskSize(szImageSize, true);
+            hMaskCreator->SetMaskWarpAffineParameters(v2WaOffset, v2WaScale, -fWaRotAngle, MatUtils::ToImVec2(szImageSize)/2.f);
+            // the masks not ready are checked again in the next call
+            if (!hMaskCreator->IsMaskReady())
+                continue;
+            const double dMaskValue = eDataType == IM_DT_INT8 ? 255 : 1;
+            auto mMask = hMaskCreator->GetMask(ImGui::MaskCreator::AA, true, eDataType, dMaskValue, 0, i64Tick);
+            if (mMask.empty())
+                continue;
+            // the mask creator may reuse its buffer for the next rasterisation
+            tCache.tMask.image = mMask.clone();
+            if (eDataType == IM_DT_INT8)
+                tCache.tMask.bounds = OpacityMasker::CalcBounds(tCache.tMask.image);
+            else
+                tCache.tMask.bounds = {0, 0, i32Width, i32Height};
+            tCache.pMaskCreator = hMaskCreator.get();
+            tCache.u32Version = u32Version;
+            tCache.i64Tick = i64Tick;
+            tCache.i32Width = i32Width;
+            tCache.i32Height = i32Height;
+            tCache.eDataType = eDataType;
+            tCache.v2WaOffset = v2WaOffset;
+            tCache.v2WaScale = v2WaScale;
+            tCache.fWaRotAngle = fWaRotAngle;
+            aMasks.push_back(tCache.tMask);
+            bChanged = true;
+        }
+        return true;
+    }
+
+    void InvalidateOpacityMasks() const
+    { m_u32OpacityMaskVersion++; }
+
     bool UpdateParamsByKeyFrames(int64_t i64Tick)
     {
-        float fTick;
         LibCurve::KeyPoint::ValType tKpVal;
         lock_guard<recursive_mutex> lk(m_mtxProcessLock);
         // Position offset
-        fTick = m_bEnableKeyFramesOnPosOffset ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_hPosOffsetCurve->CalcPointVal(fTick, false);
+        tKpVal = GetKeyFrameParams(i64Tick).tPosOffsetRatio;
         const auto i32PosOffX = (int32_t)round((float)m_u32OutWidth*tKpVal.x);
         const auto i32PosOffY = (int32_t)round((float)m_u32OutHeight*tKpVal.y);
         if (i32PosOffX != m_i32PosOffsetX || i32PosOffY != m_i32PosOffsetY)
@@ -1636,12 +1800,13 @@ protected:
             if (!SetCropRatio(fCropRatioL, fCropRatioT, fCropRatioR, fCropRatioB, false, nullptr))
                 return false;
         }
-        fTick = m_bEnableKeyFramesOnCrop ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_aCropCurves[0]->CalcPointVal(fTick, false);
+        // the crop ratios may be reset above, so the parameters are taken again
+        const auto tParams = GetKeyFrameParams(i64Tick);
+        tKpVal = tParams.tCropRatioLT;
         const auto u32CropL = (uint32_t)round((float)m_u32InWidth*tKpVal.x);
         const auto u32CropT = (uint32_t)round((float)m_u32InHeight*tKpVal.y);
         m_fCropRatioL = tKpVal.x; m_fCropRatioT = tKpVal.y;
-        tKpVal = m_aCropCurves[1]->CalcPointVal(fTick, false);
+        tKpVal = tParams.tCropRatioRB;
         const auto u32CropR = (uint32_t)round((float)m_u32InWidth*tKpVal.x);
         const auto u32CropB = (uint32_t)round((float)m_u32InHeight*tKpVal.y);
         m_fCropRatioR = tKpVal.x; m_fCropRatioB = tKpVal.y;
@@ -1654,8 +1819,7 @@ protected:
             m_bNeedUpdateCropParam = true;
         }
         // Scale
-        fTick = m_bEnableKeyFramesOnScale ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_hScaleCurve->CalcPointVal(fTick, false);
+        tKpVal = tParams.tScale;
         if (tKpVal.x != m_fScaleX || (!m_bKeepAspectRatio && tKpVal.y != m_fScaleY))
         {
             m_fScaleX = tKpVal.x;
@@ -1663,20 +1827,13 @@ protected:
             m_bNeedUpdateScaleParam = true;
         }
         // Rotation
-        fTick = m_bEnableKeyFramesOnRotation ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_hRotationCurve->CalcPointVal(fTick, false);
-        if (tKpVal.x != m_fRotateAngle)
+        if (tParams.fRotationAngle != m_fRotateAngle)
         {
-            m_fRotateAngle = tKpVal.x;
+            m_fRotateAngle = tParams.fRotationAngle;
             m_bNeedUpdateRotationParam = true;
         }
         // Opacity
-        fTick = m_bEnableKeyFramesOnOpacity ? (float)i64Tick : (float)m_tTimeRange.x;
-        tKpVal = m_hOpacityCurve->CalcPointVal(fTick, false);
-        if (tKpVal.x != m_fRotateAngle)
-        {
-            m_fOpacity = tKpVal.x;
-        }
+        m_fOpacity = tParams.fOpacity;
 
         return true;
     }
@@ -1733,7 +1890,7 @@ protected:
     }
 
 protected:
-    recursive_mutex m_mtxProcessLock;
+    mutable recursive_mutex m_mtxProcessLock;
     uint32_t m_u32InWidth{0}, m_u32InHeight{0};
     uint32_t m_u32OutWidth{0}, m_u32OutHeight{0};
     string m_strOutputFormat;
@@ -1762,7 +1919,24 @@ protected:
     bool m_bEnableKeyFramesOnRotation{false};
     LibCurve::Curve::Holder m_hOpacityCurve;
     bool m_bEnableKeyFramesOnOpacity{false};
+    static constexpr size_t MAX_KEYFRAME_PARAMS_COUNT = 65536;
+    mutable unordered_map<int64_t, KeyFrameParams> m_mapKeyFrameParams;
+    mutable uint32_t m_u32KeyFrameTableVersion{0};
+    mutable atomic<uint32_t> m_u32KeyFrameParamsVersion{1};
     vector<ImGui::MaskCreator::Holder> m_ahMaskCreators;
+    struct OpacityMaskCache
+    {
+        const ImGui::MaskCreator* pMaskCreator{nullptr};
+        uint32_t u32Version{0};
+        int64_t i64Tick{0};
+        int32_t i32Width{0}, i32Height{0};
+        ImDataType eDataType{IM_DT_INT8};
+        ImVec2 v2WaOffset, v2WaScale;
+        float fWaRotAngle{0};
+        OpacityMasker::Mask tMask;
+    };
+    vector<OpacityMaskCache> m_aOpacityMaskCaches;
+    mutable atomic<uint32_t> m_u32OpacityMaskVersion{1};
     VideoClip* m_pOwnerClip{nullptr};
     int64_t m_i64ClipStartOffset{0}, m_i64ClipEndOffset{0}, m_i64ClipDuration{0};
     imgui_json::value m_jnUiState;
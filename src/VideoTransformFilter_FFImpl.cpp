@@ -19,6 +19,10 @@
 #include <algorithm>
 #include <cmath>
 #include "VideoTransformFilter_Base.h"
+#include "AffineWarper.h"
+#include "OpacityMasker.h"
+#include "FramePool.h"
+#include "TaskExecutor.h"
 #include "FFUtils.h"
 #include "Logger.h"
 extern "C"
@@ -145,6 +149,22 @@ public:
 
         const int64_t i64Tick = pos;
         fOpacity = GetOpacity(i64Tick);
+        if (!m_ahMaskCreators.empty() && !res.empty() && res.device == IM_DD_CPU && res.c == 4 && res.type == IM_DT_INT8)
+        {
+            vector<OpacityMasker::Mask> aMasks;
+            bool bMasksChanged;
+            GetOpacityMasks(i64Tick, res.w, res.h, IM_DT_INT8, aMasks, bMasksChanged);
+            if (!aMasks.empty())
+            {
+                // the pass-through result shares the data with the input image
+                if (res.data == vmat.data)
+                    res = res.clone();
+                if (m_masker.Apply(res, aMasks, fOpacity, TaskExecutor::GetDefaultInstance()))
+                    fOpacity = 1.f;
+                else
+                    Log(Error) << "FAILED to apply the opacity masks! Error message is '" << m_masker.GetError() << "'." << endl;
+            }
+        }
         return res;
     }
 
@@ -336,6 +356,29 @@ private:
         return true;
     }
 
+    void CalcCropRect(uint32_t cropL, uint32_t cropR, uint32_t cropT, uint32_t cropB,
+            uint32_t& rectX, uint32_t& rectY, uint32_t& rectW, uint32_t& rectH) const
+    {
+        rectX = cropL<m_u32InWidth ? cropL : m_u32InWidth-1;
+        uint32_t rectX1 = cropR<m_u32InWidth ? m_u32InWidth-cropR : 0;
+        if (rectX < rectX1)
+            rectW = rectX1-rectX;
+        else
+        {
+            rectW = rectX-rectX1;
+            rectX = rectX1;
+        }
+        rectY = cropT<m_u32InHeight ? cropT : m_u32InHeight-1;
+        uint32_t rectY1 = cropB<m_u32InHeight ? m_u32InHeight-cropB : 0;
+        if (rectY < rectY1)
+            rectH = rectY1-rectY;
+        else
+        {
+            rectH = rectY-rectY1;
+            rectY = rectY1;
+        }
+    }
+
     bool PerformCropStage(const ImGui::ImMat& inMat, SelfFreeAVFramePtr& avfrmPtr)
     {
         if (m_bNeedUpdateCropRatioParam)
@@ -348,30 +391,7 @@ private:
             m_bNeedUpdateCropParam = true;
         }
         if (m_bNeedUpdateCropParam)
-        {
-            uint32_t rectX = m_u32CropL<m_u32InWidth ? m_u32CropL : m_u32InWidth-1;
-            uint32_t rectX1 = m_u32CropR<m_u32InWidth ? m_u32InWidth-m_u32CropR : 0;
-            uint32_t rectW;
-            if (rectX < rectX1)
-                rectW = rectX1-rectX;
-            else
-            {
-                rectW = rectX-rectX1;
-                rectX = rectX1;
-            }
-            uint32_t rectY = m_u32CropT<m_u32InHeight ? m_u32CropT : m_u32InHeight-1;
-            uint32_t rectY1 = m_u32CropB<m_u32InHeight ? m_u32InHeight-m_u32CropB : 0;
-            uint32_t rectH;
-            if (rectY < rectY1)
-                rectH = rectY1-rectY;
-            else
-            {
-                rectH = rectY-rectY1;
-                rectY = rectY1;
-            }
-            m_cropRectX = rectX; m_cropRectY = rectY;
-            m_cropRectW = rectW; m_cropRectH = rectH;
-        }
+            CalcCropRect(m_u32CropL, m_u32CropR, m_u32CropT, m_u32CropB, m_cropRectX, m_cropRectY, m_cropRectW, m_cropRectH);
         if (m_u32CropL != 0 || m_u32CropR != 0 || m_u32CropT != 0 || m_u32CropB != 0)
         {
             if (!avfrmPtr->data[0])
@@ -420,48 +440,53 @@ private:
         return true;
     }
 
-    bool PerformScaleStage(const ImGui::ImMat& inMat, SelfFreeAVFramePtr& avfrmPtr)
+    void CalcRealScaleRatios(float& ratioH, float& ratioV) const
     {
-        if (m_bNeedUpdateScaleParam)
+        uint32_t fitScaleWidth{m_u32InWidth}, fitScaleHeight{m_u32InHeight};
+        switch (m_eAspectFitType)
         {
-            uint32_t fitScaleWidth{m_u32InWidth}, fitScaleHeight{m_u32InHeight};
-            switch (m_eAspectFitType)
+            case ASPECT_FIT_TYPE__FIT:
+            if (m_u32InWidth*m_u32OutHeight > m_u32InHeight*m_u32OutWidth)
             {
-                case ASPECT_FIT_TYPE__FIT:
-                if (m_u32InWidth*m_u32OutHeight > m_u32InHeight*m_u32OutWidth)
-                {
-                    fitScaleWidth = m_u32OutWidth;
-                    fitScaleHeight = (uint32_t)round((float)m_u32InHeight*m_u32OutWidth/m_u32InWidth);
-                }
-                else
-                {
-                    fitScaleHeight = m_u32OutHeight;
-                    fitScaleWidth = (uint32_t)round((float)m_u32InWidth*m_u32OutHeight/m_u32InHeight);
-                }
-                break;
-                case ASPECT_FIT_TYPE__CROP:
-                fitScaleWidth = m_u32InWidth;
-                fitScaleHeight = m_u32InHeight;
-                break;
-                case ASPECT_FIT_TYPE__FILL:
-                if (m_u32InWidth*m_u32OutHeight > m_u32InHeight*m_u32OutWidth)
-                {
-                    fitScaleHeight = m_u32OutHeight;
-                    fitScaleWidth = (uint32_t)round((float)m_u32InWidth*m_u32OutHeight/m_u32InHeight);
-                }
-                else
-                {
-                    fitScaleWidth = m_u32OutWidth;
-                    fitScaleHeight = (uint32_t)round((float)m_u32InHeight*m_u32OutWidth/m_u32InWidth);
-                }
-                break;
-                case ASPECT_FIT_TYPE__STRETCH:
                 fitScaleWidth = m_u32OutWidth;
+                fitScaleHeight = (uint32_t)round((float)m_u32InHeight*m_u32OutWidth/m_u32InWidth);
+            }
+            else
+            {
                 fitScaleHeight = m_u32OutHeight;
-                break;
+                fitScaleWidth = (uint32_t)round((float)m_u32InWidth*m_u32OutHeight/m_u32InHeight);
             }
-            m_realScaleRatioH = (float)fitScaleWidth/m_u32InWidth*m_fScaleX;
-            m_realScaleRatioV = (float)fitScaleHeight/m_u32InHeight*(m_bKeepAspectRatio ? m_fScaleX : m_fScaleY);
+            break;
+            case ASPECT_FIT_TYPE__CROP:
+            fitScaleWidth = m_u32InWidth;
+            fitScaleHeight = m_u32InHeight;
+            break;
+            case ASPECT_FIT_TYPE__FILL:
+            if (m_u32InWidth*m_u32OutHeight > m_u32InHeight*m_u32OutWidth)
+            {
+                fitScaleHeight = m_u32OutHeight;
+                fitScaleWidth = (uint32_t)round((float)m_u32InWidth*m_u32OutHeight/m_u32InHeight);
+            }
+            else
+            {
+                fitScaleWidth = m_u32OutWidth;
+                fitScaleHeight = (uint32_t)round((float)m_u32InHeight*m_u32OutWidth/m_u32InWidth);
+            }
+            break;
+            case ASPECT_FIT_TYPE__STRETCH:
+            fitScaleWidth = m_u32OutWidth;
+            fitScaleHeight = m_u32OutHeight;
+            break;
+        }
+        ratioH = (float)fitScaleWidth/m_u32InWidth*m_fScaleX;
+        ratioV = (float)fitScaleHeight/m_u32InHeight*(m_bKeepAspectRatio ? m_fScaleX : m_fScaleY);
+    }
+
+    bool PerformScaleStage(const ImGui::ImMat& inMat, SelfFreeAVFramePtr& avfrmPtr)
+    {
+        if (m_bNeedUpdateScaleParam)
+        {
+            CalcRealScaleRatios(m_realScaleRatioH, m_realScaleRatioV);
 
             double posOffBrH{0}, posOffBrV{0};
             int32_t scaleInputPosOffH{0}, scaleInputPosOffV{0};
@@ -766,6 +791,131 @@ private:
         return true;
     }
 
+    // The RGBA images on cpu are transformed by a single affine warp instead of the filter stages. Crop, scale, rotation
+    // and position are combined into one matrix, which is rebuilt for every frame, so the key-framed parameters don't
+    // cause any reconfiguration. The result is equal to the stages except for the interpolation.
+    bool CanUseFusedWarp(const ImGui::ImMat& inMat) const
+    {
+        return m_unifiedOutputPixfmt == AV_PIX_FMT_RGBA && inMat.device == IM_DD_CPU && inMat.c == 4 &&
+                (inMat.type == IM_DT_INT8 || inMat.type == IM_DT_FLOAT32);
+    }
+
+    // The parameters of the warp and the setup derived from them, the setup is reused while the parameters stay the same
+    struct FusedWarpSetup
+    {
+        int32_t inW{0}, inH{0}, outW{0}, outH{0};
+        uint32_t cropL{0}, cropR{0}, cropT{0}, cropB{0};
+        float ratioH{0}, ratioV{0}, angle{0};
+        int32_t posOffX{0}, posOffY{0};
+
+        bool passThrough{false};
+        bool isEmpty{false};
+        AffineWarper::Rect srcRect;
+        float invMatrix[6] = {0};
+        AffineWarper::Interpolation interp{AffineWarper::INTERP_BILINEAR};
+
+        bool HasSameParams(const FusedWarpSetup& other) const
+        {
+            return inW == other.inW && inH == other.inH && outW == other.outW && outH == other.outH &&
+                    cropL == other.cropL && cropR == other.cropR && cropT == other.cropT && cropB == other.cropB &&
+                    ratioH == other.ratioH && ratioV == other.ratioV && angle == other.angle &&
+                    posOffX == other.posOffX && posOffY == other.posOffY;
+        }
+    };
+
+    void UpdateFusedWarpSetup(int32_t inW, int32_t inH)
+    {
+        FusedWarpSetup setup;
+        setup.inW = inW; setup.inH = inH;
+        setup.outW = m_u32OutWidth; setup.outH = m_u32OutHeight;
+        setup.cropL = m_u32CropL; setup.cropR = m_u32CropR; setup.cropT = m_u32CropT; setup.cropB = m_u32CropB;
+        if (m_bNeedUpdateCropRatioParam)
+        {
+            setup.cropL = m_u32InWidth * m_fCropRatioL;
+            setup.cropR = m_u32InWidth * m_fCropRatioR;
+            setup.cropT = m_u32InHeight * m_fCropRatioT;
+            setup.cropB = m_u32InHeight * m_fCropRatioB;
+        }
+        CalcRealScaleRatios(setup.ratioH, setup.ratioV);
+        setup.angle = m_fRotateAngle;
+        setup.posOffX = m_i32PosOffsetX; setup.posOffY = m_i32PosOffsetY;
+        if (m_bHasWarpSetup && setup.HasSameParams(m_tWarpSetup))
+            return;
+
+        const int32_t outW = setup.outW, outH = setup.outH;
+        const float ratioH = setup.ratioH, ratioV = setup.ratioV;
+        const bool isCropped = setup.cropL != 0 || setup.cropR != 0 || setup.cropT != 0 || setup.cropB != 0;
+        setup.passThrough = !isCropped && ratioH == 1 && ratioV == 1 && setup.angle == 0 && inW == outW && inH == outH &&
+                setup.posOffX == 0 && setup.posOffY == 0;
+        setup.isEmpty = ratioH <= 0 || ratioV <= 0;
+        uint32_t rectX, rectY, rectW, rectH;
+        CalcCropRect(setup.cropL, setup.cropR, setup.cropT, setup.cropB, rectX, rectY, rectW, rectH);
+        setup.srcRect.x = rectX; setup.srcRect.y = rectY;
+        setup.srcRect.w = rectW; setup.srcRect.h = rectH;
+        float* invMatrix = setup.invMatrix;
+        if (ratioH == 1 && ratioV == 1 && setup.angle == 0)
+        {
+            // pure translation, use the same integer position as the position stage
+            const int32_t ovlyX = (outW-inW)/2+setup.posOffX;
+            const int32_t ovlyY = (outH-inH)/2+setup.posOffY;
+            invMatrix[0] = 1; invMatrix[1] = 0; invMatrix[2] = -ovlyX;
+            invMatrix[3] = 0; invMatrix[4] = 1; invMatrix[5] = -ovlyY;
+            setup.interp = AffineWarper::INTERP_BILINEAR;
+        }
+        else if (!setup.isEmpty)
+        {
+            // The forward mapping is 'q = R*S*(p-inCenter)+outCenter+posOffset' on the pixel centers, where 'R' rotates
+            // clockwise in the image coordinates like the 'rotate' filter. The inverse mapping is built for the warp.
+            const double radians = setup.angle*M_PI/180;
+            const double cosA = cos(radians), sinA = sin(radians);
+            const double u0 = 0.5-outW/2.0-setup.posOffX;
+            const double v0 = 0.5-outH/2.0-setup.posOffY;
+            invMatrix[0] = (float)(cosA/ratioH);
+            invMatrix[1] = (float)(sinA/ratioH);
+            invMatrix[2] = (float)(inW/2.0-0.5+(cosA*u0+sinA*v0)/ratioH);
+            invMatrix[3] = (float)(-sinA/ratioV);
+            invMatrix[4] = (float)(cosA/ratioV);
+            invMatrix[5] = (float)(inH/2.0-0.5+(cosA*v0-sinA*u0)/ratioV);
+            setup.interp = ratioH < 1 || ratioV < 1 ? AffineWarper::INTERP_AREA : AffineWarper::INTERP_BICUBIC;
+        }
+        m_tWarpSetup = setup;
+        m_bHasWarpSetup = true;
+    }
+
+    bool PerformFusedWarp(const ImGui::ImMat& inMat, ImGui::ImMat& outMat)
+    {
+        UpdateFusedWarpSetup(inMat.w, inMat.h);
+        const auto& setup = m_tWarpSetup;
+        if (setup.passThrough)
+        {
+            outMat = inMat;
+            return true;
+        }
+
+        ImGui::ImMat warpedMat;
+        if (!FramePool::GetDefaultInstance()->AcquireMat(warpedMat, setup.outW, setup.outH, 4, IM_DT_INT8))
+            warpedMat.create_type(setup.outW, setup.outH, 4, IM_DT_INT8);
+        if (setup.isEmpty)
+        {
+            memset(warpedMat.data, 0, (size_t)setup.outW*setup.outH*4);
+        }
+        else if (!m_warper.Warp(warpedMat, inMat, setup.invMatrix, setup.srcRect, setup.interp, TaskExecutor::GetDefaultInstance()))
+        {
+            ostringstream oss;
+            oss << "FAILED to warp the image! Error message is '" << m_warper.GetError() << "'.";
+            m_strErrMsg = oss.str();
+            return false;
+        }
+        warpedMat.color_format = inMat.color_format;
+        warpedMat.color_space = inMat.color_space;
+        warpedMat.color_range = inMat.color_range;
+        warpedMat.depth = 8;
+        warpedMat.flags = IM_MAT_FLAGS_VIDEO_FRAME;
+        warpedMat.time_stamp = inMat.time_stamp;
+        outMat = warpedMat;
+        return true;
+    }
+
     bool _filterImage(const ImGui::ImMat& inMat, ImGui::ImMat& outMat, int64_t pos)
     {
         m_u32InWidth = inMat.w; m_u32InHeight = inMat.h;
@@ -774,6 +924,9 @@ private:
             Log(Error) << "[VideoTransformFilter_FFImpl::_filterImage] 'UpdateParamsByKeyFrames()' at pos " << pos << " FAILED!" << endl;
             return false;
         }
+        // the update flags are kept for the filter stages, in case a later frame can't be warped
+        if (CanUseFusedWarp(inMat))
+            return PerformFusedWarp(inMat, outMat);
 
         // allocate intermediate AVFrame
         SelfFreeAVFramePtr avfrmPtr = AllocSelfFreeAVFramePtr();
@@ -821,6 +974,10 @@ private:
 
     ImMatToAVFrameConverter m_mat2frmCvt;
     AVFrameToImMatConverter m_frm2matCvt;
+    AffineWarper m_warper;
+    OpacityMasker m_masker;
+    FusedWarpSetup m_tWarpSetup;
+    bool m_bHasWarpSetup{false};
 
     AVFilterGraph* m_scaleFg{nullptr};
     AVFilterContext* m_scaleInputCtx{nullptr};
@@ -100,28 +100,22 @@ public:
         fOpacity = GetOpacity(i64Tick);
         if (!m_ahMaskCreators.empty())
         {
-            ImGui::ImMat mCombinedMask;
-            const MatUtils::Size2i szImageSize(res.w, res.h);
-            const auto v2WaOffsetRatio = MatUtils::ToImVec2(GetPosOffsetRatio());
-            const auto v2WaScale = MatUtils::ToImVec2(GetScale());
-            const auto v2OutSize = MatUtils::ToImVec2(GetOutSize());
-            const auto v2WaOffset = v2WaOffsetRatio*(v2WaScale+ImVec2(1,1))*v2OutSize/2.f;
-            const auto fWaRotAngle = GetRotation();
-            const auto szMaskCnt = m_ahMaskCreators.size();
-            for (auto i = 0; i < szMaskCnt; i++)
+            vector<OpacityMasker::Mask> aMasks;
+            bool bMasksChanged;
+            GetOpacityMasks(i64Tick, res.w, res.h, IM_DT_FLOAT32, aMasks, bMasksChanged);
+            // the combined mask is kept until any of the masks is rasterised again
+            if (bMasksChanged)
             {
-                auto& hMaskCreator = m_ahMaskCreators[i];
-                if (szImageSize != hMaskCreator->GetMaskSize())
-                    hMaskCreator->ChangeMaskSize(szImageSize, true);
-                m_ahMaskCreators[i]->SetMaskWarpAffineParameters(v2WaOffset, v2WaScale, -fWaRotAngle, MatUtils::ToImVec2(szImageSize)/2.f);
-                if (!hMaskCreator->IsMaskReady())
-                    continue;
-                auto mMask = m_ahMaskCreators[i]->GetMask(ImGui::MaskCreator::AA, true, IM_DT_FLOAT32, 1, 0, i64Tick);
-                if (mCombinedMask.empty())
-                    mCombinedMask = mMask.clone();
-                else
-                    MatUtils::Max(mCombinedMask, mMask);
+                m_mCombinedMask.release();
+                for (const auto& tMask : aMasks)
+                {
+                    if (m_mCombinedMask.empty())
+                        m_mCombinedMask = aMasks.size() > 1 ? tMask.image.clone() : tMask.image;
+                    else
+                        MatUtils::Max(m_mCombinedMask, tMask.image);
+                }
             }
+            const auto& mCombinedMask = m_mCombinedMask;
             if (!mCombinedMask.empty())
             {
                 if (!m_pOpacityFilter) m_pOpacityFilter = new ImGui::OpacityFilter_vulkan();
@@ -268,6 +262,7 @@ private:
     ImPixel m_tCropRect;
     ImInterpolateMode m_eInterpMode{IM_INTERPOLATE_BICUBIC};
     ImGui::OpacityFilter_vulkan* m_pOpacityFilter{nullptr};
+    ImGui::ImMat m_mCombinedMask;
     bool m_bPassThrough{false};
     std::string m_strErrMsg;
 };
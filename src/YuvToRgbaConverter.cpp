@@ -0,0 +1,815 @@
+/*
+    Copyright (c) 2023-2024 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "YuvToRgbaConverter.h"
+#include "CpuFeatures.h"
+
+
+using namespace std;
+
+namespace MediaCore
+{
+using Coeffs = YuvToRgbaConverter::Coeffs;
+using Taps = YuvToRgbaConverter::Taps;
+
+static inline float Clamp01(float v)
+{
+    return v <= 0.f ? 0.f : (v >= 1.f ? 1.f : v);
+}
+
+// a value in [0, 1] stored as the output type
+template<typename T> static inline T StoreValue(float v);
+
+template<> inline uint8_t StoreValue<uint8_t>(float v)
+{
+    return (uint8_t)(Clamp01(v)*255.f+0.5f);
+}
+
+template<> inline uint16_t StoreValue<uint16_t>(float v)
+{
+    return (uint16_t)(Clamp01(v)*65535.f+0.5f);
+}
+
+template<> inline float StoreValue<float>(float v)
+{
+    return Clamp01(v);
+}
+
+static void LoadLuma8_C(uint16_t* dst, const uint8_t* src, int count, int shift)
+{
+    for (int i = 0; i < count; i++)
+        dst[i] = src[i];
+}
+
+static void LoadLuma16_C(uint16_t* dst, const uint8_t* src, int count, int shift)
+{
+    const uint16_t* s = (const uint16_t*)src;
+    for (int i = 0; i < count; i++)
+        dst[i] = s[i]>>shift;
+}
+
+static void LoadChroma8_C(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift)
+{
+    for (int i = 0; i < count; i++)
+    {
+        u[i] = src[i*2];
+        v[i] = src[i*2+1];
+    }
+}
+
+static void LoadChroma16_C(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift)
+{
+    const uint16_t* s = (const uint16_t*)src;
+    for (int i = 0; i < count; i++)
+    {
+        u[i] = s[i*2]>>shift;
+        v[i] = s[i*2+1]>>shift;
+    }
+}
+
+template<typename T>
+static void YuvToRgbaRow_C(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    T* p = (T*)rgba;
+    for (int i = 0; i < count; i++, p += 4)
+    {
+        const float yf = y[i]*k.yScale+k.yBias;
+        const float uf = u[i>>1]-k.cOffset, vf = v[i>>1]-k.cOffset;
+        p[0] = StoreValue<T>(yf+k.rv*vf);
+        p[1] = StoreValue<T>(yf-k.gu*uf-k.gv*vf);
+        p[2] = StoreValue<T>(yf+k.bu*uf);
+        p[3] = StoreValue<T>(1.f);
+    }
+}
+
+static void ResampleRow_C(float* dst, const float* src, const Taps& taps)
+{
+    const float* w = taps.weights.data();
+    for (int i = 0; i < taps.dstSize; i++, w += taps.maxCount)
+    {
+        const float* s = src+(size_t)taps.starts[i]*4;
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int j = 0; j < taps.counts[i]; j++, s += 4)
+        {
+            acc[0] += s[0]*w[j]; acc[1] += s[1]*w[j];
+            acc[2] += s[2]*w[j]; acc[3] += s[3]*w[j];
+        }
+        memcpy(dst+(size_t)i*4, acc, sizeof(acc));
+    }
+}
+
+static void SumRows_C(float* dst, const float* const* rows, const float* weights, int rowCount, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float acc = 0.f;
+        for (int j = 0; j < rowCount; j++)
+            acc += rows[j][i]*weights[j];
+        dst[i] = acc;
+    }
+}
+
+template<typename T>
+static void StoreRow_C(void* dst, const float* rgba, int count)
+{
+    T* d = (T*)dst;
+    for (int i = 0; i < count*4; i++)
+        d[i] = StoreValue<T>(rgba[i]);
+}
+
+#if MC_CPU_X86
+MC_TARGET("sse4.1") static void LoadLuma8_SSE4(uint16_t* dst, const uint8_t* src, int count, int shift)
+{
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(src+i))));
+    LoadLuma8_C(dst+i, src+i, count-i, shift);
+}
+
+MC_TARGET("sse4.1") static void LoadLuma16_SSE4(uint16_t* dst, const uint8_t* src, int count, int shift)
+{
+    const uint16_t* s = (const uint16_t*)src;
+    const __m128i vShift = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_srl_epi16(_mm_loadu_si128((const __m128i*)(s+i)), vShift));
+    LoadLuma16_C(dst+i, (const uint8_t*)(s+i), count-i, shift);
+}
+
+MC_TARGET("sse4.1") static void LoadChroma8_SSE4(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift)
+{
+    const __m128i vLowMask = _mm_set1_epi16(0xff);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        const __m128i uv = _mm_loadu_si128((const __m128i*)(src+i*2));
+        _mm_storeu_si128((__m128i*)(u+i), _mm_and_si128(uv, vLowMask));
+        _mm_storeu_si128((__m128i*)(v+i), _mm_srli_epi16(uv, 8));
+    }
+    LoadChroma8_C(u+i, v+i, src+i*2, count-i, shift);
+}
+
+MC_TARGET("sse4.1") static void LoadChroma16_SSE4(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift)
+{
+    const uint16_t* s = (const uint16_t*)src;
+    const __m128i vLowMask = _mm_set1_epi32(0xffff);
+    const __m128i vShift = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        const __m128i uv0 = _mm_loadu_si128((const __m128i*)(s+i*2));
+        const __m128i uv1 = _mm_loadu_si128((const __m128i*)(s+i*2+8));
+        const __m128i u8 = _mm_packus_epi32(_mm_and_si128(uv0, vLowMask), _mm_and_si128(uv1, vLowMask));
+        const __m128i v8 = _mm_packus_epi32(_mm_srli_epi32(uv0, 16), _mm_srli_epi32(uv1, 16));
+        _mm_storeu_si128((__m128i*)(u+i), _mm_srl_epi16(u8, vShift));
+        _mm_storeu_si128((__m128i*)(v+i), _mm_srl_epi16(v8, vShift));
+    }
+    LoadChroma16_C(u+i, v+i, (const uint8_t*)(s+i*2), count-i, shift);
+}
+
+MC_TARGET("sse4.1") static inline __m128 Clamp01_SSE4(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+}
+
+struct CoeffVecs_SSE4
+{
+    __m128 yScale, yBias, cOffset, rv, gu, gv, bu;
+};
+
+MC_TARGET("sse4.1") static inline CoeffVecs_SSE4 LoadCoeffs_SSE4(const Coeffs& k)
+{
+    return { _mm_set1_ps(k.yScale), _mm_set1_ps(k.yBias), _mm_set1_ps(k.cOffset),
+             _mm_set1_ps(k.rv), _mm_set1_ps(k.gu), _mm_set1_ps(k.gv), _mm_set1_ps(k.bu) };
+}
+
+// 4 pixels, the channels are computed in separate vectors
+MC_TARGET("sse4.1") static inline void YuvToRgb4_SSE4(const uint16_t* y, const uint16_t* u, const uint16_t* v, const CoeffVecs_SSE4& k,
+        __m128& r, __m128& g, __m128& b)
+{
+    const __m128 yf = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)y))), k.yScale), k.yBias);
+    int32_t u2, v2;
+    memcpy(&u2, u, 4);
+    memcpy(&v2, v, 4);
+    // each chroma sample is shared by 2 pixels
+    __m128i ui = _mm_cvtsi32_si128(u2), vi = _mm_cvtsi32_si128(v2);
+    ui = _mm_unpacklo_epi16(ui, ui);
+    vi = _mm_unpacklo_epi16(vi, vi);
+    const __m128 uf = _mm_sub_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(ui)), k.cOffset);
+    const __m128 vf = _mm_sub_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(vi)), k.cOffset);
+    r = Clamp01_SSE4(_mm_add_ps(yf, _mm_mul_ps(k.rv, vf)));
+    g = Clamp01_SSE4(_mm_sub_ps(yf, _mm_add_ps(_mm_mul_ps(k.gu, uf), _mm_mul_ps(k.gv, vf))));
+    b = Clamp01_SSE4(_mm_add_ps(yf, _mm_mul_ps(k.bu, uf)));
+}
+
+// the 8-bit channels of a pixel are packed into one 32-bit lane
+MC_TARGET("sse4.1") static void YuvToRgbaRowU8_SSE4(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    const CoeffVecs_SSE4 kv = LoadCoeffs_SSE4(k);
+    const __m128 vScale = _mm_set1_ps(255.f);
+    const __m128i vAlpha = _mm_set1_epi32((int)0xff000000);
+    uint8_t* p = (uint8_t*)rgba;
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        __m128 r, g, b;
+        YuvToRgb4_SSE4(y+i, u+i/2, v+i/2, kv, r, g, b);
+        const __m128i ri = _mm_cvtps_epi32(_mm_mul_ps(r, vScale));
+        const __m128i gi = _mm_cvtps_epi32(_mm_mul_ps(g, vScale));
+        const __m128i bi = _mm_cvtps_epi32(_mm_mul_ps(b, vScale));
+        const __m128i px = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), vAlpha));
+        _mm_storeu_si128((__m128i*)(p+(size_t)i*4), px);
+    }
+    YuvToRgbaRow_C<uint8_t>(p+(size_t)i*4, y+i, u+i/2, v+i/2, count-i, k);
+}
+
+// R and G of a pixel are packed into one 32-bit lane, B and A into another one, then the lanes are interleaved
+MC_TARGET("sse4.1") static void YuvToRgbaRowU16_SSE4(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    const CoeffVecs_SSE4 kv = LoadCoeffs_SSE4(k);
+    const __m128 vScale = _mm_set1_ps(65535.f);
+    const __m128i vAlpha = _mm_set1_epi32((int)0xffff0000);
+    uint16_t* p = (uint16_t*)rgba;
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        __m128 r, g, b;
+        YuvToRgb4_SSE4(y+i, u+i/2, v+i/2, kv, r, g, b);
+        const __m128i rg = _mm_or_si128(_mm_cvtps_epi32(_mm_mul_ps(r, vScale)), _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(g, vScale)), 16));
+        const __m128i ba = _mm_or_si128(_mm_cvtps_epi32(_mm_mul_ps(b, vScale)), vAlpha);
+        _mm_storeu_si128((__m128i*)(p+(size_t)i*4), _mm_unpacklo_epi32(rg, ba));
+        _mm_storeu_si128((__m128i*)(p+(size_t)i*4+8), _mm_unpackhi_epi32(rg, ba));
+    }
+    YuvToRgbaRow_C<uint16_t>(p+(size_t)i*4, y+i, u+i/2, v+i/2, count-i, k);
+}
+
+// the channel vectors are transposed into pixels
+MC_TARGET("sse4.1") static void YuvToRgbaRowF32_SSE4(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    const CoeffVecs_SSE4 kv = LoadCoeffs_SSE4(k);
+    float* p = (float*)rgba;
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        __m128 r, g, b, a = _mm_set1_ps(1.f);
+        YuvToRgb4_SSE4(y+i, u+i/2, v+i/2, kv, r, g, b);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        float* q = p+(size_t)i*4;
+        _mm_storeu_ps(q, r);
+        _mm_storeu_ps(q+4, g);
+        _mm_storeu_ps(q+8, b);
+        _mm_storeu_ps(q+12, a);
+    }
+    YuvToRgbaRow_C<float>(p+(size_t)i*4, y+i, u+i/2, v+i/2, count-i, k);
+}
+
+// One pixel is held by one vector, so the 4 channels are resampled at once.
+MC_TARGET("sse4.1") static void ResampleRow_SSE4(float* dst, const float* src, const Taps& taps)
+{
+    const float* w = taps.weights.data();
+    for (int i = 0; i < taps.dstSize; i++, w += taps.maxCount)
+    {
+        const float* s = src+(size_t)taps.starts[i]*4;
+        __m128 acc = _mm_setzero_ps();
+        for (int j = 0; j < taps.counts[i]; j++, s += 4)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s), _mm_set1_ps(w[j])));
+        _mm_storeu_ps(dst+(size_t)i*4, acc);
+    }
+}
+
+MC_TARGET("sse4.1") static void SumRows_SSE4(float* dst, const float* const* rows, const float* weights, int rowCount, int count)
+{
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        __m128 acc = _mm_setzero_ps();
+        for (int j = 0; j < rowCount; j++)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[j]+i), _mm_set1_ps(weights[j])));
+        _mm_storeu_ps(dst+i, acc);
+    }
+    for (; i < count; i++)
+    {
+        float acc = 0.f;
+        for (int j = 0; j < rowCount; j++)
+            acc += rows[j][i]*weights[j];
+        dst[i] = acc;
+    }
+}
+
+MC_TARGET("sse4.1") static inline __m128i ScaleToInt_SSE4(const float* p, __m128 vScale)
+{
+    return _mm_cvtps_epi32(_mm_mul_ps(Clamp01_SSE4(_mm_loadu_ps(p)), vScale));
+}
+
+MC_TARGET("sse4.1") static void StoreRowU8_SSE4(void* dst, const float* rgba, int count)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const __m128 vScale = _mm_set1_ps(255.f);
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        const float* p = rgba+(size_t)i*4;
+        const __m128i lo = _mm_packus_epi32(ScaleToInt_SSE4(p, vScale), ScaleToInt_SSE4(p+4, vScale));
+        const __m128i hi = _mm_packus_epi32(ScaleToInt_SSE4(p+8, vScale), ScaleToInt_SSE4(p+12, vScale));
+        _mm_storeu_si128((__m128i*)(d+(size_t)i*4), _mm_packus_epi16(lo, hi));
+    }
+    StoreRow_C<uint8_t>(d+(size_t)i*4, rgba+(size_t)i*4, count-i);
+}
+
+MC_TARGET("sse4.1") static void StoreRowU16_SSE4(void* dst, const float* rgba, int count)
+{
+    uint16_t* d = (uint16_t*)dst;
+    const __m128 vScale = _mm_set1_ps(65535.f);
+    int i = 0;
+    for (; i+2 <= count; i += 2)
+    {
+        const float* p = rgba+(size_t)i*4;
+        _mm_storeu_si128((__m128i*)(d+(size_t)i*4), _mm_packus_epi32(ScaleToInt_SSE4(p, vScale), ScaleToInt_SSE4(p+4, vScale)));
+    }
+    StoreRow_C<uint16_t>(d+(size_t)i*4, rgba+(size_t)i*4, count-i);
+}
+
+MC_TARGET("sse4.1") static void StoreRowF32_SSE4(void* dst, const float* rgba, int count)
+{
+    float* d = (float*)dst;
+    for (int i = 0; i < count*4; i += 4)
+        _mm_storeu_ps(d+i, Clamp01_SSE4(_mm_loadu_ps(rgba+i)));
+}
+#endif
+
+#if MC_CPU_NEON
+static void LoadLuma8_NEON(uint16_t* dst, const uint8_t* src, int count, int shift)
+{
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+        vst1q_u16(dst+i, vmovl_u8(vld1_u8(src+i)));
+    LoadLuma8_C(dst+i, src+i, count-i, shift);
+}
+
+static void LoadLuma16_NEON(uint16_t* dst, const uint8_t* src, int count, int shift)
+{
+    const uint16_t* s = (const uint16_t*)src;
+    const int16x8_t vShift = vdupq_n_s16((int16_t)-shift);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+        vst1q_u16(dst+i, vshlq_u16(vld1q_u16(s+i), vShift));
+    LoadLuma16_C(dst+i, (const uint8_t*)(s+i), count-i, shift);
+}
+
+static void LoadChroma8_NEON(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift)
+{
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        const uint8x8x2_t uv = vld2_u8(src+i*2);
+        vst1q_u16(u+i, vmovl_u8(uv.val[0]));
+        vst1q_u16(v+i, vmovl_u8(uv.val[1]));
+    }
+    LoadChroma8_C(u+i, v+i, src+i*2, count-i, shift);
+}
+
+static void LoadChroma16_NEON(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift)
+{
+    const uint16_t* s = (const uint16_t*)src;
+    const int16x8_t vShift = vdupq_n_s16((int16_t)-shift);
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        const uint16x8x2_t uv = vld2q_u16(s+i*2);
+        vst1q_u16(u+i, vshlq_u16(uv.val[0], vShift));
+        vst1q_u16(v+i, vshlq_u16(uv.val[1], vShift));
+    }
+    LoadChroma16_C(u+i, v+i, (const uint8_t*)(s+i*2), count-i, shift);
+}
+
+static inline float32x4_t Clamp01_NEON(float32x4_t v)
+{
+    return vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.f)), vdupq_n_f32(1.f));
+}
+
+static inline float32x4_t LoadChroma4_NEON(const uint16_t* c)
+{
+    uint32_t c2;
+    memcpy(&c2, c, 4);
+    const uint16x4_t v = vreinterpret_u16_u32(vdup_n_u32(c2));
+    return vcvtq_f32_u32(vmovl_u16(vzip_u16(v, v).val[0]));
+}
+
+// 4 pixels, the channels are computed in separate vectors
+static inline void YuvToRgb4_NEON(const uint16_t* y, const uint16_t* u, const uint16_t* v, const Coeffs& k,
+        float32x4_t& r, float32x4_t& g, float32x4_t& b)
+{
+    const float32x4_t yf = vmlaq_n_f32(vdupq_n_f32(k.yBias), vcvtq_f32_u32(vmovl_u16(vld1_u16(y))), k.yScale);
+    const float32x4_t uf = vsubq_f32(LoadChroma4_NEON(u), vdupq_n_f32(k.cOffset));
+    const float32x4_t vf = vsubq_f32(LoadChroma4_NEON(v), vdupq_n_f32(k.cOffset));
+    r = Clamp01_NEON(vmlaq_n_f32(yf, vf, k.rv));
+    g = Clamp01_NEON(vmlsq_n_f32(vmlsq_n_f32(yf, uf, k.gu), vf, k.gv));
+    b = Clamp01_NEON(vmlaq_n_f32(yf, uf, k.bu));
+}
+
+static inline uint16x4_t ScaleToInt_NEON(float32x4_t v, float scale)
+{
+    return vqmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), v, scale)));
+}
+
+// 8 pixels per iteration, the channels are interleaved by the store
+static void YuvToRgbaRowU8_NEON(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    uint8_t* p = (uint8_t*)rgba;
+    int i = 0;
+    for (; i+8 <= count; i += 8)
+    {
+        float32x4_t r0, g0, b0, r1, g1, b1;
+        YuvToRgb4_NEON(y+i, u+i/2, v+i/2, k, r0, g0, b0);
+        YuvToRgb4_NEON(y+i+4, u+i/2+2, v+i/2+2, k, r1, g1, b1);
+        uint8x8x4_t px;
+        px.val[0] = vqmovn_u16(vcombine_u16(ScaleToInt_NEON(r0, 255.f), ScaleToInt_NEON(r1, 255.f)));
+        px.val[1] = vqmovn_u16(vcombine_u16(ScaleToInt_NEON(g0, 255.f), ScaleToInt_NEON(g1, 255.f)));
+        px.val[2] = vqmovn_u16(vcombine_u16(ScaleToInt_NEON(b0, 255.f), ScaleToInt_NEON(b1, 255.f)));
+        px.val[3] = vdup_n_u8(0xff);
+        vst4_u8(p+(size_t)i*4, px);
+    }
+    YuvToRgbaRow_C<uint8_t>(p+(size_t)i*4, y+i, u+i/2, v+i/2, count-i, k);
+}
+
+static void YuvToRgbaRowU16_NEON(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    uint16_t* p = (uint16_t*)rgba;
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        float32x4_t r, g, b;
+        YuvToRgb4_NEON(y+i, u+i/2, v+i/2, k, r, g, b);
+        uint16x4x4_t px;
+        px.val[0] = ScaleToInt_NEON(r, 65535.f);
+        px.val[1] = ScaleToInt_NEON(g, 65535.f);
+        px.val[2] = ScaleToInt_NEON(b, 65535.f);
+        px.val[3] = vdup_n_u16(0xffff);
+        vst4_u16(p+(size_t)i*4, px);
+    }
+    YuvToRgbaRow_C<uint16_t>(p+(size_t)i*4, y+i, u+i/2, v+i/2, count-i, k);
+}
+
+static void YuvToRgbaRowF32_NEON(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k)
+{
+    float* p = (float*)rgba;
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        float32x4x4_t px;
+        YuvToRgb4_NEON(y+i, u+i/2, v+i/2, k, px.val[0], px.val[1], px.val[2]);
+        px.val[3] = vdupq_n_f32(1.f);
+        vst4q_f32(p+(size_t)i*4, px);
+    }
+    YuvToRgbaRow_C<float>(p+(size_t)i*4, y+i, u+i/2, v+i/2, count-i, k);
+}
+
+static void ResampleRow_NEON(float* dst, const float* src, const Taps& taps)
+{
+    const float* w = taps.weights.data();
+    for (int i = 0; i < taps.dstSize; i++, w += taps.maxCount)
+    {
+        const float* s = src+(size_t)taps.starts[i]*4;
+        float32x4_t acc = vdupq_n_f32(0.f);
+        for (int j = 0; j < taps.counts[i]; j++, s += 4)
+            acc = vmlaq_n_f32(acc, vld1q_f32(s), w[j]);
+        vst1q_f32(dst+(size_t)i*4, acc);
+    }
+}
+
+static void SumRows_NEON(float* dst, const float* const* rows, const float* weights, int rowCount, int count)
+{
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        float32x4_t acc = vdupq_n_f32(0.f);
+        for (int j = 0; j < rowCount; j++)
+            acc = vmlaq_n_f32(acc, vld1q_f32(rows[j]+i), weights[j]);
+        vst1q_f32(dst+i, acc);
+    }
+    for (; i < count; i++)
+    {
+        float acc = 0.f;
+        for (int j = 0; j < rowCount; j++)
+            acc += rows[j][i]*weights[j];
+        dst[i] = acc;
+    }
+}
+
+static void StoreRowU8_NEON(void* dst, const float* rgba, int count)
+{
+    uint8_t* d = (uint8_t*)dst;
+    int i = 0;
+    for (; i+4 <= count; i += 4)
+    {
+        const float* p = rgba+(size_t)i*4;
+        const uint8x8_t lo = vqmovn_u16(vcombine_u16(ScaleToInt_NEON(Clamp01_NEON(vld1q_f32(p)), 255.f), ScaleToInt_NEON(Clamp01_NEON(vld1q_f32(p+4)), 255.f)));
+        const uint8x8_t hi = vqmovn_u16(vcombine_u16(ScaleToInt_NEON(Clamp01_NEON(vld1q_f32(p+8)), 255.f), ScaleToInt_NEON(Clamp01_NEON(vld1q_f32(p+12)), 255.f)));
+        vst1q_u8(d+(size_t)i*4, vcombine_u8(lo, hi));
+    }
+    StoreRow_C<uint8_t>(d+(size_t)i*4, rgba+(size_t)i*4, count-i);
+}
+
+static void StoreRowU16_NEON(void* dst, const float* rgba, int count)
+{
+    uint16_t* d = (uint16_t*)dst;
+    int i = 0;
+    for (; i+2 <= count; i += 2)
+    {
+        const float* p = rgba+(size_t)i*4;
+        vst1q_u16(d+(size_t)i*4, vcombine_u16(ScaleToInt_NEON(Clamp01_NEON(vld1q_f32(p)), 65535.f), ScaleToInt_NEON(Clamp01_NEON(vld1q_f32(p+4)), 65535.f)));
+    }
+    StoreRow_C<uint16_t>(d+(size_t)i*4, rgba+(size_t)i*4, count-i);
+}
+
+static void StoreRowF32_NEON(void* dst, const float* rgba, int count)
+{
+    float* d = (float*)dst;
+    for (int i = 0; i < count*4; i += 4)
+        vst1q_f32(d+i, Clamp01_NEON(vld1q_f32(rgba+i)));
+}
+#endif
+
+YuvToRgbaConverter::YuvToRgbaConverter()
+{
+    m_kernelName = "C";
+    m_loadLuma[0] = LoadLuma8_C;
+    m_loadLuma[1] = LoadLuma16_C;
+    m_loadChroma[0] = LoadChroma8_C;
+    m_loadChroma[1] = LoadChroma16_C;
+    m_yuvToRgbaRow[0] = YuvToRgbaRow_C<uint8_t>;
+    m_yuvToRgbaRow[1] = YuvToRgbaRow_C<uint16_t>;
+    m_yuvToRgbaRow[2] = YuvToRgbaRow_C<float>;
+    m_resampleRow = ResampleRow_C;
+    m_sumRows = SumRows_C;
+    m_storeRow[0] = StoreRow_C<uint8_t>;
+    m_storeRow[1] = StoreRow_C<uint16_t>;
+    m_storeRow[2] = StoreRow_C<float>;
+#if MC_CPU_X86
+    static const bool s_hasSse41 = CpuHasSse41();
+    if (s_hasSse41)
+    {
+        m_kernelName = "SSE4.1";
+        m_loadLuma[0] = LoadLuma8_SSE4;
+        m_loadLuma[1] = LoadLuma16_SSE4;
+        m_loadChroma[0] = LoadChroma8_SSE4;
+        m_loadChroma[1] = LoadChroma16_SSE4;
+        m_yuvToRgbaRow[0] = YuvToRgbaRowU8_SSE4;
+        m_yuvToRgbaRow[1] = YuvToRgbaRowU16_SSE4;
+        m_yuvToRgbaRow[2] = YuvToRgbaRowF32_SSE4;
+        m_resampleRow = ResampleRow_SSE4;
+        m_sumRows = SumRows_SSE4;
+        m_storeRow[0] = StoreRowU8_SSE4;
+        m_storeRow[1] = StoreRowU16_SSE4;
+        m_storeRow[2] = StoreRowF32_SSE4;
+    }
+#elif MC_CPU_NEON
+    m_kernelName = "NEON";
+    m_loadLuma[0] = LoadLuma8_NEON;
+    m_loadLuma[1] = LoadLuma16_NEON;
+    m_loadChroma[0] = LoadChroma8_NEON;
+    m_loadChroma[1] = LoadChroma16_NEON;
+    m_yuvToRgbaRow[0] = YuvToRgbaRowU8_NEON;
+    m_yuvToRgbaRow[1] = YuvToRgbaRowU16_NEON;
+    m_yuvToRgbaRow[2] = YuvToRgbaRowF32_NEON;
+    m_resampleRow = ResampleRow_NEON;
+    m_sumRows = SumRows_NEON;
+    m_storeRow[0] = StoreRowU8_NEON;
+    m_storeRow[1] = StoreRowU16_NEON;
+    m_storeRow[2] = StoreRowF32_NEON;
+#endif
+}
+
+bool YuvToRgbaConverter::IsSupported(const Source& src, ImDataType outType)
+{
+    if (outType != IM_DT_INT8 && outType != IM_DT_INT16 && outType != IM_DT_FLOAT32)
+        return false;
+    if (src.bitDepth < 8 || src.bitDepth > 16 || src.shift < 0 || src.shift+src.bitDepth > (src.bitDepth > 8 ? 16 : 8))
+        return false;
+    if (src.log2ChromaH != 0 && src.log2ChromaH != 1)
+        return false;
+    return src.width > 0 && src.height > 0 && src.data[0] && src.data[1] && (src.semiPlanar || src.data[2]);
+}
+
+static Coeffs CalcCoeffs(const YuvToRgbaConverter::Source& src)
+{
+    double kr, kb;
+    switch (src.matrix)
+    {
+        case YuvToRgbaConverter::MATRIX_BT601:
+            kr = 0.299; kb = 0.114;
+            break;
+        case YuvToRgbaConverter::MATRIX_BT2020:
+            kr = 0.2627; kb = 0.0593;
+            break;
+        default:
+            kr = 0.2126; kb = 0.0722;
+            break;
+    }
+    const double kg = 1.0-kr-kb;
+    const double depthScale = (double)(1<<(src.bitDepth-8));
+    const double maxValue = (double)((1<<src.bitDepth)-1);
+    const double yOffset = src.fullRange ? 0.0 : 16.0*depthScale;
+    const double yRange = src.fullRange ? maxValue : 219.0*depthScale;
+    const double cRange = src.fullRange ? maxValue : 224.0*depthScale;
+    Coeffs k;
+    k.yScale = (float)(1.0/yRange);
+    k.yBias = (float)(-yOffset/yRange);
+    k.cOffset = (float)(128.0*depthScale);
+    k.rv = (float)(2.0*(1.0-kr)/cRange);
+    k.gu = (float)(2.0*kb*(1.0-kb)/kg/cRange);
+    k.gv = (float)(2.0*kr*(1.0-kr)/kg/cRange);
+    k.bu = (float)(2.0*(1.0-kb)/cRange);
+    return k;
+}
+
+static float FilterSupport(YuvToRgbaConverter::Interpolation interp)
+{
+    return interp == YuvToRgbaConverter::INTERP_BICUBIC ? 2.f : (interp == YuvToRgbaConverter::INTERP_AREA ? 0.5f : 1.f);
+}
+
+static float FilterWeight(YuvToRgbaConverter::Interpolation interp, float x)
+{
+    x = fabs(x);
+    if (interp == YuvToRgbaConverter::INTERP_BICUBIC)
+    {
+        const float A = -0.5f;
+        if (x < 1.f)
+            return ((A+2.f)*x-(A+3.f))*x*x+1.f;
+        if (x < 2.f)
+            return ((A*x-5.f*A)*x+8.f*A)*x-4.f*A;
+        return 0.f;
+    }
+    if (interp == YuvToRgbaConverter::INTERP_AREA)
+        return x < 0.5f ? 1.f : (x == 0.5f ? 0.5f : 0.f);
+    return x < 1.f ? 1.f-x : 0.f;
+}
+
+// The filters are stretched by the scale factor when downscaling, so every source pixel contributes to the output.
+static void CalcTaps(Taps& taps, int srcSize, int dstSize, YuvToRgbaConverter::Interpolation interp)
+{
+    if (taps.srcSize == srcSize && taps.dstSize == dstSize && taps.interp == interp)
+        return;
+    taps.srcSize = srcSize;
+    taps.dstSize = dstSize;
+    taps.interp = interp;
+    const double scale = (double)srcSize/dstSize;
+    // the box filter is the same as the nearest one when upscaling, use the bilinear one instead
+    if (interp == YuvToRgbaConverter::INTERP_AREA && scale < 1.0)
+        interp = YuvToRgbaConverter::INTERP_BILINEAR;
+    const bool isNearest = interp == YuvToRgbaConverter::INTERP_NEAREST;
+    const double filterScale = max(scale, 1.0);
+    const double support = isNearest ? 0.5 : FilterSupport(interp)*filterScale;
+    taps.maxCount = isNearest ? 1 : (int)ceil(support)*2+1;
+    taps.starts.assign(dstSize, 0);
+    taps.counts.assign(dstSize, 0);
+    taps.weights.assign((size_t)dstSize*taps.maxCount, 0.f);
+    for (int i = 0; i < dstSize; i++)
+    {
+        const double center = (i+0.5)*scale;
+        float* w = taps.weights.data()+(size_t)i*taps.maxCount;
+        if (isNearest)
+        {
+            taps.starts[i] = min((int)center, srcSize-1);
+            taps.counts[i] = 1;
+            w[0] = 1.f;
+            continue;
+        }
+        const int x0 = max((int)floor(center-support+0.5), 0);
+        const int x1 = min((int)floor(center+support+0.5), srcSize);
+        float sum = 0.f;
+        for (int x = x0; x < x1; x++)
+        {
+            w[x-x0] = FilterWeight(interp, (float)((x-center+0.5)/filterScale));
+            sum += w[x-x0];
+        }
+        if (sum != 0.f)
+        {
+            for (int x = x0; x < x1; x++)
+                w[x-x0] /= sum;
+        }
+        taps.starts[i] = x0;
+        taps.counts[i] = x1-x0;
+    }
+}
+
+bool YuvToRgbaConverter::Convert(ImGui::ImMat& dst, const Source& src, Interpolation interp, TaskExecutor::Holder hExecutor)
+{
+    if (dst.empty() || dst.device != IM_DD_CPU || dst.c != 4 ||
+        (dst.type != IM_DT_INT8 && dst.type != IM_DT_INT16 && dst.type != IM_DT_FLOAT32))
+    {
+        m_errMsg = "INVALID argument! 'dst' must be an allocated 4-channel cpu image of type INT8, INT16 or FLOAT32.";
+        return false;
+    }
+    if (!IsSupported(src, dst.type))
+    {
+        m_errMsg = "UNSUPPORTED source picture!";
+        return false;
+    }
+
+    const bool hResize = dst.w != src.width, vResize = dst.h != src.height;
+    if (hResize)
+        CalcTaps(m_hTaps, src.width, dst.w, interp);
+    if (vResize)
+        CalcTaps(m_vTaps, src.height, dst.h, interp);
+    const Coeffs k = CalcCoeffs(src);
+    const int sampleIdx = src.bitDepth > 8 ? 1 : 0;
+    const LoadLumaFunc loadLuma = m_loadLuma[sampleIdx];
+    const LoadChromaFunc loadChroma = m_loadChroma[sampleIdx];
+    const int typeIdx = dst.type == IM_DT_INT8 ? 0 : (dst.type == IM_DT_INT16 ? 1 : 2);
+    const StoreRowFunc storeRow = m_storeRow[typeIdx];
+    const int chromaWidth = (src.width+1)/2;
+    const size_t dstRowSize = (size_t)dst.w*4*dst.elemsize;
+    const size_t dstRowFloats = (size_t)dst.w*4;
+    // the rows of a vertical filter window are all kept, since the windows of the successive output rows overlap
+    const int ringSize = vResize ? m_vTaps.maxCount : (hResize ? 1 : 0);
+    const int bandCount = (dst.h+CPU_KERNEL_BAND_ROWS-1)/CPU_KERNEL_BAND_ROWS;
+    TaskExecutor::ParallelFor(hExecutor, bandCount, [&] (const TaskExecutor::ItemFetcher& fetchBand) {
+        vector<uint16_t> yRow(src.width), uRow(chromaWidth), vRow(chromaWidth);
+        vector<float> rgbaRow(hResize ? (size_t)src.width*4 : 0);
+        vector<float> ring(ringSize*dstRowFloats);
+        vector<int> ringRows(ringSize, -1);
+        vector<float> sumRow(vResize ? dstRowFloats : 0);
+        vector<const float*> windowRows(ringSize);
+        // a source row converted to RGBA, and resampled to the output width. It's of the output type if there is no
+        // resizing, otherwise it's of float.
+        auto convertRow = [&] (int sy, void* out, int rowType) {
+            const int cy = sy>>src.log2ChromaH;
+            loadLuma(yRow.data(), src.data[0]+(ptrdiff_t)sy*src.linesize[0], src.width, src.shift);
+            if (src.semiPlanar)
+            {
+                const uint8_t* pUV = src.data[1]+(ptrdiff_t)cy*src.linesize[1];
+                if (src.swapUV)
+                    loadChroma(vRow.data(), uRow.data(), pUV, chromaWidth, src.shift);
+                else
+                    loadChroma(uRow.data(), vRow.data(), pUV, chromaWidth, src.shift);
+            }
+            else
+            {
+                loadLuma(uRow.data(), src.data[1]+(ptrdiff_t)cy*src.linesize[1], chromaWidth, src.shift);
+                loadLuma(vRow.data(), src.data[2]+(ptrdiff_t)cy*src.linesize[2], chromaWidth, src.shift);
+            }
+            if (hResize)
+            {
+                m_yuvToRgbaRow[2](rgbaRow.data(), yRow.data(), uRow.data(), vRow.data(), src.width, k);
+                m_resampleRow((float*)out, rgbaRow.data(), m_hTaps);
+            }
+            else
+                m_yuvToRgbaRow[rowType](out, yRow.data(), uRow.data(), vRow.data(), src.width, k);
+        };
+        auto fetchRow = [&] (int sy) {
+            const int slot = sy%ringSize;
+            float* out = ring.data()+slot*dstRowFloats;
+            if (ringRows[slot] != sy)
+            {
+                convertRow(sy, out, 2);
+                ringRows[slot] = sy;
+            }
+            return (const float*)out;
+        };
+
+        int32_t band;
+        while (fetchBand(band))
+        {
+            const int y0 = band*CPU_KERNEL_BAND_ROWS, y1 = min(y0+CPU_KERNEL_BAND_ROWS, dst.h);
+            for (int y = y0; y < y1; y++)
+            {
+                uint8_t* dstRow = (uint8_t*)dst.data+dstRowSize*y;
+                if (!vResize)
+                {
+                    if (hResize)
+                        storeRow(dstRow, fetchRow(y), dst.w);
+                    else
+                        convertRow(y, dstRow, typeIdx);
+                    continue;
+                }
+                const int start = m_vTaps.starts[y], count = m_vTaps.counts[y];
+                for (int j = 0; j < count; j++)
+                    windowRows[j] = fetchRow(start+j);
+                m_sumRows(sumRow.data(), windowRows.data(), m_vTaps.weights.data()+(size_t)y*m_vTaps.maxCount, count, (int)dstRowFloats);
+                storeRow(dstRow, sumRow.data(), dst.w);
+            }
+        }
+    });
+    return true;
+}
+}
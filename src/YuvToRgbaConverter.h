@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <immat.h>
+#include "TaskExecutor.h"
+
+namespace MediaCore
+{
+// Convert a YUV picture with horizontally subsampled chroma (4:2:0 or 4:2:2, planar or semi-planar, 8 to 16 bits)
+// to a RGBA image on cpu. The range expansion, the color matrix and the resizing are done in a single pass over the
+// rows, the intermediate rows are kept in per-thread buffers. The row kernels are chosen at runtime by the cpu features
+// (SSE4.1 or NEON), the scalar kernels are used if none of them is available.
+// The output can be of type IM_DT_INT8, IM_DT_INT16 or IM_DT_FLOAT32, the alpha is always opaque.
+class YuvToRgbaConverter
+{
+public:
+    enum Interpolation
+    {
+        INTERP_NEAREST = 0,
+        INTERP_BILINEAR,
+        INTERP_BICUBIC,
+        INTERP_AREA,
+    };
+
+    enum ColorMatrix
+    {
+        MATRIX_BT601 = 0,
+        MATRIX_BT709,
+        MATRIX_BT2020,
+    };
+
+    struct Source
+    {
+        // plane 0 is Y, planes 1 and 2 are U and V, or plane 1 holds both of them if 'semiPlanar' is true
+        const uint8_t* data[3]{nullptr, nullptr, nullptr};
+        // can be negative for bottom-up pictures
+        int32_t linesize[3]{0, 0, 0};
+        int32_t width{0};
+        int32_t height{0};
+        // the samples take 2 bytes if 'bitDepth' > 8, and are stored in the bits [shift, shift+bitDepth) of them
+        int32_t bitDepth{8};
+        int32_t shift{0};
+        bool semiPlanar{false};
+        // the order of the interleaved chroma samples is VU instead of UV
+        bool swapUV{false};
+        // 1 for 4:2:0, 0 for 4:2:2
+        int32_t log2ChromaH{1};
+        ColorMatrix matrix{MATRIX_BT709};
+        bool fullRange{false};
+    };
+
+    YuvToRgbaConverter();
+    YuvToRgbaConverter(const YuvToRgbaConverter&) = delete;
+    YuvToRgbaConverter& operator=(const YuvToRgbaConverter&) = delete;
+
+    static bool IsSupported(const Source& src, ImDataType outType);
+
+    // 'dst' must be an allocated 4-channel cpu image, the source is resized to its size with 'interp'.
+    // Return false if the arguments are not supported, see 'GetError()'.
+    bool Convert(ImGui::ImMat& dst, const Source& src, Interpolation interp, TaskExecutor::Holder hExecutor = nullptr);
+
+    const char* GetKernelName() const { return m_kernelName; }
+    std::string GetError() const { return m_errMsg; }
+
+    struct Coeffs
+    {
+        // y' = y*yScale+yBias, u' = u-cOffset, v' = v-cOffset
+        float yScale, yBias, cOffset;
+        float rv, gu, gv, bu;
+    };
+
+    // The source range and the weights of each output position of a resampling pass
+    struct Taps
+    {
+        int32_t srcSize{0};
+        int32_t dstSize{0};
+        Interpolation interp{INTERP_NEAREST};
+        int32_t maxCount{0};
+        std::vector<int32_t> starts;
+        std::vector<int32_t> counts;
+        // 'maxCount' weights for each output position
+        std::vector<float> weights;
+    };
+
+    using LoadLumaFunc = void (*)(uint16_t* dst, const uint8_t* src, int count, int shift);
+    // deinterleave the semi-planar chroma
+    using LoadChromaFunc = void (*)(uint16_t* u, uint16_t* v, const uint8_t* src, int count, int shift);
+    // 'u' and 'v' are of half width, the float outputs are in [0, 1]
+    using YuvToRgbaRowFunc = void (*)(void* rgba, const uint16_t* y, const uint16_t* u, const uint16_t* v, int count, const Coeffs& k);
+    using ResampleRowFunc = void (*)(float* dst, const float* src, const Taps& taps);
+    using SumRowsFunc = void (*)(float* dst, const float* const* rows, const float* weights, int rowCount, int count);
+    using StoreRowFunc = void (*)(void* dst, const float* rgba, int count);
+
+private:
+    const char* m_kernelName;
+    // indexed by the sample size, 0 is 1 byte, 1 is 2 bytes. The planar chroma is loaded by 'm_loadLuma'.
+    LoadLumaFunc m_loadLuma[2];
+    LoadChromaFunc m_loadChroma[2];
+    ResampleRowFunc m_resampleRow;
+    SumRowsFunc m_sumRows;
+    // indexed by the output type, 0 is INT8, 1 is INT16, 2 is FLOAT32
+    YuvToRgbaRowFunc m_yuvToRgbaRow[3];
+    StoreRowFunc m_storeRow[3];
+    Taps m_hTaps, m_vTaps;
+    std::string m_errMsg;
+};
+}
@@ -1,6 +1,9 @@
 #include <string>
 #include <functional>
 #include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <ctime>
 #include "DebugHelper.h"
 #include "Logger.h"
 
@@ -8,27 +11,1100 @@ using namespace std;
 using namespace Logger;
 using namespace MediaCore;
 
+static string g_testMediaUrl;
+
+static bool CheckTestMediaUrl(const string& testCaseName, const string& argDesc = "a media url")
+{
+    if (!g_testMediaUrl.empty())
+        return true;
+    Log(Error) << "Test case '" << testCaseName << "' requires " << argDesc << " argument!" << endl;
+    return false;
+}
+
+#include "MediaParser.h"
 #include "MediaReader.h"
+// Read up to 'frameCount' frames one after another from 'startPos', in the current direction of the reader.
+// Return the count of the frames read, 'elapsed' is the time taken in milliseconds.
+static int ReadFramesInSequence(MediaReader::Holder hReader, int64_t startPos, int frameCount, int64_t& elapsed)
+{
+    bool eof = false;
+    int readCount = 0;
+    auto t0 = GetTimePoint();
+    auto hVfrm = hReader->ReadVideoFrame(startPos, eof, true);
+    while (hVfrm && !eof && readCount < frameCount)
+    {
+        ImGui::ImMat vmat;
+        hVfrm->GetMat(vmat);
+        readCount++;
+        hVfrm = hReader->ReadNextVideoFrame(eof, true);
+    }
+    elapsed = CountElapsedMillisec(t0, GetTimePoint());
+    return readCount;
+}
+
 static void Unit_CreateVideoReaderInstance()
 {
     AutoSection _as("CreateVideoInstance");
     auto hVideoReader = MediaReader::CreateVideoInstance();
 }
 
+// Seek to 'seekCount' positions and read the frame at each one. With 'polling', the frame is read in the non-blocking
+// mode and checked again every THREAD_IDLE_TIME, which is how the reader threads waited before they were notified by
+// events. Otherwise the blocking read is woken up by the frame-ready signal. Return the average latency in millisec.
+static double MeasureSeekLatency(bool polling, int seekCount, double& cpuMillisec)
+{
+    auto hVideoReader = MediaReader::CreateVideoInstance();
+    if (!hVideoReader->Open(g_testMediaUrl) || !hVideoReader->ConfigVideoReader(1.0f, 1.0f) || !hVideoReader->Start())
+    {
+        Log(Error) << "FAILED to start video reader on '" << g_testMediaUrl << "'! Error is '" << hVideoReader->GetError() << "'." << endl;
+        return 0;
+    }
+    const int64_t duration = (int64_t)(hVideoReader->GetVideoStream()->duration*1000);
+    int64_t totalLatency = 0;
+    bool eof;
+    const clock_t c0 = clock();
+    for (int i = 0; i < seekCount; i++)
+    {
+        const int64_t seekPos = duration*i/seekCount;
+        auto t0 = GetTimePoint();
+        hVideoReader->SeekTo(seekPos);
+        VideoFrame::Holder hVfrm;
+        if (polling)
+        {
+            eof = false;
+            while (!eof && CountElapsedMillisec(t0, GetTimePoint()) < 10000)
+            {
+                hVfrm = hVideoReader->ReadVideoFrame(seekPos, eof, false);
+                if (hVfrm)
+                    break;
+                this_thread::sleep_for(chrono::milliseconds(THREAD_IDLE_TIME));
+            }
+        }
+        else
+        {
+            hVfrm = hVideoReader->ReadVideoFrame(seekPos, eof, true);
+        }
+        auto t1 = GetTimePoint();
+        totalLatency += CountElapsedMillisec(t0, t1);
+        if (!hVfrm)
+            Log(WARN) << "FAILED to read video frame at " << seekPos << "ms after seeking." << endl;
+    }
+    cpuMillisec = (double)(clock()-c0)*1000/CLOCKS_PER_SEC;
+    hVideoReader->Close();
+    return (double)totalLatency/seekCount;
+}
+
+static void Unit_VideoReaderSeekLatency()
+{
+    AutoSection _as("VideoReaderSeekLatency");
+    if (!CheckTestMediaUrl("VideoReaderSeekLatency"))
+        return;
+    const int seekCount = 10;
+    double pollingCpu, eventCpu;
+    const double pollingLatency = MeasureSeekLatency(true, seekCount, pollingCpu);
+    const double eventLatency = MeasureSeekLatency(false, seekCount, eventCpu);
+    Log(INFO) << "Average seek latency: " << pollingLatency << "ms with polling every " << THREAD_IDLE_TIME << "ms, "
+            << eventLatency << "ms with event wakeup. CPU time of " << seekCount << " seeks: " << pollingCpu << "ms vs " << eventCpu << "ms." << endl;
+
+    // all the worker threads should be idle once the cache window is filled
+    auto hVideoReader = MediaReader::CreateVideoInstance();
+    if (!hVideoReader->Open(g_testMediaUrl) || !hVideoReader->ConfigVideoReader(1.0f, 1.0f) || !hVideoReader->Start())
+    {
+        Log(Error) << "FAILED to start video reader on '" << g_testMediaUrl << "'! Error is '" << hVideoReader->GetError() << "'." << endl;
+        return;
+    }
+    bool eof;
+    hVideoReader->ReadVideoFrame(0, eof, true);
+    const int idleMillisec = 3000;
+    this_thread::sleep_for(chrono::milliseconds(500));
+    const clock_t c0 = clock();
+    this_thread::sleep_for(chrono::milliseconds(idleMillisec));
+    const clock_t c1 = clock();
+    Log(INFO) << "CPU time consumed during " << idleMillisec << "ms idle period: " << (double)(c1-c0)*1000/CLOCKS_PER_SEC << "ms." << endl;
+    hVideoReader->Close();
+}
+
+static double MeasureReversePlaybackFps(uint64_t rvsDecMemLimit, int frameCount)
+{
+    auto hVideoReader = MediaReader::CreateVideoInstance();
+    if (!hVideoReader->Open(g_testMediaUrl) || !hVideoReader->ConfigVideoReader(1.0f, 1.0f)
+        || !hVideoReader->SetReverseDecodeMemoryLimit(rvsDecMemLimit) || !hVideoReader->Start())
+    {
+        Log(Error) << "FAILED to start video reader on '" << g_testMediaUrl << "'! Error is '" << hVideoReader->GetError() << "'." << endl;
+        return 0;
+    }
+    const int64_t duration = (int64_t)(hVideoReader->GetVideoStream()->duration*1000);
+    const int64_t startPos = duration > 1000 ? duration-1000 : 0;
+    hVideoReader->SetDirection(false);
+    hVideoReader->SeekTo(startPos);
+    int64_t elapsed;
+    const int readCount = ReadFramesInSequence(hVideoReader, startPos, frameCount, elapsed);
+    hVideoReader->Close();
+    return elapsed > 0 ? (double)readCount*1000/elapsed : 0;
+}
+
+static void Unit_VideoReaderReversePlayback()
+{
+    AutoSection _as("VideoReaderReversePlayback");
+    if (!CheckTestMediaUrl("VideoReaderReversePlayback"))
+        return;
+    const int frameCount = 300;
+    const double legacyFps = MeasureReversePlaybackFps(0, frameCount);
+    const double rvsDecFps = MeasureReversePlaybackFps(512ULL*1024*1024, frameCount);
+    Log(INFO) << "Reverse playback of " << frameCount << " frames: " << legacyFps << "fps with backward cache window, "
+            << rvsDecFps << "fps with reverse-decode mode." << endl;
+}
+
+static void Unit_ImageSequenceReaderPlayback()
+{
+    AutoSection _as("ImageSequenceReaderPlayback");
+    if (!CheckTestMediaUrl("ImageSequenceReaderPlayback", "an image sequence directory"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->OpenImageSequence(Ratio(25, 1), g_testMediaUrl, ".+\\.(png|exr|dpx|jpg|tif|tiff)$", false))
+    {
+        Log(Error) << "FAILED to open image sequence at '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    auto hReader = MediaReader::CreateImageSequenceInstance();
+    if (!hReader->Open(hParser) || !hReader->ConfigVideoReader(1.0f, 1.0f) || !hReader->Start())
+    {
+        Log(Error) << "FAILED to start image sequence reader! Error is '" << hReader->GetError() << "'." << endl;
+        return;
+    }
+    const int frameCount = 200;
+    int64_t elapsed;
+    const int readCount = ReadFramesInSequence(hReader, 0, frameCount, elapsed);
+    Log(INFO) << "Read " << readCount << " images in " << elapsed << "ms, " << (elapsed > 0 ? (double)readCount*1000/elapsed : 0) << "fps." << endl;
+    hReader->Close();
+}
+
+#include <vector>
+#include <random>
+static double MeasureRandomSeekLatency(MediaParser::Holder hParser, const vector<int64_t>& seekPosAry)
+{
+    auto hReader = MediaReader::CreateInstance();
+    if (!hReader->Open(hParser) || !hReader->ConfigVideoReader(1.0f, 1.0f) || !hReader->Start())
+    {
+        Log(Error) << "FAILED to start media reader on '" << hParser->GetUrl() << "'! Error is '" << hReader->GetError() << "'." << endl;
+        return -1;
+    }
+    int64_t totalLatency = 0;
+    bool eof;
+    ImGui::ImMat vmat;
+    for (auto seekPos : seekPosAry)
+    {
+        auto t0 = GetTimePoint();
+        hReader->SeekTo(seekPos);
+        if (!hReader->ReadVideoFrame(seekPos, vmat, eof, true) || vmat.empty())
+            Log(WARN) << "FAILED to read video frame at " << seekPos << "ms after seeking." << endl;
+        totalLatency += CountElapsedMillisec(t0, GetTimePoint());
+    }
+    hReader->Close();
+    return (double)totalLatency/seekPosAry.size();
+}
+
+static void Unit_MediaReaderRandomSeek()
+{
+    AutoSection _as("MediaReaderRandomSeek");
+    if (!CheckTestMediaUrl("MediaReaderRandomSeek"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl) || !hParser->HasVideo())
+    {
+        Log(Error) << "FAILED to open video file '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    const int64_t duration = (int64_t)(hParser->GetBestVideoStream()->duration*1000);
+    const int seekCount = 50;
+    vector<int64_t> seekPosAry(seekCount);
+    mt19937 rng(1234);
+    uniform_int_distribution<int64_t> dist(0, duration > 0 ? duration-1 : 0);
+    for (auto& seekPos : seekPosAry)
+        seekPos = dist(rng);
+
+    // gop tasks are planned with the seek points only, disable the index cache to avoid loading the frame index from it
+    const string cacheDir = MediaParser::GetIndexCacheDirectory();
+    MediaParser::SetIndexCacheDirectory("");
+    const double spLatency = MeasureRandomSeekLatency(hParser, seekPosAry);
+    MediaParser::SetIndexCacheDirectory(cacheDir);
+    // gop tasks are planned with the full video frame index
+    auto hIdxParser = MediaParser::CreateInstance();
+    if (!hIdxParser->Open(g_testMediaUrl) || !hIdxParser->EnableParseInfo(MediaParser::VIDEO_FRAME_INDEX) || !hIdxParser->GetVideoFrameIndex())
+    {
+        Log(Error) << "FAILED to parse video frame index of '" << g_testMediaUrl << "'! Error is '" << hIdxParser->GetError() << "'." << endl;
+        return;
+    }
+    const double idxLatency = MeasureRandomSeekLatency(hIdxParser, seekPosAry);
+    Log(INFO) << "Average latency of " << seekCount << " random seeks: " << spLatency << "ms with seek points, "
+            << idxLatency << "ms with frame index." << endl;
+}
+
+static int64_t ParseSeekPointsAndCountTime(const string& url, size_t& seekPointCount)
+{
+    auto t0 = GetTimePoint();
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(url) || !hParser->EnableParseInfo(MediaParser::VIDEO_SEEK_POINTS))
+    {
+        Log(Error) << "FAILED to parse seek points of '" << url << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return -1;
+    }
+    auto hSeekPoints = hParser->GetVideoSeekPoints();
+    seekPointCount = hSeekPoints ? hSeekPoints->size() : 0;
+    return CountElapsedMillisec(t0, GetTimePoint());
+}
+
+static void Unit_MediaParserIndexCache()
+{
+    AutoSection _as("MediaParserIndexCache");
+    if (!CheckTestMediaUrl("MediaParserIndexCache"))
+        return;
+    const string cacheDir = MediaParser::GetIndexCacheDirectory();
+    size_t seekPointCount = 0;
+    // cold open, the index cache is disabled
+    MediaParser::SetIndexCacheDirectory("");
+    const int64_t coldMillisec = ParseSeekPointsAndCountTime(g_testMediaUrl, seekPointCount);
+    // populate the cache, then reopen
+    MediaParser::SetIndexCacheDirectory(cacheDir);
+    ParseSeekPointsAndCountTime(g_testMediaUrl, seekPointCount);
+    const int64_t warmMillisec = ParseSeekPointsAndCountTime(g_testMediaUrl, seekPointCount);
+    Log(INFO) << "Parse " << seekPointCount << " seek points: cold open " << coldMillisec << "ms, warm open " << warmMillisec << "ms." << endl;
+}
+
+#include <atomic>
+#include "TaskExecutor.h"
+static void Unit_TaskExecutorThroughput()
+{
+    AutoSection _as("TaskExecutorThroughput");
+    auto hExecutor = TaskExecutor::CreateInstance(0, "TestExec");
+    const int taskCount = 100000;
+    atomic_int doneCount{0};
+    vector<TaskExecutor::Task::Holder> tasks;
+    tasks.reserve(taskCount);
+    auto t0 = GetTimePoint();
+    for (int i = 0; i < taskCount; i++)
+    {
+        auto priority = (TaskExecutor::Priority)(i%TaskExecutor::PRIORITY_COUNT);
+        tasks.push_back(hExecutor->Submit([&doneCount] { doneCount++; }, priority));
+    }
+    for (auto& hTask : tasks)
+        hTask->Wait();
+    auto t1 = GetTimePoint();
+    Log(INFO) << doneCount.load() << " tasks are executed by " << hExecutor->GetThreadCount() << " threads in " << CountElapsedMillisec(t0, t1) << "ms." << endl;
+}
+
+static void Unit_TaskExecutorLoopHandoff()
+{
+    AutoSection _as("TaskExecutorLoopHandoff");
+    auto hExecutor = TaskExecutor::CreateInstance(0, "TestExec");
+    // a producer and a consumer loop hand over items through a bounded queue, like the demuxing and decoding loops
+    const int itemCount = 100000, queueSize = 8;
+    atomic_int produced{0}, consumed{0};
+    atomic_bool started{false};
+    TaskExecutor::Loop::Holder hProducer;
+    auto hConsumer = hExecutor->StartLoop([&] {
+        if (consumed.load() >= produced.load())
+            return false;
+        consumed++;
+        hProducer->Wakeup();
+        return true;
+    });
+    auto t0 = GetTimePoint();
+    hProducer = hExecutor->StartLoop([&] {
+        // the consumer wakes up 'hProducer', so don't produce before it's assigned
+        if (!started.load() || produced.load() >= itemCount || produced.load()-consumed.load() >= queueSize)
+            return false;
+        produced++;
+        hConsumer->Wakeup();
+        return true;
+    });
+    started = true;
+    hProducer->Wakeup();
+    while (consumed.load() < itemCount)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    auto t1 = GetTimePoint();
+    hProducer->Stop();
+    hConsumer->Stop();
+    Log(INFO) << consumed.load() << " items are handed over between 2 loops in " << CountElapsedMillisec(t0, t1) << "ms." << endl;
+}
+
+#include <list>
+#include <cstring>
+#include "FramePool.h"
+static void Unit_FramePoolReuse()
+{
+    AutoSection _as("FramePoolReuse");
+    auto hPool = FramePool::CreateInstance("TestPool");
+    const int frameCount = 240, inFlightCount = 4;
+    const int width = 3840, height = 2160;
+    // simulate the conversion stage, which keeps a few frames in flight and releases the oldest one
+    auto RunLoop = [&] (bool usePool) {
+        list<ImGui::ImMat> inFlight;
+        auto t0 = GetTimePoint();
+        for (int i = 0; i < frameCount; i++)
+        {
+            ImGui::ImMat m;
+            if (usePool)
+                hPool->AcquireMat(m, width, height, 4, IM_DT_FLOAT32);
+            else
+                m.create_type(width, height, 4, IM_DT_FLOAT32);
+            memset(m.data, 0, (size_t)m.total()*m.elemsize);
+            inFlight.push_back(m);
+            if ((int)inFlight.size() > inFlightCount)
+                inFlight.pop_front();
+        }
+        return CountElapsedMillisec(t0, GetTimePoint());
+    };
+    const int64_t plainMillisec = RunLoop(false);
+    const int64_t pooledMillisec = RunLoop(true);
+    auto stats = hPool->GetStats();
+    Log(INFO) << frameCount << " frames of " << width << "x" << height << " RGBA float: " << plainMillisec << "ms without pool, "
+            << pooledMillisec << "ms with pool. Hit rate " << stats.MatHitRate()*100 << "%, " << stats.bytesHeld/(1024*1024) << "MB held." << endl;
+}
+
+#include "MemoryBudget.h"
+static void Unit_MemoryBudget()
+{
+    AutoSection _as("MemoryBudget");
+    const uint64_t MB = 1024*1024;
+    auto hBudget = MemoryBudget::CreateInstance(1024*MB, "TestBudget");
+    hBudget->SetLogLevel(VERBOSE);
+    // several clips ask for more than the limit, the playing one should get the largest share
+    vector<MemoryBudget::Consumer::Holder> consumers;
+    for (int i = 0; i < 6; i++)
+    {
+        auto hConsumer = hBudget->Register("Clip"+to_string(i));
+        hConsumer->SetDemand(400*MB);
+        hConsumer->SetPriority(i == 0 ? MemoryBudget::PRIORITY_ACTIVE : (i < 3 ? MemoryBudget::PRIORITY_NORMAL : MemoryBudget::PRIORITY_IDLE));
+        consumers.push_back(hConsumer);
+    }
+    consumers[0]->Touch();
+    for (int i = 0; i < 6; i++)
+        consumers[i]->UpdateUsage(min(consumers[i]->GetQuota(), 400*MB));
+    auto stats = hBudget->GetStats();
+    for (const auto& s : stats)
+        Log(INFO) << "  " << s.name << ": priority=" << (int)s.priority << ", demand=" << s.demand/MB << "MB, usage=" << s.usage/MB
+                << "MB, quota=" << s.quota/MB << "MB, idle=" << s.idleMillisec << "ms" << endl;
+    Log(INFO) << "Total usage " << hBudget->GetTotalUsage()/MB << "MB of limit " << hBudget->GetLimit()/MB << "MB." << endl;
+    // closing the idle clips releases their quotas to the others
+    consumers.resize(3);
+    Log(INFO) << "After releasing the idle clips, quota of 'Clip0' is " << consumers[0]->GetQuota()/MB << "MB, 'Clip1' is " << consumers[1]->GetQuota()/MB << "MB." << endl;
+}
+
+#include "ProxyManager.h"
+static double MeasureForwardPlaybackFps(MediaParser::Holder hParser, uint32_t width, uint32_t height, int frameCount)
+{
+    auto hVideoReader = MediaReader::CreateVideoInstance();
+    if (!hVideoReader->Open(hParser) || !hVideoReader->ConfigVideoReader(width, height) || !hVideoReader->Start())
+    {
+        Log(Error) << "FAILED to start video reader on '" << hParser->GetUrl() << "'! Error is '" << hVideoReader->GetError() << "'." << endl;
+        return 0;
+    }
+    int64_t elapsed;
+    const int readCount = ReadFramesInSequence(hVideoReader, 0, frameCount, elapsed);
+    hVideoReader->Close();
+    return elapsed > 0 ? (double)readCount*1000/elapsed : 0;
+}
+
+static void Unit_ProxyGeneration()
+{
+    AutoSection _as("ProxyGeneration");
+    if (!CheckTestMediaUrl("ProxyGeneration"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl))
+    {
+        Log(Error) << "FAILED to open media parser on '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    auto hProxyMgr = ProxyManager::CreateInstance();
+    auto t0 = GetTimePoint();
+    auto state = hProxyMgr->RequestProxy(hParser);
+    while (state == ProxyManager::PROXY_PENDING || state == ProxyManager::PROXY_GENERATING)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        state = hProxyMgr->GetState(g_testMediaUrl);
+    }
+    uint32_t proxyWidth = 0, proxyHeight = 0;
+    auto hProxyParser = hProxyMgr->GetProxyParser(hParser, proxyWidth, proxyHeight);
+    if (!hProxyParser)
+    {
+        Log(WARN) << "No proxy is available for '" << g_testMediaUrl << "', state=" << (int)state << "." << endl;
+        return;
+    }
+    Log(INFO) << "Proxy " << proxyWidth << "x" << proxyHeight << " is ready after " << CountElapsedMillisec(t0, GetTimePoint()) << "ms." << endl;
+    const int frameCount = 300;
+    const double originalFps = MeasureForwardPlaybackFps(hParser, proxyWidth, proxyHeight, frameCount);
+    const double proxyFps = MeasureForwardPlaybackFps(hProxyParser, proxyWidth, proxyHeight, frameCount);
+    Log(INFO) << "Playback of " << frameCount << " frames at proxy size: " << originalFps << "fps from original, " << proxyFps << "fps from proxy." << endl;
+}
+
 struct TestCase
 {
     function<void (void)> testProc;
 };
 
+#include <random>
+#include "VideoBlender.h"
+#include "FFUtils.h"
+static void Unit_VideoBlenderCpuBenchmark()
+{
+    AutoSection _as("VideoBlenderCpuBenchmark");
+    const int width = 1920, height = 1080, loopCount = 60;
+    mt19937 rng(0);
+    auto MakeImage = [&] (ImDataType dtype) {
+        ImGui::ImMat m;
+        m.create_type(width, height, 4, dtype);
+        if (dtype == IM_DT_FLOAT32)
+        {
+            uniform_real_distribution<float> dist(0.f, 1.f);
+            auto p = (float*)m.data;
+            for (size_t i = 0; i < m.total(); i++) p[i] = dist(rng);
+        }
+        else
+        {
+            auto p = (uint8_t*)m.data;
+            for (size_t i = 0; i < m.total()*m.elemsize; i++) p[i] = (uint8_t)(rng()&0xff);
+        }
+        return m;
+    };
+    auto baseImg = MakeImage(IM_DT_INT8), ovlyImg = MakeImage(IM_DT_INT8);
+    FFOverlayBlender ffBlender;
+    auto t0 = GetTimePoint();
+    for (int i = 0; i < loopCount; i++)
+        ffBlender.Blend(baseImg, ovlyImg, 0, 0);
+    const int64_t ffMillisec = CountElapsedMillisec(t0, GetTimePoint());
+
+    auto hBlender = VideoBlender::CreateInstance();
+    hBlender->EnableUseVulkan(false);
+    t0 = GetTimePoint();
+    for (int i = 0; i < loopCount; i++)
+        hBlender->Blend(baseImg, ovlyImg, 0, 0, 0.8f);
+    const int64_t cpuMillisec = CountElapsedMillisec(t0, GetTimePoint());
+
+    auto baseImgF = MakeImage(IM_DT_FLOAT32), ovlyImgF = MakeImage(IM_DT_FLOAT32);
+    t0 = GetTimePoint();
+    for (int i = 0; i < loopCount; i++)
+        hBlender->Blend(baseImgF, ovlyImgF, 0, 0, 0.8f);
+    const int64_t cpuMillisecF = CountElapsedMillisec(t0, GetTimePoint());
+    Log(INFO) << loopCount << " blendings of " << width << "x" << height << " RGBA: INT8 " << ffMillisec << "ms by 'FFOverlayBlender', "
+            << cpuMillisec << "ms by the cpu compositor; FLOAT32 " << cpuMillisecF << "ms by the cpu compositor." << endl;
+
+    // 8 layers, one blending per layer vs. single pass composition
+    const int layerCount = 8;
+    vector<VideoBlender::Layer> layers(layerCount);
+    for (int i = 0; i < layerCount; i++)
+    {
+        layers[i].image = MakeImage(IM_DT_INT8);
+        layers[i].opacity = i == 0 ? 1.f : 0.5f;
+    }
+    t0 = GetTimePoint();
+    for (int i = 0; i < loopCount; i++)
+    {
+        ImGui::ImMat mixed = layers[0].image;
+        for (int j = 1; j < layerCount; j++)
+            mixed = hBlender->Blend(mixed, layers[j].image, 0, 0, layers[j].opacity);
+    }
+    const int64_t seqMillisec = CountElapsedMillisec(t0, GetTimePoint());
+    t0 = GetTimePoint();
+    for (int i = 0; i < loopCount; i++)
+        hBlender->BlendLayers(layers, width, height, IM_DT_INT8);
+    const int64_t singlePassMillisec = CountElapsedMillisec(t0, GetTimePoint());
+    Log(INFO) << loopCount << " compositions of " << layerCount << " layers: " << seqMillisec << "ms by blending layer by layer, "
+            << singlePassMillisec << "ms by 'BlendLayers()'." << endl;
+}
+
+#include "MultiTrackVideoReader.h"
+static void MeasurePipPlayback(MediaParser::Holder hParser, bool occlusionCulling, int frameCount, double& fps, double& cpuMillisec)
+{
+    fps = cpuMillisec = 0;
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    if (!hMtvReader->Configure(1920, 1080, Ratio(25, 1), IM_DT_INT8) || !hMtvReader->Start())
+    {
+        Log(Error) << "FAILED to start MultiTrackVideoReader! Error is '" << hMtvReader->GetError() << "'." << endl;
+        return;
+    }
+    hMtvReader->EnableOcclusionCulling(occlusionCulling);
+    const int64_t duration = (int64_t)(hParser->GetBestVideoStream()->duration*1000);
+    // from top to bottom: a fullscreen track, a picture-in-picture track and a fullscreen background track
+    for (int64_t i = 0; i < 3; i++)
+    {
+        auto hTrack = hMtvReader->AddTrack(i+1);
+        auto hClip = hTrack->AddVideoClip(i+1, hParser, 0, duration, 0, 0, 0);
+        if (i == 1)
+            hClip->GetTransformFilter()->SetScale(0.3f, 0.3f);
+    }
+    hMtvReader->Refresh();
+    ImGui::ImMat vmat;
+    const clock_t c0 = clock();
+    auto t0 = GetTimePoint();
+    int readCount = 0;
+    while (readCount < frameCount && hMtvReader->ReadVideoFrameByIdx(readCount, vmat))
+        readCount++;
+    const int64_t elapsed = CountElapsedMillisec(t0, GetTimePoint());
+    cpuMillisec = (double)(clock()-c0)*1000/CLOCKS_PER_SEC;
+    fps = elapsed > 0 ? (double)readCount*1000/elapsed : 0;
+    hMtvReader->Close();
+}
+
+static void Unit_OcclusionCulling()
+{
+    AutoSection _as("OcclusionCulling");
+    if (!CheckTestMediaUrl("OcclusionCulling"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl))
+    {
+        Log(Error) << "FAILED to open media parser on '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    const int frameCount = 200;
+    double fps0, cpuMillisec0, fps1, cpuMillisec1;
+    MeasurePipPlayback(hParser, false, frameCount, fps0, cpuMillisec0);
+    MeasurePipPlayback(hParser, true, frameCount, fps1, cpuMillisec1);
+    Log(INFO) << "Playback of " << frameCount << " frames with 3 tracks: " << fps0 << "fps, cpu time " << cpuMillisec0 << "ms without occlusion culling; "
+            << fps1 << "fps, cpu time " << cpuMillisec1 << "ms with occlusion culling." << endl;
+}
+
+static int64_t ReadFramesAndCountTime(MultiTrackVideoReader::Holder hMtvReader, int frameCount)
+{
+    ImGui::ImMat vmat;
+    auto t0 = GetTimePoint();
+    for (int i = 0; i < frameCount; i++)
+    {
+        if (!hMtvReader->ReadVideoFrameByIdx(i, vmat))
+            break;
+    }
+    return CountElapsedMillisec(t0, GetTimePoint());
+}
+
+static void Unit_MixedFrameCache()
+{
+    AutoSection _as("MixedFrameCache");
+    if (!CheckTestMediaUrl("MixedFrameCache"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl))
+    {
+        Log(Error) << "FAILED to open media parser on '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    if (!hMtvReader->Configure(1280, 720, Ratio(25, 1), IM_DT_INT8) || !hMtvReader->Start())
+    {
+        Log(Error) << "FAILED to start MultiTrackVideoReader! Error is '" << hMtvReader->GetError() << "'." << endl;
+        return;
+    }
+    hMtvReader->SetFrameCacheCapacity(512ULL*1024*1024);
+    hMtvReader->EnableFrameCacheCompression(true);
+    const int64_t duration = min((int64_t)(hParser->GetBestVideoStream()->duration*1000), (int64_t)8000);
+    VideoTrack::Holder hTopTrack;
+    for (int64_t i = 0; i < 2; i++)
+    {
+        auto hTrack = hMtvReader->AddTrack(i+1);
+        auto hClip = hTrack->AddVideoClip(i+1, hParser, 0, duration, 0, 0, 0);
+        if (i == 0)
+        {
+            hClip->GetTransformFilter()->SetScale(0.5f, 0.5f);
+            hTopTrack = hTrack;
+        }
+    }
+    hMtvReader->Refresh();
+    const int frameCount = (int)hMtvReader->MillsecToFrameIndex(duration);
+    const int64_t coldMillisec = ReadFramesAndCountTime(hMtvReader, frameCount);
+    hMtvReader->SeekToByIdx(0);
+    const int64_t warmMillisec = ReadFramesAndCountTime(hMtvReader, frameCount);
+    auto stats = hMtvReader->GetFrameCacheStats();
+    Log(INFO) << "Read " << frameCount << " frames in " << coldMillisec << "ms, read them again in " << warmMillisec << "ms. Hit rate is "
+            << stats.HitRate() << ", " << stats.frameCount << " frames are cached with " << stats.bytes << " bytes (" << stats.rawBytes << " bytes before compression)." << endl;
+
+    // cut off the first half of the top clip, only the cached frames of that half are invalidated. The clip range is
+    // covered by the content hashes, 'Refresh()' is not called since it invalidates all the cached frames.
+    hTopTrack->ChangeClipRange(1, duration/2, 0);
+    hMtvReader->UpdateDuration();
+    const auto hitCount0 = hMtvReader->GetFrameCacheStats().hitCount;
+    hMtvReader->SeekToByIdx(0);
+    const int64_t editedMillisec = ReadFramesAndCountTime(hMtvReader, frameCount);
+    Log(INFO) << "After trimming the top clip, read " << frameCount << " frames in " << editedMillisec << "ms, "
+            << hMtvReader->GetFrameCacheStats().hitCount-hitCount0 << " of them are read from the cache." << endl;
+    hMtvReader->Close();
+}
+
+static double MeasureExportFps(MediaParser::Holder hParser, uint32_t mixingConcurrency, int frameCount)
+{
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    if (!hMtvReader->Configure(1920, 1080, Ratio(25, 1), IM_DT_INT8) || !hMtvReader->Start())
+    {
+        Log(Error) << "FAILED to start MultiTrackVideoReader! Error is '" << hMtvReader->GetError() << "'." << endl;
+        return 0;
+    }
+    hMtvReader->SetMixingConcurrency(mixingConcurrency);
+    hMtvReader->SetFrameCacheCapacity(0);
+    const int64_t duration = (int64_t)(hParser->GetBestVideoStream()->duration*1000);
+    // 4 overlapping layers, so the mixing is the bottleneck
+    for (int64_t i = 0; i < 4; i++)
+    {
+        auto hTrack = hMtvReader->AddTrack(i+1);
+        auto hClip = hTrack->AddVideoClip(i+1, hParser, 0, duration, 0, 0, 0);
+        hClip->GetTransformFilter()->SetScale(0.8f, 0.8f);
+    }
+    hMtvReader->Refresh();
+    const int64_t elapsed = ReadFramesAndCountTime(hMtvReader, frameCount);
+    hMtvReader->Close();
+    return elapsed > 0 ? (double)frameCount*1000/elapsed : 0;
+}
+
+static void Unit_MixingConcurrency()
+{
+    AutoSection _as("MixingConcurrency");
+    if (!CheckTestMediaUrl("MixingConcurrency"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl))
+    {
+        Log(Error) << "FAILED to open media parser on '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    const int frameCount = 200;
+    vector<uint32_t> concurrencies = {1, 2, 4};
+    const uint32_t coreCount = thread::hardware_concurrency();
+    if (coreCount > 4)
+        concurrencies.push_back(coreCount);
+    for (auto concurrency : concurrencies)
+    {
+        const double fps = MeasureExportFps(hParser, concurrency, frameCount);
+        Log(INFO) << "Export " << frameCount << " frames of 4 layers with mixing concurrency " << concurrency << ": " << fps << "fps." << endl;
+    }
+}
+
+#include <algorithm>
+static void Unit_MixingLatency()
+{
+    AutoSection _as("MixingLatency");
+    if (!CheckTestMediaUrl("MixingLatency"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl))
+    {
+        Log(Error) << "FAILED to open media parser on '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    if (!hMtvReader->Configure(1920, 1080, Ratio(25, 1), IM_DT_INT8) || !hMtvReader->Start())
+    {
+        Log(Error) << "FAILED to start MultiTrackVideoReader! Error is '" << hMtvReader->GetError() << "'." << endl;
+        return;
+    }
+    // every frame goes through the read-frame-tasks and the mixing threads
+    hMtvReader->SetFrameCacheCapacity(0);
+    const int64_t duration = (int64_t)(hParser->GetBestVideoStream()->duration*1000);
+    // 4 quarter-size tracks, none of them is occluded
+    for (int64_t i = 0; i < 4; i++)
+    {
+        auto hTrack = hMtvReader->AddTrack(i+1);
+        auto hClip = hTrack->AddVideoClip(i+1, hParser, 0, duration, 0, 0, 0);
+        hClip->GetTransformFilter()->SetScale(0.5f, 0.5f);
+    }
+    hMtvReader->Refresh();
+
+    const int frameCount = 200;
+    vector<int64_t> latencies;
+    latencies.reserve(frameCount);
+    ImGui::ImMat vmat;
+    const clock_t c0 = clock();
+    auto t0 = GetTimePoint();
+    for (int i = 0; i < frameCount; i++)
+    {
+        auto t1 = GetTimePoint();
+        if (!hMtvReader->ReadVideoFrameByIdx(i, vmat))
+            break;
+        latencies.push_back(CountElapsedMillisec(t1, GetTimePoint()));
+    }
+    const int64_t elapsed = CountElapsedMillisec(t0, GetTimePoint());
+    const double cpuMillisec = (double)(clock()-c0)*1000/CLOCKS_PER_SEC;
+    if (latencies.empty())
+    {
+        Log(Error) << "FAILED to read any mixed frame! Error is '" << hMtvReader->GetError() << "'." << endl;
+        hMtvReader->Close();
+        return;
+    }
+    const int readCount = latencies.size();
+    int64_t totalLatency = 0;
+    for (auto l : latencies)
+        totalLatency += l;
+    sort(latencies.begin(), latencies.end());
+    Log(INFO) << "Read " << readCount << " frames mixed from 4 tracks in " << elapsed << "ms, cpu time " << cpuMillisec << "ms. Per-frame latency: average "
+            << (double)totalLatency/readCount << "ms, p95 " << latencies[readCount*95/100] << "ms, max " << latencies.back() << "ms." << endl;
+
+    // the scheduler should not consume cpu once the cache window is filled and the playhead stops
+    const int idleMillisec = 3000;
+    this_thread::sleep_for(chrono::milliseconds(500));
+    const clock_t c1 = clock();
+    this_thread::sleep_for(chrono::milliseconds(idleMillisec));
+    Log(INFO) << "CPU time consumed during " << idleMillisec << "ms idle period: " << (double)(clock()-c1)*1000/CLOCKS_PER_SEC << "ms." << endl;
+    hMtvReader->Close();
+}
+
+static double MeasureScrubbingTimeToFirstPixel(MediaParser::Holder hParser, bool scrubbingPreview, const vector<int64_t>& scrubPosAry)
+{
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    if (!hMtvReader->Configure(1920, 1080, Ratio(25, 1), IM_DT_INT8) || !hMtvReader->Start())
+    {
+        Log(Error) << "FAILED to start MultiTrackVideoReader! Error is '" << hMtvReader->GetError() << "'." << endl;
+        return 0;
+    }
+    hMtvReader->EnableScrubbingPreview(scrubbingPreview);
+    hMtvReader->SetFrameCacheCapacity(0);
+    const int64_t duration = (int64_t)(hParser->GetBestVideoStream()->duration*1000);
+    auto hTrack = hMtvReader->AddTrack(1);
+    hTrack->AddVideoClip(1, hParser, 0, duration, 0, 0, 0);
+    hMtvReader->Refresh();
+    const int64_t frameMillisec = 40;
+    const int64_t timeout = 3000;
+    int64_t totalMillisec = 0;
+    ImGui::ImMat vmat;
+    for (auto pos : scrubPosAry)
+    {
+        // the first pixel is the first output mixed for this position, either a preview or the exact frame
+        auto t0 = GetTimePoint();
+        hMtvReader->ConsecutiveSeek(pos);
+        int64_t elapsed = 0;
+        while (elapsed < timeout)
+        {
+            if (hMtvReader->ReadVideoFrameByPos(pos, vmat, true) && !vmat.empty() && abs((int64_t)(vmat.time_stamp*1000)-pos) < frameMillisec)
+                break;
+            this_thread::sleep_for(chrono::milliseconds(1));
+            elapsed = CountElapsedMillisec(t0, GetTimePoint());
+        }
+        totalMillisec += elapsed;
+    }
+    hMtvReader->StopConsecutiveSeek();
+    hMtvReader->Close();
+    return (double)totalMillisec/scrubPosAry.size();
+}
+
+static void Unit_ScrubbingLatency()
+{
+    AutoSection _as("ScrubbingLatency");
+    if (!CheckTestMediaUrl("ScrubbingLatency"))
+        return;
+    auto hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(g_testMediaUrl))
+    {
+        Log(Error) << "FAILED to open media parser on '" << g_testMediaUrl << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return;
+    }
+    // jump around like a playhead being dragged back and forth
+    const int64_t duration = (int64_t)(hParser->GetBestVideoStream()->duration*1000);
+    const int scrubCount = 30;
+    vector<int64_t> scrubPosAry;
+    mt19937 rng(20240101);
+    uniform_int_distribution<int64_t> dist(0, duration > 1000 ? duration-1000 : 0);
+    for (int i = 0; i < scrubCount; i++)
+        scrubPosAry.push_back(dist(rng)/40*40);
+    const double exactMillisec = MeasureScrubbingTimeToFirstPixel(hParser, false, scrubPosAry);
+    const double previewMillisec = MeasureScrubbingTimeToFirstPixel(hParser, true, scrubPosAry);
+    Log(INFO) << "Average time-to-first-pixel of " << scrubCount << " scrubbing positions: " << exactMillisec << "ms without preview, "
+            << previewMillisec << "ms with preview." << endl;
+}
+
+static void Unit_AVFrameZeroCopy()
+{
+    AutoSection _as("AVFrameZeroCopy");
+    const int width = 3840, height = 2160, loopCount = 60;
+    auto hPool = FramePool::GetDefaultInstance();
+    auto MakeFrame = [&] (AVPixelFormat pixfmt) {
+        auto frm = AllocSelfFreeAVFramePtr();
+        frm->width = width;
+        frm->height = height;
+        frm->format = (int)pixfmt;
+        if (!hPool->AllocAVFrameBuffer(frm.get()))
+            av_frame_get_buffer(frm.get(), 0);
+        for (int i = 0; i < AV_NUM_DATA_POINTERS && frm->buf[i]; i++)
+            memset(frm->buf[i]->data, 0x80, frm->buf[i]->size);
+        return frm;
+    };
+    // decoded frame -> ImMat -> encoder input frame, as in a transcoding loop
+    auto RunLoop = [&] (const SelfFreeAVFramePtr& hInFrm, bool zeroCopy) {
+        AVFrameToImMatConverter frmCvt;
+        frmCvt.SetUseVulkanConverter(false);
+        frmCvt.SetZeroCopy(zeroCopy);
+        auto hOutFrm = AllocSelfFreeAVFramePtr();
+        auto t0 = GetTimePoint();
+        for (int i = 0; i < loopCount; i++)
+        {
+            ImGui::ImMat vmat;
+            if (!frmCvt.ConvertImage(hInFrm.get(), vmat, (double)i/25))
+            {
+                Log(Error) << "'AVFrameToImMatConverter::ConvertImage()' FAILED! " << frmCvt.GetError() << endl;
+                return (int64_t)-1;
+            }
+            ConvertImMatToAVFrame(vmat, hOutFrm.get(), i);
+        }
+        return CountElapsedMillisec(t0, GetTimePoint());
+    };
+    // only the packed rgb frames are wrapped, the yuv frames are always copied, see 'WrapAVFrameToImMat()'
+    auto hRgbaFrm = MakeFrame(AV_PIX_FMT_RGBA);
+    const int64_t rgbaCopyMillisec = RunLoop(hRgbaFrm, false);
+    const int64_t rgbaZeroCopyMillisec = RunLoop(hRgbaFrm, true);
+    Log(INFO) << loopCount << " round trips of " << width << "x" << height << " RGBA frames: " << rgbaCopyMillisec << "ms with copying, "
+            << rgbaZeroCopyMillisec << "ms with zero-copy." << endl;
+}
+
+static void Unit_YuvToRgbaConversion()
+{
+    AutoSection _as("YuvToRgbaConversion");
+    const int width = 3840, height = 2160, loopCount = 30;
+    const AVPixelFormat pixfmts[] = { AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P, AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV422P10LE };
+    const ImDataType dtypes[] = { IM_DT_INT8, IM_DT_INT16, IM_DT_FLOAT32 };
+    mt19937 rng(0);
+    auto MeasureConversion = [&] (const AVFrame* avfrm, ImDataType dtype, uint32_t outW, uint32_t outH, bool useSimd) {
+        AVFrameToImMatConverter frmCvt;
+        frmCvt.SetUseVulkanConverter(false);
+        frmCvt.SetUseSimdConverter(useSimd);
+        frmCvt.SetOutDataType(dtype);
+        frmCvt.SetOutSize(outW, outH);
+        ImGui::ImMat vmat;
+        auto t0 = GetTimePoint();
+        for (int i = 0; i < loopCount; i++)
+        {
+            if (!frmCvt.ConvertImage(avfrm, vmat, (double)i/25))
+            {
+                Log(Error) << "'AVFrameToImMatConverter::ConvertImage()' FAILED! " << frmCvt.GetError() << endl;
+                return -1.;
+            }
+        }
+        return (double)CountElapsedMillisec(t0, GetTimePoint())/loopCount;
+    };
+    for (auto pixfmt : pixfmts)
+    {
+        auto hFrm = AllocSelfFreeAVFramePtr();
+        hFrm->width = width;
+        hFrm->height = height;
+        hFrm->format = (int)pixfmt;
+        hFrm->colorspace = AVCOL_SPC_BT709;
+        hFrm->color_range = AVCOL_RANGE_MPEG;
+        av_frame_get_buffer(hFrm.get(), 0);
+        for (int i = 0; i < AV_NUM_DATA_POINTERS && hFrm->buf[i]; i++)
+        {
+            auto p = hFrm->buf[i]->data;
+            for (size_t j = 0; j < hFrm->buf[i]->size; j++) p[j] = (uint8_t)(rng()&0xff);
+        }
+        // 'swscale' always outputs INT8
+        const double swsMillisec = MeasureConversion(hFrm.get(), IM_DT_INT8, width, height, false);
+        const double swsRszMillisec = MeasureConversion(hFrm.get(), IM_DT_INT8, width/2, height/2, false);
+        Log(INFO) << av_get_pix_fmt_name(pixfmt) << " -> RGBA INT8 by swscale: " << swsMillisec << "ms per frame, " << swsRszMillisec << "ms resized to half." << endl;
+        for (auto dtype : dtypes)
+        {
+            const double simdMillisec = MeasureConversion(hFrm.get(), dtype, width, height, true);
+            const double simdRszMillisec = MeasureConversion(hFrm.get(), dtype, width/2, height/2, true);
+            Log(INFO) << av_get_pix_fmt_name(pixfmt) << " -> RGBA(dtype=" << (int)dtype << ") by the simd converter: " << simdMillisec << "ms per frame, "
+                    << simdRszMillisec << "ms resized to half." << endl;
+        }
+    }
+}
+
+#include <memory>
+#include "IntervalList.h"
+struct IntervalItem
+{
+    using Holder = shared_ptr<IntervalItem>;
+    int64_t start, end;
+    int64_t Start() const { return start; }
+    int64_t End() const { return end; }
+};
+
+static bool CheckIntervalList(IntervalList<IntervalItem::Holder>& ivList, const vector<IntervalItem::Holder>& items, mt19937& rng, int64_t posRange)
+{
+    // the list must hold the same items ordered by the start time
+    if (ivList.size() != items.size())
+    {
+        Log(Error) << "IntervalList has " << ivList.size() << " items, but " << items.size() << " are expected!" << endl;
+        return false;
+    }
+    vector<IntervalItem::Holder> ordered(ivList.begin(), ivList.end());
+    int64_t maxEnd = 0;
+    for (size_t i = 0; i < ordered.size(); i++)
+    {
+        if (ivList.At(i) != ordered[i] || (i > 0 && ordered[i-1]->start > ordered[i]->start)
+            || find(items.begin(), items.end(), ordered[i]) == items.end())
+        {
+            Log(Error) << "IntervalList item #" << i << " is out of order or unknown!" << endl;
+            return false;
+        }
+        int64_t start, end;
+        if (!ivList.GetIndexedRange(ordered[i], start, end) || start != ordered[i]->start || end != ordered[i]->end)
+        {
+            Log(Error) << "IntervalList indexed range of item #" << i << " doesn't match its range!" << endl;
+            return false;
+        }
+        maxEnd = max(maxEnd, ordered[i]->end);
+    }
+    if (ivList.MaxEnd() != maxEnd)
+    {
+        Log(Error) << "IntervalList::MaxEnd() returns " << ivList.MaxEnd() << ", but " << maxEnd << " is expected!" << endl;
+        return false;
+    }
+
+    // compare the queries with a linear scan over the ordered items
+    uniform_int_distribution<int64_t> posDist(-2, posRange+2);
+    for (int i = 0; i < 20; i++)
+    {
+        const int64_t pos = posDist(rng);
+        IntervalItem::Holder hExpected;
+        for (auto& hItem : ordered)
+        {
+            if (hItem->start <= pos && hItem->end > pos)
+            {
+                hExpected = hItem;
+                break;
+            }
+        }
+        if (ivList.FindAt(pos) != hExpected)
+        {
+            Log(Error) << "IntervalList::FindAt(" << pos << ") returns a wrong item!" << endl;
+            return false;
+        }
+
+        auto iter = find_if(ordered.begin(), ordered.end(), [pos] (const IntervalItem::Holder& hItem) { return hItem->end > pos; });
+        auto ivIter = ivList.FirstEndingAfter(pos);
+        if ((iter == ordered.end()) != (ivIter == ivList.end()) || (ivIter != ivList.end() && *ivIter != *iter))
+        {
+            Log(Error) << "IntervalList::FirstEndingAfter(" << pos << ") returns a wrong item!" << endl;
+            return false;
+        }
+
+        auto rIter = find_if(ordered.rbegin(), ordered.rend(), [pos] (const IntervalItem::Holder& hItem) { return hItem->start <= pos; });
+        ivIter = ivList.LastStartingAtOrBefore(pos);
+        if ((rIter == ordered.rend()) != (ivIter == ivList.end()) || (ivIter != ivList.end() && *ivIter != *rIter))
+        {
+            Log(Error) << "IntervalList::LastStartingAtOrBefore(" << pos << ") returns a wrong item!" << endl;
+            return false;
+        }
+
+        const int64_t rangeEnd = pos+posDist(rng)/4;
+        vector<IntervalItem::Holder> expectedInRange;
+        for (auto& hItem : ordered)
+        {
+            if (hItem->start < rangeEnd && hItem->end > pos)
+                expectedInRange.push_back(hItem);
+        }
+        if (ivList.FindInRange(pos, rangeEnd) != expectedInRange)
+        {
+            Log(Error) << "IntervalList::FindInRange(" << pos << ", " << rangeEnd << ") returns wrong items!" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Unit_IntervalListRandomized()
+{
+    AutoSection _as("IntervalListRandomized");
+    const int roundCount = 200, opCount = 500;
+    const int64_t posRange = 1000;
+    mt19937 rng(20240301);
+    uniform_int_distribution<int64_t> startDist(0, posRange);
+    // mostly short items, with a few long ones covering many others
+    uniform_int_distribution<int64_t> shortLenDist(1, 50), longLenDist(1, posRange/2);
+    uniform_int_distribution<int> opDist(0, 99);
+    auto RandomizeRange = [&] (IntervalItem& item) {
+        item.start = startDist(rng);
+        item.end = item.start+(opDist(rng) < 90 ? shortLenDist(rng) : longLenDist(rng));
+    };
+    int checkCount = 0;
+    for (int r = 0; r < roundCount; r++)
+    {
+        IntervalList<IntervalItem::Holder> ivList;
+        vector<IntervalItem::Holder> items;
+        for (int i = 0; i < opCount; i++)
+        {
+            const int op = opDist(rng);
+            if (items.empty() || op < 40)
+            {
+                IntervalItem::Holder hItem(new IntervalItem());
+                RandomizeRange(*hItem);
+                items.push_back(hItem);
+                ivList.Insert(hItem);
+            }
+            else if (op < 60)
+            {
+                const size_t index = rng()%items.size();
+                if (!ivList.Remove(items[index]))
+                {
+                    Log(Error) << "IntervalList::Remove() FAILED on an existing item!" << endl;
+                    return;
+                }
+                items.erase(items.begin()+index);
+            }
+            else if (op < 95)
+            {
+                auto& hItem = items[rng()%items.size()];
+                if (opDist(rng) < 50)
+                {
+                    RandomizeRange(*hItem);
+                }
+                else
+                {
+                    // move it a little, as dragging a clip does
+                    const int64_t offset = shortLenDist(rng)-25;
+                    hItem->start += offset;
+                    hItem->end += offset;
+                }
+                ivList.Update(hItem);
+            }
+            else
+            {
+                // the copy must keep its own iterators
+                IntervalList<IntervalItem::Holder> copied(ivList);
+                ivList.clear();
+                ivList = copied;
+            }
+            if (!CheckIntervalList(ivList, items, rng, posRange))
+            {
+                Log(Error) << "IntervalList check FAILED at round #" << r << ", operation #" << i << "." << endl;
+                return;
+            }
+            checkCount++;
+        }
+        IntervalItem::Holder hAbsent(new IntervalItem{0, 1});
+        if (ivList.Remove(hAbsent) || ivList.Find(hAbsent) != ivList.end())
+        {
+            Log(Error) << "IntervalList finds an item which is not in it!" << endl;
+            return;
+        }
+    }
+    Log(INFO) << "IntervalList matches the linear scan in " << checkCount << " checks." << endl;
+}
+
 static unordered_map<string, TestCase> g_TestUnits = {
-    {"CreateVideoReaderInstance", {Unit_CreateVideoReaderInstance}}
+    {"CreateVideoReaderInstance", {Unit_CreateVideoReaderInstance}},
+    {"VideoReaderSeekLatency", {Unit_VideoReaderSeekLatency}},
+    {"VideoReaderReversePlayback", {Unit_VideoReaderReversePlayback}},
+    {"ImageSequenceReaderPlayback", {Unit_ImageSequenceReaderPlayback}},
+    {"MediaReaderRandomSeek", {Unit_MediaReaderRandomSeek}},
+    {"TaskExecutorThroughput", {Unit_TaskExecutorThroughput}},
+    {"TaskExecutorLoopHandoff", {Unit_TaskExecutorLoopHandoff}},
+    {"MediaParserIndexCache", {Unit_MediaParserIndexCache}},
+    {"FramePoolReuse", {Unit_FramePoolReuse}},
+    {"MemoryBudget", {Unit_MemoryBudget}},
+    {"ProxyGeneration", {Unit_ProxyGeneration}},
+    {"VideoBlenderCpuBenchmark", {Unit_VideoBlenderCpuBenchmark}},
+    {"OcclusionCulling", {Unit_OcclusionCulling}},
+    {"MixedFrameCache", {Unit_MixedFrameCache}},
+    {"AVFrameZeroCopy", {Unit_AVFrameZeroCopy}},
+    {"YuvToRgbaConversion", {Unit_YuvToRgbaConversion}},
+    {"MixingLatency", {Unit_MixingLatency}},
+    {"MixingConcurrency", {Unit_MixingConcurrency}},
+    {"ScrubbingLatency", {Unit_ScrubbingLatency}},
+    {"IntervalListRandomized", {Unit_IntervalListRandomized}},
 };
 
 int main(int argc, char* argv[])
 {
     if (argc < 2)
     {
-        Log(Error) << "Wrong arguments! Usage: TestUnit <TestCaseName> [loopCount]" << endl;
+        Log(Error) << "Wrong arguments! Usage: TestUnit <TestCaseName> [loopCount] [mediaUrl]" << endl;
         return -1;
     }
 
@@ -38,6 +1114,8 @@ int main(int argc, char* argv[])
         testCaseName = string(argv[1]);
     if (argc >= 3)
         testLoopCount = atoi(argv[2]);
+    if (argc >= 4)
+        g_testMediaUrl = string(argv[3]);
 
     auto testCaseIter = g_TestUnits.find(testCaseName);
     if (testCaseIter == g_TestUnits.end())